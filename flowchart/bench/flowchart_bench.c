@@ -0,0 +1,278 @@
+// ============================================================================
+// PARSE / FINALIZE / LAYOUT / RENDER BENCHMARK
+// ============================================================================
+// Usage:
+//   flowchart_bench [options]          One workload, one JSON object
+//   flowchart_bench --suite            Built-in workloads, a JSON array
+//   flowchart_bench --emit [options]   Print the generated Mermaid source
+//
+// Options: --nodes N --density F --depth N --block N --label N --cycles N
+//          --seed N --iterations N --width F --height F
+//
+// Every workload runs in its own process so peak RSS belongs to it alone.
+
+#define _GNU_SOURCE
+#include "mermaid_gen.h"
+#include "flowchart_builder.h"
+#include "flowchart_layout.h"
+#include "flowchart_parser.h"
+#include "flowchart_renderer_terminal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef enum {
+    STAGE_PARSE,
+    STAGE_FINALIZE,
+    STAGE_LAYOUT,
+    STAGE_RENDER,
+    STAGE_COUNT
+} BenchStage;
+
+static const char* g_stage_names[STAGE_COUNT] = { "parse", "finalize", "layout", "render" };
+
+typedef struct {
+    const char* name;
+    MermaidGenParams gen;
+    uint32_t iterations;
+    float width;                       // Layout size
+    float height;
+} BenchWorkload;
+
+static double bench_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int bench_compare(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double bench_percentile(const double* sorted, uint32_t count, double p) {
+    uint32_t rank = (uint32_t)(p * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+// ============================================================================
+// One workload
+// ============================================================================
+
+static bool bench_run(const BenchWorkload* workload) {
+    size_t length = 0;
+    char* source = mermaid_generate(&workload->gen, &length);
+    if (!source) return false;
+
+    uint32_t iterations = workload->iterations ? workload->iterations : 1;
+    double* samples = (double*)calloc((size_t)iterations * STAGE_COUNT, sizeof(double));
+    if (!samples) {
+        free(source);
+        return false;
+    }
+
+    // Render into memory so terminal I/O stays out of the timings
+    char* sink_data = NULL;
+    size_t sink_size = 0;
+    FILE* sink = open_memstream(&sink_data, &sink_size);
+    if (!sink) {
+        free(samples);
+        free(source);
+        return false;
+    }
+
+    TerminalCapabilities caps = {0};
+    caps.color_depth = 256;
+    caps.supports_ansi = true;
+    caps.max_cols = 160;
+    caps.max_rows = 48;
+
+    uint32_t node_count = 0, edge_count = 0;
+    bool ok = true;
+    for (uint32_t i = 0; i < iterations && ok; i++) {
+        double* sample = samples + (size_t)i * STAGE_COUNT;
+
+        double t0 = bench_now_ms();
+        IRComponent* flowchart = ir_flowchart_parse(source, length);
+        double t1 = bench_now_ms();
+        if (!flowchart) {
+            ok = false;
+            break;
+        }
+
+        // ir_flowchart_parse finalizes too; this times finalization on its own
+        ir_flowchart_finalize(flowchart);
+        double t2 = bench_now_ms();
+
+        ir_layout_compute_flowchart(flowchart, workload->width, workload->height);
+        double t3 = bench_now_ms();
+
+        rewind(sink);
+        render_flowchart_terminal_to(sink, flowchart, &caps);
+        double t4 = bench_now_ms();
+
+        sample[STAGE_PARSE] = t1 - t0;
+        sample[STAGE_FINALIZE] = t2 - t1;
+        sample[STAGE_LAYOUT] = t3 - t2;
+        sample[STAGE_RENDER] = t4 - t3;
+
+        IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+        node_count = state->node_count;
+        edge_count = state->edge_count;
+        ir_flowchart_free_component(flowchart);
+    }
+    fclose(sink);
+    free(sink_data);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    if (ok) {
+        const MermaidGenParams* gen = &workload->gen;
+        printf("  {\"name\":\"%s\",\"params\":{\"nodes\":%u,\"density\":%g,\"depth\":%u,\"block\":%u,"
+               "\"label\":%u,\"cycles\":%u,\"seed\":%llu},\n",
+               workload->name, gen->nodes, gen->edge_density, gen->subgraph_depth, gen->block_size,
+               gen->label_length, gen->cycles, (unsigned long long)gen->seed);
+        printf("   \"source_bytes\":%zu,\"parsed_nodes\":%u,\"parsed_edges\":%u,\"iterations\":%u,\"stages\":{",
+               length, node_count, edge_count, iterations);
+
+        double* sorted = (double*)malloc(iterations * sizeof(double));
+        for (int s = 0; s < STAGE_COUNT && sorted; s++) {
+            double total = 0.0;
+            for (uint32_t i = 0; i < iterations; i++) {
+                sorted[i] = samples[(size_t)i * STAGE_COUNT + s];
+                total += sorted[i];
+            }
+            qsort(sorted, iterations, sizeof(double), bench_compare);
+            printf("%s\"%s\":{\"p50_ms\":%.4f,\"p99_ms\":%.4f,\"mean_ms\":%.4f}", s ? "," : "",
+                   g_stage_names[s], bench_percentile(sorted, iterations, 0.50),
+                   bench_percentile(sorted, iterations, 0.99), total / iterations);
+        }
+        free(sorted);
+
+        // ru_maxrss is in kilobytes on Linux
+        printf("},\n   \"peak_rss_kb\":%ld}", usage.ru_maxrss);
+        fflush(stdout);
+    }
+
+    free(samples);
+    free(source);
+    return ok;
+}
+
+// Run in a child process so each workload reports its own peak RSS
+static bool bench_run_isolated(const BenchWorkload* workload) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) return bench_run(workload);
+    if (pid == 0) _exit(bench_run(workload) ? 0 : 1);
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ============================================================================
+// Built-in suite
+// ============================================================================
+
+static BenchWorkload bench_workload(const char* name, uint32_t nodes, float density, uint32_t depth,
+                                    uint32_t label, uint32_t cycles, uint32_t iterations) {
+    BenchWorkload workload;
+    workload.name = name;
+    workload.gen = mermaid_gen_default_params();
+    workload.gen.nodes = nodes;
+    workload.gen.edge_density = density;
+    workload.gen.subgraph_depth = depth;
+    workload.gen.label_length = label;
+    workload.gen.cycles = cycles;
+    workload.iterations = iterations;
+    workload.width = 1600.0f;
+    workload.height = 1200.0f;
+    return workload;
+}
+
+static int bench_suite(void) {
+    BenchWorkload suite[] = {
+        bench_workload("small", 50, 1.2f, 0, 10, 0, 500),
+        bench_workload("medium", 1000, 1.5f, 0, 12, 10, 40),
+        bench_workload("nested", 1000, 1.5f, 3, 12, 10, 40),
+        bench_workload("long_labels", 1000, 1.5f, 1, 64, 0, 40),
+        bench_workload("dense_cyclic", 2000, 3.0f, 0, 12, 200, 10),
+        bench_workload("large", 10000, 1.5f, 2, 12, 50, 5),
+    };
+    uint32_t count = sizeof(suite) / sizeof(suite[0]);
+
+    printf("[\n");
+    int failures = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!bench_run_isolated(&suite[i])) {
+            fprintf(stderr, "flowchart_bench: workload '%s' failed\n", suite[i].name);
+            failures++;
+            continue;
+        }
+        printf("%s\n", i + 1 < count ? "," : "");
+    }
+    printf("]\n");
+    return failures ? 1 : 0;
+}
+
+// ============================================================================
+// Command line
+// ============================================================================
+
+int main(int argc, char** argv) {
+    BenchWorkload workload = bench_workload("custom", 1000, 1.5f, 0, 12, 0, 20);
+    bool emit = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--suite") == 0) return bench_suite();
+        if (strcmp(arg, "--emit") == 0) {
+            emit = true;
+            continue;
+        }
+        if (!value) {
+            fprintf(stderr, "flowchart_bench: missing value for %s\n", arg);
+            return 2;
+        }
+
+        if (strcmp(arg, "--nodes") == 0) workload.gen.nodes = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--density") == 0) workload.gen.edge_density = strtof(value, NULL);
+        else if (strcmp(arg, "--depth") == 0) workload.gen.subgraph_depth = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--block") == 0) workload.gen.block_size = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--label") == 0) workload.gen.label_length = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--cycles") == 0) workload.gen.cycles = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--seed") == 0) workload.gen.seed = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "--iterations") == 0) workload.iterations = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--width") == 0) workload.width = strtof(value, NULL);
+        else if (strcmp(arg, "--height") == 0) workload.height = strtof(value, NULL);
+        else {
+            fprintf(stderr, "flowchart_bench: unknown option %s\n", arg);
+            return 2;
+        }
+        i++;
+    }
+
+    if (emit) {
+        size_t length = 0;
+        char* source = mermaid_generate(&workload.gen, &length);
+        if (!source) return 1;
+        fwrite(source, 1, length, stdout);
+        free(source);
+        return 0;
+    }
+
+    if (!bench_run(&workload)) return 1;
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+// ============================================================================
+// SYNTHETIC MERMAID GENERATOR
+// ============================================================================
+
+#include "mermaid_gen.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Nodes a forward edge may skip (keeps edges local, like hand-written charts)
+#define GEN_EDGE_WINDOW 8
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+    uint64_t rng;
+} GenBuffer;
+
+static uint64_t gen_next(GenBuffer* gen) {
+    // xorshift64*
+    gen->rng ^= gen->rng >> 12;
+    gen->rng ^= gen->rng << 25;
+    gen->rng ^= gen->rng >> 27;
+    return gen->rng * 0x2545F4914F6CDD1Dull;
+}
+
+static uint32_t gen_below(GenBuffer* gen, uint32_t bound) {
+    return bound == 0 ? 0 : (uint32_t)(gen_next(gen) % bound);
+}
+
+static bool gen_reserve(GenBuffer* gen, size_t extra) {
+    if (gen->failed) return false;
+    if (gen->length + extra + 1 <= gen->capacity) return true;
+
+    size_t new_capacity = gen->capacity == 0 ? 4096 : gen->capacity * 2;
+    while (new_capacity < gen->length + extra + 1) new_capacity *= 2;
+    char* new_data = (char*)realloc(gen->data, new_capacity);
+    if (!new_data) {
+        gen->failed = true;
+        return false;
+    }
+    gen->data = new_data;
+    gen->capacity = new_capacity;
+    return true;
+}
+
+static void gen_printf(GenBuffer* gen, const char* format, ...) {
+    char text[128];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (n < 0 || !gen_reserve(gen, (size_t)n)) return;
+    memcpy(gen->data + gen->length, text, (size_t)n);
+    gen->length += (size_t)n;
+    gen->data[gen->length] = '\0';
+}
+
+static void gen_indent(GenBuffer* gen, uint32_t depth) {
+    if (!gen_reserve(gen, depth * 2 + 2)) return;
+    memset(gen->data + gen->length, ' ', depth * 2 + 2);
+    gen->length += depth * 2 + 2;
+}
+
+// Words of 2-8 lowercase letters separated by spaces
+static void gen_label(GenBuffer* gen, uint32_t length) {
+    if (!gen_reserve(gen, length)) return;
+    char* out = gen->data + gen->length;
+    uint32_t word = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        if (word > 0 && i + 1 < length && (word >= 8 || (word >= 2 && gen_below(gen, 4) == 0))) {
+            out[i] = ' ';
+            word = 0;
+        } else {
+            out[i] = (char)('a' + gen_below(gen, 26));
+            word++;
+        }
+    }
+    gen->length += length;
+    gen->data[gen->length] = '\0';
+}
+
+MermaidGenParams mermaid_gen_default_params(void) {
+    MermaidGenParams params;
+    params.nodes = 1000;
+    params.edge_density = 1.5f;
+    params.subgraph_depth = 0;
+    params.block_size = 32;
+    params.label_length = 12;
+    params.cycles = 0;
+    params.seed = 1;
+    return params;
+}
+
+char* mermaid_generate(const MermaidGenParams* params, size_t* length) {
+    if (!params) return NULL;
+
+    GenBuffer gen = {0};
+    gen.rng = params->seed ? params->seed : 0x9E3779B97F4A7C15ull;
+    uint32_t block_size = params->block_size ? params->block_size : 32;
+
+    gen_printf(&gen, "flowchart TD\n");
+
+    // Node declarations, each block wrapped in its nested subgraphs
+    for (uint32_t start = 0; start < params->nodes; start += block_size) {
+        uint32_t end = start + block_size < params->nodes ? start + block_size : params->nodes;
+        for (uint32_t d = 0; d < params->subgraph_depth; d++) {
+            gen_indent(&gen, d);
+            gen_printf(&gen, "subgraph g%u_%u [Group %u.%u]\n", start / block_size, d, start / block_size, d);
+        }
+        for (uint32_t i = start; i < end; i++) {
+            gen_indent(&gen, params->subgraph_depth);
+            gen_printf(&gen, "n%u[\"", i);
+            gen_label(&gen, params->label_length ? params->label_length : 1);
+            gen_printf(&gen, "\"]\n");
+        }
+        for (uint32_t d = params->subgraph_depth; d > 0; d--) {
+            gen_indent(&gen, d - 1);
+            gen_printf(&gen, "end\n");
+        }
+    }
+
+    // Forward edges to nearby nodes; the fractional density is spread randomly
+    uint32_t whole = (uint32_t)params->edge_density;
+    uint32_t fraction = (uint32_t)((params->edge_density - (float)whole) * 1000.0f);
+    for (uint32_t i = 0; i + 1 < params->nodes; i++) {
+        uint32_t count = whole + (gen_below(&gen, 1000) < fraction ? 1 : 0);
+        uint32_t window = params->nodes - 1 - i < GEN_EDGE_WINDOW ? params->nodes - 1 - i : GEN_EDGE_WINDOW;
+        for (uint32_t e = 0; e < count; e++) {
+            gen_printf(&gen, "  n%u --> n%u\n", i, i + 1 + gen_below(&gen, window));
+        }
+    }
+
+    // Back edges
+    for (uint32_t c = 0; c < params->cycles && params->nodes > 1; c++) {
+        uint32_t to = gen_below(&gen, params->nodes - 1);
+        uint32_t from = to + 1 + gen_below(&gen, params->nodes - 1 - to);
+        gen_printf(&gen, "  n%u -.-> n%u\n", from, to);
+    }
+
+    if (gen.failed) {
+        free(gen.data);
+        return NULL;
+    }
+    if (length) *length = gen.length;
+    return gen.data;
+}
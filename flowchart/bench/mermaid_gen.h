@@ -0,0 +1,36 @@
+#ifndef MERMAID_GEN_H
+#define MERMAID_GEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Synthetic Mermaid flowchart generator (benchmark workloads)
+ *
+ * Nodes are declared first, in blocks of `block_size` that each sit in
+ * `subgraph_depth` nested subgraphs. Edges follow: every node links
+ * forward to nearby nodes (`edge_density` edges per node on average),
+ * then `cycles` back edges close cycles. The same parameters and seed
+ * always produce the same source.
+ */
+typedef struct {
+    uint32_t nodes;
+    float edge_density;                // Average forward edges per node
+    uint32_t subgraph_depth;           // Nesting of the subgraphs around each block (0 = none)
+    uint32_t block_size;               // Nodes per innermost subgraph
+    uint32_t label_length;             // Characters per node label
+    uint32_t cycles;                   // Back edges
+    uint64_t seed;
+} MermaidGenParams;
+
+MermaidGenParams mermaid_gen_default_params(void);
+
+/**
+ * Generate a flowchart source
+ *
+ * @param length Receives the source length (may be NULL)
+ * @return NUL-terminated source (caller frees), or NULL on allocation failure
+ */
+char* mermaid_generate(const MermaidGenParams* params, size_t* length);
+
+#endif // MERMAID_GEN_H
@@ -2,6 +2,7 @@
 #define FLOWCHART_API_H
 
 #include "flowchart_types.h"
+#include "flowchart_batch.h"
 #include "ir_core.h"
 
 /**
@@ -25,6 +26,10 @@ bool ir_flowchart_is_mermaid(const char* source, size_t length);
 // Layout API
 void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width, float available_height);
 
+// Batch API (flowchart_batch.h)
+uint32_t ir_flowchart_process_batch(const IRFlowchartSource* sources, uint32_t count,
+                                    const IRFlowchartBatchOptions* opts, IRComponent** results);
+
 // Renderer API (backend-specific)
 bool render_flowchart_terminal(IRComponent* flowchart, const void* caps);
 void render_flowchart_sdl3(IRComponent* flowchart, void* sdl_renderer);
@@ -0,0 +1,59 @@
+#ifndef FLOWCHART_BATCH_H
+#define FLOWCHART_BATCH_H
+
+#include <stddef.h>
+#include "flowchart_types.h"
+#include "ir_core.h"
+
+/**
+ * Batch parse and layout
+ *
+ * Parses and lays out many Mermaid sources on worker threads. Each chart
+ * is built and laid out by one worker; charts are claimed one at a time,
+ * so a few large charts do not hold up the rest. Results are returned in
+ * input order and do not depend on the number of threads.
+ *
+ * Thread safety: parsing and layout keep all their state in the
+ * flowchart being built. What is shared is locked: the parse/layout cache
+ * (flowchart_cache.h), the core's component allocator and the font
+ * backend (flowchart_measure.h). The measurement hook must not be
+ * replaced while a batch runs.
+ *
+ * Scaling: the core's allocator is not thread-safe, so every
+ * ir_create_component and ir_destroy_component in the process goes through
+ * one global lock (see ir_flowchart_new_component). Workers building
+ * charts of many small elements spend much of their time waiting on it,
+ * which bounds the speedup over a serial run well below the thread count.
+ */
+
+typedef struct {
+    const char* source;                // Mermaid source
+    size_t length;                     // Length of source
+} IRFlowchartSource;
+
+typedef struct {
+    uint32_t threads;                  // Worker threads including the caller (0 = one per CPU, 1 = serial)
+    bool layout;                       // Lay every chart out after parsing
+    float available_width;             // Passed to ir_layout_compute_flowchart
+    float available_height;
+} IRFlowchartBatchOptions;
+
+/**
+ * Default options: one thread per CPU, layout at natural size
+ */
+IRFlowchartBatchOptions ir_flowchart_batch_options_default(void);
+
+/**
+ * Parse (and lay out) every source
+ *
+ * @param sources Sources to process
+ * @param count Number of sources
+ * @param opts Options (NULL = ir_flowchart_batch_options_default())
+ * @param results Output: flowchart of each source, NULL where parsing
+ *                failed; the caller frees each with ir_flowchart_free_component
+ * @return Number of sources parsed successfully
+ */
+uint32_t ir_flowchart_process_batch(const IRFlowchartSource* sources, uint32_t count,
+                                    const IRFlowchartBatchOptions* opts, IRComponent** results);
+
+#endif // FLOWCHART_BATCH_H
@@ -25,6 +25,21 @@ extern IRFlowchartSubgraphData* ir_flowchart_subgraph_data_create(const char* su
 extern void ir_flowchart_subgraph_data_destroy(IRFlowchartSubgraphData* data);
 extern IRFlowchartSubgraphData* ir_get_flowchart_subgraph_data(IRComponent* c);
 
+// Data owned by `state`: strings interned in its arena, node and edge structs
+// taken from its pools (NULL = individually malloc'd, as above)
+extern IRFlowchartNodeData* ir_flowchart_node_data_create_in(IRFlowchartState* state, const char* node_id,
+                                                             IRFlowchartShape shape, const char* label);
+extern IRFlowchartEdgeData* ir_flowchart_edge_data_create_in(IRFlowchartState* state,
+                                                             const char* from_id, const char* to_id);
+extern IRFlowchartSubgraphData* ir_flowchart_subgraph_data_create_in(IRFlowchartState* state,
+                                                                     const char* subgraph_id, const char* title);
+
+// Core component allocation, serialized through one process-wide lock so flowcharts
+// can be built on several threads (ir_flowchart_process_batch)
+// Use these instead of ir_create_component/ir_destroy_component in the plugin
+extern IRComponent* ir_flowchart_new_component(IRComponentType type);
+extern void ir_flowchart_free_component(IRComponent* comp);
+
 // Component creation
 extern IRComponent* ir_flowchart(IRFlowchartDirection direction);
 extern IRComponent* ir_flowchart_node(const char* node_id, IRFlowchartShape shape, const char* label);
@@ -32,6 +47,14 @@ extern IRComponent* ir_flowchart_edge(const char* from_id, const char* to_id, IR
 extern IRComponent* ir_flowchart_subgraph(const char* subgraph_id, const char* title);
 extern IRComponent* ir_flowchart_label(const char* text);
 
+// Component creation for a given flowchart
+// IDs, labels and titles are interned in the flowchart's string arena
+// (see flowchart_strings.h) instead of being copied one by one, so these
+// components must not outlive the flowchart.
+extern IRComponent* ir_flowchart_create_node(IRComponent* flowchart, const char* node_id, IRFlowchartShape shape, const char* label);
+extern IRComponent* ir_flowchart_create_edge(IRComponent* flowchart, const char* from_id, const char* to_id, IRFlowchartEdgeType type);
+extern IRComponent* ir_flowchart_create_subgraph(IRComponent* flowchart, const char* subgraph_id, const char* title);
+
 // Edge/Node styling
 extern void ir_flowchart_edge_set_label(IRFlowchartEdgeData* data, const char* label);
 extern void ir_flowchart_edge_set_markers(IRFlowchartEdgeData* data, IRFlowchartMarker start, IRFlowchartMarker end);
@@ -39,11 +62,60 @@ extern void ir_flowchart_node_set_fill_color(IRFlowchartNodeData* data, uint32_t
 extern void ir_flowchart_node_set_stroke_color(IRFlowchartNodeData* data, uint32_t color);
 extern void ir_flowchart_node_set_stroke_width(IRFlowchartNodeData* data, float width);
 
+// Style tables (classDef, class, linkStyle)
+// Entries are recorded as statements arrive and resolved onto the elements
+// by ir_flowchart_finalize(): a node takes `classDef default`, then its
+// classes in assignment order, except for properties set directly on it
+// (style statements, the setters above); an edge takes `linkStyle default`,
+// then the style given for its index (declaration order). An edge looks its
+// index up once, when first finalized, and keeps that style as other edges
+// are removed; later linkStyle calls for its index change its own style.
+extern bool ir_flowchart_define_class(IRFlowchartState* state, const char* name, const IRFlowchartStyle* style);
+extern bool ir_flowchart_node_add_class(IRFlowchartState* state, IRFlowchartNodeData* node, const char* name);
+extern bool ir_flowchart_set_link_style(IRFlowchartState* state, uint32_t edge_index, const IRFlowchartStyle* style);  // IR_FLOWCHART_INVALID_INDEX = default
+extern void ir_flowchart_compile_styles(IRFlowchartState* state);  // Before applying styles to elements
+extern void ir_flowchart_apply_node_style(const IRFlowchartState* state, IRFlowchartNodeData* node);
+extern void ir_flowchart_apply_edge_style(const IRFlowchartState* state, IRFlowchartEdgeData* edge, uint32_t edge_index);
+
 // Registration
 extern void ir_flowchart_register_node(IRComponent* flowchart, IRComponent* node);
 extern void ir_flowchart_register_edge(IRComponent* flowchart, IRComponent* edge);
 extern void ir_flowchart_register_subgraph(IRComponent* flowchart, IRComponent* subgraph);
 
+// Room for this many nodes, edges and subgraphs in total: registries, the
+// node ID index and contiguous node and edge data slabs. Optional; builders
+// that know their size up front avoid regrowing as elements are added.
+extern bool ir_flowchart_reserve(IRComponent* flowchart, uint32_t nodes, uint32_t edges, uint32_t subgraphs);
+
+// Mutation after finalization
+// Changes are recorded in the state's dirty sets; the next layout only
+// redoes the affected parts (label and edge edits) or runs in full (nodes).
+// Removing a node also removes its edges. Edge removal drops the first
+// edge registered between the two IDs.
+extern bool ir_flowchart_set_label(IRComponent* flowchart, const char* node_id, const char* label);
+extern IRComponent* ir_flowchart_add_node(IRComponent* flowchart, const char* node_id, IRFlowchartShape shape, const char* label);
+extern bool ir_flowchart_remove_node(IRComponent* flowchart, const char* node_id);
+extern IRComponent* ir_flowchart_add_edge(IRComponent* flowchart, const char* from_id, const char* to_id, IRFlowchartEdgeType type);
+extern bool ir_flowchart_remove_edge(IRComponent* flowchart, const char* from_id, const char* to_id);
+
+// Handles
+// Every registered node, edge and subgraph carries a handle in its `handle`
+// field. It keeps naming the element while other elements are removed or
+// the flowchart is finalized again; once the element is removed the
+// lookups below return IR_FLOWCHART_INVALID_INDEX for it.
+extern uint32_t ir_flowchart_node_handle_index(const IRFlowchartState* state, IRFlowchartHandle handle);
+extern uint32_t ir_flowchart_edge_handle_index(const IRFlowchartState* state, IRFlowchartHandle handle);
+extern uint32_t ir_flowchart_subgraph_handle_index(const IRFlowchartState* state, IRFlowchartHandle handle);
+
+// Removal by handle, in O(1) for the registries and the ID index: the last
+// node, edge or subgraph moves into the freed slot, so registration order is
+// not kept (ir_flowchart_remove_node/_edge keep it at O(N + E) per call).
+// A node takes its edges with it in O(degree). A subgraph's contents move to
+// its parent subgraph, or to the top level. Stale handles return false.
+extern bool ir_flowchart_swap_remove_node(IRComponent* flowchart, IRFlowchartHandle node);
+extern bool ir_flowchart_swap_remove_edge(IRComponent* flowchart, IRFlowchartHandle edge);
+extern bool ir_flowchart_swap_remove_subgraph(IRComponent* flowchart, IRFlowchartHandle subgraph);
+
 // String helpers
 extern IRFlowchartDirection ir_flowchart_parse_direction(const char* str);
 extern const char* ir_flowchart_direction_to_string(IRFlowchartDirection dir);
@@ -54,12 +126,31 @@ extern const char* ir_flowchart_edge_type_to_string(IRFlowchartEdgeType type);
 extern IRFlowchartMarker ir_flowchart_parse_marker(const char* str);
 extern const char* ir_flowchart_marker_to_string(IRFlowchartMarker marker);
 
-// Lookup
+// Lookup (O(1) through the node ID index)
 extern IRFlowchartNodeData* ir_flowchart_find_node(IRFlowchartState* state, const char* node_id);
+extern uint32_t ir_flowchart_find_node_index(const IRFlowchartState* state, const char* node_id);
+extern void ir_flowchart_resolve_edges(IRFlowchartState* state);
+
+// Resolve node subgraph_id and subgraph parent_subgraph_id values not yet
+// known by index (elements registered by hand) and rebuild the member lists
+extern void ir_flowchart_resolve_subgraphs(IRFlowchartState* state);
 
 // Finalization
+// Registers every node, edge and subgraph in the component tree, subgraph
+// contents included; an element's container is the subgraph it sits under
+// (recorded in subgraph_index/parent_index and the ID fields), or the one
+// its ID fields name when it sits at the top level. The registries are
+// rebuilt each time, so finalizing again is idempotent: indices, handles,
+// containers and resolved styles come out the same; only the layout is
+// marked as not computed.
 extern void ir_flowchart_finalize(IRComponent* flowchart);
 
+// Copy of a flowchart: its nodes, edges and subgraphs with their styling
+// (class and linkStyle assignments and the style tables they refer to),
+// and the state's layout parameters. The copy is finalized, its layout not
+// yet computed. Returns NULL on allocation failure.
+extern IRComponent* ir_flowchart_clone(IRComponent* flowchart);
+
 // Layout (from flowchart_layout.c in plugin)
 void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width, float available_height);
 
@@ -0,0 +1,96 @@
+#ifndef FLOWCHART_CACHE_H
+#define FLOWCHART_CACHE_H
+
+#include <stddef.h>
+#include "flowchart_types.h"
+#include "ir_core.h"
+
+/**
+ * Content-addressed parse and layout cache
+ *
+ * Optional, process-wide and disabled by default. While enabled,
+ * ir_flowchart_parse() looks the source up by a 64-bit hash of its bytes
+ * (confirmed against a kept copy) and returns a clone of the flowchart
+ * parsed earlier instead of parsing again. Clones remember the source in
+ * state->content_key, so their first full layout can install a natural
+ * layout computed for the same source, direction, font and layout
+ * parameters, and then only fits it to the available size.
+ *
+ * Parse results and layouts share one LRU list bounded by entry count.
+ * Cached flowcharts are never handed out; callers always get their own
+ * copy and may edit it freely (edits clear content_key). Code changing
+ * node, edge or subgraph data directly must clear content_key itself.
+ *
+ * All functions are thread-safe.
+ */
+
+typedef struct {
+    uint64_t parse_hits;
+    uint64_t parse_misses;
+    uint64_t layout_hits;
+    uint64_t layout_misses;
+    uint64_t evictions;                // Entries dropped to stay within capacity
+    uint32_t entries;                  // Parse results and layouts currently cached
+    uint32_t capacity;
+} IRFlowchartCacheStats;
+
+/**
+ * Set the maximum number of cached entries (0 = disabled, the default)
+ *
+ * Shrinking evicts the least recently used entries.
+ */
+void ir_flowchart_cache_set_capacity(uint32_t entries);
+
+/**
+ * Drop every cached entry (counters are kept)
+ */
+void ir_flowchart_cache_clear(void);
+
+/**
+ * Read the counters
+ */
+void ir_flowchart_cache_get_stats(IRFlowchartCacheStats* stats);
+
+/**
+ * Reset hit, miss and eviction counters
+ */
+void ir_flowchart_cache_reset_stats(void);
+
+// ============================================================================
+// Hooks for the parser and the layout
+// ============================================================================
+
+bool ir_flowchart_cache_enabled(void);
+
+/**
+ * Hash of a source or parameter block (never 0, so 0 can mean "no key")
+ */
+uint64_t ir_flowchart_cache_hash(const void* data, size_t length);
+
+/**
+ * Clone of the flowchart cached for a source (NULL on a miss)
+ */
+IRComponent* ir_flowchart_cache_find_parse(const char* source, size_t length, uint64_t key);
+
+/**
+ * Cache a clone of a freshly parsed flowchart
+ */
+void ir_flowchart_cache_store_parse(const char* source, size_t length, uint64_t key, IRComponent* flowchart);
+
+/**
+ * Install a cached layout through `apply`
+ *
+ * The snapshot stays valid for the duration of the call.
+ *
+ * @return The result of apply, or false on a miss
+ */
+bool ir_flowchart_cache_apply_layout(uint64_t content_key, uint64_t layout_key,
+                                     bool (*apply)(const IRFlowchartLayoutSnapshot* snapshot, void* user_data),
+                                     void* user_data);
+
+/**
+ * Cache a layout; the cache takes ownership of the snapshot
+ */
+void ir_flowchart_cache_store_layout(uint64_t content_key, uint64_t layout_key, IRFlowchartLayoutSnapshot* snapshot);
+
+#endif // FLOWCHART_CACHE_H
@@ -0,0 +1,33 @@
+#ifndef FLOWCHART_GEOMETRY_H
+#define FLOWCHART_GEOMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Flowchart geometry kernels
+ *
+ * Node geometry is kept as parallel float arrays in the state
+ * (IRFlowchartState.node_x / node_y / node_width / node_height), and edge
+ * paths as one float array (path_pool). The passes below run over those
+ * arrays with AVX or SSE when the compiler targets them (-mavx, SSE2 is
+ * the x86-64 baseline) and with a plain loop otherwise.
+ */
+
+/**
+ * out[i] = offset + in[i] * scale for i in [0, count)
+ *
+ * `out` may be `in`.
+ */
+void ir_flowchart_geometry_fit(float* out, const float* in, uint32_t count, float scale, float offset);
+
+/**
+ * Bounding box of `count` boxes given as parallel arrays
+ *
+ * @param bounds Receives min x, min y, max x, max y (max = position + size)
+ * @return false when count is 0 (bounds left untouched)
+ */
+bool ir_flowchart_geometry_bounds(const float* x, const float* y, const float* width, const float* height,
+                                  uint32_t count, float bounds[4]);
+
+#endif // FLOWCHART_GEOMETRY_H
@@ -0,0 +1,173 @@
+#ifndef FLOWCHART_GRAPH_H
+#define FLOWCHART_GRAPH_H
+
+#include "flowchart_types.h"
+
+/**
+ * Flowchart graph core
+ *
+ * Compact adjacency representation of a flowchart built once per layout.
+ * Nodes are identified by their index in IRFlowchartState.nodes, and
+ * adjacency is stored in CSR form (offsets + flat target arrays) so that
+ * every layout phase can walk neighbours without string comparisons.
+ *
+ * After ir_flowchart_graph_insert_virtual_nodes, indices at or above
+ * real_node_count are virtual nodes that split edges spanning several layers.
+ */
+typedef struct IRFlowchartGraph {
+    uint32_t node_count;               // Real + virtual nodes
+    uint32_t real_node_count;          // Nodes backed by IRFlowchartState.nodes
+
+    // Edge list (resolved, non-self-loop edges or segments of split edges)
+    uint32_t edge_count;
+    uint32_t* edge_from;
+    uint32_t* edge_to;
+    uint32_t* edge_ref;                // Index into IRFlowchartState.edges
+
+    // Outgoing adjacency: targets of node v are out_targets[out_offsets[v] .. out_offsets[v+1])
+    uint32_t* out_offsets;
+    uint32_t* out_targets;
+
+    // Incoming adjacency: sources of node v are in_sources[in_offsets[v] .. in_offsets[v+1])
+    uint32_t* in_offsets;
+    uint32_t* in_sources;
+
+    // Layering result (filled by ir_flowchart_graph_assign_layers)
+    int* layer;                        // Layer (rank) of each node
+    uint32_t layer_count;              // max layer + 1
+
+    // Ordering within layers (filled by ir_flowchart_graph_order_layers)
+    // Nodes of layer l are layer_nodes[layer_offsets[l] .. layer_offsets[l+1]) left to right
+    uint32_t* layer_offsets;
+    uint32_t* layer_nodes;
+    uint32_t* position;                // Position of each node within its layer
+    uint64_t crossings;                // Crossings between adjacent layers after ordering
+
+    // Virtual node chains (filled by ir_flowchart_graph_insert_virtual_nodes)
+    // Chain of state edge e is chain_nodes[chain_offsets[e] .. chain_offsets[e+1]), from source to target
+    uint32_t chain_edge_count;         // Number of state edges covered by chain_offsets
+    uint32_t* chain_offsets;
+    uint32_t* chain_nodes;
+} IRFlowchartGraph;
+
+/**
+ * Build adjacency lists from the registered nodes and edges
+ *
+ * Uses the pre-resolved from_index/to_index of each edge (see
+ * ir_flowchart_resolve_edges). Unresolved edges and self-loops are skipped.
+ *
+ * @param graph Graph to fill (previous contents are not freed)
+ * @param state Flowchart state with registered nodes/edges
+ * @return true on success, false on allocation failure
+ */
+bool ir_flowchart_graph_build(IRFlowchartGraph* graph, const IRFlowchartState* state);
+
+/**
+ * Build adjacency lists from an explicit edge list
+ *
+ * Used when the graph nodes are not the state's nodes, e.g. the members
+ * and nested subgraph blocks of one subgraph level. Out-of-range edges and
+ * self-loops are skipped.
+ *
+ * @param graph Graph to fill (previous contents are not freed)
+ * @param node_count Number of graph nodes
+ * @param edge_count Number of entries in from/to/ref
+ * @param from Source node of each edge
+ * @param to Target node of each edge
+ * @param ref Index of each edge in IRFlowchartState.edges (keys the virtual node chains)
+ * @return true on success, false on allocation failure
+ */
+bool ir_flowchart_graph_build_edges(IRFlowchartGraph* graph, uint32_t node_count, uint32_t edge_count,
+                                    const uint32_t* from, const uint32_t* to, const uint32_t* ref);
+
+/**
+ * Assign every node to a layer using Kahn's algorithm with longest-path ranks
+ *
+ * Runs in O(N + E). When the remaining nodes all sit on cycles, the next
+ * node reached by an already-ranked predecessor (or, failing that, the
+ * lowest-index unranked node) is released, which breaks the cycle at that
+ * node's unranked incoming edges.
+ *
+ * @param graph Graph built with ir_flowchart_graph_build
+ * @return true on success, false on allocation failure
+ */
+bool ir_flowchart_graph_assign_layers(IRFlowchartGraph* graph);
+
+/**
+ * Split every edge spanning more than one layer into a chain of virtual nodes
+ *
+ * Each virtual node sits on one intermediate layer, so after this call every
+ * edge connects adjacent layers and long edges take part in ordering and
+ * coordinate assignment like ordinary nodes. Adjacency lists are rebuilt.
+ *
+ * @param graph Graph with layers assigned
+ * @param state_edge_count Number of edges in IRFlowchartState (size of the chain table)
+ * @return true on success, false on allocation failure
+ */
+bool ir_flowchart_graph_insert_virtual_nodes(IRFlowchartGraph* graph, uint32_t state_edge_count);
+
+/**
+ * Order nodes within each layer to reduce edge crossings
+ *
+ * Starts from registration order and runs alternating down/up sweeps that
+ * sort each layer by the median position of its neighbours in the previous
+ * layer of the sweep. The ordering with the fewest adjacent-layer crossings
+ * is kept. All scratch buffers are allocated once up front; each sweep only
+ * sorts packed integer keys.
+ *
+ * @param graph Graph with layers assigned
+ * @param max_iterations Maximum number of sweeps (0 = keep registration order)
+ * @param time_budget_ms Wall-clock budget for the sweeps (<= 0 = unlimited)
+ * @return true on success, false on allocation failure
+ */
+bool ir_flowchart_graph_order_layers(IRFlowchartGraph* graph, uint32_t max_iterations, float time_budget_ms);
+
+/**
+ * Re-sweep a few layers starting from a previous ordering
+ *
+ * Used by incremental relayout after local edge changes. Nodes start at
+ * `position` (the ordering of an earlier graph with the same layered nodes)
+ * and only layers flagged in `sweep` are reordered by the median heuristic.
+ * The ordering with the fewest crossings between the layer pairs touching a
+ * flagged layer is kept, so the result is never worse than the start.
+ *
+ * @param graph Graph with layers assigned and virtual nodes inserted
+ * @param position Previous position of each node within its layer (node_count entries)
+ * @param sweep Layers to reorder (layer_count entries)
+ * @param max_iterations Maximum number of sweeps over the flagged layers
+ * @return true on success, false on allocation failure or if position is not an ordering of these layers
+ */
+bool ir_flowchart_graph_reorder_layers(IRFlowchartGraph* graph, const uint32_t* position,
+                                       const bool* sweep, uint32_t max_iterations);
+
+/**
+ * Count crossings between adjacent layers for the current ordering
+ *
+ * Edges spanning more than one layer are ignored.
+ */
+uint64_t ir_flowchart_graph_count_crossings(const IRFlowchartGraph* graph);
+
+/**
+ * Assign a coordinate across the layer direction to every node
+ *
+ * Each layer is first packed tightly and centered, then alternating
+ * down/up sweeps pull every node towards the mean center of its neighbours
+ * in the adjacent layer while keeping the within-layer order and a gap of
+ * node_spacing between node extents. Virtual nodes pull harder so long
+ * edges stay straight. Each sweep is O(N + E).
+ *
+ * @param graph Graph with layers ordered (ir_flowchart_graph_order_layers)
+ * @param breadth Extent of each node across the layer direction (node_count entries)
+ * @param node_spacing Minimum gap between neighbouring nodes of a layer
+ * @param center Output: center of each node, leftmost extent at 0 (node_count entries)
+ * @return true on success, false on allocation failure
+ */
+bool ir_flowchart_graph_assign_coordinates(const IRFlowchartGraph* graph, const float* breadth,
+                                           float node_spacing, float* center);
+
+/**
+ * Free all arrays owned by the graph
+ */
+void ir_flowchart_graph_destroy(IRFlowchartGraph* graph);
+
+#endif // FLOWCHART_GRAPH_H
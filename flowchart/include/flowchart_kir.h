@@ -0,0 +1,84 @@
+#ifndef FLOWCHART_KIR_H
+#define FLOWCHART_KIR_H
+
+#include <stddef.h>
+#include "flowchart_types.h"
+
+/**
+ * Direct KIR JSON writer
+ *
+ * Writes the KIR JSON of a flowchart from the elements the parser reports,
+ * without building IRComponents. The parser hands over node, edge and
+ * subgraph data in source order. Until the writer is settled, a later
+ * style, class, classDef or linkStyle statement can still change any of
+ * them, so they are queued; once settled, each element is styled, written
+ * through a fixed-size output buffer and freed as soon as it is complete.
+ * Only the elements of an open top-level subgraph are held back, since a
+ * direction statement can still change the subgraph and its edges follow
+ * it in the document.
+ *
+ * The document has the element layout ir_serialize_json_v2() gives the
+ * component tree ir_flowchart_parse() builds: nodes and subgraphs nest
+ * under the subgraph they were declared in, edges are children of the
+ * flowchart, following the top-level element during which they were
+ * declared. Strings that are not set, zero colors and unset widths are
+ * left out.
+ *
+ *   {"type":"Flowchart","flowchart":{"direction":"TB","nodeSpacing":50,...},"children":[
+ *     {"type":"FlowchartNode","flowchartNode":{"nodeId":"A","shape":"rectangle","label":"Start",...}},
+ *     {"type":"FlowchartSubgraph","flowchartSubgraph":{"subgraphId":"s1","title":"Group",...},"children":[...]},
+ *     {"type":"FlowchartEdge","flowchartEdge":{"fromId":"A","toId":"B","edgeType":"arrow",...}}]}
+ */
+
+/**
+ * Output callback
+ *
+ * @return false to stop writing (reported as failure by the writer)
+ */
+typedef bool (*IRFlowchartWriteFn)(const char* data, size_t length, void* user_data);
+
+typedef struct IRFlowchartKirWriter IRFlowchartKirWriter;
+
+IRFlowchartKirWriter* ir_flowchart_kir_writer_create(IRFlowchartWriteFn write, void* user_data);
+
+/**
+ * Free a writer and all element data it has not written yet
+ */
+void ir_flowchart_kir_writer_destroy(IRFlowchartKirWriter* writer);
+
+/**
+ * Start the document for the flowchart of a state
+ *
+ * Called once the header has been parsed, before any element. The state
+ * supplies the flowchart settings and the style tables; it must outlive
+ * the writer.
+ */
+bool ir_flowchart_kir_begin(IRFlowchartKirWriter* writer, IRFlowchartState* state);
+
+// Element events, in source order
+// The writer takes ownership of the data, even when an event fails (out of memory)
+bool ir_flowchart_kir_add_node(IRFlowchartKirWriter* writer, IRFlowchartNodeData* node);
+bool ir_flowchart_kir_add_edge(IRFlowchartKirWriter* writer, IRFlowchartEdgeData* edge);
+bool ir_flowchart_kir_begin_subgraph(IRFlowchartKirWriter* writer, IRFlowchartSubgraphData* subgraph);
+bool ir_flowchart_kir_end_subgraph(IRFlowchartKirWriter* writer);
+
+/**
+ * Declare that no style statement follows
+ *
+ * Compiles the state's classes and link styles (the direct counterpart of
+ * the style pass in ir_flowchart_finalize()) and writes the queued
+ * elements. From here on, the data of a written element is freed, so the
+ * caller must not touch element data after handing it over.
+ */
+void ir_flowchart_kir_settle(IRFlowchartKirWriter* writer);
+
+/**
+ * Finish the document
+ *
+ * Settles the writer if needed and closes subgraphs still open.
+ *
+ * @return true if every write succeeded
+ */
+bool ir_flowchart_kir_finish(IRFlowchartKirWriter* writer);
+
+#endif // FLOWCHART_KIR_H
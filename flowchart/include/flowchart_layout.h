@@ -8,17 +8,61 @@
  * Compute flowchart layout using graph layering algorithm
  *
  * This function performs hierarchical graph layout:
- * 1. Computes node sizes based on labels
+ * 1. Computes node sizes based on labels (cached, see flowchart_measure.h)
  * 2. Assigns nodes to layers (ranks)
- * 3. Orders nodes within each layer
- * 4. Positions nodes to minimize edge crossings
+ * 3. Orders nodes within each layer to reduce edge crossings
+ * 4. Positions nodes
  * 5. Routes edges between nodes
  * 6. Computes subgraph bounds
  *
+ * Steps 2-5 run once per subgraph, innermost first, in the subgraph's own
+ * direction; each subgraph is then placed as a single block in its parent.
+ * Subgraph layouts are cached (local_width/local_height/layout_computed)
+ * and reused while their contents do not change.
+ *
+ * The natural (unscaled) layout is kept in state->layout_cache. While
+ * state->layout_computed stays set, a call with a different available size
+ * only refits the cached layout (O(N + path points)); structural or label
+ * changes clear layout_computed and trigger a full relayout.
+ *
+ * Edits made through the mutation API (ir_flowchart_set_label,
+ * ir_flowchart_add_edge, ...) are recorded in the state's dirty sets and
+ * applied to the previous layout: only relabelled nodes are measured,
+ * resized components are placed again with their previous ordering, and
+ * components whose edges changed are re-swept on the touched layers only.
+ * A full relayout runs when the rank structure changes (nodes added or
+ * removed, components merged or split, items changing layer).
+ *
+ * With the parse/layout cache enabled (flowchart_cache.h), the first
+ * layout of a chart parsed from a cached source takes the natural layout
+ * computed for an earlier chart of the same source and parameters, and
+ * only fits it to the available size.
+ *
+ * Within each level, connected components are laid out independently
+ * (on up to state->layout_threads threads for large charts) and then
+ * packed with a deterministic shelf packer. Results do not depend on
+ * the thread count.
+ *
  * @param flowchart Flowchart component
  * @param available_width Available width for layout
  * @param available_height Available height for layout
  */
 void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width, float available_height);
 
+/**
+ * Free the natural layout kept by ir_layout_compute_flowchart
+ *
+ * Called when the flowchart state is destroyed.
+ *
+ * @param cache Cache to free (NULL is ignored)
+ */
+void ir_flowchart_layout_cache_destroy(IRFlowchartLayoutCache* cache);
+
+/**
+ * Free a layout kept by the parse/layout cache (see flowchart_cache.h)
+ *
+ * @param snapshot Snapshot to free (NULL is ignored)
+ */
+void ir_flowchart_layout_snapshot_destroy(IRFlowchartLayoutSnapshot* snapshot);
+
 #endif // FLOWCHART_LAYOUT_H
@@ -0,0 +1,90 @@
+#ifndef FLOWCHART_LEXER_H
+#define FLOWCHART_LEXER_H
+
+#include <stddef.h>
+#include "flowchart_types.h"
+
+/**
+ * Mermaid flowchart lexer
+ *
+ * Splits Mermaid source into lines and each line into a token stream
+ * consumed by the grammar in flowchart_parser.c. Characters are classified
+ * through a 256-entry table, line ends and label delimiters are found with
+ * memchr, and keywords and arrows are recognized with perfect hashes, so
+ * every byte is looked at a small constant number of times.
+ *
+ * Tokens refer to the line by offset; nothing is copied. The header words
+ * "flowchart" and "graph" are plain identifiers, left to the grammar.
+ */
+
+typedef enum {
+    IR_FLOWCHART_TOKEN_IDENT,          // Node or subgraph ID
+    IR_FLOWCHART_TOKEN_KEYWORD,        // First word of a statement; IRFlowchartKeyword in kind
+    IR_FLOWCHART_TOKEN_ARROW,          // Edge operator; IRFlowchartEdgeType in kind
+    IR_FLOWCHART_TOKEN_SHAPE,          // Bracketed node text; IRFlowchartShape in kind
+    IR_FLOWCHART_TOKEN_EDGE_LABEL,     // |text| or the text of -- text -->
+    IR_FLOWCHART_TOKEN_AMPERSAND,      // &
+    IR_FLOWCHART_TOKEN_REST,           // Rest of a style/classDef/class/linkStyle/click statement
+    IR_FLOWCHART_TOKEN_OTHER,          // Any other character
+    IR_FLOWCHART_TOKEN_END             // End of statement (';' or end of line)
+} IRFlowchartTokenType;
+
+typedef enum {
+    IR_FLOWCHART_KEYWORD_SUBGRAPH,
+    IR_FLOWCHART_KEYWORD_END,
+    IR_FLOWCHART_KEYWORD_STYLE,
+    IR_FLOWCHART_KEYWORD_CLASSDEF,
+    IR_FLOWCHART_KEYWORD_CLASS,
+    IR_FLOWCHART_KEYWORD_LINKSTYLE,
+    IR_FLOWCHART_KEYWORD_DIRECTION,
+    IR_FLOWCHART_KEYWORD_CLICK
+} IRFlowchartKeyword;
+
+// Token flags
+#define IR_FLOWCHART_TOKEN_RAW    0x1u  // Text is used verbatim (no trimming or HTML processing)
+#define IR_FLOWCHART_TOKEN_QUOTED 0x2u  // Text was written as "..." (quotes not included)
+
+typedef struct {
+    uint8_t type;                      // IRFlowchartTokenType
+    uint8_t kind;                      // Keyword, edge type or shape
+    uint8_t flags;                     // IR_FLOWCHART_TOKEN_* flags
+    uint32_t start;                    // Offset of the token text in the line
+    uint32_t length;                   // Length of the token text
+} IRFlowchartToken;
+
+typedef struct {
+    IRFlowchartToken* tokens;
+    uint32_t count;
+    uint32_t capacity;
+} IRFlowchartTokenStream;
+
+/**
+ * Find the next line
+ *
+ * @param cursor Start of the line
+ * @param end End of the input
+ * @param length Output: length of the line without "\n" or "\r\n"
+ * @return Start of the following line (end if this was the last one)
+ */
+const char* ir_flowchart_next_line(const char* cursor, const char* end, size_t* length);
+
+/**
+ * Tokenize one line
+ *
+ * The stream is cleared first. Every statement ends with an END token, so
+ * a line with "A --> B; C --> D" yields two statements. Comment lines and
+ * blank lines yield no tokens.
+ *
+ * @param stream Token stream to fill (reused between lines)
+ * @param line Line text (without the line terminator)
+ * @param length Length of the line
+ * @return true on success, false on allocation failure
+ */
+bool ir_flowchart_lex_line(IRFlowchartTokenStream* stream, const char* line, size_t length);
+
+/**
+ * Free the tokens owned by a stream
+ */
+void ir_flowchart_token_stream_destroy(IRFlowchartTokenStream* stream);
+
+#endif // FLOWCHART_LEXER_H
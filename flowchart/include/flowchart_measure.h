@@ -0,0 +1,78 @@
+#ifndef FLOWCHART_MEASURE_H
+#define FLOWCHART_MEASURE_H
+
+#include "flowchart_types.h"
+
+/**
+ * Flowchart text measurement
+ *
+ * Label widths and font heights are measured through the host's font
+ * metrics (g_ir_font_metrics) and kept in a per-state cache keyed on
+ * (label hash, font size, font id). Repeated layouts of the same chart
+ * make no font metric calls; only new or edited labels are measured.
+ * Labels missing from the cache are measured in one call when a batch
+ * hook is installed, otherwise one get_text_width call per distinct label.
+ *
+ * The cache is dropped when the font backend or batch hook changes.
+ * Backend calls are serialized, so charts on different threads can be
+ * laid out at the same time without a thread-safe font backend.
+ */
+
+/**
+ * Batch text measurement hook
+ *
+ * @param texts Labels to measure (not NUL-terminated past lengths[i])
+ * @param lengths Byte length of each label
+ * @param count Number of labels
+ * @param font_size Font size in pixels
+ * @param font_family Font family (NULL = default font)
+ * @param widths Output: width of each label
+ * @param user_data Pointer given to ir_flowchart_set_measure_batch
+ */
+typedef void (*IRFlowchartMeasureBatchFn)(const char* const* texts, const uint32_t* lengths, uint32_t count,
+                                          float font_size, const char* font_family, float* widths,
+                                          void* user_data);
+
+/**
+ * Install a batch measurement hook for label widths (NULL = measure one by one)
+ *
+ * Set once by the rendering backend, before flowcharts are laid out.
+ */
+void ir_flowchart_set_measure_batch(IRFlowchartMeasureBatchFn fn, void* user_data);
+
+/**
+ * Identity of the current measurement backend
+ *
+ * Changes when the font metrics or the batch hook are replaced, i.e. when
+ * labels may measure differently; part of the key of cached layouts.
+ */
+uint64_t ir_flowchart_measure_backend_id(void);
+
+/**
+ * Measure the labels of the given nodes
+ *
+ * Nodes with an empty label get width 0. Without font metrics the width
+ * is estimated from the label length and nothing is cached.
+ *
+ * @param state Flowchart state (owns the cache)
+ * @param nodes Node indices to measure
+ * @param count Number of entries in nodes
+ * @param font_size Font size in pixels
+ * @param font_family Font family (NULL = default font)
+ * @param widths Output: label width of each requested node (count entries)
+ * @param height Output: line height for font_size
+ * @return true on success, false on allocation failure (widths are still filled)
+ */
+bool ir_flowchart_measure_labels(IRFlowchartState* state, const uint32_t* nodes, uint32_t count,
+                                 float font_size, const char* font_family, float* widths, float* height);
+
+/**
+ * Free a text measurement cache
+ *
+ * Called when the flowchart state is destroyed.
+ *
+ * @param cache Cache to free (NULL is ignored)
+ */
+void ir_flowchart_text_cache_destroy(IRFlowchartTextCache* cache);
+
+#endif // FLOWCHART_MEASURE_H
@@ -0,0 +1,43 @@
+#ifndef FLOWCHART_PARALLEL_H
+#define FLOWCHART_PARALLEL_H
+
+#include <stdint.h>
+
+/**
+ * Flowchart parallel-for
+ *
+ * Minimal parallel-for used by the layout engine and the batch API. Each
+ * call starts its worker threads and joins them before returning; no
+ * threads are kept between calls. Starting and joining one costs some
+ * tens of microseconds, so callers only go parallel for work that takes
+ * milliseconds (see FLOWCHART_PARALLEL_MIN_ITEMS in flowchart_layout.c).
+ *
+ * Tasks are claimed from a shared atomic counter, so uneven task sizes
+ * balance themselves. The calling thread always takes part, and if no
+ * worker thread can be started the whole range simply runs on the caller.
+ */
+
+typedef void (*IRFlowchartTaskFn)(void* user_data, uint32_t index);
+
+/**
+ * Number of worker threads used when a caller asks for "auto" (0)
+ *
+ * @return Online CPU count, at least 1
+ */
+uint32_t ir_flowchart_parallel_default_threads(void);
+
+/**
+ * Run fn(user_data, i) for every i in [0, count)
+ *
+ * Starts up to max_threads - 1 threads and returns once every task has
+ * finished and every thread is joined. Tasks must not depend on each
+ * other's results.
+ *
+ * @param count Number of tasks
+ * @param max_threads Upper bound on threads including the caller (0 = auto, 1 = serial)
+ * @param fn Task function
+ * @param user_data Passed through to fn
+ */
+void ir_flowchart_parallel_for(uint32_t count, uint32_t max_threads, IRFlowchartTaskFn fn, void* user_data);
+
+#endif // FLOWCHART_PARALLEL_H
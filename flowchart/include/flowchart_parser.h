@@ -4,6 +4,7 @@
 #include "ir_core.h"
 #include "ir_builder.h"
 #include "flowchart_types.h"
+#include "flowchart_kir.h"
 
 /**
  * Parse Mermaid flowchart syntax to IR components
@@ -25,9 +26,17 @@
  *   A <--> B           Bidirectional arrow
  *   A -->|label| B     Edge with label
  *   A -- label --> B   Edge with label (alternative)
+ *   A --> B --> C      Edge chain
+ *   A & B --> C & D    Edges from every node on the left to every node on the right
  *   subgraph id[title] Subgraph start
  *   end                Subgraph end
  *   style A fill:#f9f  Style definition (basic support)
+ *   classDef c fill:#f9f          Class definition (fill, stroke, stroke-width)
+ *   class A,B c                   Class assignment
+ *   linkStyle 0,1 stroke:#f00     Edge style by declaration index (or `default`)
+ *
+ * With the parse/layout cache enabled (see flowchart_cache.h), a source
+ * parsed before is not parsed again; the result is a copy of the cached one.
  *
  * @param source Mermaid flowchart source code
  * @param length Length of source string
@@ -35,6 +44,49 @@
  */
 IRComponent* ir_flowchart_parse(const char* source, size_t length);
 
+/**
+ * Streaming parse
+ *
+ * Builds the same component tree as ir_flowchart_parse() from source that
+ * arrives in chunks of any size; a line may be split across chunks. Only
+ * the unfinished last line of a chunk is buffered, so memory does not grow
+ * with the source, but no single line may exceed IR_FLOWCHART_PARSE_MAX_LINE.
+ *
+ * Usage:
+ *   IRFlowchartParseStream* stream = ir_flowchart_parse_begin();
+ *   while (more input) ir_flowchart_parse_feed(stream, chunk, chunk_length);
+ *   IRComponent* flowchart = ir_flowchart_parse_end(stream);
+ */
+#define IR_FLOWCHART_PARSE_MAX_LINE (1u << 20)
+
+typedef struct IRFlowchartParseStream IRFlowchartParseStream;
+
+/**
+ * Start a streaming parse
+ *
+ * @return New stream (freed by ir_flowchart_parse_end), or NULL on allocation failure
+ */
+IRFlowchartParseStream* ir_flowchart_parse_begin(void);
+
+/**
+ * Parse the lines completed by a chunk
+ *
+ * @param stream Stream from ir_flowchart_parse_begin()
+ * @param data Next chunk of source
+ * @param length Length of the chunk
+ * @return false on error (invalid header, over-long line, out of memory);
+ *         the partial result is dropped and later feeds are ignored
+ */
+bool ir_flowchart_parse_feed(IRFlowchartParseStream* stream, const char* data, size_t length);
+
+/**
+ * Parse the last line, finalize the flowchart and free the stream
+ *
+ * @param stream Stream from ir_flowchart_parse_begin()
+ * @return IRComponent* Root Flowchart component, or NULL on error
+ */
+IRComponent* ir_flowchart_parse_end(IRFlowchartParseStream* stream);
+
 /**
  * Convert Mermaid flowchart to KIR JSON string
  *
@@ -46,6 +98,35 @@ IRComponent* ir_flowchart_parse(const char* source, size_t length);
  */
 char* ir_flowchart_to_kir(const char* source, size_t length);
 
+/**
+ * Convert Mermaid flowchart to KIR JSON without building components
+ *
+ * Writes the KIR JSON straight from the parsed elements (see
+ * flowchart_kir.h), so the component tree never exists and the output is
+ * handed over in 64 KB pieces. A quick scan first finds the last style,
+ * class, classDef or linkStyle line; elements declared after it are
+ * written and freed as they are parsed, those before it are held until
+ * then. The document matches ir_flowchart_to_kir() for the same source.
+ *
+ * @param source Mermaid flowchart source code
+ * @param length Length of source string
+ * @param write Output callback, called with consecutive pieces of the JSON
+ * @param user_data Passed to write
+ * @return true on success, false on a parse error, allocation failure or
+ *         a write callback returning false
+ */
+bool ir_flowchart_write_kir(const char* source, size_t length, IRFlowchartWriteFn write, void* user_data);
+
+/**
+ * Convert Mermaid flowchart to KIR JSON in one buffer, without building components
+ *
+ * @param source Mermaid flowchart source code
+ * @param length Length of source string
+ * @param out_length Output: length of the JSON (may be NULL)
+ * @return char* JSON string (caller must free), or NULL on error
+ */
+char* ir_flowchart_to_kir_direct(const char* source, size_t length, size_t* out_length);
+
 /**
  * Check if source looks like a Mermaid flowchart
  *
@@ -0,0 +1,53 @@
+#ifndef FLOWCHART_POOL_H
+#define FLOWCHART_POOL_H
+
+#include <stddef.h>
+#include "flowchart_types.h"
+
+/**
+ * Flowchart element pool
+ *
+ * Node and edge data of a flowchart are carved out of slabs owned by its
+ * state (IRFlowchartState.node_pool / edge_pool) instead of being
+ * allocated one by one, so a chart's elements sit next to each other and
+ * are freed a whole slab at a time. Freed elements are reused.
+ *
+ * The state and its elements can be destroyed in either order: when the
+ * owner releases the pool while elements are still out, the slabs go
+ * with the last of them.
+ *
+ * A pool is used by one thread at a time, like the state owning it.
+ */
+
+/**
+ * Create an empty pool of `element_size` byte elements (nothing is allocated yet)
+ */
+IRFlowchartPool* ir_flowchart_pool_create(size_t element_size);
+
+/**
+ * Drop the owner's hold on a pool
+ *
+ * The slabs are freed now if no element is out, otherwise with the last one.
+ *
+ * @param pool Pool to release (NULL is ignored)
+ */
+void ir_flowchart_pool_release(IRFlowchartPool* pool);
+
+/**
+ * Zeroed element (NULL on allocation failure)
+ */
+void* ir_flowchart_pool_alloc(IRFlowchartPool* pool);
+
+/**
+ * Give an element back for reuse
+ */
+void ir_flowchart_pool_free(IRFlowchartPool* pool, void* element);
+
+/**
+ * Make room for `count` elements in total, in a single slab where possible
+ *
+ * @return false on allocation failure
+ */
+bool ir_flowchart_pool_reserve(IRFlowchartPool* pool, uint32_t count);
+
+#endif // FLOWCHART_POOL_H
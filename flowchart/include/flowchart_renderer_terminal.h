@@ -1,10 +1,12 @@
 #ifndef FLOWCHART_RENDERER_TERMINAL_H
 #define FLOWCHART_RENDERER_TERMINAL_H
 
+#include "flowchart_snapshot.h"
 #include "flowchart_types.h"
 #include "ir_core.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 // Terminal Capabilities
 typedef struct {
@@ -57,10 +59,16 @@ void terminal_buffer_clear(TerminalBuffer* buffer);
 void terminal_buffer_set_char(TerminalBuffer* buffer, int col, int row, char ch);
 void terminal_buffer_set_char_colored(TerminalBuffer* buffer, int col, int row, char ch, uint32_t color);
 void terminal_buffer_render(const TerminalBuffer* buffer, const TerminalCapabilities* caps);
+void terminal_buffer_render_to(FILE* out, const TerminalBuffer* buffer, const TerminalCapabilities* caps);
 
 // Node Shape Rendering
+// Node geometry lives in the flowchart state (node_x etc.); render_node_terminal
+// finds the state through the node's component, render_node_terminal_in is
+// given it (and also renders nodes not attached to a component)
 void render_node_terminal(TerminalBuffer* buffer, const IRFlowchartNodeData* node,
                          const TerminalScaling* scale, const TerminalCapabilities* caps);
+void render_node_terminal_in(TerminalBuffer* buffer, const IRFlowchartState* fc_state, const IRFlowchartNodeData* node,
+                            const TerminalScaling* scale, const TerminalCapabilities* caps);
 void render_rectangle_terminal(TerminalBuffer* buffer, TerminalCell pos, int w, int h,
                               const TerminalCapabilities* caps);
 void render_rounded_terminal(TerminalBuffer* buffer, TerminalCell pos, int w, int h,
@@ -83,13 +91,27 @@ void draw_line_terminal(TerminalBuffer* buffer, TerminalCell c1, TerminalCell c2
 // Text Rendering
 void render_label_centered(TerminalBuffer* buffer, TerminalCell pos, int w, int h, const char* label);
 
-// Color Support (ANSI Escape Codes)
+// Color Support (ANSI Escape Codes, written to stdout or `out`)
 void set_terminal_color_rgb(uint8_t r, uint8_t g, uint8_t b, bool foreground, const TerminalCapabilities* caps);
 void reset_terminal_color(void);
+void set_terminal_color_rgb_to(FILE* out, uint8_t r, uint8_t g, uint8_t b, bool foreground,
+                               const TerminalCapabilities* caps);
+void reset_terminal_color_to(FILE* out);
 int rgb_to_256color(uint8_t r, uint8_t g, uint8_t b);
 int rgb_to_16color(uint8_t r, uint8_t g, uint8_t b);
 
 // Main Terminal Flowchart Renderer
+// render_flowchart_terminal writes to stdout; the _to form writes to any
+// stream (a file, a pipe, an open_memstream buffer)
 bool render_flowchart_terminal(IRComponent* flowchart, const TerminalCapabilities* caps);
+bool render_flowchart_terminal_to(FILE* out, IRComponent* flowchart, const TerminalCapabilities* caps);
+
+// Draw a published snapshot (see flowchart_snapshot.h) instead of the live
+// state, so a render thread never reads what the editing thread changes.
+// Gives the same picture as render_flowchart_terminal_to for the layout
+// the snapshot was published from.
+bool render_flowchart_terminal_snapshot(const IRFlowchartSnapshot* snapshot, const TerminalCapabilities* caps);
+bool render_flowchart_terminal_snapshot_to(FILE* out, const IRFlowchartSnapshot* snapshot,
+                                           const TerminalCapabilities* caps);
 
 #endif // FLOWCHART_RENDERER_TERMINAL_H
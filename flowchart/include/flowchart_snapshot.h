@@ -0,0 +1,167 @@
+#ifndef FLOWCHART_SNAPSHOT_H
+#define FLOWCHART_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "flowchart_types.h"
+#include "ir_core.h"
+
+/**
+ * Copy-on-write render snapshots
+ *
+ * A snapshot is an immutable copy of everything needed to draw a laid-out
+ * flowchart: node boxes, shapes, labels and colors; edge endpoints, paths,
+ * line types, markers, labels and colors; subgraph boxes, titles and
+ * colors; and the content size. The thread that edits and lays out a
+ * flowchart publishes a snapshot after each layout; other threads (a
+ * renderer, see render_flowchart_terminal_snapshot_to()) acquire the latest
+ * one and draw from it without locking for as long as they hold it.
+ *
+ * Publishing swaps one atomic pointer and never waits for readers;
+ * acquiring takes a reference and never waits for the writer. Snapshot data
+ * is split into reference-counted chunks of IR_FLOWCHART_SNAPSHOT_CHUNK
+ * elements shared between consecutive snapshots. The builder API marks the
+ * chunks it changes, so a publish rebuilds only those; the others are
+ * reused as they are, or after comparing their boxes and paths in place
+ * when a layout ran since the previous publish.
+ *
+ * One thread at a time may publish, the one mutating the flowchart.
+ * Snapshots stay valid after the flowchart is destroyed. Indices are those
+ * of the state's registries when the snapshot was published.
+ */
+
+#define IR_FLOWCHART_SNAPSHOT_CHUNK 256    // Nodes, edges or subgraphs per chunk
+
+typedef struct IRFlowchartSnapshot IRFlowchartSnapshot;
+
+// Strings and path points below are owned by the snapshot
+
+typedef struct {
+    float x, y, width, height;
+    IRFlowchartShape shape;
+    const char* label;                 // NULL if none
+    uint32_t label_length;
+    uint32_t fill_color;               // RGBA, styles applied
+    uint32_t stroke_color;
+    float stroke_width;
+    uint32_t style_flags;              // IR_FLOWCHART_STYLE_* set directly on the node
+} IRFlowchartSnapshotNode;
+
+typedef struct {
+    uint32_t from_index;               // Node indices (IR_FLOWCHART_INVALID_INDEX if unresolved)
+    uint32_t to_index;
+    const float* path_points;          // x,y pairs (NULL if not routed)
+    uint32_t path_point_count;
+    float label_x, label_y;
+    IRFlowchartEdgeType type;
+    IRFlowchartMarker start_marker;
+    IRFlowchartMarker end_marker;
+    const char* label;                 // NULL if none
+    uint32_t label_length;
+    uint32_t stroke_color;             // Valid with IR_FLOWCHART_STYLE_STROKE
+    float stroke_width;                // Valid with IR_FLOWCHART_STYLE_STROKE_WIDTH
+    uint32_t style_flags;
+} IRFlowchartSnapshotEdge;
+
+typedef struct {
+    float x, y, width, height;
+    const char* title;                 // NULL if none
+    uint32_t title_length;
+    uint32_t background_color;         // RGBA
+    uint32_t border_color;
+} IRFlowchartSnapshotSubgraph;
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+/**
+ * Publish the flowchart's current layout
+ *
+ * Call after ir_layout_compute_flowchart(). The previous snapshot stays
+ * valid for readers still holding it.
+ *
+ * @return false when no layout is computed or on allocation failure
+ *         (the previous snapshot stays published)
+ */
+bool ir_flowchart_snapshot_publish(IRComponent* flowchart);
+
+/**
+ * Rebuild every chunk on the next publish
+ *
+ * Needed after writing element data fields directly instead of through the
+ * builder API, which the publisher cannot see.
+ */
+void ir_flowchart_snapshot_invalidate(IRComponent* flowchart);
+
+// ============================================================================
+// Readers (any thread)
+// ============================================================================
+
+/**
+ * Take a reference to the latest published snapshot
+ *
+ * @return NULL before the first publish
+ */
+const IRFlowchartSnapshot* ir_flowchart_snapshot_acquire(IRComponent* flowchart);
+
+/**
+ * Drop a reference taken by ir_flowchart_snapshot_acquire (NULL is ignored)
+ */
+void ir_flowchart_snapshot_release(const IRFlowchartSnapshot* snapshot);
+
+/**
+ * Publication number, increasing from 1
+ */
+uint64_t ir_flowchart_snapshot_version(const IRFlowchartSnapshot* snapshot);
+
+uint32_t ir_flowchart_snapshot_node_count(const IRFlowchartSnapshot* snapshot);
+uint32_t ir_flowchart_snapshot_edge_count(const IRFlowchartSnapshot* snapshot);
+uint32_t ir_flowchart_snapshot_subgraph_count(const IRFlowchartSnapshot* snapshot);
+
+/**
+ * Content size (IRFlowchartState.content_width / content_height)
+ */
+void ir_flowchart_snapshot_size(const IRFlowchartSnapshot* snapshot, float* width, float* height);
+
+/**
+ * @param box Receives x, y, width, height
+ * @return false when index is out of range
+ */
+bool ir_flowchart_snapshot_node_box(const IRFlowchartSnapshot* snapshot, uint32_t index, float box[4]);
+bool ir_flowchart_snapshot_subgraph_box(const IRFlowchartSnapshot* snapshot, uint32_t index, float box[4]);
+
+/**
+ * @return false when index is out of range
+ */
+bool ir_flowchart_snapshot_node(const IRFlowchartSnapshot* snapshot, uint32_t index, IRFlowchartSnapshotNode* node);
+bool ir_flowchart_snapshot_edge(const IRFlowchartSnapshot* snapshot, uint32_t index, IRFlowchartSnapshotEdge* edge);
+bool ir_flowchart_snapshot_subgraph(const IRFlowchartSnapshot* snapshot, uint32_t index,
+                                    IRFlowchartSnapshotSubgraph* subgraph);
+
+// ============================================================================
+// Hooks for the state
+// ============================================================================
+
+typedef enum {
+    IR_FLOWCHART_SNAPSHOT_NODES,
+    IR_FLOWCHART_SNAPSHOT_EDGES,
+    IR_FLOWCHART_SNAPSHOT_SUBGRAPHS
+} IRFlowchartSnapshotKind;
+
+IRFlowchartPublisher* ir_flowchart_publisher_create(void);
+
+/**
+ * Record that element `index` of `kind` changed since the last publish
+ *
+ * @param index IR_FLOWCHART_INVALID_INDEX marks every element of the kind
+ *              (NULL publisher is ignored)
+ */
+void ir_flowchart_publisher_mark(IRFlowchartPublisher* publisher, IRFlowchartSnapshotKind kind, uint32_t index);
+
+/**
+ * Drop the published snapshot; readers holding it keep it alive
+ */
+void ir_flowchart_publisher_destroy(IRFlowchartPublisher* publisher);
+
+#endif // FLOWCHART_SNAPSHOT_H
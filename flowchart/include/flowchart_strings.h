@@ -0,0 +1,56 @@
+#ifndef FLOWCHART_STRINGS_H
+#define FLOWCHART_STRINGS_H
+
+#include <stddef.h>
+#include "flowchart_types.h"
+
+/**
+ * Flowchart string arena
+ *
+ * IDs, labels and titles of a flowchart are interned in an arena owned by
+ * its state (IRFlowchartState.strings). Each distinct string is stored
+ * once, in large chunks that are freed together with the state. Two
+ * strings interned in the same arena are equal exactly when their pointers
+ * are, and each one carries its hash, so lookups keyed by interned IDs
+ * never look at the characters.
+ *
+ * Interned strings are read-only and live as long as the arena.
+ */
+
+/**
+ * Create an empty arena (nothing is allocated until the first string)
+ */
+IRFlowchartStringArena* ir_flowchart_string_arena_create(void);
+
+/**
+ * Free an arena and every string interned in it
+ *
+ * @param arena Arena to free (NULL is ignored)
+ */
+void ir_flowchart_string_arena_destroy(IRFlowchartStringArena* arena);
+
+/**
+ * Intern a NUL-terminated string
+ *
+ * @return The arena's copy (NULL if str is NULL or on allocation failure)
+ */
+const char* ir_flowchart_intern(IRFlowchartStringArena* arena, const char* str);
+
+/**
+ * Intern `length` bytes of a string that need not be NUL-terminated
+ *
+ * @return The arena's NUL-terminated copy (NULL on allocation failure)
+ */
+const char* ir_flowchart_intern_n(IRFlowchartStringArena* arena, const char* str, size_t length);
+
+/**
+ * FNV-1a hash of a NUL-terminated string
+ */
+uint32_t ir_flowchart_string_hash(const char* str);
+
+/**
+ * Hash stored with an interned string (same value as ir_flowchart_string_hash)
+ */
+uint32_t ir_flowchart_interned_hash(const char* interned);
+
+#endif // FLOWCHART_STRINGS_H
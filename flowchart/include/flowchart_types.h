@@ -12,6 +12,25 @@
 #define IR_COMPONENT_FLOWCHART_SUBGRAPH 50
 #define IR_COMPONENT_FLOWCHART_LABEL 51
 
+// Sentinel for unresolved node/edge indices
+#define IR_FLOWCHART_INVALID_INDEX UINT32_MAX
+
+// Stable reference to a registered node, edge or subgraph: generation << 32 | handle table slot
+// It keeps naming its element while the registries are reordered or rebuilt,
+// and goes stale once the element is removed (see ir_flowchart_*_handle_index)
+typedef uint64_t IRFlowchartHandle;
+#define IR_FLOWCHART_NULL_HANDLE 0
+
+// Changes recorded since the last layout (IRFlowchartState.dirty_flags)
+#define IR_FLOWCHART_DIRTY_LABELS    0x1u  // Node labels changed (dirty_nodes)
+#define IR_FLOWCHART_DIRTY_EDGES     0x2u  // Edges added or removed (dirty_edge_ends)
+#define IR_FLOWCHART_DIRTY_STRUCTURE 0x4u  // Nodes or subgraphs changed; needs a full layout
+
+// Style properties (IRFlowchartStyle.flags and the elements' style_flags)
+#define IR_FLOWCHART_STYLE_FILL         0x1u
+#define IR_FLOWCHART_STYLE_STROKE       0x2u
+#define IR_FLOWCHART_STYLE_STROKE_WIDTH 0x4u
+
 // Flowchart direction (layout direction)
 typedef enum {
     IR_FLOWCHART_DIR_TB,    // Top to Bottom (default)
@@ -52,23 +71,40 @@ typedef enum {
     IR_FLOWCHART_MARKER_CROSS          // Cross marker (x)
 } IRFlowchartMarker;
 
+// String arena interning a flowchart's IDs, labels and titles (opaque, owned by the state)
+typedef struct IRFlowchartStringArena IRFlowchartStringArena;
+
+// Slab allocator for node and edge data (opaque, owned by the state)
+typedef struct IRFlowchartPool IRFlowchartPool;
+
 // Flowchart node data (stored in custom_data)
 typedef struct IRFlowchartNodeData {
     char* node_id;                     // Node ID for edge references (e.g., "A", "start")
     IRFlowchartShape shape;            // Visual shape
     char* label;                       // Display text
 
-    // Computed layout (filled during layout phase)
-    float x, y;                        // Position
-    float width, height;               // Dimensions
+    // Computed layout lives in IRFlowchartState.node_x/node_y/node_width/node_height
+    uint32_t index;                    // Slot in IRFlowchartState.nodes (IR_FLOWCHART_INVALID_INDEX until registered)
+    IRFlowchartHandle handle;          // Stable reference (IR_FLOWCHART_NULL_HANDLE until registered)
+    uint32_t first_edge[2];            // Heads of the outgoing [0] and incoming [1] edge lists (edge indices)
 
     // Styling
     uint32_t fill_color;               // Background color (RGBA)
     uint32_t stroke_color;             // Border color (RGBA)
     float stroke_width;                // Border width
+    uint32_t style_class;              // Class (index + 1 into IRFlowchartState.styles, 0 = none)
+    uint32_t style_flags;              // IR_FLOWCHART_STYLE_* set directly; classes do not override them
 
     // For subgraph containment
     char* subgraph_id;                 // ID of containing subgraph (NULL if none)
+    uint32_t subgraph_index;           // Containing subgraph in IRFlowchartState.subgraphs (IR_FLOWCHART_INVALID_INDEX if none)
+
+    struct IRComponent* component;     // Component carrying this data (set at registration)
+    uint32_t child_slot;               // Position among the parent's children (hint, checked before use)
+    char* label_buffer;                // Labels set by ir_flowchart_set_label, rewritten in place (owned)
+    uint32_t label_capacity;           // Bytes allocated for label_buffer
+    IRFlowchartStringArena* strings;   // Arena holding the strings above (NULL = each one malloc'd)
+    IRFlowchartPool* pool;             // Slab holding this struct (NULL = malloc'd)
 } IRFlowchartNodeData;
 
 // Flowchart edge data (stored in custom_data)
@@ -77,17 +113,34 @@ typedef struct IRFlowchartEdgeData {
     char* to_id;                       // Target node ID
     char* label;                       // Optional edge label text
 
+    // Resolved endpoints (indices into IRFlowchartState.nodes)
+    uint32_t from_index;               // IR_FLOWCHART_INVALID_INDEX if unresolved
+    uint32_t to_index;                 // IR_FLOWCHART_INVALID_INDEX if unresolved
+    uint32_t next_edge[2];             // Links in the source's outgoing [0] and the target's
+    uint32_t prev_edge[2];             //   incoming [1] edge list, set once that end resolves
+    IRFlowchartHandle handle;          // Stable reference (IR_FLOWCHART_NULL_HANDLE until registered)
+
     // Edge styling
     IRFlowchartEdgeType type;          // Line style
     IRFlowchartMarker start_marker;    // Marker at start
     IRFlowchartMarker end_marker;      // Marker at end
+    uint32_t stroke_color;             // Line color (RGBA), valid with IR_FLOWCHART_STYLE_STROKE
+    float stroke_width;                // Line width, valid with IR_FLOWCHART_STYLE_STROKE_WIDTH
+    uint32_t style_class;              // linkStyle (index + 1 into IRFlowchartState.styles, 0 = none)
+    uint32_t style_flags;              // IR_FLOWCHART_STYLE_* properties set (renderer defaults otherwise)
+    bool link_style_resolved;          // style_class taken from IRFlowchartState.link_styles (done once)
 
     // Computed path (filled during layout phase)
-    float* path_points;                // Array of x,y coordinates [x0,y0,x1,y1,...]
+    float* path_points;                // Array of x,y coordinates [x0,y0,x1,y1,...] (points into IRFlowchartState.path_pool)
     uint32_t path_point_count;         // Number of coordinate pairs
 
     // Label position (computed)
     float label_x, label_y;            // Position for edge label
+
+    struct IRComponent* component;     // Component carrying this data (set at registration)
+    uint32_t child_slot;               // Position among the parent's children (hint, checked before use)
+    IRFlowchartStringArena* strings;   // Arena holding the strings above (NULL = each one malloc'd)
+    IRFlowchartPool* pool;             // Slab holding this struct (NULL = malloc'd)
 } IRFlowchartEdgeData;
 
 // Flowchart subgraph data (for grouped nodes)
@@ -104,12 +157,57 @@ typedef struct IRFlowchartSubgraphData {
     float local_height;                // Height in local coordinates
     bool layout_computed;              // Flag to track if layout done
     char* parent_subgraph_id;          // Parent subgraph ID (NULL if top-level)
+    uint32_t parent_index;             // Parent in IRFlowchartState.subgraphs (IR_FLOWCHART_INVALID_INDEX if top-level)
 
     // Styling
     uint32_t background_color;         // Background color (RGBA)
     uint32_t border_color;             // Border color (RGBA)
+
+    IRFlowchartHandle handle;          // Stable reference (IR_FLOWCHART_NULL_HANDLE until registered)
+    struct IRComponent* component;     // Component carrying this data (set at registration)
+    uint32_t child_slot;               // Position among the parent's children (hint, checked before use)
+    IRFlowchartStringArena* strings;   // Arena holding the strings above (NULL = each one malloc'd)
 } IRFlowchartSubgraphData;
 
+// Compiled classDef or linkStyle, resolved onto the elements at finalization
+// A node with several classes points at a combined entry: `base` applied first, then `top`
+typedef struct {
+    const char* name;                  // Class name (interned); NULL for combined entries and link styles
+    uint32_t base;                     // Combined entry: classes applied first (index + 1)
+    uint32_t top;                      // Combined entry: class applied last (index + 1)
+    uint32_t flags;                    // IR_FLOWCHART_STYLE_* properties defined
+    uint32_t fill_color;
+    uint32_t stroke_color;
+    float stroke_width;
+} IRFlowchartStyle;
+
+// Where the element behind a handle sits now
+typedef struct {
+    uint32_t index;                    // Registry index (IR_FLOWCHART_INVALID_INDEX while free)
+    uint32_t generation;               // Bumped when the slot is freed, so older handles go stale
+    uint32_t next_free;                // Free list link
+} IRFlowchartHandleSlot;
+
+// Handles of one kind of element
+typedef struct {
+    IRFlowchartHandleSlot* slots;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t free_head;                // First free slot (IR_FLOWCHART_INVALID_INDEX if none)
+} IRFlowchartHandleTable;
+
+// Natural layout kept between layout passes (opaque, owned by the state)
+typedef struct IRFlowchartLayoutCache IRFlowchartLayoutCache;
+
+// Natural layout detached from its chart, as kept by the parse/layout cache (opaque)
+typedef struct IRFlowchartLayoutSnapshot IRFlowchartLayoutSnapshot;
+
+// Measured label widths and font heights (opaque, owned by the state)
+typedef struct IRFlowchartTextCache IRFlowchartTextCache;
+
+// Published layout snapshots (opaque, owned by the state, see flowchart_snapshot.h)
+typedef struct IRFlowchartPublisher IRFlowchartPublisher;
+
 // Flowchart state (stored in Flowchart component's custom_data)
 typedef struct IRFlowchartState {
     IRFlowchartDirection direction;    // Layout direction (TB, LR, BT, RL)
@@ -119,22 +217,81 @@ typedef struct IRFlowchartState {
     uint32_t node_count;
     uint32_t node_capacity;
 
+    // Node geometry, parallel to `nodes` (filled during layout phase)
+    float* node_x;                     // Position (top-left)
+    float* node_y;
+    float* node_width;                 // Dimensions
+    float* node_height;
+
+    // Node ID index (open addressing, slot holds node index + 1, 0 = empty)
+    uint32_t* node_index_slots;
+    uint32_t node_index_capacity;      // Power of two
+
     // Edge registry
     IRFlowchartEdgeData** edges;       // Array of edge data pointers
     uint32_t edge_count;
     uint32_t edge_capacity;
+    bool edges_resolved;               // All edge endpoints resolved to indices
 
     // Subgraph registry
     IRFlowchartSubgraphData** subgraphs;
     uint32_t subgraph_count;
     uint32_t subgraph_capacity;
 
+    // Direct member nodes of subgraph s (see ir_flowchart_resolve_subgraphs):
+    // subgraph_members[subgraph_member_offsets[s] .. subgraph_member_offsets[s + 1])
+    uint32_t* subgraph_member_offsets; // subgraph_count + 1 entries (NULL before finalization)
+    uint32_t* subgraph_members;        // Node indices, in registration order
+    bool subgraphs_resolved;           // Containers resolved to indices and member lists current
+
+    // Handles of the registered elements, by kind
+    IRFlowchartHandleTable node_handles;
+    IRFlowchartHandleTable edge_handles;
+    IRFlowchartHandleTable subgraph_handles;
+
+    // Edge path storage shared by all edges (owned by the state, reused across layouts)
+    float* path_pool;
+    uint32_t path_pool_count;          // Floats in use
+    uint32_t path_pool_capacity;       // Floats allocated
+
     // Layout cache
     bool layout_computed;
     float computed_width;
     float computed_height;
     float natural_width;               // Natural width before scaling
     float natural_height;              // Natural height before scaling
+    float fit_scale;                   // Fit applied to the natural layout: position =
+    float fit_offset_x;                //   fit_offset + natural position * fit_scale
+    float fit_offset_y;                //   (node sizes are never scaled)
+    uint64_t layout_generation;        // Bumped whenever layout rewrites the geometry
+    IRFlowchartLayoutCache* layout_cache;  // Natural layout kept for resizes (owned)
+    IRFlowchartTextCache* text_cache;  // Label measurements kept across layouts (owned)
+    IRFlowchartStringArena* strings;   // Interned IDs, labels and titles (owned)
+    IRFlowchartPool* node_pool;        // Node data slabs (owned)
+    IRFlowchartPool* edge_pool;        // Edge data slabs (owned)
+    IRFlowchartPublisher* publisher;   // Snapshots handed to other threads (owned)
+    uint64_t content_key;              // Hash of the source this chart was parsed from (0 = unknown or edited)
+
+    // Style table (classDef, class and linkStyle statements)
+    IRFlowchartStyle* styles;
+    uint32_t style_count;
+    uint32_t style_capacity;
+    uint32_t* style_index_slots;       // Classes by interned name and combined entries by (base, top):
+    uint32_t style_index_capacity;     //   index + 1, open addressing, power of two, at most half full
+    uint32_t default_class;            // classDef default, applied under every node's classes (index + 1, 0 = none)
+    uint32_t* link_styles;             // Style (index + 1, 0 = none) per edge index, until the edge takes it
+    uint32_t link_style_count;
+    uint32_t link_style_capacity;
+    uint32_t link_style_default;       // linkStyle default, applied under every edge's own (index + 1, 0 = none)
+
+    // Changes since the last layout, recorded by the mutation API (ir_flowchart_set_label etc.)
+    uint32_t dirty_flags;              // IR_FLOWCHART_DIRTY_* bits
+    uint32_t* dirty_nodes;             // Relabelled nodes, re-measured by the next layout
+    uint32_t dirty_node_count;
+    uint32_t dirty_node_capacity;
+    uint32_t* dirty_edge_ends;         // from, to node index of every added or removed edge
+    uint32_t dirty_edge_end_count;     // Entries (two per edge)
+    uint32_t dirty_edge_end_capacity;
 
     // Content bounds (for responsive SVG)
     float content_width;               // Actual width of flowchart content
@@ -145,6 +302,9 @@ typedef struct IRFlowchartState {
     // Layout parameters
     float node_spacing;                // Space between nodes
     float rank_spacing;                // Space between layers/ranks
+    uint32_t crossing_iterations;      // Max crossing-reduction sweeps (0 = keep registration order)
+    float crossing_time_budget_ms;     // Wall-clock cap for crossing reduction (<= 0 = unlimited)
+    uint32_t layout_threads;           // Threads for independent components (0 = one per CPU, 1 = serial)
     float subgraph_padding;            // Padding inside subgraphs
 } IRFlowchartState;
 
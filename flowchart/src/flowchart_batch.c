@@ -0,0 +1,65 @@
+// ============================================================================
+// FLOWCHART BATCH PROCESSING
+// ============================================================================
+
+#include "flowchart_batch.h"
+#include "flowchart_builder.h"
+#include "flowchart_layout.h"
+#include "flowchart_parallel.h"
+#include "flowchart_parser.h"
+#include <stdlib.h>
+
+typedef struct {
+    const IRFlowchartSource* sources;
+    const IRFlowchartBatchOptions* opts;
+    bool parallel;                     // Charts run side by side on several threads
+    IRComponent** results;
+} BatchWork;
+
+IRFlowchartBatchOptions ir_flowchart_batch_options_default(void) {
+    IRFlowchartBatchOptions opts;
+    opts.threads = 0;
+    opts.layout = true;
+    opts.available_width = 0;
+    opts.available_height = 0;
+    return opts;
+}
+
+// Worker: one chart, written to its own result slot
+static void batch_process_one(void* user_data, uint32_t index) {
+    BatchWork* work = (BatchWork*)user_data;
+    const IRFlowchartSource* source = &work->sources[index];
+
+    IRComponent* flowchart = source->source ? ir_flowchart_parse(source->source, source->length) : NULL;
+    if (flowchart && work->opts->layout) {
+        // The pool is already busy with other charts; threads inside one
+        // chart would only compete with it (layouts do not depend on this)
+        IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+        if (work->parallel) state->layout_threads = 1;
+        ir_layout_compute_flowchart(flowchart, work->opts->available_width, work->opts->available_height);
+    }
+    work->results[index] = flowchart;
+}
+
+uint32_t ir_flowchart_process_batch(const IRFlowchartSource* sources, uint32_t count,
+                                    const IRFlowchartBatchOptions* opts, IRComponent** results) {
+    if (!sources || !results || count == 0) return 0;
+
+    IRFlowchartBatchOptions defaults = ir_flowchart_batch_options_default();
+    if (!opts) opts = &defaults;
+
+    uint32_t threads = opts->threads == 0 ? ir_flowchart_parallel_default_threads() : opts->threads;
+
+    BatchWork work;
+    work.sources = sources;
+    work.opts = opts;
+    work.parallel = threads > 1 && count > 1;
+    work.results = results;
+    ir_flowchart_parallel_for(count, threads, batch_process_one, &work);
+
+    uint32_t parsed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (results[i]) parsed++;
+    }
+    return parsed;
+}
@@ -1,5 +1,11 @@
 #include "flowchart_builder.h"
+#include "flowchart_layout.h"
+#include "flowchart_measure.h"
+#include "flowchart_pool.h"
+#include "flowchart_snapshot.h"
+#include "flowchart_strings.h"
 #include "ir_builder.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -7,6 +13,9 @@
 // Default layout parameters
 #define DEFAULT_NODE_SPACING 20.0f
 #define DEFAULT_RANK_SPACING 40.0f
+#define DEFAULT_CROSSING_ITERATIONS 24
+#define DEFAULT_CROSSING_TIME_BUDGET_MS 0.0f
+#define DEFAULT_LAYOUT_THREADS 0
 #define DEFAULT_SUBGRAPH_PADDING 40.0f
 
 // ============================================================================
@@ -17,6 +26,19 @@ IRFlowchartState* ir_flowchart_create_state(void) {
     IRFlowchartState* state = (IRFlowchartState*)calloc(1, sizeof(IRFlowchartState));
     if (!state) return NULL;
 
+    state->strings = ir_flowchart_string_arena_create();
+    state->node_pool = ir_flowchart_pool_create(sizeof(IRFlowchartNodeData));
+    state->edge_pool = ir_flowchart_pool_create(sizeof(IRFlowchartEdgeData));
+    state->publisher = ir_flowchart_publisher_create();
+    if (!state->strings || !state->node_pool || !state->edge_pool || !state->publisher) {
+        ir_flowchart_string_arena_destroy(state->strings);
+        ir_flowchart_pool_release(state->node_pool);
+        ir_flowchart_pool_release(state->edge_pool);
+        ir_flowchart_publisher_destroy(state->publisher);
+        free(state);
+        return NULL;
+    }
+
     state->direction = IR_FLOWCHART_DIR_TB;
     state->nodes = NULL;
     state->node_count = 0;
@@ -27,9 +49,32 @@ IRFlowchartState* ir_flowchart_create_state(void) {
     state->subgraphs = NULL;
     state->subgraph_count = 0;
     state->subgraph_capacity = 0;
+    state->node_index_slots = NULL;
+    state->node_index_capacity = 0;
+    state->edges_resolved = true;
+    state->subgraphs_resolved = true;
+    state->node_handles.free_head = IR_FLOWCHART_INVALID_INDEX;
+    state->edge_handles.free_head = IR_FLOWCHART_INVALID_INDEX;
+    state->subgraph_handles.free_head = IR_FLOWCHART_INVALID_INDEX;
+    state->path_pool = NULL;
+    state->path_pool_count = 0;
+    state->path_pool_capacity = 0;
     state->layout_computed = false;
+    state->fit_scale = 1.0f;
+    state->layout_cache = NULL;
+    state->text_cache = NULL;
+    state->dirty_flags = 0;
+    state->dirty_nodes = NULL;
+    state->dirty_node_count = 0;
+    state->dirty_node_capacity = 0;
+    state->dirty_edge_ends = NULL;
+    state->dirty_edge_end_count = 0;
+    state->dirty_edge_end_capacity = 0;
     state->node_spacing = DEFAULT_NODE_SPACING;
     state->rank_spacing = DEFAULT_RANK_SPACING;
+    state->crossing_iterations = DEFAULT_CROSSING_ITERATIONS;
+    state->crossing_time_budget_ms = DEFAULT_CROSSING_TIME_BUDGET_MS;
+    state->layout_threads = DEFAULT_LAYOUT_THREADS;
     state->subgraph_padding = DEFAULT_SUBGRAPH_PADDING;
 
     return state;
@@ -38,8 +83,32 @@ IRFlowchartState* ir_flowchart_create_state(void) {
 void ir_flowchart_destroy_state(IRFlowchartState* state) {
     if (!state) return;
     free(state->nodes);
+    free(state->node_x);
+    free(state->node_y);
+    free(state->node_width);
+    free(state->node_height);
+    free(state->node_index_slots);
     free(state->edges);
     free(state->subgraphs);
+    free(state->subgraph_member_offsets);
+    free(state->subgraph_members);
+    free(state->node_handles.slots);
+    free(state->edge_handles.slots);
+    free(state->subgraph_handles.slots);
+    free(state->path_pool);
+    free(state->dirty_nodes);
+    free(state->dirty_edge_ends);
+    free(state->styles);
+    free(state->style_index_slots);
+    free(state->link_styles);
+    ir_flowchart_layout_cache_destroy(state->layout_cache);
+    ir_flowchart_text_cache_destroy(state->text_cache);
+    ir_flowchart_string_arena_destroy(state->strings);
+    // Snapshots still held by readers stay valid
+    ir_flowchart_publisher_destroy(state->publisher);
+    // Elements still alive keep their slabs until they are destroyed
+    ir_flowchart_pool_release(state->node_pool);
+    ir_flowchart_pool_release(state->edge_pool);
     free(state);
 }
 
@@ -52,26 +121,81 @@ IRFlowchartState* ir_get_flowchart_state(IRComponent* c) {
 // Node Data Management
 // ============================================================================
 
-IRFlowchartNodeData* ir_flowchart_node_data_create(const char* node_id, IRFlowchartShape shape, const char* label) {
-    IRFlowchartNodeData* data = (IRFlowchartNodeData*)calloc(1, sizeof(IRFlowchartNodeData));
+// Copy a string into `strings` when given, on the heap otherwise
+// Sets *failed when a non-NULL string could not be copied
+static char* ir_flowchart_copy_string(IRFlowchartStringArena* strings, const char* str, bool* failed) {
+    if (!str) return NULL;
+    char* copy = strings ? (char*)ir_flowchart_intern(strings, str) : strdup(str);
+    if (!copy) *failed = true;
+    return copy;
+}
+
+// State of the flowchart holding an element's component (NULL when it is in none)
+static IRFlowchartState* ir_flowchart_element_state(IRComponent* component) {
+    for (IRComponent* c = component ? component->parent : NULL; c; c = c->parent) {
+        if (c->type == IR_COMPONENT_FLOWCHART) return ir_get_flowchart_state(c);
+    }
+    return NULL;
+}
+
+// Setters below change what the next snapshot publishes for registered elements
+static void ir_flowchart_mark_node(const IRFlowchartNodeData* data) {
+    if (data->index == IR_FLOWCHART_INVALID_INDEX) return;
+    IRFlowchartState* state = ir_flowchart_element_state(data->component);
+    if (state) ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_NODES, data->index);
+}
+
+static void ir_flowchart_mark_edge(const IRFlowchartEdgeData* data) {
+    IRFlowchartState* state = ir_flowchart_element_state(data->component);
+    uint32_t index = state ? ir_flowchart_edge_handle_index(state, data->handle) : IR_FLOWCHART_INVALID_INDEX;
+    if (index != IR_FLOWCHART_INVALID_INDEX) {
+        ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, index);
+    }
+}
+
+IRFlowchartNodeData* ir_flowchart_node_data_create_in(IRFlowchartState* state, const char* node_id,
+                                                      IRFlowchartShape shape, const char* label) {
+    IRFlowchartNodeData* data = state ? (IRFlowchartNodeData*)ir_flowchart_pool_alloc(state->node_pool)
+                                      : (IRFlowchartNodeData*)calloc(1, sizeof(IRFlowchartNodeData));
     if (!data) return NULL;
 
-    data->node_id = node_id ? strdup(node_id) : NULL;
+    bool failed = false;
+    IRFlowchartStringArena* strings = state ? state->strings : NULL;
+    data->strings = strings;
+    data->pool = state ? state->node_pool : NULL;
+    data->node_id = ir_flowchart_copy_string(strings, node_id, &failed);
     data->shape = shape;
-    data->label = label ? strdup(label) : NULL;
+    data->label = ir_flowchart_copy_string(strings, label, &failed);
+    data->index = IR_FLOWCHART_INVALID_INDEX;
+    data->first_edge[0] = data->first_edge[1] = IR_FLOWCHART_INVALID_INDEX;
+    data->subgraph_index = IR_FLOWCHART_INVALID_INDEX;
+    data->child_slot = IR_FLOWCHART_INVALID_INDEX;
     data->fill_color = 0xFFFFFFFF;
     data->stroke_color = 0x000000FF;
     data->stroke_width = 1.0f;
 
+    if (failed) {
+        ir_flowchart_node_data_destroy(data);
+        return NULL;
+    }
     return data;
 }
 
+IRFlowchartNodeData* ir_flowchart_node_data_create(const char* node_id, IRFlowchartShape shape, const char* label) {
+    return ir_flowchart_node_data_create_in(NULL, node_id, shape, label);
+}
+
 void ir_flowchart_node_data_destroy(IRFlowchartNodeData* data) {
     if (!data) return;
-    free(data->node_id);
-    free(data->label);
-    free(data->subgraph_id);
-    free(data);
+    // Interned strings are freed with the flowchart's arena
+    if (!data->strings) {
+        free(data->node_id);
+        if (data->label != data->label_buffer) free(data->label);
+        free(data->subgraph_id);
+    }
+    free(data->label_buffer);
+    if (data->pool) ir_flowchart_pool_free(data->pool, data);
+    else free(data);
 }
 
 IRFlowchartNodeData* ir_get_flowchart_node_data(IRComponent* c) {
@@ -83,12 +207,28 @@ IRFlowchartNodeData* ir_get_flowchart_node_data(IRComponent* c) {
 // Edge Data Management
 // ============================================================================
 
-IRFlowchartEdgeData* ir_flowchart_edge_data_create(const char* from_id, const char* to_id) {
-    IRFlowchartEdgeData* data = (IRFlowchartEdgeData*)calloc(1, sizeof(IRFlowchartEdgeData));
+IRFlowchartEdgeData* ir_flowchart_edge_data_create_in(IRFlowchartState* state,
+                                                       const char* from_id, const char* to_id) {
+    IRFlowchartEdgeData* data = state ? (IRFlowchartEdgeData*)ir_flowchart_pool_alloc(state->edge_pool)
+                                      : (IRFlowchartEdgeData*)calloc(1, sizeof(IRFlowchartEdgeData));
     if (!data) return NULL;
 
-    data->from_id = from_id ? strdup(from_id) : NULL;
-    data->to_id = to_id ? strdup(to_id) : NULL;
+    bool failed = false;
+    IRFlowchartStringArena* strings = state ? state->strings : NULL;
+    data->strings = strings;
+    data->pool = state ? state->edge_pool : NULL;
+    data->from_id = ir_flowchart_copy_string(strings, from_id, &failed);
+    data->to_id = ir_flowchart_copy_string(strings, to_id, &failed);
+    if (failed) {
+        ir_flowchart_edge_data_destroy(data);
+        return NULL;
+    }
+    data->from_index = IR_FLOWCHART_INVALID_INDEX;
+    data->to_index = IR_FLOWCHART_INVALID_INDEX;
+    for (int side = 0; side < 2; side++) {
+        data->next_edge[side] = data->prev_edge[side] = IR_FLOWCHART_INVALID_INDEX;
+    }
+    data->child_slot = IR_FLOWCHART_INVALID_INDEX;
     data->type = IR_FLOWCHART_EDGE_ARROW;
     data->start_marker = IR_FLOWCHART_MARKER_NONE;
     data->end_marker = IR_FLOWCHART_MARKER_ARROW;
@@ -96,13 +236,20 @@ IRFlowchartEdgeData* ir_flowchart_edge_data_create(const char* from_id, const ch
     return data;
 }
 
+IRFlowchartEdgeData* ir_flowchart_edge_data_create(const char* from_id, const char* to_id) {
+    return ir_flowchart_edge_data_create_in(NULL, from_id, to_id);
+}
+
 void ir_flowchart_edge_data_destroy(IRFlowchartEdgeData* data) {
     if (!data) return;
-    free(data->from_id);
-    free(data->to_id);
-    free(data->label);
-    free(data->path_points);
-    free(data);
+    if (!data->strings) {
+        free(data->from_id);
+        free(data->to_id);
+        free(data->label);
+    }
+    // path_points belongs to the flowchart state's path pool
+    if (data->pool) ir_flowchart_pool_free(data->pool, data);
+    else free(data);
 }
 
 IRFlowchartEdgeData* ir_get_flowchart_edge_data(IRComponent* c) {
@@ -112,38 +259,57 @@ IRFlowchartEdgeData* ir_get_flowchart_edge_data(IRComponent* c) {
 
 void ir_flowchart_edge_set_label(IRFlowchartEdgeData* data, const char* label) {
     if (!data) return;
-    free(data->label);
-    data->label = label ? strdup(label) : NULL;
+    if (!data->strings) free(data->label);
+    bool failed = false;
+    data->label = ir_flowchart_copy_string(data->strings, label, &failed);
+    ir_flowchart_mark_edge(data);
 }
 
 void ir_flowchart_edge_set_markers(IRFlowchartEdgeData* data, IRFlowchartMarker start, IRFlowchartMarker end) {
     if (!data) return;
     data->start_marker = start;
     data->end_marker = end;
+    ir_flowchart_mark_edge(data);
 }
 
 // ============================================================================
 // Subgraph Data Management
 // ============================================================================
 
-IRFlowchartSubgraphData* ir_flowchart_subgraph_data_create(const char* subgraph_id, const char* title) {
+IRFlowchartSubgraphData* ir_flowchart_subgraph_data_create_in(IRFlowchartState* state,
+                                                               const char* subgraph_id, const char* title) {
     IRFlowchartSubgraphData* data = (IRFlowchartSubgraphData*)calloc(1, sizeof(IRFlowchartSubgraphData));
     if (!data) return NULL;
 
-    data->subgraph_id = subgraph_id ? strdup(subgraph_id) : NULL;
-    data->title = title ? strdup(title) : NULL;
+    bool failed = false;
+    IRFlowchartStringArena* strings = state ? state->strings : NULL;
+    data->strings = strings;
+    data->subgraph_id = ir_flowchart_copy_string(strings, subgraph_id, &failed);
+    data->title = ir_flowchart_copy_string(strings, title, &failed);
     data->direction = IR_FLOWCHART_DIR_TB;
+    data->parent_index = IR_FLOWCHART_INVALID_INDEX;
+    data->child_slot = IR_FLOWCHART_INVALID_INDEX;
     data->background_color = 0xF0F0F0FF;
     data->border_color = 0x000000FF;
 
+    if (failed) {
+        ir_flowchart_subgraph_data_destroy(data);
+        return NULL;
+    }
     return data;
 }
 
+IRFlowchartSubgraphData* ir_flowchart_subgraph_data_create(const char* subgraph_id, const char* title) {
+    return ir_flowchart_subgraph_data_create_in(NULL, subgraph_id, title);
+}
+
 void ir_flowchart_subgraph_data_destroy(IRFlowchartSubgraphData* data) {
     if (!data) return;
-    free(data->subgraph_id);
-    free(data->title);
-    free(data->parent_subgraph_id);
+    if (!data->strings) {
+        free(data->subgraph_id);
+        free(data->title);
+        free(data->parent_subgraph_id);
+    }
     free(data);
 }
 
@@ -156,32 +322,297 @@ IRFlowchartSubgraphData* ir_get_flowchart_subgraph_data(IRComponent* c) {
 // Node Styling
 // ============================================================================
 
+// Properties set here take precedence over the node's classes
+
 void ir_flowchart_node_set_fill_color(IRFlowchartNodeData* data, uint32_t color) {
     if (!data) return;
     data->fill_color = color;
+    data->style_flags |= IR_FLOWCHART_STYLE_FILL;
+    ir_flowchart_mark_node(data);
 }
 
 void ir_flowchart_node_set_stroke_color(IRFlowchartNodeData* data, uint32_t color) {
     if (!data) return;
     data->stroke_color = color;
+    data->style_flags |= IR_FLOWCHART_STYLE_STROKE;
+    ir_flowchart_mark_node(data);
 }
 
 void ir_flowchart_node_set_stroke_width(IRFlowchartNodeData* data, float width) {
     if (!data) return;
     data->stroke_width = width;
+    data->style_flags |= IR_FLOWCHART_STYLE_STROKE_WIDTH;
+    ir_flowchart_mark_node(data);
+}
+
+// ============================================================================
+// Style Tables
+// ============================================================================
+// classDef, class and linkStyle statements only record entries here; the
+// properties reach the elements in one pass at finalization.
+
+static uint32_t ir_flowchart_style_push(IRFlowchartState* state, const IRFlowchartStyle* style) {
+    if (state->style_count >= state->style_capacity) {
+        uint32_t new_capacity = state->style_capacity == 0 ? 16 : state->style_capacity * 2;
+        IRFlowchartStyle* new_styles = (IRFlowchartStyle*)realloc(state->styles, new_capacity * sizeof(IRFlowchartStyle));
+        if (!new_styles) return 0;
+        state->styles = new_styles;
+        state->style_capacity = new_capacity;
+    }
+    state->styles[state->style_count++] = *style;
+    return state->style_count;
+}
+
+// Classes and combined entries are found through an index keyed by the
+// interned name (compared by pointer) or the (base, top) pair; link styles
+// are reached by edge index and stay out of it
+static uint32_t ir_flowchart_style_hash(const char* name, uint32_t base, uint32_t top) {
+    if (name) return ir_flowchart_interned_hash(name);
+    uint32_t hash = base * 0x9E3779B1u ^ top * 0x85EBCA77u;
+    return hash ^ (hash >> 15);
+}
+
+// Entry with this name, or the combined entry of (base, top) when name is NULL (index + 1, 0 if none)
+static uint32_t ir_flowchart_style_find(const IRFlowchartState* state, const char* name, uint32_t base, uint32_t top) {
+    if (state->style_index_capacity == 0) return 0;
+
+    uint32_t mask = state->style_index_capacity - 1;
+    uint32_t slot = ir_flowchart_style_hash(name, base, top) & mask;
+    while (state->style_index_slots[slot] != 0) {
+        uint32_t index = state->style_index_slots[slot];
+        const IRFlowchartStyle* entry = &state->styles[index - 1];
+        if (name ? entry->name == name : (!entry->name && entry->base == base && entry->top == top)) return index;
+        slot = (slot + 1) & mask;
+    }
+    return 0;
+}
+
+static void ir_flowchart_style_index_insert(IRFlowchartState* state, uint32_t index) {
+    const IRFlowchartStyle* entry = &state->styles[index - 1];
+    uint32_t mask = state->style_index_capacity - 1;
+    uint32_t slot = ir_flowchart_style_hash(entry->name, entry->base, entry->top) & mask;
+    while (state->style_index_slots[slot] != 0) slot = (slot + 1) & mask;
+    state->style_index_slots[slot] = index;
+}
+
+// Index the entry just pushed (index + 1), growing the table as needed
+static bool ir_flowchart_style_index_add(IRFlowchartState* state, uint32_t index) {
+    if (state->style_count * 2 > state->style_index_capacity) {
+        uint32_t new_capacity = state->style_index_capacity == 0 ? 32 : state->style_index_capacity;
+        while (new_capacity < state->style_count * 2) new_capacity *= 2;
+
+        uint32_t* new_slots = (uint32_t*)calloc(new_capacity, sizeof(uint32_t));
+        if (!new_slots) return false;
+        free(state->style_index_slots);
+        state->style_index_slots = new_slots;
+        state->style_index_capacity = new_capacity;
+
+        for (uint32_t i = 1; i < index; i++) {
+            const IRFlowchartStyle* entry = &state->styles[i - 1];
+            if (entry->name || entry->base != 0) ir_flowchart_style_index_insert(state, i);
+        }
+    }
+    ir_flowchart_style_index_insert(state, index);
+    return true;
+}
+
+// Copy the properties `style` defines over `target`
+static void ir_flowchart_style_merge(IRFlowchartStyle* target, const IRFlowchartStyle* style) {
+    if (style->flags & IR_FLOWCHART_STYLE_FILL) target->fill_color = style->fill_color;
+    if (style->flags & IR_FLOWCHART_STYLE_STROKE) target->stroke_color = style->stroke_color;
+    if (style->flags & IR_FLOWCHART_STYLE_STROKE_WIDTH) target->stroke_width = style->stroke_width;
+    target->flags |= style->flags;
+}
+
+// Entry of a named class (index + 1, 0 on failure)
+// Created empty on first mention, since a class can be assigned before its classDef
+static uint32_t ir_flowchart_class_entry(IRFlowchartState* state, const char* name) {
+    const char* interned = ir_flowchart_intern(state->strings, name);
+    if (!interned) return 0;
+    uint32_t found = ir_flowchart_style_find(state, interned, 0, 0);
+    if (found != 0) return found;
+
+    IRFlowchartStyle entry = {0};
+    entry.name = interned;
+    uint32_t index = ir_flowchart_style_push(state, &entry);
+    if (index == 0) return 0;
+    if (!ir_flowchart_style_index_add(state, index)) {
+        state->style_count--;
+        return 0;
+    }
+    if (strcmp(interned, "default") == 0) state->default_class = index;
+    return index;
+}
+
+bool ir_flowchart_define_class(IRFlowchartState* state, const char* name, const IRFlowchartStyle* style) {
+    if (!state || !name || !style) return false;
+    uint32_t index = ir_flowchart_class_entry(state, name);
+    if (index == 0) return false;
+    ir_flowchart_style_merge(&state->styles[index - 1], style);
+    return true;
+}
+
+bool ir_flowchart_node_add_class(IRFlowchartState* state, IRFlowchartNodeData* node, const char* name) {
+    if (!state || !node || !name) return false;
+    uint32_t top = ir_flowchart_class_entry(state, name);
+    if (top == 0) return false;
+
+    uint32_t base = node->style_class;
+    if (base == 0 || base == top) {
+        node->style_class = top;
+        return true;
+    }
+
+    // Nodes with the same class list share one combined entry
+    uint32_t found = ir_flowchart_style_find(state, NULL, base, top);
+    if (found != 0) {
+        node->style_class = found;
+        return true;
+    }
+
+    IRFlowchartStyle combined = {0};
+    combined.base = base;
+    combined.top = top;
+    uint32_t index = ir_flowchart_style_push(state, &combined);
+    if (index == 0) return false;
+    if (!ir_flowchart_style_index_add(state, index)) {
+        state->style_count--;
+        return false;
+    }
+    node->style_class = index;
+    return true;
+}
+
+bool ir_flowchart_set_link_style(IRFlowchartState* state, uint32_t edge_index, const IRFlowchartStyle* style) {
+    if (!state || !style) return false;
+
+    uint32_t* slot = &state->link_style_default;
+    if (edge_index < state->edge_count && state->edges[edge_index] &&
+        state->edges[edge_index]->link_style_resolved) {
+        // The edge already took its entry from the table; it owns it from now on
+        slot = &state->edges[edge_index]->style_class;
+    } else if (edge_index != IR_FLOWCHART_INVALID_INDEX) {
+        if (edge_index >= state->link_style_capacity) {
+            uint32_t new_capacity = state->link_style_capacity == 0 ? 16 : state->link_style_capacity;
+            while (new_capacity <= edge_index && new_capacity < UINT32_MAX / 2) new_capacity *= 2;
+            if (new_capacity <= edge_index) return false;
+            uint32_t* new_styles = (uint32_t*)realloc(state->link_styles, new_capacity * sizeof(uint32_t));
+            if (!new_styles) return false;
+            memset(new_styles + state->link_style_capacity, 0,
+                   (new_capacity - state->link_style_capacity) * sizeof(uint32_t));
+            state->link_styles = new_styles;
+            state->link_style_capacity = new_capacity;
+        }
+        if (edge_index >= state->link_style_count) state->link_style_count = edge_index + 1;
+        slot = &state->link_styles[edge_index];
+    }
+
+    // Later statements for the same edge add to its entry
+    if (*slot == 0) {
+        IRFlowchartStyle entry = {0};
+        uint32_t index = ir_flowchart_style_push(state, &entry);
+        if (index == 0) return false;
+        *slot = index;
+    }
+    ir_flowchart_style_merge(&state->styles[*slot - 1], style);
+    return true;
+}
+
+// Keep entries not yet taken on the edges they were given for when the edge
+// at `index` is removed and the one at `moved` takes its slot (`moved` ==
+// `index` when the edges after it shift down instead)
+static void ir_flowchart_link_styles_remove(IRFlowchartState* state, uint32_t index, uint32_t moved) {
+    uint32_t count = state->link_style_count;
+    if (index >= count) return;
+    if (moved != index) {
+        state->link_styles[index] = moved < count ? state->link_styles[moved] : 0;
+        index = moved;
+        if (index >= count) return;
+    }
+    memmove(&state->link_styles[index], &state->link_styles[index + 1], (count - index - 1) * sizeof(uint32_t));
+    state->link_styles[count - 1] = 0;
+    state->link_style_count = count - 1;
+}
+
+// Combined entries only refer to entries created before them, so one pass in order resolves them all
+void ir_flowchart_compile_styles(IRFlowchartState* state) {
+    if (!state) return;
+    for (uint32_t i = 0; i < state->style_count; i++) {
+        IRFlowchartStyle* entry = &state->styles[i];
+        if (entry->name || entry->base == 0) continue;
+        entry->flags = 0;
+        ir_flowchart_style_merge(entry, &state->styles[entry->base - 1]);
+        ir_flowchart_style_merge(entry, &state->styles[entry->top - 1]);
+    }
+}
+
+static void ir_flowchart_node_apply(IRFlowchartNodeData* node, const IRFlowchartStyle* style) {
+    uint32_t flags = style->flags & ~node->style_flags;
+    if (flags & IR_FLOWCHART_STYLE_FILL) node->fill_color = style->fill_color;
+    if (flags & IR_FLOWCHART_STYLE_STROKE) node->stroke_color = style->stroke_color;
+    if (flags & IR_FLOWCHART_STYLE_STROKE_WIDTH) node->stroke_width = style->stroke_width;
+}
+
+void ir_flowchart_apply_node_style(const IRFlowchartState* state, IRFlowchartNodeData* node) {
+    if (!state || !node) return;
+    if (node->index != IR_FLOWCHART_INVALID_INDEX) {
+        ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_NODES, node->index);
+    }
+    if (state->default_class) ir_flowchart_node_apply(node, &state->styles[state->default_class - 1]);
+    if (node->style_class && node->style_class <= state->style_count) {
+        ir_flowchart_node_apply(node, &state->styles[node->style_class - 1]);
+    }
+}
+
+static void ir_flowchart_edge_apply(IRFlowchartEdgeData* edge, const IRFlowchartStyle* style) {
+    if (style->flags & IR_FLOWCHART_STYLE_STROKE) edge->stroke_color = style->stroke_color;
+    if (style->flags & IR_FLOWCHART_STYLE_STROKE_WIDTH) edge->stroke_width = style->stroke_width;
+    edge->style_flags |= style->flags & (IR_FLOWCHART_STYLE_STROKE | IR_FLOWCHART_STYLE_STROKE_WIDTH);
+}
+
+void ir_flowchart_apply_edge_style(const IRFlowchartState* state, IRFlowchartEdgeData* edge, uint32_t edge_index) {
+    if (!state || !edge) return;
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, edge_index);
+    // The index only picks the style the first time; edges keep it when others are removed
+    if (!edge->link_style_resolved) {
+        if (edge_index < state->link_style_count) edge->style_class = state->link_styles[edge_index];
+        edge->link_style_resolved = true;
+    }
+    if (state->link_style_default) ir_flowchart_edge_apply(edge, &state->styles[state->link_style_default - 1]);
+    if (edge->style_class && edge->style_class <= state->style_count) {
+        ir_flowchart_edge_apply(edge, &state->styles[edge->style_class - 1]);
+    }
 }
 
 // ============================================================================
 // Component Creation
 // ============================================================================
 
+// The core allocates components from shared state, so flowcharts built on
+// several threads (ir_flowchart_process_batch) take turns here
+static pthread_mutex_t g_component_lock = PTHREAD_MUTEX_INITIALIZER;
+
+IRComponent* ir_flowchart_new_component(IRComponentType type) {
+    pthread_mutex_lock(&g_component_lock);
+    IRComponent* comp = ir_create_component(type);
+    pthread_mutex_unlock(&g_component_lock);
+    return comp;
+}
+
+void ir_flowchart_free_component(IRComponent* comp) {
+    if (!comp) return;
+    pthread_mutex_lock(&g_component_lock);
+    ir_destroy_component(comp);
+    pthread_mutex_unlock(&g_component_lock);
+}
+
 IRComponent* ir_flowchart(IRFlowchartDirection direction) {
-    IRComponent* comp = ir_create_component(IR_COMPONENT_FLOWCHART);
+    IRComponent* comp = ir_flowchart_new_component(IR_COMPONENT_FLOWCHART);
     if (!comp) return NULL;
 
     IRFlowchartState* state = ir_flowchart_create_state();
     if (!state) {
-        ir_destroy_component(comp);
+        ir_flowchart_free_component(comp);
         return NULL;
     }
 
@@ -190,13 +621,14 @@ IRComponent* ir_flowchart(IRFlowchartDirection direction) {
     return comp;
 }
 
-IRComponent* ir_flowchart_node(const char* node_id, IRFlowchartShape shape, const char* label) {
-    IRComponent* comp = ir_create_component(IR_COMPONENT_FLOWCHART_NODE);
+static IRComponent* ir_flowchart_node_in(IRFlowchartState* state, const char* node_id,
+                                         IRFlowchartShape shape, const char* label) {
+    IRComponent* comp = ir_flowchart_new_component(IR_COMPONENT_FLOWCHART_NODE);
     if (!comp) return NULL;
 
-    IRFlowchartNodeData* data = ir_flowchart_node_data_create(node_id, shape, label);
+    IRFlowchartNodeData* data = ir_flowchart_node_data_create_in(state, node_id, shape, label);
     if (!data) {
-        ir_destroy_component(comp);
+        ir_flowchart_free_component(comp);
         return NULL;
     }
 
@@ -204,13 +636,14 @@ IRComponent* ir_flowchart_node(const char* node_id, IRFlowchartShape shape, cons
     return comp;
 }
 
-IRComponent* ir_flowchart_edge(const char* from_id, const char* to_id, IRFlowchartEdgeType type) {
-    IRComponent* comp = ir_create_component(IR_COMPONENT_FLOWCHART_EDGE);
+static IRComponent* ir_flowchart_edge_in(IRFlowchartState* state, const char* from_id,
+                                         const char* to_id, IRFlowchartEdgeType type) {
+    IRComponent* comp = ir_flowchart_new_component(IR_COMPONENT_FLOWCHART_EDGE);
     if (!comp) return NULL;
 
-    IRFlowchartEdgeData* data = ir_flowchart_edge_data_create(from_id, to_id);
+    IRFlowchartEdgeData* data = ir_flowchart_edge_data_create_in(state, from_id, to_id);
     if (!data) {
-        ir_destroy_component(comp);
+        ir_flowchart_free_component(comp);
         return NULL;
     }
 
@@ -219,13 +652,13 @@ IRComponent* ir_flowchart_edge(const char* from_id, const char* to_id, IRFlowcha
     return comp;
 }
 
-IRComponent* ir_flowchart_subgraph(const char* subgraph_id, const char* title) {
-    IRComponent* comp = ir_create_component(IR_COMPONENT_FLOWCHART_SUBGRAPH);
+static IRComponent* ir_flowchart_subgraph_in(IRFlowchartState* state, const char* subgraph_id, const char* title) {
+    IRComponent* comp = ir_flowchart_new_component(IR_COMPONENT_FLOWCHART_SUBGRAPH);
     if (!comp) return NULL;
 
-    IRFlowchartSubgraphData* data = ir_flowchart_subgraph_data_create(subgraph_id, title);
+    IRFlowchartSubgraphData* data = ir_flowchart_subgraph_data_create_in(state, subgraph_id, title);
     if (!data) {
-        ir_destroy_component(comp);
+        ir_flowchart_free_component(comp);
         return NULL;
     }
 
@@ -233,21 +666,388 @@ IRComponent* ir_flowchart_subgraph(const char* subgraph_id, const char* title) {
     return comp;
 }
 
+IRComponent* ir_flowchart_node(const char* node_id, IRFlowchartShape shape, const char* label) {
+    return ir_flowchart_node_in(NULL, node_id, shape, label);
+}
+
+IRComponent* ir_flowchart_edge(const char* from_id, const char* to_id, IRFlowchartEdgeType type) {
+    return ir_flowchart_edge_in(NULL, from_id, to_id, type);
+}
+
+IRComponent* ir_flowchart_subgraph(const char* subgraph_id, const char* title) {
+    return ir_flowchart_subgraph_in(NULL, subgraph_id, title);
+}
+
+// Strings and data of these components live in the flowchart's arena and pools
+IRComponent* ir_flowchart_create_node(IRComponent* flowchart, const char* node_id, IRFlowchartShape shape, const char* label) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return NULL;
+    return ir_flowchart_node_in(state, node_id, shape, label);
+}
+
+IRComponent* ir_flowchart_create_edge(IRComponent* flowchart, const char* from_id, const char* to_id, IRFlowchartEdgeType type) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return NULL;
+    return ir_flowchart_edge_in(state, from_id, to_id, type);
+}
+
+IRComponent* ir_flowchart_create_subgraph(IRComponent* flowchart, const char* subgraph_id, const char* title) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return NULL;
+    return ir_flowchart_subgraph_in(state, subgraph_id, title);
+}
+
 IRComponent* ir_flowchart_label(const char* text) {
-    IRComponent* comp = ir_create_component(IR_COMPONENT_FLOWCHART_LABEL);
+    IRComponent* comp = ir_flowchart_new_component(IR_COMPONENT_FLOWCHART_LABEL);
     if (!comp) return NULL;
 
     if (text) {
-        ir_add_child(comp, ir_text(text));
+        pthread_mutex_lock(&g_component_lock);
+        IRComponent* text_comp = ir_text(text);
+        pthread_mutex_unlock(&g_component_lock);
+        ir_add_child(comp, text_comp);
     }
 
     return comp;
 }
 
+// ============================================================================
+// Node ID Index
+// ============================================================================
+
+// IDs interned in the state's arena carry their hash and compare by pointer;
+// any other ID is hashed and compared character by character
+static bool ir_flowchart_is_interned(const IRFlowchartState* state, IRFlowchartStringArena* strings) {
+    return strings && strings == state->strings;
+}
+
+static uint32_t ir_flowchart_index_slot(const IRFlowchartState* state, const char* node_id, bool interned) {
+    uint32_t hash = interned ? ir_flowchart_interned_hash(node_id) : ir_flowchart_string_hash(node_id);
+    return hash & (state->node_index_capacity - 1);
+}
+
+static bool ir_flowchart_id_equal(const IRFlowchartState* state, const IRFlowchartNodeData* node,
+                                  const char* node_id, bool interned) {
+    if (node->node_id == node_id) return true;
+    if (interned && ir_flowchart_is_interned(state, node->strings)) return false;
+    return strcmp(node->node_id, node_id) == 0;
+}
+
+// Look up an ID; `interned` tells that it lives in state->strings
+static uint32_t ir_flowchart_index_find(const IRFlowchartState* state, const char* node_id, bool interned) {
+    if (state->node_index_capacity == 0) return IR_FLOWCHART_INVALID_INDEX;
+
+    uint32_t mask = state->node_index_capacity - 1;
+    uint32_t slot = ir_flowchart_index_slot(state, node_id, interned);
+    while (state->node_index_slots[slot] != 0) {
+        uint32_t index = state->node_index_slots[slot] - 1;
+        if (ir_flowchart_id_equal(state, state->nodes[index], node_id, interned)) return index;
+        slot = (slot + 1) & mask;
+    }
+    return IR_FLOWCHART_INVALID_INDEX;
+}
+
+// Insert node index into the ID table (first registration of an ID wins)
+static void ir_flowchart_index_insert(IRFlowchartState* state, uint32_t index) {
+    const IRFlowchartNodeData* node = state->nodes[index];
+    if (!node->node_id) return;
+
+    bool interned = ir_flowchart_is_interned(state, node->strings);
+    uint32_t mask = state->node_index_capacity - 1;
+    uint32_t slot = ir_flowchart_index_slot(state, node->node_id, interned);
+    while (state->node_index_slots[slot] != 0) {
+        IRFlowchartNodeData* existing = state->nodes[state->node_index_slots[slot] - 1];
+        if (ir_flowchart_id_equal(state, existing, node->node_id, interned)) return;
+        slot = (slot + 1) & mask;
+    }
+    state->node_index_slots[slot] = index + 1;
+}
+
+// Keep the ID table at most half full
+static bool ir_flowchart_index_reserve(IRFlowchartState* state, uint32_t node_count) {
+    if (node_count * 2 <= state->node_index_capacity) return true;
+
+    uint32_t new_capacity = state->node_index_capacity == 0 ? 16 : state->node_index_capacity;
+    while (new_capacity < node_count * 2) new_capacity *= 2;
+
+    uint32_t* new_slots = (uint32_t*)calloc(new_capacity, sizeof(uint32_t));
+    if (!new_slots) return false;
+
+    free(state->node_index_slots);
+    state->node_index_slots = new_slots;
+    state->node_index_capacity = new_capacity;
+
+    // Rehash in registration order so duplicates keep resolving to the first node
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        if (state->nodes[i]) ir_flowchart_index_insert(state, i);
+    }
+    return true;
+}
+
+// Slot holding node `index`, or the empty slot ending its probe sequence
+// when the node is not indexed (a later duplicate of an ID)
+static uint32_t ir_flowchart_index_locate(const IRFlowchartState* state, uint32_t index) {
+    const IRFlowchartNodeData* node = state->nodes[index];
+    uint32_t mask = state->node_index_capacity - 1;
+    uint32_t slot = ir_flowchart_index_slot(state, node->node_id, ir_flowchart_is_interned(state, node->strings));
+    while (state->node_index_slots[slot] != 0 && state->node_index_slots[slot] != index + 1) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Drop node `index` from the ID table, shifting later entries of its probe
+// run back so lookups never stop at the hole
+static void ir_flowchart_index_remove(IRFlowchartState* state, uint32_t index) {
+    if (state->node_index_capacity == 0 || !state->nodes[index]->node_id) return;
+
+    uint32_t mask = state->node_index_capacity - 1;
+    uint32_t hole = ir_flowchart_index_locate(state, index);
+    if (state->node_index_slots[hole] == 0) return;
+
+    for (uint32_t slot = (hole + 1) & mask; state->node_index_slots[slot] != 0; slot = (slot + 1) & mask) {
+        const IRFlowchartNodeData* node = state->nodes[state->node_index_slots[slot] - 1];
+        uint32_t home = ir_flowchart_index_slot(state, node->node_id, ir_flowchart_is_interned(state, node->strings));
+        // The entry may move back when the hole lies between its home slot and it
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            state->node_index_slots[hole] = state->node_index_slots[slot];
+            hole = slot;
+        }
+    }
+    state->node_index_slots[hole] = 0;
+}
+
+// Point the ID table entry of node `from` at `to`, where it is moving
+static void ir_flowchart_index_renumber(IRFlowchartState* state, uint32_t from, uint32_t to) {
+    if (state->node_index_capacity == 0 || !state->nodes[from]->node_id) return;
+
+    uint32_t slot = ir_flowchart_index_locate(state, from);
+    if (state->node_index_slots[slot] != 0) state->node_index_slots[slot] = to + 1;
+}
+
+// ============================================================================
+// Edge Incidence Lists
+// ============================================================================
+// Every resolved edge end is linked into a list on its node: side 0 into the
+// source's outgoing list, side 1 into the target's incoming list. The lists
+// hold edge indices, so removals find a node's edges in O(degree).
+
+static uint32_t ir_flowchart_edge_end(const IRFlowchartEdgeData* edge, int side) {
+    return side ? edge->to_index : edge->from_index;
+}
+
+static void ir_flowchart_link_edge(IRFlowchartState* state, uint32_t e, int side) {
+    IRFlowchartEdgeData* edge = state->edges[e];
+    IRFlowchartNodeData* node = state->nodes[ir_flowchart_edge_end(edge, side)];
+
+    edge->prev_edge[side] = IR_FLOWCHART_INVALID_INDEX;
+    edge->next_edge[side] = node->first_edge[side];
+    if (node->first_edge[side] != IR_FLOWCHART_INVALID_INDEX) {
+        state->edges[node->first_edge[side]]->prev_edge[side] = e;
+    }
+    node->first_edge[side] = e;
+}
+
+static void ir_flowchart_unlink_edge(IRFlowchartState* state, uint32_t e, int side) {
+    IRFlowchartEdgeData* edge = state->edges[e];
+    uint32_t end = ir_flowchart_edge_end(edge, side);
+    if (end == IR_FLOWCHART_INVALID_INDEX) return;
+
+    uint32_t prev = edge->prev_edge[side];
+    uint32_t next = edge->next_edge[side];
+    if (prev != IR_FLOWCHART_INVALID_INDEX) state->edges[prev]->next_edge[side] = next;
+    else state->nodes[end]->first_edge[side] = next;
+    if (next != IR_FLOWCHART_INVALID_INDEX) state->edges[next]->prev_edge[side] = prev;
+    edge->prev_edge[side] = edge->next_edge[side] = IR_FLOWCHART_INVALID_INDEX;
+}
+
+// The edge that sat at `from` now sits at `to`: repoint its list neighbours
+static void ir_flowchart_relink_edge(IRFlowchartState* state, uint32_t from, uint32_t to) {
+    IRFlowchartEdgeData* edge = state->edges[to];
+    for (int side = 0; side < 2; side++) {
+        uint32_t end = ir_flowchart_edge_end(edge, side);
+        if (end == IR_FLOWCHART_INVALID_INDEX) continue;
+
+        uint32_t prev = edge->prev_edge[side];
+        uint32_t next = edge->next_edge[side];
+        if (prev != IR_FLOWCHART_INVALID_INDEX) state->edges[prev]->next_edge[side] = to;
+        else if (state->nodes[end]->first_edge[side] == from) state->nodes[end]->first_edge[side] = to;
+        if (next != IR_FLOWCHART_INVALID_INDEX) state->edges[next]->prev_edge[side] = to;
+    }
+}
+
+// Rebuild every list, after removals that renumber the registries in order
+static void ir_flowchart_link_edges(IRFlowchartState* state) {
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        state->nodes[i]->first_edge[0] = state->nodes[i]->first_edge[1] = IR_FLOWCHART_INVALID_INDEX;
+    }
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        for (int side = 0; side < 2; side++) {
+            if (ir_flowchart_edge_end(state->edges[e], side) != IR_FLOWCHART_INVALID_INDEX) {
+                ir_flowchart_link_edge(state, e, side);
+            }
+        }
+    }
+}
+
+static bool ir_flowchart_resolve_edge(IRFlowchartState* state, uint32_t e) {
+    IRFlowchartEdgeData* edge = state->edges[e];
+    bool interned = ir_flowchart_is_interned(state, edge->strings);
+    if (edge->from_index == IR_FLOWCHART_INVALID_INDEX && edge->from_id) {
+        edge->from_index = ir_flowchart_index_find(state, edge->from_id, interned);
+        if (edge->from_index != IR_FLOWCHART_INVALID_INDEX) ir_flowchart_link_edge(state, e, 0);
+    }
+    if (edge->to_index == IR_FLOWCHART_INVALID_INDEX && edge->to_id) {
+        edge->to_index = ir_flowchart_index_find(state, edge->to_id, interned);
+        if (edge->to_index != IR_FLOWCHART_INVALID_INDEX) ir_flowchart_link_edge(state, e, 1);
+    }
+    return edge->from_index != IR_FLOWCHART_INVALID_INDEX &&
+           edge->to_index != IR_FLOWCHART_INVALID_INDEX;
+}
+
+void ir_flowchart_resolve_edges(IRFlowchartState* state) {
+    if (!state || state->edges_resolved) return;
+
+    bool all_resolved = true;
+    for (uint32_t i = 0; i < state->edge_count; i++) {
+        IRFlowchartEdgeData* edge = state->edges[i];
+        if (!edge) continue;
+        uint32_t from = edge->from_index, to = edge->to_index;
+        if (!ir_flowchart_resolve_edge(state, i)) all_resolved = false;
+        if (edge->from_index != from || edge->to_index != to) {
+            ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, i);
+        }
+    }
+    state->edges_resolved = all_resolved;
+}
+
+// ============================================================================
+// Handles
+// ============================================================================
+// A handle names a slot of its kind's table and the slot's generation when
+// handed out. The slot follows the element through the registry; removing
+// the element frees the slot and bumps its generation, so the handle no
+// longer matches.
+
+static uint32_t ir_flowchart_handle_slot(IRFlowchartHandle handle) {
+    return (uint32_t)handle;
+}
+
+static uint32_t ir_flowchart_handle_generation(IRFlowchartHandle handle) {
+    return (uint32_t)(handle >> 32);
+}
+
+// Registry index of a handle's element, IR_FLOWCHART_INVALID_INDEX once stale
+static uint32_t ir_flowchart_handle_index(const IRFlowchartHandleTable* table, IRFlowchartHandle handle) {
+    uint32_t slot = ir_flowchart_handle_slot(handle);
+    if (slot >= table->count || table->slots[slot].generation != ir_flowchart_handle_generation(handle)) {
+        return IR_FLOWCHART_INVALID_INDEX;
+    }
+    return table->slots[slot].index;
+}
+
+// Handle for an element registered at `index`; `current` is kept when it is
+// still live in this table (finalizing again), a slot is taken otherwise
+static IRFlowchartHandle ir_flowchart_handle_acquire(IRFlowchartHandleTable* table, IRFlowchartHandle current,
+                                                     uint32_t index) {
+    uint32_t slot = ir_flowchart_handle_slot(current);
+    if (current != IR_FLOWCHART_NULL_HANDLE && slot < table->count &&
+        table->slots[slot].generation == ir_flowchart_handle_generation(current)) {
+        table->slots[slot].index = index;
+        return current;
+    }
+
+    if (table->free_head != IR_FLOWCHART_INVALID_INDEX) {
+        slot = table->free_head;
+        table->free_head = table->slots[slot].next_free;
+    } else {
+        if (table->count >= table->capacity) {
+            uint32_t new_capacity = table->capacity == 0 ? 16 : table->capacity * 2;
+            IRFlowchartHandleSlot* new_slots = (IRFlowchartHandleSlot*)realloc(table->slots,
+                                                                               new_capacity * sizeof(IRFlowchartHandleSlot));
+            if (!new_slots) return IR_FLOWCHART_NULL_HANDLE;
+            table->slots = new_slots;
+            table->capacity = new_capacity;
+        }
+        slot = table->count++;
+        table->slots[slot].generation = 1;
+    }
+
+    table->slots[slot].index = index;
+    table->slots[slot].next_free = IR_FLOWCHART_INVALID_INDEX;
+    return ((IRFlowchartHandle)table->slots[slot].generation << 32) | slot;
+}
+
+static void ir_flowchart_handle_move(IRFlowchartHandleTable* table, IRFlowchartHandle handle, uint32_t index) {
+    uint32_t slot = ir_flowchart_handle_slot(handle);
+    if (handle != IR_FLOWCHART_NULL_HANDLE && slot < table->count) table->slots[slot].index = index;
+}
+
+static void ir_flowchart_handle_free_slot(IRFlowchartHandleTable* table, uint32_t slot) {
+    IRFlowchartHandleSlot* entry = &table->slots[slot];
+    entry->index = IR_FLOWCHART_INVALID_INDEX;
+    if (++entry->generation == 0) entry->generation = 1;  // Handles are never 0
+    entry->next_free = table->free_head;
+    table->free_head = slot;
+}
+
+static void ir_flowchart_handle_release(IRFlowchartHandleTable* table, IRFlowchartHandle handle) {
+    if (ir_flowchart_handle_index(table, handle) == IR_FLOWCHART_INVALID_INDEX) return;
+    ir_flowchart_handle_free_slot(table, ir_flowchart_handle_slot(handle));
+}
+
+// Finalization re-registers from the tree: every slot starts unclaimed, and
+// those no element claimed again are freed afterwards
+static void ir_flowchart_handles_unclaim(IRFlowchartHandleTable* table) {
+    for (uint32_t slot = 0; slot < table->count; slot++) {
+        table->slots[slot].index = IR_FLOWCHART_INVALID_INDEX;
+    }
+}
+
+static void ir_flowchart_handles_sweep(IRFlowchartHandleTable* table) {
+    table->free_head = IR_FLOWCHART_INVALID_INDEX;
+    for (uint32_t slot = table->count; slot-- > 0;) {
+        if (table->slots[slot].index == IR_FLOWCHART_INVALID_INDEX) ir_flowchart_handle_free_slot(table, slot);
+    }
+}
+
+uint32_t ir_flowchart_node_handle_index(const IRFlowchartState* state, IRFlowchartHandle handle) {
+    return state ? ir_flowchart_handle_index(&state->node_handles, handle) : IR_FLOWCHART_INVALID_INDEX;
+}
+
+uint32_t ir_flowchart_edge_handle_index(const IRFlowchartState* state, IRFlowchartHandle handle) {
+    return state ? ir_flowchart_handle_index(&state->edge_handles, handle) : IR_FLOWCHART_INVALID_INDEX;
+}
+
+uint32_t ir_flowchart_subgraph_handle_index(const IRFlowchartState* state, IRFlowchartHandle handle) {
+    return state ? ir_flowchart_handle_index(&state->subgraph_handles, handle) : IR_FLOWCHART_INVALID_INDEX;
+}
+
 // ============================================================================
 // Registration Functions
 // ============================================================================
 
+// Grow the node registry and the geometry arrays parallel to it
+// New geometry starts zeroed; re-registration (finalize) keeps what a slot holds
+static bool ir_flowchart_node_reserve(IRFlowchartState* state, uint32_t capacity) {
+    if (capacity <= state->node_capacity) return true;
+
+    IRFlowchartNodeData** new_nodes = (IRFlowchartNodeData**)realloc(state->nodes, capacity * sizeof(IRFlowchartNodeData*));
+    if (!new_nodes) return false;
+    state->nodes = new_nodes;
+
+    float** columns[4] = { &state->node_x, &state->node_y, &state->node_width, &state->node_height };
+    for (int c = 0; c < 4; c++) {
+        float* new_column = (float*)realloc(*columns[c], capacity * sizeof(float));
+        if (!new_column) return false;
+        memset(new_column + state->node_capacity, 0, (capacity - state->node_capacity) * sizeof(float));
+        *columns[c] = new_column;
+    }
+
+    state->node_capacity = capacity;
+    return true;
+}
+
 void ir_flowchart_register_node(IRComponent* flowchart, IRComponent* node) {
     if (!flowchart || !node) return;
 
@@ -255,16 +1055,25 @@ void ir_flowchart_register_node(IRComponent* flowchart, IRComponent* node) {
     IRFlowchartNodeData* node_data = ir_get_flowchart_node_data(node);
     if (!state || !node_data) return;
 
-    // Expand array if needed
-    if (state->node_count >= state->node_capacity) {
-        uint32_t new_capacity = state->node_capacity == 0 ? 8 : state->node_capacity * 2;
-        IRFlowchartNodeData** new_nodes = (IRFlowchartNodeData**)realloc(state->nodes, new_capacity * sizeof(IRFlowchartNodeData*));
-        if (!new_nodes) return;
-        state->nodes = new_nodes;
-        state->node_capacity = new_capacity;
+    // Expand arrays if needed
+    if (state->node_count >= state->node_capacity &&
+        !ir_flowchart_node_reserve(state, state->node_capacity == 0 ? 8 : state->node_capacity * 2)) {
+        return;
     }
-
-    state->nodes[state->node_count++] = node_data;
+    if (!ir_flowchart_index_reserve(state, state->node_count + 1)) return;
+
+    IRFlowchartHandle handle = ir_flowchart_handle_acquire(&state->node_handles, node_data->handle, state->node_count);
+    if (handle == IR_FLOWCHART_NULL_HANDLE) return;
+
+    uint32_t index = state->node_count++;
+    state->nodes[index] = node_data;
+    node_data->index = index;
+    node_data->handle = handle;
+    node_data->component = node;
+    node_data->first_edge[0] = node_data->first_edge[1] = IR_FLOWCHART_INVALID_INDEX;
+    ir_flowchart_index_insert(state, index);
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_NODES, index);
+    if (node_data->subgraph_id) state->subgraphs_resolved = false;
 }
 
 void ir_flowchart_register_edge(IRComponent* flowchart, IRComponent* edge) {
@@ -283,7 +1092,22 @@ void ir_flowchart_register_edge(IRComponent* flowchart, IRComponent* edge) {
         state->edge_capacity = new_capacity;
     }
 
-    state->edges[state->edge_count++] = edge_data;
+    IRFlowchartHandle handle = ir_flowchart_handle_acquire(&state->edge_handles, edge_data->handle, state->edge_count);
+    if (handle == IR_FLOWCHART_NULL_HANDLE) return;
+
+    uint32_t index = state->edge_count++;
+    state->edges[index] = edge_data;
+    edge_data->handle = handle;
+    edge_data->component = edge;
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, index);
+
+    // Resolve eagerly (again when finalizing, as node indices may have
+    // changed); endpoints registered later are picked up by
+    // ir_flowchart_resolve_edges()
+    edge_data->from_index = edge_data->to_index = IR_FLOWCHART_INVALID_INDEX;
+    if (!ir_flowchart_resolve_edge(state, index)) {
+        state->edges_resolved = false;
+    }
 }
 
 void ir_flowchart_register_subgraph(IRComponent* flowchart, IRComponent* subgraph) {
@@ -302,7 +1126,368 @@ void ir_flowchart_register_subgraph(IRComponent* flowchart, IRComponent* subgrap
         state->subgraph_capacity = new_capacity;
     }
 
+    IRFlowchartHandle handle = ir_flowchart_handle_acquire(&state->subgraph_handles, subgraph_data->handle,
+                                                           state->subgraph_count);
+    if (handle == IR_FLOWCHART_NULL_HANDLE) return;
+
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_SUBGRAPHS, state->subgraph_count);
     state->subgraphs[state->subgraph_count++] = subgraph_data;
+    subgraph_data->handle = handle;
+    subgraph_data->component = subgraph;
+    state->subgraphs_resolved = false;
+}
+
+bool ir_flowchart_reserve(IRComponent* flowchart, uint32_t nodes, uint32_t edges, uint32_t subgraphs) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return false;
+
+    if (!ir_flowchart_node_reserve(state, nodes)) return false;
+    if (edges > state->edge_capacity) {
+        IRFlowchartEdgeData** new_edges = (IRFlowchartEdgeData**)realloc(state->edges, edges * sizeof(IRFlowchartEdgeData*));
+        if (!new_edges) return false;
+        state->edges = new_edges;
+        state->edge_capacity = edges;
+    }
+    if (subgraphs > state->subgraph_capacity) {
+        IRFlowchartSubgraphData** new_subgraphs = (IRFlowchartSubgraphData**)realloc(state->subgraphs, subgraphs * sizeof(IRFlowchartSubgraphData*));
+        if (!new_subgraphs) return false;
+        state->subgraphs = new_subgraphs;
+        state->subgraph_capacity = subgraphs;
+    }
+
+    return ir_flowchart_index_reserve(state, nodes) &&
+           ir_flowchart_pool_reserve(state->node_pool, nodes) &&
+           ir_flowchart_pool_reserve(state->edge_pool, edges);
+}
+
+// Helper: Subgraph registered under an ID (subgraph counts are small)
+static uint32_t ir_flowchart_find_subgraph_index(const IRFlowchartState* state, const char* subgraph_id) {
+    for (uint32_t s = 0; subgraph_id && s < state->subgraph_count; s++) {
+        const IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        if (sg && sg->subgraph_id &&
+            (sg->subgraph_id == subgraph_id || strcmp(sg->subgraph_id, subgraph_id) == 0)) {
+            return s;
+        }
+    }
+    return IR_FLOWCHART_INVALID_INDEX;
+}
+
+// Helper: Containers named only by ID, for elements placed at the top level of the tree
+static void ir_flowchart_resolve_containers(IRFlowchartState* state) {
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        if (sg->parent_index != IR_FLOWCHART_INVALID_INDEX || !sg->parent_subgraph_id) continue;
+        uint32_t parent = ir_flowchart_find_subgraph_index(state, sg->parent_subgraph_id);
+        if (parent != s) sg->parent_index = parent;
+    }
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        IRFlowchartNodeData* node = state->nodes[i];
+        if (node->subgraph_index != IR_FLOWCHART_INVALID_INDEX || !node->subgraph_id) continue;
+        node->subgraph_index = ir_flowchart_find_subgraph_index(state, node->subgraph_id);
+    }
+}
+
+// Helper: Bucket the registered nodes by containing subgraph (counting sort, O(N + S))
+// On allocation failure the lists are dropped (left NULL)
+static void ir_flowchart_build_members(IRFlowchartState* state) {
+    uint32_t* offsets = (uint32_t*)realloc(state->subgraph_member_offsets,
+                                           (state->subgraph_count + 1) * sizeof(uint32_t));
+    if (offsets) state->subgraph_member_offsets = offsets;
+    uint32_t* members = (uint32_t*)realloc(state->subgraph_members, (state->node_count + 1) * sizeof(uint32_t));
+    if (members) state->subgraph_members = members;
+    if (!offsets || !members) {
+        free(state->subgraph_member_offsets);
+        free(state->subgraph_members);
+        state->subgraph_member_offsets = NULL;
+        state->subgraph_members = NULL;
+        return;
+    }
+
+    memset(offsets, 0, (state->subgraph_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        uint32_t s = state->nodes[i]->subgraph_index;
+        if (s < state->subgraph_count) offsets[s + 1]++;
+    }
+    for (uint32_t s = 0; s < state->subgraph_count; s++) offsets[s + 1] += offsets[s];
+
+    // Fill through offsets[s] as a cursor, then shift the offsets back
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        uint32_t s = state->nodes[i]->subgraph_index;
+        if (s < state->subgraph_count) members[offsets[s]++] = i;
+    }
+    for (uint32_t s = state->subgraph_count; s > 0; s--) offsets[s] = offsets[s - 1];
+    offsets[0] = 0;
+}
+
+void ir_flowchart_resolve_subgraphs(IRFlowchartState* state) {
+    if (!state || state->subgraphs_resolved) return;
+    ir_flowchart_resolve_containers(state);
+    ir_flowchart_build_members(state);
+    state->subgraphs_resolved = true;
+}
+
+// ============================================================================
+// Mutation Functions
+// ============================================================================
+// Edits after finalization record what changed so the next layout can
+// update the previous one instead of starting over (see flowchart_layout.h).
+
+// Append one entry to a dirty list
+static bool ir_flowchart_dirty_push(uint32_t** list, uint32_t* count, uint32_t* capacity, uint32_t value) {
+    if (*count >= *capacity) {
+        uint32_t new_capacity = *capacity == 0 ? 8 : *capacity * 2;
+        uint32_t* new_list = (uint32_t*)realloc(*list, new_capacity * sizeof(uint32_t));
+        if (!new_list) return false;
+        *list = new_list;
+        *capacity = new_capacity;
+    }
+    (*list)[(*count)++] = value;
+    return true;
+}
+
+// Record an added or removed edge between two resolved nodes
+static void ir_flowchart_mark_edge_dirty(IRFlowchartState* state, const IRFlowchartEdgeData* edge) {
+    state->layout_computed = false;
+    state->content_key = 0;
+    if (edge->from_index == IR_FLOWCHART_INVALID_INDEX || edge->to_index == IR_FLOWCHART_INVALID_INDEX) return;
+
+    if (!ir_flowchart_dirty_push(&state->dirty_edge_ends, &state->dirty_edge_end_count,
+                                 &state->dirty_edge_end_capacity, edge->from_index) ||
+        !ir_flowchart_dirty_push(&state->dirty_edge_ends, &state->dirty_edge_end_count,
+                                 &state->dirty_edge_end_capacity, edge->to_index)) {
+        state->dirty_flags |= IR_FLOWCHART_DIRTY_STRUCTURE;
+        return;
+    }
+    state->dirty_flags |= IR_FLOWCHART_DIRTY_EDGES;
+}
+
+// Child slot hint of a flowchart element's component (NULL for other components)
+static uint32_t* ir_flowchart_child_slot(IRComponent* component) {
+    if (!component) return NULL;
+    switch (component->type) {
+        case IR_COMPONENT_FLOWCHART_NODE: {
+            IRFlowchartNodeData* data = ir_get_flowchart_node_data(component);
+            return data ? &data->child_slot : NULL;
+        }
+        case IR_COMPONENT_FLOWCHART_EDGE: {
+            IRFlowchartEdgeData* data = ir_get_flowchart_edge_data(component);
+            return data ? &data->child_slot : NULL;
+        }
+        case IR_COMPONENT_FLOWCHART_SUBGRAPH: {
+            IRFlowchartSubgraphData* data = ir_get_flowchart_subgraph_data(component);
+            return data ? &data->child_slot : NULL;
+        }
+        default:
+            return NULL;
+    }
+}
+
+// Detach an element's component from the tree and free it; the data itself
+// is freed by the caller. The component is found through its child slot
+// hint when that still holds. With `keep_order` the later siblings move up,
+// otherwise the last sibling takes its place.
+// A component outside the tree belongs to whoever built it and is only unlinked from its data.
+static void ir_flowchart_free_element(IRComponent* component, uint32_t child_slot, bool keep_order) {
+    if (!component) return;
+
+    IRComponent* parent = component->parent;
+    uint32_t i = child_slot;
+    if (parent && (i >= parent->child_count || parent->children[i] != component)) {
+        for (i = 0; i < parent->child_count && parent->children[i] != component; i++) {}
+    }
+    component->custom_data = NULL;
+    if (!parent || i == parent->child_count) return;
+
+    uint32_t last = parent->child_count - 1;
+    if (keep_order) {
+        memmove(&parent->children[i], &parent->children[i + 1], (last - i) * sizeof(IRComponent*));
+    } else if (i != last) {
+        parent->children[i] = parent->children[last];
+        uint32_t* moved_slot = ir_flowchart_child_slot(parent->children[i]);
+        if (moved_slot) *moved_slot = i;
+    }
+    parent->child_count--;
+    ir_flowchart_free_component(component);
+}
+
+// Remove the registered edge at `index`, keeping the order of the others
+// The caller rebuilds the incidence lists (ir_flowchart_link_edges)
+static void ir_flowchart_remove_edge_at(IRFlowchartState* state, uint32_t index) {
+    IRFlowchartEdgeData* edge = state->edges[index];
+    memmove(&state->edges[index], &state->edges[index + 1],
+            (state->edge_count - index - 1) * sizeof(IRFlowchartEdgeData*));
+    state->edge_count--;
+    for (uint32_t e = index; e < state->edge_count; e++) {
+        if (state->edges[e]) ir_flowchart_handle_move(&state->edge_handles, state->edges[e]->handle, e);
+    }
+    ir_flowchart_link_styles_remove(state, index, index);
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, IR_FLOWCHART_INVALID_INDEX);
+
+    if (edge) {
+        ir_flowchart_mark_edge_dirty(state, edge);
+        ir_flowchart_handle_release(&state->edge_handles, edge->handle);
+        ir_flowchart_free_element(edge->component, edge->child_slot, true);
+        ir_flowchart_edge_data_destroy(edge);
+    }
+}
+
+bool ir_flowchart_set_label(IRComponent* flowchart, const char* node_id, const char* label) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    uint32_t index = ir_flowchart_find_node_index(state, node_id);
+    if (index == IR_FLOWCHART_INVALID_INDEX) return false;
+
+    IRFlowchartNodeData* node = state->nodes[index];
+    if (node->label == label || (node->label && label && strcmp(node->label, label) == 0)) return true;
+
+    // New labels go to the node's own buffer rather than the arena, which
+    // only grows: a label rewritten many times a second stays in one place
+    char* replaced = node->label;
+    if (label) {
+        size_t size = strlen(label) + 1;
+        if (size > node->label_capacity) {
+            size_t capacity = node->label_capacity ? node->label_capacity : 16;
+            while (capacity < size) capacity *= 2;
+            if (capacity > UINT32_MAX) return false;
+            char* buffer = (char*)realloc(node->label_buffer, capacity);
+            if (!buffer) return false;
+            node->label_buffer = buffer;
+            node->label_capacity = (uint32_t)capacity;
+        }
+        memcpy(node->label_buffer, label, size);
+        node->label = node->label_buffer;
+    } else {
+        node->label = NULL;
+    }
+    if (!node->strings && replaced != node->label_buffer) free(replaced);
+
+    // Past node_count entries the list is dropped and every node is re-measured
+    if (state->dirty_node_count < state->node_count) {
+        ir_flowchart_dirty_push(&state->dirty_nodes, &state->dirty_node_count,
+                                &state->dirty_node_capacity, index);
+    }
+    state->dirty_flags |= IR_FLOWCHART_DIRTY_LABELS;
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_NODES, index);
+    state->layout_computed = false;
+    state->content_key = 0;
+    return true;
+}
+
+IRComponent* ir_flowchart_add_node(IRComponent* flowchart, const char* node_id, IRFlowchartShape shape, const char* label) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state || !node_id) return NULL;
+
+    IRComponent* node = ir_flowchart_create_node(flowchart, node_id, shape, label);
+    if (!node) return NULL;
+
+    uint32_t count = state->node_count;
+    ir_flowchart_register_node(flowchart, node);
+    if (state->node_count == count) {
+        ir_flowchart_node_data_destroy(ir_get_flowchart_node_data(node));
+        node->custom_data = NULL;
+        ir_flowchart_free_component(node);
+        return NULL;
+    }
+    ir_add_child(flowchart, node);
+    ir_get_flowchart_node_data(node)->child_slot = flowchart->child_count - 1;
+
+    // Edges waiting for this ID are picked up by the next layout
+    state->edges_resolved = false;
+    state->dirty_flags |= IR_FLOWCHART_DIRTY_STRUCTURE;
+    state->layout_computed = false;
+    state->content_key = 0;
+    return node;
+}
+
+bool ir_flowchart_remove_node(IRComponent* flowchart, const char* node_id) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    uint32_t index = ir_flowchart_find_node_index(state, node_id);
+    if (index == IR_FLOWCHART_INVALID_INDEX) return false;
+
+    // Edges attached to the node go with it
+    for (uint32_t e = state->edge_count; e-- > 0;) {
+        IRFlowchartEdgeData* edge = state->edges[e];
+        if (edge && (edge->from_index == index || edge->to_index == index)) {
+            ir_flowchart_remove_edge_at(state, e);
+        }
+    }
+
+    IRFlowchartNodeData* node = state->nodes[index];
+    uint32_t tail = state->node_count - index - 1;
+    memmove(&state->nodes[index], &state->nodes[index + 1], tail * sizeof(IRFlowchartNodeData*));
+    memmove(&state->node_x[index], &state->node_x[index + 1], tail * sizeof(float));
+    memmove(&state->node_y[index], &state->node_y[index + 1], tail * sizeof(float));
+    memmove(&state->node_width[index], &state->node_width[index + 1], tail * sizeof(float));
+    memmove(&state->node_height[index], &state->node_height[index + 1], tail * sizeof(float));
+    state->node_count--;
+    for (uint32_t i = index; i < state->node_count; i++) {
+        if (!state->nodes[i]) continue;
+        state->nodes[i]->index = i;
+        ir_flowchart_handle_move(&state->node_handles, state->nodes[i]->handle, i);
+    }
+
+    // Later nodes moved down by one, and the edges' indices with them
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_NODES, IR_FLOWCHART_INVALID_INDEX);
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, IR_FLOWCHART_INVALID_INDEX);
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        IRFlowchartEdgeData* edge = state->edges[e];
+        if (!edge) continue;
+        if (edge->from_index != IR_FLOWCHART_INVALID_INDEX && edge->from_index > index) edge->from_index--;
+        if (edge->to_index != IR_FLOWCHART_INVALID_INDEX && edge->to_index > index) edge->to_index--;
+    }
+    memset(state->node_index_slots, 0, state->node_index_capacity * sizeof(uint32_t));
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        if (state->nodes[i]) ir_flowchart_index_insert(state, i);
+    }
+    ir_flowchart_link_edges(state);
+    state->subgraphs_resolved = false;
+    ir_flowchart_resolve_subgraphs(state);
+
+    ir_flowchart_handle_release(&state->node_handles, node->handle);
+    ir_flowchart_free_element(node->component, node->child_slot, true);
+    ir_flowchart_node_data_destroy(node);
+
+    state->dirty_flags |= IR_FLOWCHART_DIRTY_STRUCTURE;
+    state->layout_computed = false;
+    state->content_key = 0;
+    return true;
+}
+
+IRComponent* ir_flowchart_add_edge(IRComponent* flowchart, const char* from_id, const char* to_id, IRFlowchartEdgeType type) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state || !from_id || !to_id) return NULL;
+
+    IRComponent* edge = ir_flowchart_create_edge(flowchart, from_id, to_id, type);
+    if (!edge) return NULL;
+
+    uint32_t count = state->edge_count;
+    ir_flowchart_register_edge(flowchart, edge);
+    if (state->edge_count == count) {
+        ir_flowchart_edge_data_destroy(ir_get_flowchart_edge_data(edge));
+        edge->custom_data = NULL;
+        ir_flowchart_free_component(edge);
+        return NULL;
+    }
+    ir_add_child(flowchart, edge);
+    ir_get_flowchart_edge_data(edge)->child_slot = flowchart->child_count - 1;
+
+    ir_flowchart_mark_edge_dirty(state, ir_get_flowchart_edge_data(edge));
+    return edge;
+}
+
+bool ir_flowchart_remove_edge(IRComponent* flowchart, const char* from_id, const char* to_id) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state || !from_id || !to_id) return false;
+
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        IRFlowchartEdgeData* edge = state->edges[e];
+        if (edge && edge->from_id && edge->to_id &&
+            strcmp(edge->from_id, from_id) == 0 && strcmp(edge->to_id, to_id) == 0) {
+            ir_flowchart_remove_edge_at(state, e);
+            ir_flowchart_link_edges(state);
+            return true;
+        }
+    }
+    return false;
 }
 
 // ============================================================================
@@ -417,52 +1602,425 @@ const char* ir_flowchart_marker_to_string(IRFlowchartMarker marker) {
 // Lookup Functions
 // ============================================================================
 
-IRFlowchartNodeData* ir_flowchart_find_node(IRFlowchartState* state, const char* node_id) {
-    if (!state || !node_id) return NULL;
-
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        IRFlowchartNodeData* node = state->nodes[i];
-        if (node && node->node_id && strcmp(node->node_id, node_id) == 0) {
-            return node;
-        }
-    }
+uint32_t ir_flowchart_find_node_index(const IRFlowchartState* state, const char* node_id) {
+    if (!state || !node_id) return IR_FLOWCHART_INVALID_INDEX;
+    return ir_flowchart_index_find(state, node_id, false);
+}
 
-    return NULL;
+IRFlowchartNodeData* ir_flowchart_find_node(IRFlowchartState* state, const char* node_id) {
+    uint32_t index = ir_flowchart_find_node_index(state, node_id);
+    if (index == IR_FLOWCHART_INVALID_INDEX) return NULL;
+    return state->nodes[index];
 }
 
 // ============================================================================
 // Finalization
 // ============================================================================
 
-void ir_flowchart_finalize(IRComponent* flowchart) {
-    if (!flowchart || flowchart->type != IR_COMPONENT_FLOWCHART) return;
+// Helper: Name `subgraph` in a node's subgraph_id or a subgraph's parent_subgraph_id
+// (NULL clears it). The ID is shared when both live in the same arena, copied otherwise
+static void ir_flowchart_set_container_id(IRFlowchartStringArena* strings, char** id,
+                                          const IRFlowchartSubgraphData* subgraph) {
+    const char* container_id = subgraph ? subgraph->subgraph_id : NULL;
+    if (*id == container_id || (*id && container_id && strcmp(*id, container_id) == 0)) return;
+
+    bool failed = false;
+    char* copy = (subgraph && strings && strings == subgraph->strings)
+                 ? subgraph->subgraph_id : ir_flowchart_copy_string(strings, container_id, &failed);
+    if (failed) return;
+    if (!strings) free(*id);
+    *id = copy;
+}
 
-    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
-    if (!state) return;
+// Helper: Register the flowchart elements under `parent`, subgraph contents included
+// `container` is the subgraph index of `parent` (IR_FLOWCHART_INVALID_INDEX for the flowchart)
+static void ir_flowchart_register_tree(IRComponent* flowchart, IRFlowchartState* state,
+                                       IRComponent* parent, uint32_t container) {
+    IRFlowchartSubgraphData* container_data =
+        container != IR_FLOWCHART_INVALID_INDEX ? state->subgraphs[container] : NULL;
 
-    // Register all children nodes, edges, and subgraphs
-    for (uint32_t i = 0; i < flowchart->child_count; i++) {
-        IRComponent* child = flowchart->children[i];
+    for (uint32_t i = 0; i < parent->child_count; i++) {
+        IRComponent* child = parent->children[i];
         if (!child) continue;
 
         if (child->type == IR_COMPONENT_FLOWCHART_NODE) {
             IRFlowchartNodeData* node_data = ir_get_flowchart_node_data(child);
-            if (node_data) {
-                ir_flowchart_register_node(flowchart, child);
-            }
+            uint32_t count = state->node_count;
+            if (!node_data) continue;
+            ir_flowchart_register_node(flowchart, child);
+            if (state->node_count == count) continue;
+
+            node_data->child_slot = i;
+            node_data->subgraph_index = container;
+            if (container_data) ir_flowchart_set_container_id(node_data->strings, &node_data->subgraph_id, container_data);
         } else if (child->type == IR_COMPONENT_FLOWCHART_EDGE) {
             IRFlowchartEdgeData* edge_data = ir_get_flowchart_edge_data(child);
             if (edge_data) {
                 ir_flowchart_register_edge(flowchart, child);
+                edge_data->child_slot = i;
             }
         } else if (child->type == IR_COMPONENT_FLOWCHART_SUBGRAPH) {
             IRFlowchartSubgraphData* subgraph_data = ir_get_flowchart_subgraph_data(child);
-            if (subgraph_data) {
-                ir_flowchart_register_subgraph(flowchart, child);
+            uint32_t index = state->subgraph_count;
+            if (!subgraph_data) continue;
+            ir_flowchart_register_subgraph(flowchart, child);
+            if (state->subgraph_count == index) continue;
+
+            subgraph_data->child_slot = i;
+            subgraph_data->parent_index = container;
+            if (container_data) {
+                ir_flowchart_set_container_id(subgraph_data->strings, &subgraph_data->parent_subgraph_id, container_data);
             }
+            ir_flowchart_register_tree(flowchart, state, child, index);
+        }
+    }
+}
+
+void ir_flowchart_finalize(IRComponent* flowchart) {
+    if (!flowchart || flowchart->type != IR_COMPONENT_FLOWCHART) return;
+
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return;
+
+    // The registries are rebuilt from the children rather than appended to:
+    // the tree is the source of truth, so a chart edited through the tree or
+    // finalized twice (ir_flowchart_parse already finalizes) ends up with
+    // the same registries, handles and styles as one finalized once
+    state->node_count = 0;
+    state->edge_count = 0;
+    state->subgraph_count = 0;
+    state->edges_resolved = true;
+    if (state->node_index_slots) {
+        memset(state->node_index_slots, 0, state->node_index_capacity * sizeof(uint32_t));
+    }
+
+    // Register nodes, edges and subgraphs at any depth, with their containers
+    // Elements keep their handles; those of elements gone from the tree are freed
+    ir_flowchart_handles_unclaim(&state->node_handles);
+    ir_flowchart_handles_unclaim(&state->edge_handles);
+    ir_flowchart_handles_unclaim(&state->subgraph_handles);
+    ir_flowchart_register_tree(flowchart, state, flowchart, IR_FLOWCHART_INVALID_INDEX);
+    ir_flowchart_handles_sweep(&state->node_handles);
+    ir_flowchart_handles_sweep(&state->edge_handles);
+    ir_flowchart_handles_sweep(&state->subgraph_handles);
+    state->subgraphs_resolved = false;
+    ir_flowchart_resolve_subgraphs(state);
+
+    // Resolve edge endpoints to node indices once
+    ir_flowchart_resolve_edges(state);
+
+    // Resolve classes and link styles onto the elements
+    if (state->style_count > 0) {
+        ir_flowchart_compile_styles(state);
+        for (uint32_t i = 0; i < state->node_count; i++) {
+            ir_flowchart_apply_node_style(state, state->nodes[i]);
         }
+        for (uint32_t i = 0; i < state->edge_count; i++) {
+            ir_flowchart_apply_edge_style(state, state->edges[i], i);
+        }
+
+        // Registered edges have taken their entries; later ones wait for edges not added yet
+        uint32_t taken = state->edge_count < state->link_style_count ? state->edge_count : state->link_style_count;
+        if (taken > 0) memset(state->link_styles, 0, taken * sizeof(uint32_t));
     }
 
-    // Mark layout as not computed
+    // Mark layout as not computed; registered content may have changed,
+    // so cached subgraph layouts are dropped too
     state->layout_computed = false;
+    state->dirty_flags |= IR_FLOWCHART_DIRTY_STRUCTURE;
+    state->content_key = 0;
+    ir_flowchart_snapshot_invalidate(flowchart);
+    for (uint32_t i = 0; i < state->subgraph_count; i++) {
+        if (state->subgraphs[i]) state->subgraphs[i]->layout_computed = false;
+    }
+}
+
+// ============================================================================
+// Removal by Handle
+// ============================================================================
+// The last element of a registry moves into the removed one's slot, so
+// nothing else is renumbered; registration order is not kept.
+
+// Helper: Remove the edge at `index`, the last edge taking its slot
+static void ir_flowchart_swap_remove_edge_at(IRFlowchartState* state, uint32_t index) {
+    IRFlowchartEdgeData* edge = state->edges[index];
+    ir_flowchart_mark_edge_dirty(state, edge);
+    ir_flowchart_unlink_edge(state, index, 0);
+    ir_flowchart_unlink_edge(state, index, 1);
+    ir_flowchart_handle_release(&state->edge_handles, edge->handle);
+
+    uint32_t last = --state->edge_count;
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, index);
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, last);
+    if (index != last) {
+        state->edges[index] = state->edges[last];
+        ir_flowchart_relink_edge(state, last, index);
+        ir_flowchart_handle_move(&state->edge_handles, state->edges[index]->handle, index);
+    }
+    ir_flowchart_link_styles_remove(state, index, last);
+
+    ir_flowchart_free_element(edge->component, edge->child_slot, false);
+    ir_flowchart_edge_data_destroy(edge);
+}
+
+bool ir_flowchart_swap_remove_edge(IRComponent* flowchart, IRFlowchartHandle edge) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    uint32_t index = ir_flowchart_edge_handle_index(state, edge);
+    if (index == IR_FLOWCHART_INVALID_INDEX) return false;
+
+    ir_flowchart_swap_remove_edge_at(state, index);
+    return true;
+}
+
+bool ir_flowchart_swap_remove_node(IRComponent* flowchart, IRFlowchartHandle handle) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    uint32_t index = ir_flowchart_node_handle_index(state, handle);
+    if (index == IR_FLOWCHART_INVALID_INDEX) return false;
+
+    // Edges attached to the node go with it
+    IRFlowchartNodeData* node = state->nodes[index];
+    for (int side = 0; side < 2; side++) {
+        while (node->first_edge[side] != IR_FLOWCHART_INVALID_INDEX) {
+            ir_flowchart_swap_remove_edge_at(state, node->first_edge[side]);
+        }
+    }
+
+    ir_flowchart_index_remove(state, index);
+    ir_flowchart_handle_release(&state->node_handles, node->handle);
+    if (node->subgraph_index != IR_FLOWCHART_INVALID_INDEX) state->subgraphs_resolved = false;
+
+    uint32_t last = --state->node_count;
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_NODES, index);
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_NODES, last);
+    if (index != last) {
+        IRFlowchartNodeData* moved = state->nodes[last];
+        ir_flowchart_index_renumber(state, last, index);
+        state->nodes[index] = moved;
+        state->node_x[index] = state->node_x[last];
+        state->node_y[index] = state->node_y[last];
+        state->node_width[index] = state->node_width[last];
+        state->node_height[index] = state->node_height[last];
+        moved->index = index;
+        ir_flowchart_handle_move(&state->node_handles, moved->handle, index);
+
+        // Its edges now end at `index`
+        for (uint32_t e = moved->first_edge[0]; e != IR_FLOWCHART_INVALID_INDEX; e = state->edges[e]->next_edge[0]) {
+            state->edges[e]->from_index = index;
+            ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, e);
+        }
+        for (uint32_t e = moved->first_edge[1]; e != IR_FLOWCHART_INVALID_INDEX; e = state->edges[e]->next_edge[1]) {
+            state->edges[e]->to_index = index;
+            ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_EDGES, e);
+        }
+        if (moved->subgraph_index != IR_FLOWCHART_INVALID_INDEX) state->subgraphs_resolved = false;
+    }
+
+    ir_flowchart_free_element(node->component, node->child_slot, false);
+    ir_flowchart_node_data_destroy(node);
+
+    state->dirty_flags |= IR_FLOWCHART_DIRTY_STRUCTURE;
+    state->layout_computed = false;
+    state->content_key = 0;
+    return true;
+}
+
+// Helper: Move the direct member nodes of subgraph `from` into `to`, naming
+// `container` (the data of `to`, NULL for the top level) in their subgraph_id
+// when `rename` is set. Walks the member lists, which must be current.
+static void ir_flowchart_move_members(IRFlowchartState* state, uint32_t from, uint32_t to,
+                                      const IRFlowchartSubgraphData* container, bool rename) {
+    const uint32_t* offsets = state->subgraph_member_offsets;
+    uint32_t begin = offsets ? offsets[from] : 0;
+    uint32_t end = offsets ? offsets[from + 1] : state->node_count;
+
+    for (uint32_t k = begin; k < end; k++) {
+        IRFlowchartNodeData* node = state->nodes[offsets ? state->subgraph_members[k] : k];
+        if (node->subgraph_index != from) continue;
+        node->subgraph_index = to;
+        if (rename) ir_flowchart_set_container_id(node->strings, &node->subgraph_id, container);
+    }
+}
+
+bool ir_flowchart_swap_remove_subgraph(IRComponent* flowchart, IRFlowchartHandle handle) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    uint32_t index = ir_flowchart_subgraph_handle_index(state, handle);
+    if (index == IR_FLOWCHART_INVALID_INDEX) return false;
+
+    ir_flowchart_resolve_subgraphs(state);
+    IRFlowchartSubgraphData* subgraph = state->subgraphs[index];
+    uint32_t last = state->subgraph_count - 1;
+
+    // The contents go to the parent, which may be the subgraph about to move
+    uint32_t parent = subgraph->parent_index;
+    IRFlowchartSubgraphData* parent_data = parent != IR_FLOWCHART_INVALID_INDEX ? state->subgraphs[parent] : NULL;
+    if (parent == last) parent = index;
+
+    ir_flowchart_move_members(state, index, parent, parent_data, true);
+    if (index != last) ir_flowchart_move_members(state, last, index, NULL, false);
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        if (s == index) continue;
+        if (sg->parent_index == index) {
+            sg->parent_index = parent;
+            ir_flowchart_set_container_id(sg->strings, &sg->parent_subgraph_id, parent_data);
+        } else if (sg->parent_index == last) {
+            sg->parent_index = index;
+        }
+    }
+    if (parent_data) parent_data->layout_computed = false;
+
+    // Same for the child components
+    IRComponent* component = subgraph->component;
+    IRComponent* container = component ? component->parent : NULL;
+    if (container) {
+        for (uint32_t i = 0; i < component->child_count; i++) {
+            IRComponent* child = component->children[i];
+            if (!child) continue;
+            ir_add_child(container, child);
+            uint32_t* child_slot = ir_flowchart_child_slot(child);
+            if (child_slot) *child_slot = container->child_count - 1;
+        }
+        component->child_count = 0;
+    }
+
+    ir_flowchart_handle_release(&state->subgraph_handles, subgraph->handle);
+    state->subgraph_count--;
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_SUBGRAPHS, index);
+    ir_flowchart_publisher_mark(state->publisher, IR_FLOWCHART_SNAPSHOT_SUBGRAPHS, last);
+    if (index != last) {
+        state->subgraphs[index] = state->subgraphs[last];
+        ir_flowchart_handle_move(&state->subgraph_handles, state->subgraphs[index]->handle, index);
+    }
+
+    ir_flowchart_free_element(component, subgraph->child_slot, false);
+    ir_flowchart_subgraph_data_destroy(subgraph);
+
+    // Member lists are rebuilt by the next layout
+    state->subgraphs_resolved = false;
+    state->dirty_flags |= IR_FLOWCHART_DIRTY_STRUCTURE;
+    state->layout_computed = false;
+    state->content_key = 0;
+    return true;
+}
+
+// ============================================================================
+// Cloning
+// ============================================================================
+
+// Helper: Copy the flowchart elements among `source`'s children under `target`
+// Strings are interned in the copy's arena, data taken from its pools
+static bool ir_flowchart_clone_children(IRComponent* flowchart, IRComponent* target, IRComponent* source) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    IRFlowchartStringArena* strings = state->strings;
+
+    for (uint32_t i = 0; i < source->child_count; i++) {
+        IRComponent* child = source->children[i];
+        if (!child) continue;
+
+        IRComponent* copy = NULL;
+        bool failed = false;
+        if (child->type == IR_COMPONENT_FLOWCHART_NODE) {
+            IRFlowchartNodeData* node = ir_get_flowchart_node_data(child);
+            if (!node) continue;
+            copy = ir_flowchart_node_in(state, node->node_id, node->shape, node->label);
+            if (!copy) return false;
+
+            IRFlowchartNodeData* data = ir_get_flowchart_node_data(copy);
+            data->fill_color = node->fill_color;
+            data->stroke_color = node->stroke_color;
+            data->stroke_width = node->stroke_width;
+            data->style_flags = node->style_flags;
+            data->style_class = node->style_class;
+            data->subgraph_id = ir_flowchart_copy_string(strings, node->subgraph_id, &failed);
+        } else if (child->type == IR_COMPONENT_FLOWCHART_EDGE) {
+            IRFlowchartEdgeData* edge = ir_get_flowchart_edge_data(child);
+            if (!edge) continue;
+            copy = ir_flowchart_edge_in(state, edge->from_id, edge->to_id, edge->type);
+            if (!copy) return false;
+
+            IRFlowchartEdgeData* data = ir_get_flowchart_edge_data(copy);
+            data->label = ir_flowchart_copy_string(strings, edge->label, &failed);
+            data->start_marker = edge->start_marker;
+            data->end_marker = edge->end_marker;
+            data->stroke_color = edge->stroke_color;
+            data->stroke_width = edge->stroke_width;
+            data->style_flags = edge->style_flags;
+            data->style_class = edge->style_class;
+            data->link_style_resolved = edge->link_style_resolved;
+        } else if (child->type == IR_COMPONENT_FLOWCHART_SUBGRAPH) {
+            IRFlowchartSubgraphData* subgraph = ir_get_flowchart_subgraph_data(child);
+            if (!subgraph) continue;
+            copy = ir_flowchart_subgraph_in(state, subgraph->subgraph_id, subgraph->title);
+            if (!copy) return false;
+
+            IRFlowchartSubgraphData* data = ir_get_flowchart_subgraph_data(copy);
+            data->direction = subgraph->direction;
+            data->background_color = subgraph->background_color;
+            data->border_color = subgraph->border_color;
+            data->parent_subgraph_id = ir_flowchart_copy_string(strings, subgraph->parent_subgraph_id, &failed);
+        } else {
+            continue;
+        }
+
+        // Attached first so a failure below is cleaned up with the copy
+        ir_add_child(target, copy);
+        if (failed) return false;
+        if (child->type == IR_COMPONENT_FLOWCHART_SUBGRAPH &&
+            !ir_flowchart_clone_children(flowchart, copy, child)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Helper: Copy the style tables, so the elements' class indices mean the same in the copy
+// Class names are interned in the copy's arena
+static bool ir_flowchart_clone_styles(IRFlowchartState* state, const IRFlowchartState* source) {
+    for (uint32_t i = 0; i < source->style_count; i++) {
+        IRFlowchartStyle style = source->styles[i];
+        if (style.name && !(style.name = ir_flowchart_intern(state->strings, style.name))) return false;
+
+        uint32_t index = ir_flowchart_style_push(state, &style);
+        if (index == 0) return false;
+        if ((style.name || style.base != 0) && !ir_flowchart_style_index_add(state, index)) return false;
+    }
+    state->default_class = source->default_class;
+    state->link_style_default = source->link_style_default;
+
+    if (source->link_style_count > 0) {
+        state->link_styles = (uint32_t*)malloc(source->link_style_count * sizeof(uint32_t));
+        if (!state->link_styles) return false;
+        memcpy(state->link_styles, source->link_styles, source->link_style_count * sizeof(uint32_t));
+        state->link_style_count = source->link_style_count;
+        state->link_style_capacity = source->link_style_count;
+    }
+    return true;
+}
+
+IRComponent* ir_flowchart_clone(IRComponent* flowchart) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return NULL;
+
+    IRComponent* clone = ir_flowchart(state->direction);
+    if (!clone) return NULL;
+    if (!ir_flowchart_reserve(clone, state->node_count, state->edge_count, state->subgraph_count) ||
+        !ir_flowchart_clone_styles(ir_get_flowchart_state(clone), state) ||
+        !ir_flowchart_clone_children(clone, clone, flowchart)) {
+        ir_flowchart_free_component(clone);
+        return NULL;
+    }
+
+    IRFlowchartState* clone_state = ir_get_flowchart_state(clone);
+    clone_state->node_spacing = state->node_spacing;
+    clone_state->rank_spacing = state->rank_spacing;
+    clone_state->crossing_iterations = state->crossing_iterations;
+    clone_state->crossing_time_budget_ms = state->crossing_time_budget_ms;
+    clone_state->layout_threads = state->layout_threads;
+    clone_state->subgraph_padding = state->subgraph_padding;
+
+    ir_flowchart_finalize(clone);
+
+    // Same content as the original, so cached layouts of it still apply
+    clone_state->content_key = state->content_key;
+    return clone;
 }
@@ -0,0 +1,365 @@
+// ============================================================================
+// FLOWCHART PARSE AND LAYOUT CACHE
+// ============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+#include "flowchart_cache.h"
+#include "flowchart_builder.h"
+#include "flowchart_layout.h"
+#include "ir_builder.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    CACHE_ENTRY_PARSE,
+    CACHE_ENTRY_LAYOUT
+} CacheEntryType;
+
+// Cached entries are immutable; readers copy from them outside the lock
+typedef struct CacheEntry {
+    struct CacheEntry* prev;           // LRU list, most recently used first
+    struct CacheEntry* next;
+    struct CacheEntry* bucket_next;    // Chain in the key index
+    CacheEntryType type;
+    uint64_t key;                      // Source hash
+    uint64_t layout_key;               // Layout parameter hash (CACHE_ENTRY_LAYOUT)
+    uint32_t refs;                     // One for the list, one per reader still copying
+
+    // CACHE_ENTRY_PARSE
+    char* source;                      // Copy of the source, compared on lookup
+    size_t length;
+    IRComponent* flowchart;            // Parsed flowchart, only ever cloned
+
+    // CACHE_ENTRY_LAYOUT
+    IRFlowchartLayoutSnapshot* snapshot;
+} CacheEntry;
+
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry* g_cache_head = NULL;
+static CacheEntry* g_cache_tail = NULL;
+static uint32_t g_cache_count = 0;
+static uint32_t g_cache_capacity = 0;
+static CacheEntry** g_cache_buckets = NULL;   // Key index: lookups go here, the list only orders by recency
+static uint32_t g_cache_bucket_count = 0;     // Power of two, at least g_cache_count once allocated
+static IRFlowchartCacheStats g_cache_stats;
+
+// ============================================================================
+// Hashing
+// ============================================================================
+
+#define CACHE_HASH_K1 0x87c37b91114253d5ull
+#define CACHE_HASH_K2 0x4cf5ad432745937full
+
+static uint64_t cache_rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Final avalanche so every input bit affects every output bit
+static uint64_t cache_fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Eight bytes per step; the tail is zero-padded into a last word
+uint64_t ir_flowchart_cache_hash(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = (uint64_t)length * CACHE_HASH_K2;
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash ^= cache_rotl(word * CACHE_HASH_K1, 31) * CACHE_HASH_K2;
+        hash = cache_rotl(hash, 27) * 5 + 0x52dce729;
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, length - i);
+        hash ^= cache_rotl(word * CACHE_HASH_K1, 31) * CACHE_HASH_K2;
+    }
+
+    hash = cache_fmix(hash);
+    return hash == 0 ? 1 : hash;
+}
+
+// ============================================================================
+// Key index (callers hold g_cache_lock)
+// ============================================================================
+
+static uint32_t cache_bucket(CacheEntryType type, uint64_t key, uint64_t layout_key) {
+    uint64_t hash = cache_fmix(key ^ cache_rotl(layout_key, 29) ^ (uint64_t)type);
+    return (uint32_t)hash & (g_cache_bucket_count - 1);
+}
+
+// Make room for `count` entries at one per bucket on average
+// Failing to grow only lengthens the chains, unless there is no table yet
+static bool cache_index_reserve(uint32_t count) {
+    if (count <= g_cache_bucket_count) return true;
+
+    uint32_t new_count = g_cache_bucket_count == 0 ? 16 : g_cache_bucket_count;
+    while (new_count < count && new_count < (1u << 31)) new_count *= 2;
+    CacheEntry** new_buckets = (CacheEntry**)calloc(new_count, sizeof(CacheEntry*));
+    if (!new_buckets) return g_cache_bucket_count > 0;
+
+    free(g_cache_buckets);
+    g_cache_buckets = new_buckets;
+    g_cache_bucket_count = new_count;
+    for (CacheEntry* entry = g_cache_head; entry; entry = entry->next) {
+        uint32_t bucket = cache_bucket(entry->type, entry->key, entry->layout_key);
+        entry->bucket_next = g_cache_buckets[bucket];
+        g_cache_buckets[bucket] = entry;
+    }
+    return true;
+}
+
+// Entries in the list are exactly those in the index
+static void cache_index_add(CacheEntry* entry) {
+    uint32_t bucket = cache_bucket(entry->type, entry->key, entry->layout_key);
+    entry->bucket_next = g_cache_buckets[bucket];
+    g_cache_buckets[bucket] = entry;
+}
+
+static void cache_index_remove(CacheEntry* entry) {
+    CacheEntry** link = &g_cache_buckets[cache_bucket(entry->type, entry->key, entry->layout_key)];
+    while (*link && *link != entry) link = &(*link)->bucket_next;
+    if (*link) *link = entry->bucket_next;
+    entry->bucket_next = NULL;
+}
+
+// ============================================================================
+// LRU list (callers hold g_cache_lock)
+// ============================================================================
+
+static void cache_entry_free(CacheEntry* entry) {
+    if (!entry) return;
+    if (entry->flowchart) ir_flowchart_free_component(entry->flowchart);
+    ir_flowchart_layout_snapshot_destroy(entry->snapshot);
+    free(entry->source);
+    free(entry);
+}
+
+static void cache_unlink(CacheEntry* entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else g_cache_head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else g_cache_tail = entry->prev;
+    entry->prev = NULL;
+    entry->next = NULL;
+    g_cache_count--;
+}
+
+static void cache_push_front(CacheEntry* entry) {
+    entry->prev = NULL;
+    entry->next = g_cache_head;
+    if (g_cache_head) g_cache_head->prev = entry;
+    g_cache_head = entry;
+    if (!g_cache_tail) g_cache_tail = entry;
+    g_cache_count++;
+}
+
+// Drop one reference; returns the entry if it is now free to delete
+static CacheEntry* cache_release(CacheEntry* entry) {
+    return --entry->refs == 0 ? entry : NULL;
+}
+
+// Unlink entries past `capacity`, oldest first
+// Entries no reader holds are chained through `next` for freeing after unlock
+static CacheEntry* cache_trim(uint32_t capacity, bool count_evictions) {
+    CacheEntry* dead = NULL;
+    while (g_cache_count > capacity) {
+        CacheEntry* entry = g_cache_tail;
+        cache_index_remove(entry);
+        cache_unlink(entry);
+        if (count_evictions) g_cache_stats.evictions++;
+        if (cache_release(entry)) {
+            entry->next = dead;
+            dead = entry;
+        }
+    }
+    return dead;
+}
+
+static void cache_free_chain(CacheEntry* dead) {
+    while (dead) {
+        CacheEntry* next = dead->next;
+        cache_entry_free(dead);
+        dead = next;
+    }
+}
+
+// Find an entry and mark it most recently used; the caller gets a reference
+static CacheEntry* cache_acquire(CacheEntryType type, uint64_t key, uint64_t layout_key,
+                                 const char* source, size_t length) {
+    if (g_cache_bucket_count == 0) return NULL;
+
+    CacheEntry* entry = g_cache_buckets[cache_bucket(type, key, layout_key)];
+    for (; entry; entry = entry->bucket_next) {
+        if (entry->type != type || entry->key != key || entry->layout_key != layout_key) continue;
+        if (type == CACHE_ENTRY_PARSE &&
+            (entry->length != length || memcmp(entry->source, source, length) != 0)) {
+            continue;
+        }
+
+        if (entry != g_cache_head) {
+            cache_unlink(entry);
+            cache_push_front(entry);
+        }
+        entry->refs++;
+        return entry;
+    }
+    return NULL;
+}
+
+// Add an entry unless an equal one was stored meanwhile, then trim to capacity
+static void cache_insert(CacheEntry* entry) {
+    pthread_mutex_lock(&g_cache_lock);
+    CacheEntry* dead = entry;
+    if (g_cache_capacity > 0) {
+        CacheEntry* existing = cache_acquire(entry->type, entry->key, entry->layout_key,
+                                             entry->source, entry->length);
+        if (existing) {
+            existing->refs--;
+        } else if (cache_index_reserve(g_cache_count + 1)) {
+            entry->refs = 1;
+            cache_index_add(entry);
+            cache_push_front(entry);
+            dead = cache_trim(g_cache_capacity, true);
+        }
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+
+    cache_free_chain(dead);
+}
+
+// Give back a reference taken by cache_acquire
+static void cache_return(CacheEntry* entry) {
+    pthread_mutex_lock(&g_cache_lock);
+    CacheEntry* dead = cache_release(entry);
+    pthread_mutex_unlock(&g_cache_lock);
+
+    cache_entry_free(dead);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void ir_flowchart_cache_set_capacity(uint32_t entries) {
+    pthread_mutex_lock(&g_cache_lock);
+    g_cache_capacity = entries;
+    CacheEntry* dead = cache_trim(entries, true);
+    pthread_mutex_unlock(&g_cache_lock);
+
+    cache_free_chain(dead);
+}
+
+void ir_flowchart_cache_clear(void) {
+    pthread_mutex_lock(&g_cache_lock);
+    CacheEntry* dead = cache_trim(0, false);
+    pthread_mutex_unlock(&g_cache_lock);
+
+    cache_free_chain(dead);
+}
+
+void ir_flowchart_cache_get_stats(IRFlowchartCacheStats* stats) {
+    if (!stats) return;
+    pthread_mutex_lock(&g_cache_lock);
+    *stats = g_cache_stats;
+    stats->entries = g_cache_count;
+    stats->capacity = g_cache_capacity;
+    pthread_mutex_unlock(&g_cache_lock);
+}
+
+void ir_flowchart_cache_reset_stats(void) {
+    pthread_mutex_lock(&g_cache_lock);
+    memset(&g_cache_stats, 0, sizeof(g_cache_stats));
+    pthread_mutex_unlock(&g_cache_lock);
+}
+
+bool ir_flowchart_cache_enabled(void) {
+    pthread_mutex_lock(&g_cache_lock);
+    bool enabled = g_cache_capacity > 0;
+    pthread_mutex_unlock(&g_cache_lock);
+    return enabled;
+}
+
+// ============================================================================
+// Parse results
+// ============================================================================
+
+IRComponent* ir_flowchart_cache_find_parse(const char* source, size_t length, uint64_t key) {
+    if (!source || key == 0) return NULL;
+
+    pthread_mutex_lock(&g_cache_lock);
+    CacheEntry* entry = cache_acquire(CACHE_ENTRY_PARSE, key, 0, source, length);
+    if (entry) g_cache_stats.parse_hits++;
+    else g_cache_stats.parse_misses++;
+    pthread_mutex_unlock(&g_cache_lock);
+    if (!entry) return NULL;
+
+    IRComponent* flowchart = ir_flowchart_clone(entry->flowchart);
+    cache_return(entry);
+    return flowchart;
+}
+
+void ir_flowchart_cache_store_parse(const char* source, size_t length, uint64_t key, IRComponent* flowchart) {
+    if (!source || key == 0 || !flowchart || !ir_flowchart_cache_enabled()) return;
+
+    CacheEntry* entry = (CacheEntry*)calloc(1, sizeof(CacheEntry));
+    if (!entry) return;
+    entry->type = CACHE_ENTRY_PARSE;
+    entry->key = key;
+    entry->length = length;
+    entry->source = (char*)malloc(length + 1);
+    entry->flowchart = ir_flowchart_clone(flowchart);
+    if (!entry->source || !entry->flowchart) {
+        cache_entry_free(entry);
+        return;
+    }
+    memcpy(entry->source, source, length);
+    entry->source[length] = '\0';
+
+    cache_insert(entry);
+}
+
+// ============================================================================
+// Layouts
+// ============================================================================
+
+bool ir_flowchart_cache_apply_layout(uint64_t content_key, uint64_t layout_key,
+                                     bool (*apply)(const IRFlowchartLayoutSnapshot* snapshot, void* user_data),
+                                     void* user_data) {
+    if (content_key == 0 || !apply) return false;
+
+    pthread_mutex_lock(&g_cache_lock);
+    CacheEntry* entry = cache_acquire(CACHE_ENTRY_LAYOUT, content_key, layout_key, NULL, 0);
+    if (entry) g_cache_stats.layout_hits++;
+    else g_cache_stats.layout_misses++;
+    pthread_mutex_unlock(&g_cache_lock);
+    if (!entry) return false;
+
+    bool applied = apply(entry->snapshot, user_data);
+    cache_return(entry);
+    return applied;
+}
+
+void ir_flowchart_cache_store_layout(uint64_t content_key, uint64_t layout_key, IRFlowchartLayoutSnapshot* snapshot) {
+    if (!snapshot) return;
+
+    CacheEntry* entry = (CacheEntry*)calloc(1, sizeof(CacheEntry));
+    if (!entry) {
+        ir_flowchart_layout_snapshot_destroy(snapshot);
+        return;
+    }
+    entry->type = CACHE_ENTRY_LAYOUT;
+    entry->key = content_key;
+    entry->layout_key = layout_key;
+    entry->snapshot = snapshot;
+
+    cache_insert(entry);
+}
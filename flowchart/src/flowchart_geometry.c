@@ -0,0 +1,114 @@
+// ============================================================================
+// FLOWCHART GEOMETRY KERNELS
+// ============================================================================
+
+#include "flowchart_geometry.h"
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define GEOMETRY_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GEOMETRY_SSE 1
+#endif
+
+// Multiply and add stay separate instructions (no FMA), rounding like the
+// scalar loop does on the same target
+void ir_flowchart_geometry_fit(float* out, const float* in, uint32_t count, float scale, float offset) {
+    uint32_t i = 0;
+
+#if defined(GEOMETRY_AVX)
+    __m256 scale8 = _mm256_set1_ps(scale);
+    __m256 offset8 = _mm256_set1_ps(offset);
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_loadu_ps(in + i);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(offset8, _mm256_mul_ps(v, scale8)));
+    }
+#elif defined(GEOMETRY_SSE)
+    __m128 scale4 = _mm_set1_ps(scale);
+    __m128 offset4 = _mm_set1_ps(offset);
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(offset4, _mm_mul_ps(v, scale4)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = offset + in[i] * scale;
+    }
+}
+
+bool ir_flowchart_geometry_bounds(const float* x, const float* y, const float* width, const float* height,
+                                  uint32_t count, float bounds[4]) {
+    if (count == 0) return false;
+
+    float min_x = x[0], min_y = y[0];
+    float max_x = x[0] + width[0], max_y = y[0] + height[0];
+    uint32_t i = 0;
+
+#if defined(GEOMETRY_AVX)
+    if (count >= 8) {
+        __m256 lo_x = _mm256_loadu_ps(x), lo_y = _mm256_loadu_ps(y);
+        __m256 hi_x = _mm256_add_ps(lo_x, _mm256_loadu_ps(width));
+        __m256 hi_y = _mm256_add_ps(lo_y, _mm256_loadu_ps(height));
+        for (i = 8; i + 8 <= count; i += 8) {
+            __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i);
+            lo_x = _mm256_min_ps(lo_x, vx);
+            lo_y = _mm256_min_ps(lo_y, vy);
+            hi_x = _mm256_max_ps(hi_x, _mm256_add_ps(vx, _mm256_loadu_ps(width + i)));
+            hi_y = _mm256_max_ps(hi_y, _mm256_add_ps(vy, _mm256_loadu_ps(height + i)));
+        }
+
+        float lanes[4][8];
+        _mm256_storeu_ps(lanes[0], lo_x);
+        _mm256_storeu_ps(lanes[1], lo_y);
+        _mm256_storeu_ps(lanes[2], hi_x);
+        _mm256_storeu_ps(lanes[3], hi_y);
+        for (int k = 0; k < 8; k++) {
+            min_x = fminf(min_x, lanes[0][k]);
+            min_y = fminf(min_y, lanes[1][k]);
+            max_x = fmaxf(max_x, lanes[2][k]);
+            max_y = fmaxf(max_y, lanes[3][k]);
+        }
+    }
+#elif defined(GEOMETRY_SSE)
+    if (count >= 4) {
+        __m128 lo_x = _mm_loadu_ps(x), lo_y = _mm_loadu_ps(y);
+        __m128 hi_x = _mm_add_ps(lo_x, _mm_loadu_ps(width));
+        __m128 hi_y = _mm_add_ps(lo_y, _mm_loadu_ps(height));
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i);
+            lo_x = _mm_min_ps(lo_x, vx);
+            lo_y = _mm_min_ps(lo_y, vy);
+            hi_x = _mm_max_ps(hi_x, _mm_add_ps(vx, _mm_loadu_ps(width + i)));
+            hi_y = _mm_max_ps(hi_y, _mm_add_ps(vy, _mm_loadu_ps(height + i)));
+        }
+
+        float lanes[4][4];
+        _mm_storeu_ps(lanes[0], lo_x);
+        _mm_storeu_ps(lanes[1], lo_y);
+        _mm_storeu_ps(lanes[2], hi_x);
+        _mm_storeu_ps(lanes[3], hi_y);
+        for (int k = 0; k < 4; k++) {
+            min_x = fminf(min_x, lanes[0][k]);
+            min_y = fminf(min_y, lanes[1][k]);
+            max_x = fmaxf(max_x, lanes[2][k]);
+            max_y = fmaxf(max_y, lanes[3][k]);
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        min_x = fminf(min_x, x[i]);
+        min_y = fminf(min_y, y[i]);
+        max_x = fmaxf(max_x, x[i] + width[i]);
+        max_y = fmaxf(max_y, y[i] + height[i]);
+    }
+
+    bounds[0] = min_x;
+    bounds[1] = min_y;
+    bounds[2] = max_x;
+    bounds[3] = max_y;
+    return true;
+}
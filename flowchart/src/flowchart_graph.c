@@ -0,0 +1,844 @@
+// FLOWCHART GRAPH CORE
+// ============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+#include "flowchart_graph.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GRAPH_NO_NODE IR_FLOWCHART_INVALID_INDEX
+
+// ============================================================================
+// Graph Construction
+// ============================================================================
+
+// Build CSR in/out adjacency from the edge list
+static bool graph_build_adjacency(IRFlowchartGraph* graph) {
+    uint32_t n = graph->node_count;
+    uint32_t m = graph->edge_count;
+
+    free(graph->out_offsets);
+    free(graph->out_targets);
+    free(graph->in_offsets);
+    free(graph->in_sources);
+    graph->out_offsets = (uint32_t*)calloc(n + 1, sizeof(uint32_t));
+    graph->in_offsets = (uint32_t*)calloc(n + 1, sizeof(uint32_t));
+    graph->out_targets = (uint32_t*)malloc((m + 1) * sizeof(uint32_t));
+    graph->in_sources = (uint32_t*)malloc((m + 1) * sizeof(uint32_t));
+    uint32_t* out_fill = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    uint32_t* in_fill = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    if (!graph->out_offsets || !graph->in_offsets || !graph->out_targets ||
+        !graph->in_sources || !out_fill || !in_fill) {
+        free(out_fill);
+        free(in_fill);
+        return false;
+    }
+
+    // Prefix sums turn degree counts into offsets
+    for (uint32_t e = 0; e < m; e++) {
+        graph->out_offsets[graph->edge_from[e] + 1]++;
+        graph->in_offsets[graph->edge_to[e] + 1]++;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        graph->out_offsets[v + 1] += graph->out_offsets[v];
+        graph->in_offsets[v + 1] += graph->in_offsets[v];
+    }
+
+    memcpy(out_fill, graph->out_offsets, n * sizeof(uint32_t));
+    memcpy(in_fill, graph->in_offsets, n * sizeof(uint32_t));
+
+    // Scatter edges in list order so neighbour lists stay stable
+    for (uint32_t e = 0; e < m; e++) {
+        graph->out_targets[out_fill[graph->edge_from[e]]++] = graph->edge_to[e];
+        graph->in_sources[in_fill[graph->edge_to[e]]++] = graph->edge_from[e];
+    }
+
+    free(out_fill);
+    free(in_fill);
+    return true;
+}
+
+bool ir_flowchart_graph_build(IRFlowchartGraph* graph, const IRFlowchartState* state) {
+    if (!graph || !state) return false;
+    memset(graph, 0, sizeof(IRFlowchartGraph));
+
+    uint32_t n = state->node_count;
+    graph->node_count = n;
+    graph->real_node_count = n;
+
+    graph->edge_from = (uint32_t*)malloc((state->edge_count + 1) * sizeof(uint32_t));
+    graph->edge_to = (uint32_t*)malloc((state->edge_count + 1) * sizeof(uint32_t));
+    graph->edge_ref = (uint32_t*)malloc((state->edge_count + 1) * sizeof(uint32_t));
+    if (!graph->edge_from || !graph->edge_to || !graph->edge_ref) {
+        ir_flowchart_graph_destroy(graph);
+        return false;
+    }
+
+    // Collect edges from the pre-resolved endpoint indices
+    uint32_t m = 0;
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        IRFlowchartEdgeData* edge = state->edges[e];
+        if (!edge) continue;
+
+        uint32_t from = edge->from_index;
+        uint32_t to = edge->to_index;
+        if (from >= n || to >= n || from == to) continue;
+
+        graph->edge_from[m] = from;
+        graph->edge_to[m] = to;
+        graph->edge_ref[m] = e;
+        m++;
+    }
+    graph->edge_count = m;
+
+    if (!graph_build_adjacency(graph)) {
+        ir_flowchart_graph_destroy(graph);
+        return false;
+    }
+    return true;
+}
+
+bool ir_flowchart_graph_build_edges(IRFlowchartGraph* graph, uint32_t node_count, uint32_t edge_count,
+                                    const uint32_t* from, const uint32_t* to, const uint32_t* ref) {
+    if (!graph || (edge_count > 0 && (!from || !to || !ref))) return false;
+    memset(graph, 0, sizeof(IRFlowchartGraph));
+
+    graph->node_count = node_count;
+    graph->real_node_count = node_count;
+
+    graph->edge_from = (uint32_t*)malloc((edge_count + 1) * sizeof(uint32_t));
+    graph->edge_to = (uint32_t*)malloc((edge_count + 1) * sizeof(uint32_t));
+    graph->edge_ref = (uint32_t*)malloc((edge_count + 1) * sizeof(uint32_t));
+    if (!graph->edge_from || !graph->edge_to || !graph->edge_ref) {
+        ir_flowchart_graph_destroy(graph);
+        return false;
+    }
+
+    uint32_t m = 0;
+    for (uint32_t e = 0; e < edge_count; e++) {
+        if (from[e] >= node_count || to[e] >= node_count || from[e] == to[e]) continue;
+        graph->edge_from[m] = from[e];
+        graph->edge_to[m] = to[e];
+        graph->edge_ref[m] = ref[e];
+        m++;
+    }
+    graph->edge_count = m;
+
+    if (!graph_build_adjacency(graph)) {
+        ir_flowchart_graph_destroy(graph);
+        return false;
+    }
+    return true;
+}
+
+void ir_flowchart_graph_destroy(IRFlowchartGraph* graph) {
+    if (!graph) return;
+    free(graph->edge_from);
+    free(graph->edge_to);
+    free(graph->edge_ref);
+    free(graph->out_offsets);
+    free(graph->out_targets);
+    free(graph->in_offsets);
+    free(graph->in_sources);
+    free(graph->layer);
+    free(graph->layer_offsets);
+    free(graph->layer_nodes);
+    free(graph->position);
+    free(graph->chain_offsets);
+    free(graph->chain_nodes);
+    memset(graph, 0, sizeof(IRFlowchartGraph));
+}
+
+// ============================================================================
+// Layer Assignment
+// ============================================================================
+
+bool ir_flowchart_graph_assign_layers(IRFlowchartGraph* graph) {
+    if (!graph) return false;
+
+    uint32_t n = graph->node_count;
+    free(graph->layer);
+    graph->layer = (int*)calloc(n + 1, sizeof(int));
+    uint32_t* pending = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));  // Unranked predecessors
+    uint32_t* queue = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));    // Ready nodes (FIFO)
+    uint32_t* reached = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));  // Nodes touched by a ranked predecessor
+    bool* ranked = (bool*)calloc(n + 1, sizeof(bool));
+    bool* was_reached = (bool*)calloc(n + 1, sizeof(bool));
+    if (!graph->layer || !pending || !queue || !reached || !ranked || !was_reached) {
+        free(pending);
+        free(queue);
+        free(reached);
+        free(ranked);
+        free(was_reached);
+        return false;
+    }
+
+    uint32_t head = 0, tail = 0;
+    uint32_t reached_head = 0, reached_tail = 0;
+    uint32_t next_unranked = 0;
+
+    for (uint32_t v = 0; v < n; v++) {
+        pending[v] = graph->in_offsets[v + 1] - graph->in_offsets[v];
+        if (pending[v] == 0) queue[tail++] = v;
+    }
+
+    uint32_t ranked_count = 0;
+    while (ranked_count < n) {
+        if (head == tail) {
+            // Every remaining node sits on (or behind) a cycle. Release the
+            // first node already reached from the ranked part of the graph,
+            // otherwise the lowest-index unranked node.
+            uint32_t pick = GRAPH_NO_NODE;
+            while (reached_head < reached_tail) {
+                uint32_t candidate = reached[reached_head++];
+                if (!ranked[candidate]) {
+                    pick = candidate;
+                    break;
+                }
+            }
+            if (pick == GRAPH_NO_NODE) {
+                while (ranked[next_unranked]) next_unranked++;
+                pick = next_unranked;
+            }
+            queue[tail++] = pick;
+        }
+
+        uint32_t u = queue[head++];
+        if (ranked[u]) continue;
+        ranked[u] = true;
+        ranked_count++;
+
+        // Longest path: each successor sits below its deepest ranked predecessor
+        for (uint32_t k = graph->out_offsets[u]; k < graph->out_offsets[u + 1]; k++) {
+            uint32_t v = graph->out_targets[k];
+            if (ranked[v]) continue;  // Back edge of a broken cycle
+
+            if (graph->layer[v] < graph->layer[u] + 1) {
+                graph->layer[v] = graph->layer[u] + 1;
+            }
+            if (!was_reached[v]) {
+                was_reached[v] = true;
+                reached[reached_tail++] = v;
+            }
+            if (--pending[v] == 0) queue[tail++] = v;
+        }
+    }
+
+    int max_layer = 0;
+    for (uint32_t v = 0; v < n; v++) {
+        if (graph->layer[v] > max_layer) max_layer = graph->layer[v];
+    }
+    graph->layer_count = n > 0 ? (uint32_t)max_layer + 1 : 0;
+
+    free(pending);
+    free(queue);
+    free(reached);
+    free(ranked);
+    free(was_reached);
+    return true;
+}
+
+// ============================================================================
+// Virtual Nodes
+// ============================================================================
+
+bool ir_flowchart_graph_insert_virtual_nodes(IRFlowchartGraph* graph, uint32_t state_edge_count) {
+    if (!graph || !graph->layer) return false;
+
+    free(graph->chain_offsets);
+    free(graph->chain_nodes);
+    graph->chain_nodes = NULL;
+    graph->chain_edge_count = state_edge_count;
+    graph->chain_offsets = (uint32_t*)calloc(state_edge_count + 1, sizeof(uint32_t));
+    if (!graph->chain_offsets) return false;
+
+    // Count virtual nodes per state edge
+    uint32_t virtual_count = 0;
+    for (uint32_t e = 0; e < graph->edge_count; e++) {
+        int span = abs(graph->layer[graph->edge_to[e]] - graph->layer[graph->edge_from[e]]);
+        if (span > 1) {
+            graph->chain_offsets[graph->edge_ref[e] + 1] = (uint32_t)span - 1;
+            virtual_count += (uint32_t)span - 1;
+        }
+    }
+    for (uint32_t e = 0; e < state_edge_count; e++) {
+        graph->chain_offsets[e + 1] += graph->chain_offsets[e];
+    }
+    if (virtual_count == 0) return true;
+
+    uint32_t n = graph->node_count + virtual_count;
+    uint32_t m = graph->edge_count + virtual_count;
+
+    graph->chain_nodes = (uint32_t*)malloc(virtual_count * sizeof(uint32_t));
+    int* layer = (int*)realloc(graph->layer, (n + 1) * sizeof(int));
+    if (layer) graph->layer = layer;
+    uint32_t* edge_from = (uint32_t*)malloc((m + 1) * sizeof(uint32_t));
+    uint32_t* edge_to = (uint32_t*)malloc((m + 1) * sizeof(uint32_t));
+    uint32_t* edge_ref = (uint32_t*)malloc((m + 1) * sizeof(uint32_t));
+    if (!graph->chain_nodes || !layer || !edge_from || !edge_to || !edge_ref) {
+        free(edge_from);
+        free(edge_to);
+        free(edge_ref);
+        return false;
+    }
+
+    // Replace each long edge with segments through fresh virtual nodes
+    uint32_t next_node = graph->node_count;
+    uint32_t out = 0;
+    for (uint32_t e = 0; e < graph->edge_count; e++) {
+        uint32_t from = graph->edge_from[e];
+        uint32_t to = graph->edge_to[e];
+        uint32_t ref = graph->edge_ref[e];
+        int from_layer = graph->layer[from];
+        int step = graph->layer[to] > from_layer ? 1 : -1;
+        uint32_t chain = graph->chain_offsets[ref];
+        uint32_t chain_end = graph->chain_offsets[ref + 1];
+
+        uint32_t prev = from;
+        for (uint32_t k = chain; k < chain_end; k++) {
+            uint32_t v = next_node++;
+            graph->layer[v] = from_layer + step * (int)(k - chain + 1);
+            graph->chain_nodes[k] = v;
+
+            edge_from[out] = prev;
+            edge_to[out] = v;
+            edge_ref[out] = ref;
+            out++;
+            prev = v;
+        }
+
+        edge_from[out] = prev;
+        edge_to[out] = to;
+        edge_ref[out] = ref;
+        out++;
+    }
+
+    free(graph->edge_from);
+    free(graph->edge_to);
+    free(graph->edge_ref);
+    graph->edge_from = edge_from;
+    graph->edge_to = edge_to;
+    graph->edge_ref = edge_ref;
+    graph->edge_count = m;
+    graph->node_count = n;
+
+    return graph_build_adjacency(graph);
+}
+
+// ============================================================================
+// Crossing Reduction
+// ============================================================================
+
+// Stop after this many sweeps without an improvement
+#define GRAPH_ORDER_MAX_STALE_SWEEPS 4
+
+// Scratch buffers shared by all sweeps (allocated once per ordering)
+typedef struct {
+    uint64_t* keys;                    // Packed (sort key << 32 | current position)
+    uint32_t* neighbors;               // Neighbour positions of one node
+    uint32_t* south;                   // Crossing count: target positions in edge order
+    uint64_t* tree;                    // Crossing count: accumulator tree
+    uint32_t* best_nodes;              // Best layer_nodes ordering seen so far
+} GraphOrderScratch;
+
+static int graph_compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int graph_compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void graph_sort_u32(uint32_t* values, uint32_t count) {
+    if (count > 16) {
+        qsort(values, count, sizeof(uint32_t), graph_compare_u32);
+        return;
+    }
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t value = values[i];
+        uint32_t j = i;
+        while (j > 0 && values[j - 1] > value) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = value;
+    }
+}
+
+static double graph_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Bilayer crossing count using an accumulator tree (Barth, Juenger, Mutzel)
+static uint64_t graph_count_layer_crossings(const IRFlowchartGraph* graph, uint32_t upper,
+                                            uint32_t* south, uint64_t* tree) {
+    uint32_t lower = upper + 1;
+    uint32_t lower_size = graph->layer_offsets[lower + 1] - graph->layer_offsets[lower];
+    if (lower_size == 0) return 0;
+
+    // Targets in the lower layer, sorted by (upper position, lower position)
+    uint32_t south_count = 0;
+    for (uint32_t k = graph->layer_offsets[upper]; k < graph->layer_offsets[upper + 1]; k++) {
+        uint32_t u = graph->layer_nodes[k];
+        uint32_t start = south_count;
+        for (uint32_t e = graph->out_offsets[u]; e < graph->out_offsets[u + 1]; e++) {
+            uint32_t v = graph->out_targets[e];
+            if ((uint32_t)graph->layer[v] == lower) south[south_count++] = graph->position[v];
+        }
+        for (uint32_t e = graph->in_offsets[u]; e < graph->in_offsets[u + 1]; e++) {
+            uint32_t v = graph->in_sources[e];
+            if ((uint32_t)graph->layer[v] == lower) south[south_count++] = graph->position[v];
+        }
+        graph_sort_u32(south + start, south_count - start);
+    }
+
+    uint32_t first_index = 1;
+    while (first_index < lower_size) first_index <<= 1;
+    uint32_t tree_size = 2 * first_index - 1;
+    first_index -= 1;
+    memset(tree, 0, tree_size * sizeof(uint64_t));
+
+    uint64_t crossings = 0;
+    for (uint32_t k = 0; k < south_count; k++) {
+        uint32_t index = south[k] + first_index;
+        tree[index]++;
+        while (index > 0) {
+            if (index % 2) crossings += tree[index + 1];
+            index = (index - 1) / 2;
+            tree[index]++;
+        }
+    }
+    return crossings;
+}
+
+static uint64_t graph_count_crossings_with(const IRFlowchartGraph* graph, uint32_t* south, uint64_t* tree) {
+    uint64_t crossings = 0;
+    for (uint32_t l = 0; l + 1 < graph->layer_count; l++) {
+        crossings += graph_count_layer_crossings(graph, l, south, tree);
+    }
+    return crossings;
+}
+
+uint64_t ir_flowchart_graph_count_crossings(const IRFlowchartGraph* graph) {
+    if (!graph || !graph->layer_offsets || graph->layer_count < 2) return 0;
+
+    uint32_t* south = (uint32_t*)malloc((graph->edge_count + 1) * sizeof(uint32_t));
+    uint64_t* tree = (uint64_t*)malloc((4 * (size_t)graph->node_count + 4) * sizeof(uint64_t));
+    uint64_t crossings = 0;
+    if (south && tree) {
+        crossings = graph_count_crossings_with(graph, south, tree);
+    }
+    free(south);
+    free(tree);
+    return crossings;
+}
+
+// Reorder one layer by the median position of its neighbours in the layer
+// above (when sweeping down) or below (when sweeping up). Both edge
+// directions count, so segments of reversed cycle edges pull too.
+static void graph_sort_layer(IRFlowchartGraph* graph, uint32_t l, bool downward, GraphOrderScratch* scratch) {
+    uint32_t begin = graph->layer_offsets[l];
+    uint32_t end = graph->layer_offsets[l + 1];
+    uint32_t count = end - begin;
+    if (count < 2) return;
+
+    int fixed_layer = downward ? (int)l - 1 : (int)l + 1;
+
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t v = graph->layer_nodes[begin + k];
+
+        uint32_t degree = 0;
+        for (uint32_t e = graph->in_offsets[v]; e < graph->in_offsets[v + 1]; e++) {
+            uint32_t w = graph->in_sources[e];
+            if (graph->layer[w] == fixed_layer) scratch->neighbors[degree++] = graph->position[w];
+        }
+        for (uint32_t e = graph->out_offsets[v]; e < graph->out_offsets[v + 1]; e++) {
+            uint32_t w = graph->out_targets[e];
+            if (graph->layer[w] == fixed_layer) scratch->neighbors[degree++] = graph->position[w];
+        }
+
+        // Keys are doubled so that even-degree medians stay integral;
+        // nodes without neighbours keep their current slot
+        uint32_t key;
+        if (degree == 0) {
+            key = 2 * k;
+        } else {
+            graph_sort_u32(scratch->neighbors, degree);
+            uint32_t mid = degree / 2;
+            key = (degree % 2) ? 2 * scratch->neighbors[mid]
+                               : scratch->neighbors[mid - 1] + scratch->neighbors[mid];
+        }
+        scratch->keys[k] = ((uint64_t)key << 32) | k;
+    }
+
+    qsort(scratch->keys, count, sizeof(uint64_t), graph_compare_u64);
+
+    // Decode the sorted keys through the saved slots before overwriting them
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t old_slot = (uint32_t)(scratch->keys[k] & 0xFFFFFFFFu);
+        scratch->neighbors[k] = graph->layer_nodes[begin + old_slot];
+    }
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t v = scratch->neighbors[k];
+        graph->layer_nodes[begin + k] = v;
+        graph->position[v] = k;
+    }
+}
+
+static void graph_update_positions(IRFlowchartGraph* graph) {
+    for (uint32_t l = 0; l < graph->layer_count; l++) {
+        for (uint32_t k = graph->layer_offsets[l]; k < graph->layer_offsets[l + 1]; k++) {
+            graph->position[graph->layer_nodes[k]] = k - graph->layer_offsets[l];
+        }
+    }
+}
+
+// Helper: Allocate the ordering arrays and bucket nodes by layer, keeping registration order
+static bool graph_bucket_layers(IRFlowchartGraph* graph) {
+    uint32_t n = graph->node_count;
+    uint32_t layers = graph->layer_count;
+
+    free(graph->layer_offsets);
+    free(graph->layer_nodes);
+    free(graph->position);
+    graph->layer_offsets = (uint32_t*)calloc(layers + 2, sizeof(uint32_t));
+    graph->layer_nodes = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    graph->position = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    graph->crossings = 0;
+    if (!graph->layer_offsets || !graph->layer_nodes || !graph->position) return false;
+
+    // Counts go one slot to the right so the fill pass below leaves
+    // layer_offsets[l] at the start of layer l.
+    for (uint32_t v = 0; v < n; v++) {
+        graph->layer_offsets[graph->layer[v] + 2]++;
+    }
+    for (uint32_t l = 1; l <= layers; l++) {
+        graph->layer_offsets[l + 1] += graph->layer_offsets[l];
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        uint32_t l = (uint32_t)graph->layer[v];
+        graph->layer_nodes[graph->layer_offsets[l + 1]++] = v;
+    }
+    graph_update_positions(graph);
+    return true;
+}
+
+static void graph_order_scratch_free(GraphOrderScratch* scratch) {
+    free(scratch->keys);
+    free(scratch->neighbors);
+    free(scratch->south);
+    free(scratch->tree);
+    free(scratch->best_nodes);
+}
+
+static bool graph_order_scratch_init(GraphOrderScratch* scratch, const IRFlowchartGraph* graph) {
+    uint32_t n = graph->node_count;
+    uint32_t max_degree = 0;
+    for (uint32_t v = 0; v < n; v++) {
+        uint32_t degree = (graph->out_offsets[v + 1] - graph->out_offsets[v]) +
+                          (graph->in_offsets[v + 1] - graph->in_offsets[v]);
+        if (degree > max_degree) max_degree = degree;
+    }
+
+    scratch->keys = (uint64_t*)malloc((n + 1) * sizeof(uint64_t));
+    scratch->neighbors = (uint32_t*)malloc(((max_degree > n ? max_degree : n) + 1) * sizeof(uint32_t));
+    scratch->south = (uint32_t*)malloc((graph->edge_count + 1) * sizeof(uint32_t));
+    scratch->tree = (uint64_t*)malloc((4 * (size_t)n + 4) * sizeof(uint64_t));
+    scratch->best_nodes = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    if (!scratch->keys || !scratch->neighbors || !scratch->south || !scratch->tree || !scratch->best_nodes) {
+        graph_order_scratch_free(scratch);
+        return false;
+    }
+    return true;
+}
+
+bool ir_flowchart_graph_order_layers(IRFlowchartGraph* graph, uint32_t max_iterations, float time_budget_ms) {
+    if (!graph || !graph->layer) return false;
+
+    uint32_t n = graph->node_count;
+    uint32_t layers = graph->layer_count;
+
+    // Initial order: registration order within each layer
+    if (!graph_bucket_layers(graph)) return false;
+
+    if (layers < 2 || max_iterations == 0) {
+        graph->crossings = ir_flowchart_graph_count_crossings(graph);
+        return true;
+    }
+
+    GraphOrderScratch scratch;
+    if (!graph_order_scratch_init(&scratch, graph)) return false;
+
+    double deadline = time_budget_ms > 0 ? graph_now_ms() + time_budget_ms : 0;
+    uint64_t best = graph_count_crossings_with(graph, scratch.south, scratch.tree);
+    memcpy(scratch.best_nodes, graph->layer_nodes, n * sizeof(uint32_t));
+
+    uint32_t stale = 0;
+    for (uint32_t iter = 0; iter < max_iterations && best > 0; iter++) {
+        bool downward = (iter % 2) == 0;
+        if (downward) {
+            for (uint32_t l = 1; l < layers; l++) graph_sort_layer(graph, l, true, &scratch);
+        } else {
+            for (uint32_t l = layers - 1; l-- > 0;) graph_sort_layer(graph, l, false, &scratch);
+        }
+
+        uint64_t crossings = graph_count_crossings_with(graph, scratch.south, scratch.tree);
+        if (crossings < best) {
+            best = crossings;
+            memcpy(scratch.best_nodes, graph->layer_nodes, n * sizeof(uint32_t));
+            stale = 0;
+        } else if (++stale >= GRAPH_ORDER_MAX_STALE_SWEEPS) {
+            break;
+        }
+
+        if (deadline > 0 && graph_now_ms() >= deadline) break;
+    }
+
+    // Restore the best ordering found
+    memcpy(graph->layer_nodes, scratch.best_nodes, n * sizeof(uint32_t));
+    graph_update_positions(graph);
+    graph->crossings = best;
+
+    graph_order_scratch_free(&scratch);
+    return true;
+}
+
+// Crossings between the layer pairs that touch a flagged layer
+static uint64_t graph_count_swept_crossings(const IRFlowchartGraph* graph, const bool* sweep,
+                                            uint32_t* south, uint64_t* tree) {
+    uint64_t crossings = 0;
+    for (uint32_t l = 0; l + 1 < graph->layer_count; l++) {
+        if (sweep[l] || sweep[l + 1]) crossings += graph_count_layer_crossings(graph, l, south, tree);
+    }
+    return crossings;
+}
+
+bool ir_flowchart_graph_reorder_layers(IRFlowchartGraph* graph, const uint32_t* position,
+                                       const bool* sweep, uint32_t max_iterations) {
+    if (!graph || !graph->layer || !position || !sweep) return false;
+
+    uint32_t n = graph->node_count;
+    uint32_t layers = graph->layer_count;
+    if (!graph_bucket_layers(graph)) return false;
+
+    // Install the previous ordering; it must be a permutation of every layer
+    for (uint32_t k = 0; k < n; k++) graph->layer_nodes[k] = GRAPH_NO_NODE;
+    for (uint32_t v = 0; v < n; v++) {
+        uint32_t l = (uint32_t)graph->layer[v];
+        uint32_t size = graph->layer_offsets[l + 1] - graph->layer_offsets[l];
+        uint32_t slot = graph->layer_offsets[l] + position[v];
+        if (position[v] >= size || graph->layer_nodes[slot] != GRAPH_NO_NODE) return false;
+        graph->layer_nodes[slot] = v;
+    }
+    graph_update_positions(graph);
+
+    if (layers < 2 || max_iterations == 0) {
+        graph->crossings = ir_flowchart_graph_count_crossings(graph);
+        return true;
+    }
+
+    GraphOrderScratch scratch;
+    if (!graph_order_scratch_init(&scratch, graph)) return false;
+
+    uint64_t best = graph_count_swept_crossings(graph, sweep, scratch.south, scratch.tree);
+    memcpy(scratch.best_nodes, graph->layer_nodes, n * sizeof(uint32_t));
+
+    for (uint32_t iter = 0; iter < max_iterations && best > 0; iter++) {
+        bool downward = (iter % 2) == 0;
+        if (downward) {
+            for (uint32_t l = 1; l < layers; l++) {
+                if (sweep[l]) graph_sort_layer(graph, l, true, &scratch);
+            }
+        } else {
+            for (uint32_t l = layers - 1; l-- > 0;) {
+                if (sweep[l]) graph_sort_layer(graph, l, false, &scratch);
+            }
+        }
+
+        uint64_t crossings = graph_count_swept_crossings(graph, sweep, scratch.south, scratch.tree);
+        if (crossings < best) {
+            best = crossings;
+            memcpy(scratch.best_nodes, graph->layer_nodes, n * sizeof(uint32_t));
+        }
+    }
+
+    memcpy(graph->layer_nodes, scratch.best_nodes, n * sizeof(uint32_t));
+    graph_update_positions(graph);
+    graph->crossings = graph_count_crossings_with(graph, scratch.south, scratch.tree);
+
+    graph_order_scratch_free(&scratch);
+    return true;
+}
+
+// ============================================================================
+// Coordinate Assignment
+// ============================================================================
+
+// Alternating down/up balancing sweeps after the initial packing
+#define GRAPH_COORD_SWEEPS 4
+// Pull of a node's current center when it has no neighbour in the fixed layer
+#define GRAPH_COORD_FREE_WEIGHT 0.25f
+// Extra pull on virtual nodes so long edges stay straight
+#define GRAPH_COORD_VIRTUAL_WEIGHT 2.0f
+
+typedef struct {
+    float* offset;          // Minimum distance of each slot from the first slot of its layer
+    float* target;          // Desired center shifted by -offset
+    float* weight;
+    uint32_t* block_end;    // Pool-adjacent-violators stack: one past the last slot of each block
+    float* block_weight;
+    float* block_sum;
+} GraphCoordScratch;
+
+// Place layer l as close as possible to its neighbours in the fixed layer
+// while keeping the order and the minimum separation between nodes.
+// The least-squares placement is found with pool-adjacent-violators on
+// centers shifted by their cumulative separation, which is linear in the layer.
+static void graph_balance_layer(const IRFlowchartGraph* graph, uint32_t l, int fixed_layer,
+                                const float* breadth, float node_spacing,
+                                float* center, GraphCoordScratch* scratch) {
+    uint32_t begin = graph->layer_offsets[l];
+    uint32_t count = graph->layer_offsets[l + 1] - begin;
+    if (count == 0) return;
+
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t v = graph->layer_nodes[begin + k];
+
+        if (k == 0) {
+            scratch->offset[k] = 0;
+        } else {
+            uint32_t prev = graph->layer_nodes[begin + k - 1];
+            scratch->offset[k] = scratch->offset[k - 1] + (breadth[prev] + breadth[v]) / 2.0f + node_spacing;
+        }
+
+        uint32_t degree = 0;
+        float sum = 0;
+        for (uint32_t e = graph->in_offsets[v]; e < graph->in_offsets[v + 1]; e++) {
+            uint32_t w = graph->in_sources[e];
+            if (graph->layer[w] == fixed_layer) { sum += center[w]; degree++; }
+        }
+        for (uint32_t e = graph->out_offsets[v]; e < graph->out_offsets[v + 1]; e++) {
+            uint32_t w = graph->out_targets[e];
+            if (graph->layer[w] == fixed_layer) { sum += center[w]; degree++; }
+        }
+
+        float desired = degree > 0 ? sum / (float)degree : center[v];
+        float weight = degree > 0 ? (float)degree : GRAPH_COORD_FREE_WEIGHT;
+        if (v >= graph->real_node_count) weight *= GRAPH_COORD_VIRTUAL_WEIGHT;
+
+        scratch->target[k] = desired - scratch->offset[k];
+        scratch->weight[k] = weight;
+    }
+
+    // Merge blocks until the shifted centers are non-decreasing
+    uint32_t blocks = 0;
+    for (uint32_t k = 0; k < count; k++) {
+        scratch->block_end[blocks] = k + 1;
+        scratch->block_weight[blocks] = scratch->weight[k];
+        scratch->block_sum[blocks] = scratch->weight[k] * scratch->target[k];
+        blocks++;
+
+        while (blocks > 1 &&
+               scratch->block_sum[blocks - 2] * scratch->block_weight[blocks - 1] >
+               scratch->block_sum[blocks - 1] * scratch->block_weight[blocks - 2]) {
+            scratch->block_end[blocks - 2] = scratch->block_end[blocks - 1];
+            scratch->block_weight[blocks - 2] += scratch->block_weight[blocks - 1];
+            scratch->block_sum[blocks - 2] += scratch->block_sum[blocks - 1];
+            blocks--;
+        }
+    }
+
+    uint32_t k = 0;
+    for (uint32_t b = 0; b < blocks; b++) {
+        float value = scratch->block_sum[b] / scratch->block_weight[b];
+        for (; k < scratch->block_end[b]; k++) {
+            center[graph->layer_nodes[begin + k]] = value + scratch->offset[k];
+        }
+    }
+}
+
+bool ir_flowchart_graph_assign_coordinates(const IRFlowchartGraph* graph, const float* breadth,
+                                           float node_spacing, float* center) {
+    if (!graph || !graph->layer_nodes || !breadth || !center) return false;
+
+    uint32_t n = graph->node_count;
+    uint32_t layers = graph->layer_count;
+    if (n == 0) return true;
+
+    uint32_t max_count = 0;
+    for (uint32_t l = 0; l < layers; l++) {
+        uint32_t count = graph->layer_offsets[l + 1] - graph->layer_offsets[l];
+        if (count > max_count) max_count = count;
+    }
+
+    GraphCoordScratch scratch;
+    scratch.offset = (float*)malloc((max_count + 1) * sizeof(float));
+    scratch.target = (float*)malloc((max_count + 1) * sizeof(float));
+    scratch.weight = (float*)malloc((max_count + 1) * sizeof(float));
+    scratch.block_end = (uint32_t*)malloc((max_count + 1) * sizeof(uint32_t));
+    scratch.block_weight = (float*)malloc((max_count + 1) * sizeof(float));
+    scratch.block_sum = (float*)malloc((max_count + 1) * sizeof(float));
+    if (!scratch.offset || !scratch.target || !scratch.weight ||
+        !scratch.block_end || !scratch.block_weight || !scratch.block_sum) {
+        free(scratch.offset);
+        free(scratch.target);
+        free(scratch.weight);
+        free(scratch.block_end);
+        free(scratch.block_weight);
+        free(scratch.block_sum);
+        return false;
+    }
+
+    // Initial placement: pack each layer tightly and center it on 0
+    for (uint32_t l = 0; l < layers; l++) {
+        uint32_t begin = graph->layer_offsets[l];
+        uint32_t end = graph->layer_offsets[l + 1];
+        float cursor = 0;
+        for (uint32_t k = begin; k < end; k++) {
+            uint32_t v = graph->layer_nodes[k];
+            if (k > begin) cursor += (breadth[graph->layer_nodes[k - 1]] + breadth[v]) / 2.0f + node_spacing;
+            center[v] = cursor;
+        }
+        for (uint32_t k = begin; k < end; k++) {
+            center[graph->layer_nodes[k]] -= cursor / 2.0f;
+        }
+    }
+
+    // Pull every layer towards its neighbours, alternating sweep direction
+    for (uint32_t sweep = 0; sweep < GRAPH_COORD_SWEEPS && layers > 1; sweep++) {
+        if (sweep % 2 == 0) {
+            for (uint32_t l = 1; l < layers; l++) {
+                graph_balance_layer(graph, l, (int)l - 1, breadth, node_spacing, center, &scratch);
+            }
+        } else {
+            for (uint32_t l = layers - 1; l-- > 0;) {
+                graph_balance_layer(graph, l, (int)l + 1, breadth, node_spacing, center, &scratch);
+            }
+        }
+    }
+
+    // Shift so the leftmost node edge sits at 0
+    float min_edge = center[0] - breadth[0] / 2.0f;
+    for (uint32_t v = 1; v < n; v++) {
+        min_edge = fminf(min_edge, center[v] - breadth[v] / 2.0f);
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        center[v] -= min_edge;
+    }
+
+    free(scratch.offset);
+    free(scratch.target);
+    free(scratch.weight);
+    free(scratch.block_end);
+    free(scratch.block_weight);
+    free(scratch.block_sum);
+    return true;
+}
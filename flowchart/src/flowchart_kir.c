@@ -0,0 +1,382 @@
+// ============================================================================
+// DIRECT KIR JSON WRITER
+// ============================================================================
+
+#include "flowchart_kir.h"
+#include "flowchart_builder.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Output is staged here and handed to the callback when full
+#define KIR_BUFFER_SIZE (64 * 1024)
+
+typedef enum {
+    KIR_EVENT_NODE,
+    KIR_EVENT_EDGE,
+    KIR_EVENT_SUBGRAPH_BEGIN,
+    KIR_EVENT_SUBGRAPH_END
+} KirEventType;
+
+typedef struct {
+    KirEventType type;
+    uint32_t edge_index;               // Index linkStyle refers to (KIR_EVENT_EDGE)
+    void* data;                        // Element data (NULL for KIR_EVENT_SUBGRAPH_END)
+} KirEvent;
+
+typedef struct {
+    KirEvent* events;
+    uint32_t count;
+    uint32_t capacity;
+} KirQueue;
+
+struct IRFlowchartKirWriter {
+    IRFlowchartWriteFn write;
+    void* user_data;
+    IRFlowchartState* state;           // Set by ir_flowchart_kir_begin() (not owned)
+
+    // Elements not written yet, in source order (owned)
+    KirQueue queue;
+    uint32_t queue_depth;              // Subgraphs begun and not ended in the queue
+    uint32_t edge_count;               // Edges handed over so far
+
+    // Edges of the top-level subgraph being written, which follow it (owned)
+    KirQueue pending;
+
+    bool settled;                      // No style statement follows
+    bool need_comma;                   // A sibling was written before the next child
+    bool need_field_comma;             // A field was written before the next one
+    bool failed;                       // A write failed; nothing more is written
+    size_t used;
+    char buffer[KIR_BUFFER_SIZE];
+};
+
+IRFlowchartKirWriter* ir_flowchart_kir_writer_create(IRFlowchartWriteFn write, void* user_data) {
+    if (!write) return NULL;
+    IRFlowchartKirWriter* writer = (IRFlowchartKirWriter*)calloc(1, sizeof(IRFlowchartKirWriter));
+    if (!writer) return NULL;
+    writer->write = write;
+    writer->user_data = user_data;
+    return writer;
+}
+
+static void kir_event_destroy(KirEvent* event) {
+    switch (event->type) {
+        case KIR_EVENT_NODE: ir_flowchart_node_data_destroy((IRFlowchartNodeData*)event->data); break;
+        case KIR_EVENT_EDGE: ir_flowchart_edge_data_destroy((IRFlowchartEdgeData*)event->data); break;
+        case KIR_EVENT_SUBGRAPH_BEGIN: ir_flowchart_subgraph_data_destroy((IRFlowchartSubgraphData*)event->data); break;
+        case KIR_EVENT_SUBGRAPH_END: break;
+    }
+    event->data = NULL;
+}
+
+static void kir_queue_clear(KirQueue* queue) {
+    for (uint32_t i = 0; i < queue->count; i++) {
+        kir_event_destroy(&queue->events[i]);
+    }
+    queue->count = 0;
+}
+
+static bool kir_queue_push(KirQueue* queue, const KirEvent* event) {
+    if (queue->count >= queue->capacity) {
+        uint32_t new_capacity = queue->capacity == 0 ? 64 : queue->capacity * 2;
+        KirEvent* new_events = (KirEvent*)realloc(queue->events, new_capacity * sizeof(KirEvent));
+        if (!new_events) return false;
+        queue->events = new_events;
+        queue->capacity = new_capacity;
+    }
+    queue->events[queue->count++] = *event;
+    return true;
+}
+
+void ir_flowchart_kir_writer_destroy(IRFlowchartKirWriter* writer) {
+    if (!writer) return;
+    kir_queue_clear(&writer->queue);
+    kir_queue_clear(&writer->pending);
+    free(writer->queue.events);
+    free(writer->pending.events);
+    free(writer);
+}
+
+// ============================================================================
+// Output
+// ============================================================================
+
+static void kir_flush(IRFlowchartKirWriter* writer) {
+    if (writer->used > 0 && !writer->failed &&
+        !writer->write(writer->buffer, writer->used, writer->user_data)) {
+        writer->failed = true;
+    }
+    writer->used = 0;
+}
+
+static void kir_write(IRFlowchartKirWriter* writer, const char* data, size_t length) {
+    if (writer->failed) return;
+    if (writer->used + length > KIR_BUFFER_SIZE) {
+        kir_flush(writer);
+        if (length > KIR_BUFFER_SIZE) {
+            if (!writer->failed && !writer->write(data, length, writer->user_data)) writer->failed = true;
+            return;
+        }
+    }
+    memcpy(writer->buffer + writer->used, data, length);
+    writer->used += length;
+}
+
+static void kir_write_str(IRFlowchartKirWriter* writer, const char* text) {
+    kir_write(writer, text, strlen(text));
+}
+
+// Write a JSON string literal
+static void kir_write_string(IRFlowchartKirWriter* writer, const char* text) {
+    kir_write(writer, "\"", 1);
+    const char* run = text;
+    for (const char* c = text; *c; c++) {
+        unsigned char ch = (unsigned char)*c;
+        if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+
+        kir_write(writer, run, (size_t)(c - run));
+        run = c + 1;
+        char escape[8];
+        switch (ch) {
+            case '"': kir_write(writer, "\\\"", 2); break;
+            case '\\': kir_write(writer, "\\\\", 2); break;
+            case '\b': kir_write(writer, "\\b", 2); break;
+            case '\f': kir_write(writer, "\\f", 2); break;
+            case '\n': kir_write(writer, "\\n", 2); break;
+            case '\r': kir_write(writer, "\\r", 2); break;
+            case '\t': kir_write(writer, "\\t", 2); break;
+            default:
+                snprintf(escape, sizeof(escape), "\\u%04x", ch);
+                kir_write(writer, escape, 6);
+                break;
+        }
+    }
+    kir_write(writer, run, strlen(run));
+    kir_write(writer, "\"", 1);
+}
+
+// Open a component and its payload object, e.g. "{\"type\":\"Flowchart\",\"flowchart\":{"
+static void kir_begin_payload(IRFlowchartKirWriter* writer, const char* head) {
+    kir_write_str(writer, head);
+    writer->need_field_comma = false;
+}
+
+static void kir_write_key(IRFlowchartKirWriter* writer, const char* key) {
+    if (writer->need_field_comma) kir_write(writer, ",", 1);
+    writer->need_field_comma = true;
+    kir_write(writer, "\"", 1);
+    kir_write_str(writer, key);
+    kir_write(writer, "\":", 2);
+}
+
+static void kir_write_field(IRFlowchartKirWriter* writer, const char* key, const char* value) {
+    if (!value) return;
+    kir_write_key(writer, key);
+    kir_write_string(writer, value);
+}
+
+// Numbers are printed the way the serializer's JSON library prints them
+static void kir_write_number(IRFlowchartKirWriter* writer, const char* key, double value) {
+    char text[64];
+    int n;
+    if (value != value || value > 1e308 || value < -1e308) {
+        n = snprintf(text, sizeof(text), "null");
+    } else if (value >= INT_MIN && value <= INT_MAX && value == (double)(int)value) {
+        n = snprintf(text, sizeof(text), "%d", (int)value);
+    } else {
+        n = snprintf(text, sizeof(text), "%1.15g", value);
+        if (strtod(text, NULL) != value) n = snprintf(text, sizeof(text), "%1.17g", value);
+    }
+    kir_write_key(writer, key);
+    kir_write(writer, text, (size_t)n);
+}
+
+static void kir_write_color(IRFlowchartKirWriter* writer, const char* key, uint32_t color) {
+    if (color == 0) return;
+    char text[16];
+    snprintf(text, sizeof(text), "#%08X", (unsigned)color);
+    kir_write_field(writer, key, text);
+}
+
+static void kir_write_width(IRFlowchartKirWriter* writer, const char* key, float width) {
+    if (width > 0.0f) kir_write_number(writer, key, width);
+}
+
+static void kir_begin_child(IRFlowchartKirWriter* writer) {
+    if (writer->need_comma) kir_write(writer, ",", 1);
+    writer->need_comma = true;
+}
+
+static void kir_write_node(IRFlowchartKirWriter* writer, const IRFlowchartNodeData* node) {
+    kir_begin_child(writer);
+    kir_begin_payload(writer, "{\"type\":\"FlowchartNode\",\"flowchartNode\":{");
+    kir_write_field(writer, "nodeId", node->node_id);
+    kir_write_field(writer, "shape", ir_flowchart_shape_to_string(node->shape));
+    kir_write_field(writer, "label", node->label);
+    kir_write_color(writer, "fillColor", node->fill_color);
+    kir_write_color(writer, "strokeColor", node->stroke_color);
+    kir_write_width(writer, "strokeWidth", node->stroke_width);
+    kir_write(writer, "}}", 2);
+}
+
+static void kir_write_edge(IRFlowchartKirWriter* writer, const IRFlowchartEdgeData* edge) {
+    kir_begin_child(writer);
+    kir_begin_payload(writer, "{\"type\":\"FlowchartEdge\",\"flowchartEdge\":{");
+    kir_write_field(writer, "fromId", edge->from_id);
+    kir_write_field(writer, "toId", edge->to_id);
+    kir_write_field(writer, "edgeType", ir_flowchart_edge_type_to_string(edge->type));
+    kir_write_field(writer, "label", edge->label);
+    kir_write_field(writer, "startMarker", ir_flowchart_marker_to_string(edge->start_marker));
+    kir_write_field(writer, "endMarker", ir_flowchart_marker_to_string(edge->end_marker));
+    kir_write_color(writer, "strokeColor", edge->stroke_color);
+    kir_write_width(writer, "strokeWidth", edge->stroke_width);
+    kir_write(writer, "}}", 2);
+}
+
+static void kir_begin_subgraph(IRFlowchartKirWriter* writer, const IRFlowchartSubgraphData* subgraph) {
+    kir_begin_child(writer);
+    kir_begin_payload(writer, "{\"type\":\"FlowchartSubgraph\",\"flowchartSubgraph\":{");
+    kir_write_field(writer, "subgraphId", subgraph->subgraph_id);
+    kir_write_field(writer, "title", subgraph->title);
+    kir_write_field(writer, "direction", ir_flowchart_direction_to_string(subgraph->direction));
+    kir_write_color(writer, "backgroundColor", subgraph->background_color);
+    kir_write_color(writer, "borderColor", subgraph->border_color);
+    kir_write(writer, "},\"children\":[", 14);
+    writer->need_comma = false;
+}
+
+static void kir_end_subgraph(IRFlowchartKirWriter* writer) {
+    kir_write(writer, "]}", 2);
+    writer->need_comma = true;
+}
+
+// ============================================================================
+// Events
+// ============================================================================
+
+// Write one event and free its data
+// Edges of a top-level subgraph wait in pending until it ends.
+static void kir_emit(IRFlowchartKirWriter* writer, KirEvent* event, uint32_t* depth) {
+    const IRFlowchartState* state = writer->state;
+    switch (event->type) {
+        case KIR_EVENT_NODE:
+            if (state->style_count > 0) ir_flowchart_apply_node_style(state, (IRFlowchartNodeData*)event->data);
+            kir_write_node(writer, (const IRFlowchartNodeData*)event->data);
+            break;
+        case KIR_EVENT_EDGE:
+            if (state->style_count > 0) {
+                ir_flowchart_apply_edge_style(state, (IRFlowchartEdgeData*)event->data, event->edge_index);
+            }
+            if (*depth > 0) {
+                if (kir_queue_push(&writer->pending, event)) return;  // Pending owns the data now
+                writer->failed = true;
+                break;
+            }
+            kir_write_edge(writer, (const IRFlowchartEdgeData*)event->data);
+            break;
+        case KIR_EVENT_SUBGRAPH_BEGIN:
+            kir_begin_subgraph(writer, (const IRFlowchartSubgraphData*)event->data);
+            (*depth)++;
+            break;
+        case KIR_EVENT_SUBGRAPH_END:
+            if (*depth == 0) break;
+            kir_end_subgraph(writer);
+            if (--(*depth) > 0) break;
+
+            for (uint32_t i = 0; i < writer->pending.count; i++) {
+                kir_write_edge(writer, (const IRFlowchartEdgeData*)writer->pending.events[i].data);
+            }
+            kir_queue_clear(&writer->pending);
+            break;
+    }
+    kir_event_destroy(event);
+}
+
+// Write the queue once it is settled and holds no open subgraph
+static void kir_drain(IRFlowchartKirWriter* writer) {
+    if (!writer->settled || !writer->state || writer->queue_depth > 0) return;
+
+    uint32_t depth = 0;
+    for (uint32_t i = 0; i < writer->queue.count; i++) {
+        kir_emit(writer, &writer->queue.events[i], &depth);
+    }
+    writer->queue.count = 0;
+}
+
+static bool kir_push_event(IRFlowchartKirWriter* writer, KirEventType type, void* data) {
+    KirEvent event = { type, 0, data };
+    if (!writer) {
+        kir_event_destroy(&event);
+        return false;
+    }
+
+    if (type == KIR_EVENT_EDGE) event.edge_index = writer->edge_count;
+    if (!kir_queue_push(&writer->queue, &event)) {
+        kir_event_destroy(&event);
+        return false;
+    }
+
+    if (type == KIR_EVENT_EDGE) writer->edge_count++;
+    if (type == KIR_EVENT_SUBGRAPH_BEGIN) writer->queue_depth++;
+    if (type == KIR_EVENT_SUBGRAPH_END && writer->queue_depth > 0) writer->queue_depth--;
+    kir_drain(writer);
+    return true;
+}
+
+bool ir_flowchart_kir_add_node(IRFlowchartKirWriter* writer, IRFlowchartNodeData* node) {
+    return node && kir_push_event(writer, KIR_EVENT_NODE, node);
+}
+
+bool ir_flowchart_kir_add_edge(IRFlowchartKirWriter* writer, IRFlowchartEdgeData* edge) {
+    return edge && kir_push_event(writer, KIR_EVENT_EDGE, edge);
+}
+
+bool ir_flowchart_kir_begin_subgraph(IRFlowchartKirWriter* writer, IRFlowchartSubgraphData* subgraph) {
+    return subgraph && kir_push_event(writer, KIR_EVENT_SUBGRAPH_BEGIN, subgraph);
+}
+
+bool ir_flowchart_kir_end_subgraph(IRFlowchartKirWriter* writer) {
+    return kir_push_event(writer, KIR_EVENT_SUBGRAPH_END, NULL);
+}
+
+// ============================================================================
+// Document
+// ============================================================================
+
+bool ir_flowchart_kir_begin(IRFlowchartKirWriter* writer, IRFlowchartState* state) {
+    if (!writer || !state || writer->state) return false;
+    writer->state = state;
+
+    kir_begin_payload(writer, "{\"type\":\"Flowchart\",\"flowchart\":{");
+    kir_write_field(writer, "direction", ir_flowchart_direction_to_string(state->direction));
+    kir_write_number(writer, "nodeSpacing", state->node_spacing);
+    kir_write_number(writer, "rankSpacing", state->rank_spacing);
+    kir_write_number(writer, "subgraphPadding", state->subgraph_padding);
+    kir_write(writer, "},\"children\":[", 14);
+    writer->need_comma = false;
+    return !writer->failed;
+}
+
+void ir_flowchart_kir_settle(IRFlowchartKirWriter* writer) {
+    if (!writer || writer->settled) return;
+    writer->settled = true;
+    if (writer->state && writer->state->style_count > 0) ir_flowchart_compile_styles(writer->state);
+    kir_drain(writer);
+}
+
+bool ir_flowchart_kir_finish(IRFlowchartKirWriter* writer) {
+    if (!writer || !writer->state) return false;
+
+    ir_flowchart_kir_settle(writer);
+
+    // Subgraphs left open by the source
+    while (writer->queue_depth > 0) {
+        if (!ir_flowchart_kir_end_subgraph(writer)) return false;
+    }
+
+    kir_write(writer, "]}", 2);
+    kir_flush(writer);
+    return !writer->failed;
+}
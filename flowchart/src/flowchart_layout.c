@@ -3,6 +3,12 @@
 
 #include "flowchart_types.h"
 #include "flowchart_builder.h"
+#include "flowchart_graph.h"
+#include "flowchart_parallel.h"
+#include "flowchart_measure.h"
+#include "flowchart_cache.h"
+#include "flowchart_geometry.h"
+#include "flowchart_layout.h"
 #include "ir_core.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,639 +28,1622 @@ extern void ir_layout_dispatch(IRComponent* c, IRLayoutConstraints constraints,
 #define FLOWCHART_SUBGRAPH_PADDING 40.0f
 #define FLOWCHART_SUBGRAPH_TITLE_HEIGHT 30.0f
 
-// Compute bounding boxes for subgraphs based on their contained nodes
-static void compute_subgraph_bounds(IRFlowchartState* fc_state) {
-    if (!fc_state) return;
-
-    // Iterate over all subgraphs
-    for (uint32_t i = 0; i < fc_state->subgraph_count; i++) {
-        IRFlowchartSubgraphData* sg_data = fc_state->subgraphs[i];
-        if (!sg_data || !sg_data->subgraph_id) continue;
-
-        // Find all nodes that belong to this subgraph
-        float min_x = INFINITY, min_y = INFINITY;
-        float max_x = -INFINITY, max_y = -INFINITY;
-        bool has_nodes = false;
-
-        for (uint32_t j = 0; j < fc_state->node_count; j++) {
-            IRFlowchartNodeData* node_data = fc_state->nodes[j];
-
-            // Check if this node belongs to the current subgraph
-            if (node_data && node_data->subgraph_id &&
-                strcmp(node_data->subgraph_id, sg_data->subgraph_id) == 0) {
-
-                has_nodes = true;
-
-                // Update bounding box
-                float node_left = node_data->x;
-                float node_top = node_data->y;
-                float node_right = node_data->x + node_data->width;
-                float node_bottom = node_data->y + node_data->height;
-
-                if (node_left < min_x) min_x = node_left;
-                if (node_top < min_y) min_y = node_top;
-                if (node_right > max_x) max_x = node_right;
-                if (node_bottom > max_y) max_y = node_bottom;
-            }
-        }
+// Items of a wave per thread started for it. Threads are started per wave
+// (ir_flowchart_parallel_for) at some 20 us each; this many items take
+// about a millisecond to lay out. Smaller waves stay on the calling thread.
+#define FLOWCHART_PARALLEL_MIN_ITEMS 1024
+
+// Median sweeps over the layers touched by an incremental edge change
+#define FLOWCHART_LOCAL_SWEEPS 2
+
+struct FlowchartLevel;
+
+// Work left for a component in this pass
+typedef enum {
+    COMPONENT_LAYOUT_FULL,             // Layer, order and place
+    COMPONENT_LAYOUT_REORDER,          // Edges changed locally: re-sweep the touched layers, then place
+    COMPONENT_LAYOUT_PLACE,            // Item sizes changed: place with the previous ordering
+    COMPONENT_LAYOUT_KEEP              // Unchanged: geometry carried over from the previous layout
+} FlowchartComponentWork;
+
+// One connected component of one level, laid out independently of the others
+// Workers only read the level's item sizes and write their own items and bends
+typedef struct {
+    struct FlowchartLevel* level;
+    uint32_t item_begin;               // Slice of level->component_items
+    uint32_t item_count;
+    uint32_t edge_begin;               // Slice of the level edge arrays
+    uint32_t edge_count;
+    float* bends;                      // Bend points of all component edges (x, y pairs)
+    uint32_t* bend_offsets;            // Bends of local edge k are points bend_offsets[k] .. bend_offsets[k+1]
+    float width, height;               // Component extent
+    float offset_x, offset_y;          // Placement inside the level (set by the packer)
+    FlowchartComponentWork work;
+    IRFlowchartGraph graph;            // Layered and ordered items, kept for incremental relayout
+    const uint32_t* previous_position; // Ordering to start from (COMPONENT_LAYOUT_REORDER)
+    bool* sweep_layers;                // Layers touched by changed edges (COMPONENT_LAYOUT_REORDER)
+    bool ok;
+} FlowchartComponent;
+
+// One level of the subgraph hierarchy, split into connected components
+typedef struct FlowchartLevel {
+    uint32_t group;
+    bool horizontal;
+    bool reversed;
+    float node_spacing;
+    float rank_spacing;
+    uint32_t crossing_iterations;
+    float crossing_time_budget_ms;
+
+    uint32_t item_count;
+    uint32_t* item_ref;                // Node index, or node_count + subgraph index
+    float* item_width;
+    float* item_height;
+    float* item_x;                     // Top-left, component-local until the level is finished
+    float* item_y;
+    uint32_t* component_items;         // Level items grouped by component
+
+    uint32_t edge_count;
+    uint32_t* edge_state;              // State edge index, grouped by component
+    uint32_t* edge_from;               // Component-local endpoints
+    uint32_t* edge_to;
+
+    uint32_t component_count;
+    FlowchartComponent* components;
+} FlowchartLevel;
+
+static void level_destroy(FlowchartLevel* level) {
+    for (uint32_t c = 0; c < level->component_count; c++) {
+        free(level->components[c].bends);
+        free(level->components[c].bend_offsets);
+        free(level->components[c].sweep_layers);
+        ir_flowchart_graph_destroy(&level->components[c].graph);
+    }
+    free(level->components);
+    free(level->item_ref);
+    free(level->item_width);
+    free(level->item_height);
+    free(level->item_x);
+    free(level->item_y);
+    free(level->component_items);
+    free(level->edge_state);
+    free(level->edge_from);
+    free(level->edge_to);
+    memset(level, 0, sizeof(FlowchartLevel));
+}
 
-        if (has_nodes) {
-            // Add padding around nodes for subgraph box
-            sg_data->x = min_x - FLOWCHART_SUBGRAPH_PADDING;
-            sg_data->y = min_y - FLOWCHART_SUBGRAPH_PADDING - FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
-            sg_data->width = (max_x - min_x) + (FLOWCHART_SUBGRAPH_PADDING * 2);
-            sg_data->height = (max_y - min_y) + (FLOWCHART_SUBGRAPH_PADDING * 2) + FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
+// Layout context shared by every level of the subgraph hierarchy
+// Groups are subgraph indices; the top level is the extra group `root`
+// (== subgraph_count). Per-group lists are CSR arrays built once per pass.
+typedef struct {
+    IRFlowchartState* state;
+    float node_spacing;
+    float rank_spacing;
+    uint32_t root;
+
+    uint32_t* node_group;          // Innermost group of each node
+    uint32_t* group_parent;        // Parent group (IR_FLOWCHART_INVALID_INDEX for root)
+    uint32_t* group_depth;         // Nesting depth (root = 0)
+    uint32_t* group_node_total;    // Nodes in each group's subtree
+    uint32_t* edge_group;          // Group an edge is routed in (lowest common group of its endpoints)
+
+    // Direct members, child subgraphs and routed edges of group g live in
+    // *_items[*_offsets[g] .. *_offsets[g+1])
+    uint32_t* member_offsets;
+    uint32_t* member_items;
+    uint32_t* child_offsets;
+    uint32_t* child_items;
+    uint32_t* edge_offsets;
+    uint32_t* edge_items;
+
+    // Placement of each group's content origin inside its parent's content
+    float* origin_x;
+    float* origin_y;
+
+    uint32_t* item_of;             // Item index of a node/child block within the level being laid out
+    uint32_t* path_offset;         // Start of each edge's path in state->path_pool
+    FlowchartLevel* levels;        // Laid out levels per group, kept for incremental relayout
+} FlowchartLayoutContext;
+
+// Helper: Bucket `count` keys into CSR lists over `buckets` groups
+static bool build_group_lists(const uint32_t* keys, uint32_t count, uint32_t buckets,
+                              uint32_t** out_offsets, uint32_t** out_items) {
+    uint32_t* offsets = (uint32_t*)calloc(buckets + 2, sizeof(uint32_t));
+    uint32_t* items = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+    if (!offsets || !items) {
+        free(offsets);
+        free(items);
+        return false;
+    }
 
-            #ifdef KRYON_TRACE_LAYOUT
-            fprintf(stderr, "  📦 Subgraph '%s' bounds: x=%.1f y=%.1f w=%.1f h=%.1f\n",
-                   sg_data->subgraph_id, sg_data->x, sg_data->y,
-                   sg_data->width, sg_data->height);
-            #endif
-        }
+    // Counts go one slot to the right so the fill pass leaves offsets[g] at the start of g
+    for (uint32_t i = 0; i < count; i++) {
+        if (keys[i] < buckets) offsets[keys[i] + 2]++;
     }
+    for (uint32_t g = 1; g <= buckets; g++) {
+        offsets[g + 1] += offsets[g];
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (keys[i] < buckets) items[offsets[keys[i] + 1]++] = i;
+    }
+
+    *out_offsets = offsets;
+    *out_items = items;
+    return true;
 }
 
-// Helper: Transform coordinates recursively for nested subgraphs
-static void transform_subgraph_coordinates(IRComponent* subgraph, float offset_x, float offset_y, IRFlowchartState* state) {
-    if (!subgraph || !state) return;
+static void layout_context_destroy(FlowchartLayoutContext* ctx) {
+    if (ctx->levels) {
+        for (uint32_t g = 0; g <= ctx->root; g++) level_destroy(&ctx->levels[g]);
+    }
+    free(ctx->levels);
+    free(ctx->node_group);
+    free(ctx->group_parent);
+    free(ctx->group_depth);
+    free(ctx->group_node_total);
+    free(ctx->edge_group);
+    free(ctx->member_offsets);
+    free(ctx->member_items);
+    free(ctx->child_offsets);
+    free(ctx->child_items);
+    free(ctx->edge_offsets);
+    free(ctx->edge_items);
+    free(ctx->origin_x);
+    free(ctx->origin_y);
+    free(ctx->item_of);
+    free(ctx->path_offset);
+    memset(ctx, 0, sizeof(FlowchartLayoutContext));
+}
+
+// Helper: Innermost group containing both nodes (where an edge between them is routed)
+static uint32_t lowest_common_group(const FlowchartLayoutContext* ctx, uint32_t from, uint32_t to) {
+    uint32_t a = ctx->node_group[from];
+    uint32_t b = ctx->node_group[to];
+    while (ctx->group_depth[a] > ctx->group_depth[b]) a = ctx->group_parent[a];
+    while (ctx->group_depth[b] > ctx->group_depth[a]) b = ctx->group_parent[b];
+    while (a != b) {
+        a = ctx->group_parent[a];
+        b = ctx->group_parent[b];
+    }
+    return a;
+}
 
-    IRFlowchartSubgraphData* sg_data = ir_get_flowchart_subgraph_data(subgraph);
-    if (!sg_data || !sg_data->subgraph_id) return;
+// Helper: Resolve the subgraph hierarchy into index arrays
+static bool layout_context_init(FlowchartLayoutContext* ctx, IRFlowchartState* state,
+                                float node_spacing, float rank_spacing) {
+    memset(ctx, 0, sizeof(FlowchartLayoutContext));
+    ctx->state = state;
+    ctx->node_spacing = node_spacing;
+    ctx->rank_spacing = rank_spacing;
+    ctx->root = state->subgraph_count;
+
+    uint32_t groups = state->subgraph_count + 1;
+    ctx->node_group = (uint32_t*)malloc((state->node_count + 1) * sizeof(uint32_t));
+    ctx->group_parent = (uint32_t*)malloc(groups * sizeof(uint32_t));
+    ctx->group_depth = (uint32_t*)calloc(groups, sizeof(uint32_t));
+    ctx->group_node_total = (uint32_t*)calloc(groups, sizeof(uint32_t));
+    ctx->edge_group = (uint32_t*)malloc((state->edge_count + 1) * sizeof(uint32_t));
+    ctx->origin_x = (float*)calloc(groups, sizeof(float));
+    ctx->origin_y = (float*)calloc(groups, sizeof(float));
+    ctx->item_of = (uint32_t*)malloc((state->node_count + groups) * sizeof(uint32_t));
+    ctx->path_offset = (uint32_t*)malloc((state->edge_count + 1) * sizeof(uint32_t));
+    ctx->levels = (FlowchartLevel*)calloc(groups, sizeof(FlowchartLevel));
+    if (!ctx->node_group || !ctx->group_parent || !ctx->group_depth || !ctx->group_node_total ||
+        !ctx->edge_group || !ctx->origin_x || !ctx->origin_y || !ctx->item_of || !ctx->path_offset ||
+        !ctx->levels) {
+        layout_context_destroy(ctx);
+        return false;
+    }
+
+    // Containers as resolved by ir_flowchart_resolve_subgraphs; anything else is top level
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        uint32_t parent = sg ? sg->parent_index : IR_FLOWCHART_INVALID_INDEX;
+        ctx->group_parent[s] = (parent >= state->subgraph_count || parent == s) ? ctx->root : parent;
+    }
+    ctx->group_parent[ctx->root] = IR_FLOWCHART_INVALID_INDEX;
+
+    // Depths; a parent chain longer than the subgraph count is a cycle and is cut
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        uint32_t depth = 0;
+        uint32_t g = s;
+        while (g != ctx->root && depth <= state->subgraph_count) {
+            g = ctx->group_parent[g];
+            depth++;
+        }
+        if (g != ctx->root) {
+            ctx->group_parent[s] = ctx->root;
+            depth = 1;
+        }
+        ctx->group_depth[s] = depth;
+    }
 
-    // Transform all nodes in this subgraph
     for (uint32_t i = 0; i < state->node_count; i++) {
         IRFlowchartNodeData* node = state->nodes[i];
-        if (node && node->subgraph_id && strcmp(node->subgraph_id, sg_data->subgraph_id) == 0) {
-            node->x += offset_x;
-            node->y += offset_y;
-        }
-    }
-
-    // Transform edges (if they belong to this subgraph)
-    for (uint32_t i = 0; i < state->edge_count; i++) {
-        IRFlowchartEdgeData* edge = state->edges[i];
-        if (edge && edge->path_points) {
-            // Check if edge connects nodes in this subgraph
-            bool from_in_subgraph = false;
-            bool to_in_subgraph = false;
-
-            for (uint32_t j = 0; j < state->node_count; j++) {
-                IRFlowchartNodeData* node = state->nodes[j];
-                if (node && node->subgraph_id && strcmp(node->subgraph_id, sg_data->subgraph_id) == 0) {
-                    if (edge->from_id && node->node_id && strcmp(node->node_id, edge->from_id) == 0) {
-                        from_in_subgraph = true;
-                    }
-                    if (edge->to_id && node->node_id && strcmp(node->node_id, edge->to_id) == 0) {
-                        to_in_subgraph = true;
-                    }
-                }
-            }
-
-            // Transform edge if both endpoints are in this subgraph
-            if (from_in_subgraph && to_in_subgraph) {
-                for (uint32_t p = 0; p < edge->path_point_count; p++) {
-                    edge->path_points[p * 2] += offset_x;
-                    edge->path_points[p * 2 + 1] += offset_y;
-                }
-            }
+        uint32_t g = node ? node->subgraph_index : IR_FLOWCHART_INVALID_INDEX;
+        ctx->node_group[i] = g >= state->subgraph_count ? ctx->root : g;
+        if (!node) continue;
+        for (uint32_t a = ctx->node_group[i]; a != IR_FLOWCHART_INVALID_INDEX; a = ctx->group_parent[a]) {
+            ctx->group_node_total[a]++;
         }
     }
 
-    // Update subgraph bounds
-    sg_data->x += offset_x;
-    sg_data->y += offset_y;
+    // Each edge is routed in the innermost group containing both endpoints
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        IRFlowchartEdgeData* edge = state->edges[e];
+        ctx->edge_group[e] = IR_FLOWCHART_INVALID_INDEX;
+        ctx->path_offset[e] = IR_FLOWCHART_INVALID_INDEX;
+        if (!edge || edge->from_index >= state->node_count || edge->to_index >= state->node_count) continue;
+        if (!state->nodes[edge->from_index] || !state->nodes[edge->to_index]) continue;
+        ctx->edge_group[e] = lowest_common_group(ctx, edge->from_index, edge->to_index);
+    }
 
-    // Recursively transform nested subgraphs
-    for (uint32_t i = 0; i < subgraph->child_count; i++) {
-        IRComponent* child = subgraph->children[i];
-        if (child && child->type == IR_COMPONENT_FLOWCHART_SUBGRAPH) {
-            transform_subgraph_coordinates(child, offset_x, offset_y, state);
-        }
+    if (!build_group_lists(ctx->node_group, state->node_count, groups, &ctx->member_offsets, &ctx->member_items) ||
+        !build_group_lists(ctx->group_parent, state->subgraph_count, groups, &ctx->child_offsets, &ctx->child_items) ||
+        !build_group_lists(ctx->edge_group, state->edge_count, groups, &ctx->edge_offsets, &ctx->edge_items)) {
+        layout_context_destroy(ctx);
+        return false;
     }
+    return true;
 }
 
-// Helper: Compute node sizes based on labels and shapes
-static void compute_flowchart_node_sizes(IRFlowchartState* state, float font_size) {
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        IRFlowchartNodeData* node = state->nodes[i];
-        if (!node) continue;
+// Helper: Drop the cached layout of a subgraph and every subgraph containing it
+static void invalidate_subgraph_layout(FlowchartLayoutContext* ctx, uint32_t group) {
+    for (uint32_t g = group; g != ctx->root && g != IR_FLOWCHART_INVALID_INDEX; g = ctx->group_parent[g]) {
+        IRFlowchartSubgraphData* sg = ctx->state->subgraphs[g];
+        if (sg) sg->layout_computed = false;
+    }
+}
 
-        float label_width = 50.0f;
-        float label_height = font_size * 1.2f;
+// Helper: Outermost subgraph around `group` (inclusive) whose cached layout is reused
+static uint32_t outermost_cached_group(const FlowchartLayoutContext* ctx, uint32_t group) {
+    uint32_t cached = IR_FLOWCHART_INVALID_INDEX;
+    for (uint32_t g = group; g != ctx->root && g != IR_FLOWCHART_INVALID_INDEX; g = ctx->group_parent[g]) {
+        IRFlowchartSubgraphData* sg = ctx->state->subgraphs[g];
+        if (sg && sg->layout_computed) cached = g;
+    }
+    return cached;
+}
 
-        if (node->label && node->label[0] != '\0') {
-            if (g_ir_font_metrics && g_ir_font_metrics->get_text_width) {
-                size_t len = strlen(node->label);
-                label_width = g_ir_font_metrics->get_text_width(node->label, (uint32_t)len, font_size, NULL);
-                label_height = g_ir_font_metrics->get_font_height(font_size, NULL);
-            } else {
-                // No font metrics - use estimate
-                label_width = strlen(node->label) * font_size * 0.6f;
-            }
+// Compute bounding boxes for subgraphs based on their contained nodes
+// Nested subgraphs are enclosed by their parents
+static void compute_subgraph_bounds(FlowchartLayoutContext* ctx) {
+    IRFlowchartState* fc_state = ctx->state;
+    uint32_t count = fc_state->subgraph_count;
+    if (count == 0) return;
+
+    float* bounds = (float*)malloc(count * 4 * sizeof(float));
+    uint32_t* order = (uint32_t*)malloc(count * sizeof(uint32_t));
+    if (!bounds || !order) {
+        free(bounds);
+        free(order);
+        return;
+    }
+
+    for (uint32_t s = 0; s < count; s++) {
+        bounds[s * 4] = INFINITY;
+        bounds[s * 4 + 1] = INFINITY;
+        bounds[s * 4 + 2] = -INFINITY;
+        bounds[s * 4 + 3] = -INFINITY;
+        order[s] = s;
+    }
+
+    for (uint32_t j = 0; j < fc_state->node_count; j++) {
+        uint32_t s = ctx->node_group[j];
+        if (!fc_state->nodes[j] || s == ctx->root) continue;
+
+        bounds[s * 4] = fminf(bounds[s * 4], fc_state->node_x[j]);
+        bounds[s * 4 + 1] = fminf(bounds[s * 4 + 1], fc_state->node_y[j]);
+        bounds[s * 4 + 2] = fmaxf(bounds[s * 4 + 2], fc_state->node_x[j] + fc_state->node_width[j]);
+        bounds[s * 4 + 3] = fmaxf(bounds[s * 4 + 3], fc_state->node_y[j] + fc_state->node_height[j]);
+    }
+
+    // Innermost subgraphs first so each box can grow its parent
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t s = order[i];
+        uint32_t k = i;
+        while (k > 0 && ctx->group_depth[order[k - 1]] < ctx->group_depth[s]) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = s;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t s = order[i];
+        IRFlowchartSubgraphData* sg_data = fc_state->subgraphs[s];
+        if (!sg_data || bounds[s * 4] > bounds[s * 4 + 2]) continue;
+
+        // Add padding around nodes for subgraph box
+        sg_data->x = bounds[s * 4] - FLOWCHART_SUBGRAPH_PADDING;
+        sg_data->y = bounds[s * 4 + 1] - FLOWCHART_SUBGRAPH_PADDING - FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
+        sg_data->width = (bounds[s * 4 + 2] - bounds[s * 4]) + (FLOWCHART_SUBGRAPH_PADDING * 2);
+        sg_data->height = (bounds[s * 4 + 3] - bounds[s * 4 + 1]) + (FLOWCHART_SUBGRAPH_PADDING * 2) + FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
+
+        uint32_t parent = ctx->group_parent[s];
+        if (parent != ctx->root) {
+            bounds[parent * 4] = fminf(bounds[parent * 4], sg_data->x);
+            bounds[parent * 4 + 1] = fminf(bounds[parent * 4 + 1], sg_data->y);
+            bounds[parent * 4 + 2] = fmaxf(bounds[parent * 4 + 2], sg_data->x + sg_data->width);
+            bounds[parent * 4 + 3] = fmaxf(bounds[parent * 4 + 3], sg_data->y + sg_data->height);
         }
 
-        // Add padding around text
-        float h_padding = 32.0f;  // 16px on each side
-        float v_padding = 20.0f;  // 10px on each side
+        #ifdef KRYON_TRACE_LAYOUT
+        fprintf(stderr, "  📦 Subgraph '%s' bounds: x=%.1f y=%.1f w=%.1f h=%.1f\n",
+               sg_data->subgraph_id ? sg_data->subgraph_id : "?", sg_data->x, sg_data->y,
+               sg_data->width, sg_data->height);
+        #endif
+    }
+
+    free(bounds);
+    free(order);
+}
+
+// Helper: Move every subgraph block from its parent's local coordinates to absolute ones
+// Each group's content was laid out relative to its own origin; the origins
+// of all enclosing groups are summed once and applied to nodes, edge bends
+// and subgraph boxes in a single pass.
+static void transform_subgraph_coordinates(FlowchartLayoutContext* ctx) {
+    IRFlowchartState* state = ctx->state;
+    uint32_t groups = state->subgraph_count + 1;
+
+    float* abs_x = (float*)calloc(groups, sizeof(float));
+    float* abs_y = (float*)calloc(groups, sizeof(float));
+    if (!abs_x || !abs_y) {
+        free(abs_x);
+        free(abs_y);
+        return;
+    }
 
-        // Extra padding for non-rectangular shapes (text area is smaller)
-        if (node->shape == IR_FLOWCHART_SHAPE_DIAMOND) {
-            h_padding *= 2.0f;  // Diamond needs ~2x because text area is diagonal
-            v_padding *= 2.0f;
-        } else if (node->shape == IR_FLOWCHART_SHAPE_CIRCLE ||
-                   node->shape == IR_FLOWCHART_SHAPE_HEXAGON) {
-            h_padding *= 1.5f;
-            v_padding *= 1.5f;
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        for (uint32_t g = s; g != ctx->root; g = ctx->group_parent[g]) {
+            abs_x[s] += ctx->origin_x[g];
+            abs_y[s] += ctx->origin_y[g];
         }
+    }
 
-        node->width = fmaxf(FLOWCHART_NODE_MIN_WIDTH, label_width + h_padding);
-        node->height = fmaxf(FLOWCHART_NODE_MIN_HEIGHT, label_height + v_padding);
+    // Transform all nodes
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        state->node_x[i] += abs_x[ctx->node_group[i]];
+        state->node_y[i] += abs_y[ctx->node_group[i]];
+    }
 
-        // Make circles and diamonds square
-        if (node->shape == IR_FLOWCHART_SHAPE_CIRCLE ||
-            node->shape == IR_FLOWCHART_SHAPE_DIAMOND) {
-            float size = fmaxf(node->width, node->height);
-            node->width = size;
-            node->height = size;
+    // Transform edge bends routed inside subgraphs
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        uint32_t g = ctx->edge_group[e];
+        IRFlowchartEdgeData* edge = state->edges[e];
+        if (g == IR_FLOWCHART_INVALID_INDEX || g == ctx->root || !edge) continue;
+        if (ctx->path_offset[e] == IR_FLOWCHART_INVALID_INDEX) continue;
+
+        float* points = &state->path_pool[ctx->path_offset[e]];
+        for (uint32_t p = 0; p < edge->path_point_count; p++) {
+            points[p * 2] += abs_x[g];
+            points[p * 2 + 1] += abs_y[g];
         }
     }
+
+    // Update subgraph bounds (boxes live in their parent's coordinates)
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        IRFlowchartSubgraphData* sg_data = state->subgraphs[s];
+        if (!sg_data || ctx->group_node_total[s] == 0) continue;
+        sg_data->x += abs_x[ctx->group_parent[s]];
+        sg_data->y += abs_y[ctx->group_parent[s]];
+    }
+
+    free(abs_x);
+    free(abs_y);
 }
 
-// Helper: Layout nodes belonging to a specific subgraph (or top-level if subgraph_id is NULL)
-// Returns the computed size of the subgraph in local coordinates
-static void layout_subgraph_nodes(IRFlowchartState* state, const char* subgraph_id,
-                                   IRFlowchartDirection direction, float node_spacing,
-                                   float rank_spacing, float* out_width, float* out_height) {
-    if (!state) return;
+// Helper: Append room for `floats` path coordinates to the state's path pool
+// The pool only grows, so repeated layouts of the same chart do not allocate
+static uint32_t append_edge_path(IRFlowchartState* state, uint32_t floats) {
+    uint32_t needed = state->path_pool_count + floats;
+    if (needed > state->path_pool_capacity) {
+        uint32_t new_capacity = state->path_pool_capacity == 0 ? 64 : state->path_pool_capacity;
+        while (new_capacity < needed) new_capacity *= 2;
+
+        float* new_pool = (float*)realloc(state->path_pool, new_capacity * sizeof(float));
+        if (!new_pool) return IR_FLOWCHART_INVALID_INDEX;
+        state->path_pool = new_pool;
+        state->path_pool_capacity = new_capacity;
+    }
 
-    // Filter nodes that belong to this subgraph
-    uint32_t* subgraph_node_indices = (uint32_t*)malloc(state->node_count * sizeof(uint32_t));
-    uint32_t subgraph_node_count = 0;
+    uint32_t offset = state->path_pool_count;
+    state->path_pool_count = needed;
+    return offset;
+}
 
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        IRFlowchartNodeData* node = state->nodes[i];
-        if (!node) continue;
+// Natural (unscaled) layout kept between passes
+// Resizes only refit from here; structural changes rebuild it
+struct IRFlowchartLayoutCache {
+    FlowchartLayoutContext ctx;        // Hierarchy and path offsets of the natural layout
+    float* node_x;                     // Natural position of each node
+    float* node_y;
+    float* path_coords;                // Copy of the path pool
+    float* subgraph_boxes;             // x, y, width, height of each subgraph
+    uint32_t node_count;
+    uint32_t edge_count;
+    uint32_t subgraph_count;
+    uint32_t path_count;
+    float content_width;               // Natural size without padding
+    float content_height;
+    float font_size;                   // Font the node sizes were measured with
+};
+
+void ir_flowchart_layout_cache_destroy(IRFlowchartLayoutCache* cache) {
+    if (!cache) return;
+    layout_context_destroy(&cache->ctx);
+    free(cache->node_x);
+    free(cache->node_y);
+    free(cache->path_coords);
+    free(cache->subgraph_boxes);
+    free(cache);
+}
 
-        // Check if node belongs to this subgraph
-        bool belongs = false;
-        if (subgraph_id == NULL) {
-            // Top-level: nodes with no subgraph_id
-            belongs = (node->subgraph_id == NULL);
-        } else {
-            // Specific subgraph: nodes with matching subgraph_id
-            belongs = (node->subgraph_id && strcmp(node->subgraph_id, subgraph_id) == 0);
+// Helper: Move the content of reused subgraph layouts back to local coordinates
+// Node positions and edge bends come from the previous natural layout,
+// relative to the outermost cached subgraph whose box gives the old origin.
+static bool restore_cached_subgraphs(FlowchartLayoutContext* ctx) {
+    IRFlowchartState* state = ctx->state;
+    IRFlowchartLayoutCache* cache = state->layout_cache;
+    const float inset_x = FLOWCHART_SUBGRAPH_PADDING;
+    const float inset_y = FLOWCHART_SUBGRAPH_PADDING + FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
+
+    state->path_pool_count = 0;
+
+    // Reuse needs the previous natural layout of the same content; node and
+    // edge edits renumber the arrays the cached coordinates are indexed by
+    if (!cache || cache->node_count != state->node_count ||
+        cache->edge_count != state->edge_count || cache->subgraph_count != state->subgraph_count ||
+        (state->dirty_flags & ~IR_FLOWCHART_DIRTY_LABELS) != 0) {
+        for (uint32_t s = 0; s < state->subgraph_count; s++) {
+            if (state->subgraphs[s]) state->subgraphs[s]->layout_computed = false;
         }
+        return true;
+    }
+
+    const float* boxes = cache->subgraph_boxes;
+
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        uint32_t c = outermost_cached_group(ctx, ctx->node_group[i]);
+        if (!state->nodes[i] || c == IR_FLOWCHART_INVALID_INDEX) continue;
+        state->node_x[i] = cache->node_x[i] - (boxes[c * 4] + inset_x);
+        state->node_y[i] = cache->node_y[i] - (boxes[c * 4 + 1] + inset_y);
+    }
+
+    // Nested boxes inside a reused subgraph; the outermost box is placed anew
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        uint32_t c = outermost_cached_group(ctx, ctx->group_parent[s]);
+        if (!sg || c == IR_FLOWCHART_INVALID_INDEX) continue;
+        sg->x = boxes[s * 4] - (boxes[c * 4] + inset_x);
+        sg->y = boxes[s * 4 + 1] - (boxes[c * 4 + 1] + inset_y);
+        sg->width = boxes[s * 4 + 2];
+        sg->height = boxes[s * 4 + 3];
+    }
 
-        if (belongs) {
-            subgraph_node_indices[subgraph_node_count++] = i;
+    // Cached paths go to the front of the rebuilt pool
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        IRFlowchartEdgeData* edge = state->edges[e];
+        uint32_t old_offset = cache->ctx.path_offset[e];
+        if (ctx->edge_group[e] == IR_FLOWCHART_INVALID_INDEX || !edge || old_offset == IR_FLOWCHART_INVALID_INDEX) continue;
+        uint32_t c = outermost_cached_group(ctx, ctx->edge_group[e]);
+        if (c == IR_FLOWCHART_INVALID_INDEX) continue;
+
+        uint32_t offset = append_edge_path(state, edge->path_point_count * 2);
+        if (offset == IR_FLOWCHART_INVALID_INDEX) return false;
+
+        const float* old_points = &cache->path_coords[old_offset];
+        float* points = &state->path_pool[offset];
+        for (uint32_t p = 0; p < edge->path_point_count; p++) {
+            points[p * 2] = old_points[p * 2] - (boxes[c * 4] + inset_x);
+            points[p * 2 + 1] = old_points[p * 2 + 1] - (boxes[c * 4 + 1] + inset_y);
         }
+        ctx->path_offset[e] = offset;
     }
 
-    if (subgraph_node_count == 0) {
-        free(subgraph_node_indices);
-        if (out_width) *out_width = 0;
-        if (out_height) *out_height = 0;
-        return;
+    return true;
+}
+
+// Helper: Keep the natural layout; the cache takes over the layout context
+static bool save_natural_layout(FlowchartLayoutContext* ctx, float content_width, float content_height,
+                                float font_size) {
+    IRFlowchartState* state = ctx->state;
+    IRFlowchartLayoutCache* cache = (IRFlowchartLayoutCache*)calloc(1, sizeof(IRFlowchartLayoutCache));
+    if (!cache) return false;
+
+    cache->node_x = (float*)malloc((state->node_count + 1) * sizeof(float));
+    cache->node_y = (float*)malloc((state->node_count + 1) * sizeof(float));
+    cache->path_coords = (float*)malloc((state->path_pool_count + 1) * sizeof(float));
+    cache->subgraph_boxes = (float*)malloc((state->subgraph_count * 4 + 1) * sizeof(float));
+    if (!cache->node_x || !cache->node_y || !cache->path_coords || !cache->subgraph_boxes) {
+        ir_flowchart_layout_cache_destroy(cache);
+        return false;
+    }
+
+    memcpy(cache->node_x, state->node_x, state->node_count * sizeof(float));
+    memcpy(cache->node_y, state->node_y, state->node_count * sizeof(float));
+    if (state->path_pool_count > 0) {
+        memcpy(cache->path_coords, state->path_pool, state->path_pool_count * sizeof(float));
+    }
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        cache->subgraph_boxes[s * 4] = sg ? sg->x : 0;
+        cache->subgraph_boxes[s * 4 + 1] = sg ? sg->y : 0;
+        cache->subgraph_boxes[s * 4 + 2] = sg ? sg->width : 0;
+        cache->subgraph_boxes[s * 4 + 3] = sg ? sg->height : 0;
     }
 
-    // TODO: Implement layering and positioning for subgraph nodes
-    // For now, just free and return
-    free(subgraph_node_indices);
-    if (out_width) *out_width = 0;
-    if (out_height) *out_height = 0;
+    cache->node_count = state->node_count;
+    cache->edge_count = state->edge_count;
+    cache->subgraph_count = state->subgraph_count;
+    cache->path_count = state->path_pool_count;
+    cache->content_width = content_width;
+    cache->content_height = content_height;
+    cache->font_size = font_size;
+    cache->ctx = *ctx;
+    memset(ctx, 0, sizeof(FlowchartLayoutContext));
+
+    ir_flowchart_layout_cache_destroy(state->layout_cache);
+    state->layout_cache = cache;
+    return true;
 }
 
-// Simple layered layout for flowcharts
-// Uses topological sort to assign layers, then positions nodes within layers
-void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width, float available_height) {
-    if (!flowchart || flowchart->type != IR_COMPONENT_FLOWCHART) return;
+// ============================================================================
+// Shared layouts (parse/layout cache)
+// ============================================================================
+// A chart parsed from a cached source (state->content_key) can take over
+// the natural layout of an earlier chart with the same source, as long as
+// direction, font, spacing and measurement backend match as well.
+
+// Natural layout of a chart, independent of its state
+struct IRFlowchartLayoutSnapshot {
+    uint32_t node_count;
+    uint32_t edge_count;
+    uint32_t subgraph_count;
+    uint32_t path_count;
+    float content_width;
+    float content_height;
+    float* node_boxes;                 // x of every node, then y, width and height (node_count each)
+    uint32_t* path_offsets;            // Start of each edge's path in path_coords (IR_FLOWCHART_INVALID_INDEX = none)
+    uint32_t* path_point_counts;
+    float* path_coords;
+    float* subgraph_boxes;             // x, y, width, height of each subgraph
+};
+
+void ir_flowchart_layout_snapshot_destroy(IRFlowchartLayoutSnapshot* snapshot) {
+    if (!snapshot) return;
+    free(snapshot->node_boxes);
+    free(snapshot->path_offsets);
+    free(snapshot->path_point_counts);
+    free(snapshot->path_coords);
+    free(snapshot->subgraph_boxes);
+    free(snapshot);
+}
 
-    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
-    if (!state) return;
+// Helper: Key of everything besides the source that a natural layout depends on
+// 0 when the layout must not be shared (crossing reduction cut by wall-clock time)
+static uint64_t layout_snapshot_key(const IRFlowchartState* state, float font_size,
+                                    float node_spacing, float rank_spacing) {
+    if (state->crossing_time_budget_ms > 0) return 0;
+
+    struct {
+        uint64_t backend;
+        uint32_t direction;
+        uint32_t crossing_iterations;
+        float font_size;
+        float node_spacing;
+        float rank_spacing;
+        float subgraph_padding;
+    } key;
+    memset(&key, 0, sizeof(key));
+    key.backend = ir_flowchart_measure_backend_id();
+    key.direction = (uint32_t)state->direction;
+    key.crossing_iterations = state->crossing_iterations;
+    key.font_size = font_size;
+    key.node_spacing = node_spacing;
+    key.rank_spacing = rank_spacing;
+    key.subgraph_padding = state->subgraph_padding;
+    return ir_flowchart_cache_hash(&key, sizeof(key));
+}
 
-    // Check if layout is already computed and dimensions match
-    if (state->layout_computed &&
-        state->computed_width == available_width &&
-        state->computed_height == available_height) {
-        return;
+// Helper: Copy a finished natural layout (before save_natural_layout takes the context)
+static IRFlowchartLayoutSnapshot* create_layout_snapshot(const FlowchartLayoutContext* ctx,
+                                                         float content_width, float content_height) {
+    const IRFlowchartState* state = ctx->state;
+    IRFlowchartLayoutSnapshot* snapshot = (IRFlowchartLayoutSnapshot*)calloc(1, sizeof(IRFlowchartLayoutSnapshot));
+    if (!snapshot) return NULL;
+
+    snapshot->node_boxes = (float*)malloc((state->node_count * 4 + 1) * sizeof(float));
+    snapshot->path_offsets = (uint32_t*)malloc((state->edge_count + 1) * sizeof(uint32_t));
+    snapshot->path_point_counts = (uint32_t*)malloc((state->edge_count + 1) * sizeof(uint32_t));
+    snapshot->path_coords = (float*)malloc((state->path_pool_count + 1) * sizeof(float));
+    snapshot->subgraph_boxes = (float*)malloc((state->subgraph_count * 4 + 1) * sizeof(float));
+    if (!snapshot->node_boxes || !snapshot->path_offsets || !snapshot->path_point_counts ||
+        !snapshot->path_coords || !snapshot->subgraph_boxes) {
+        ir_flowchart_layout_snapshot_destroy(snapshot);
+        return NULL;
     }
 
-    #ifdef KRYON_TRACE_LAYOUT
-    fprintf(stderr, "🔀 FLOWCHART_LAYOUT: %u nodes, %u edges, dir=%s\n",
-            state->node_count, state->edge_count,
-            ir_flowchart_direction_to_string(state->direction));
-    #endif
+    uint32_t n = state->node_count;
+    memcpy(snapshot->node_boxes, state->node_x, n * sizeof(float));
+    memcpy(snapshot->node_boxes + n, state->node_y, n * sizeof(float));
+    memcpy(snapshot->node_boxes + n * 2, state->node_width, n * sizeof(float));
+    memcpy(snapshot->node_boxes + n * 3, state->node_height, n * sizeof(float));
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        const IRFlowchartEdgeData* edge = state->edges[e];
+        snapshot->path_offsets[e] = edge ? ctx->path_offset[e] : IR_FLOWCHART_INVALID_INDEX;
+        snapshot->path_point_counts[e] = edge ? edge->path_point_count : 0;
+    }
+    if (state->path_pool_count > 0) {
+        memcpy(snapshot->path_coords, state->path_pool, state->path_pool_count * sizeof(float));
+    }
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        const IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        snapshot->subgraph_boxes[s * 4] = sg ? sg->x : 0;
+        snapshot->subgraph_boxes[s * 4 + 1] = sg ? sg->y : 0;
+        snapshot->subgraph_boxes[s * 4 + 2] = sg ? sg->width : 0;
+        snapshot->subgraph_boxes[s * 4 + 3] = sg ? sg->height : 0;
+    }
 
-    if (state->node_count == 0) {
-        state->layout_computed = true;
-        state->computed_width = available_width;
-        state->computed_height = available_height;
-        return;
+    snapshot->node_count = state->node_count;
+    snapshot->edge_count = state->edge_count;
+    snapshot->subgraph_count = state->subgraph_count;
+    snapshot->path_count = state->path_pool_count;
+    snapshot->content_width = content_width;
+    snapshot->content_height = content_height;
+    return snapshot;
+}
+
+typedef struct {
+    FlowchartLayoutContext* ctx;
+    float content_width;
+    float content_height;
+} SnapshotInstall;
+
+// Helper: Put a shared natural layout in place of phases 1-5
+// Only the geometry is installed; no levels are kept, so the next edit
+// of this chart falls back to a full layout.
+static bool install_layout_snapshot(const IRFlowchartLayoutSnapshot* snapshot, void* user_data) {
+    SnapshotInstall* install = (SnapshotInstall*)user_data;
+    FlowchartLayoutContext* ctx = install->ctx;
+    IRFlowchartState* state = ctx->state;
+    if (snapshot->node_count != state->node_count || snapshot->edge_count != state->edge_count ||
+        snapshot->subgraph_count != state->subgraph_count) {
+        return false;
     }
 
-    // Use layout parameters from state or defaults
-    float node_spacing = state->node_spacing > 0 ? state->node_spacing : FLOWCHART_NODE_SPACING;
-    float rank_spacing = state->rank_spacing > 0 ? state->rank_spacing : FLOWCHART_RANK_SPACING;
+    state->path_pool_count = 0;
+    if (append_edge_path(state, snapshot->path_count) == IR_FLOWCHART_INVALID_INDEX) return false;
+    if (snapshot->path_count > 0) {
+        memcpy(state->path_pool, snapshot->path_coords, snapshot->path_count * sizeof(float));
+    }
 
-    // Phase 1: Compute node sizes based on labels
-    // Use flowchart's font size if specified, otherwise default to 14
-    float font_size = (flowchart->style && flowchart->style->font.size > 0)
-                      ? flowchart->style->font.size : 14.0f;
-    compute_flowchart_node_sizes(state, font_size);
-
-    // Check if any subgraphs have different directions than parent
-    bool has_directional_subgraphs = false;
-    for (uint32_t i = 0; i < state->subgraph_count; i++) {
-        IRFlowchartSubgraphData* sg = state->subgraphs[i];
-        if (sg && sg->direction != state->direction) {
-            has_directional_subgraphs = true;
-            #ifdef KRYON_TRACE_LAYOUT
-            fprintf(stderr, "  📐 Subgraph '%s' has direction %s (parent: %s)\n",
-                    sg->subgraph_id ? sg->subgraph_id : "?",
-                    ir_flowchart_direction_to_string(sg->direction),
-                    ir_flowchart_direction_to_string(state->direction));
-            #endif
-            break;
-        }
+    uint32_t n = state->node_count;
+    memcpy(state->node_x, snapshot->node_boxes, n * sizeof(float));
+    memcpy(state->node_y, snapshot->node_boxes + n, n * sizeof(float));
+    memcpy(state->node_width, snapshot->node_boxes + n * 2, n * sizeof(float));
+    memcpy(state->node_height, snapshot->node_boxes + n * 3, n * sizeof(float));
+    for (uint32_t e = 0; e < state->edge_count; e++) {
+        IRFlowchartEdgeData* edge = state->edges[e];
+        if (!edge) continue;
+        uint32_t offset = snapshot->path_offsets[e];
+        ctx->path_offset[e] = offset;
+        edge->path_point_count = offset == IR_FLOWCHART_INVALID_INDEX ? 0 : snapshot->path_point_counts[e];
+        edge->path_points = offset == IR_FLOWCHART_INVALID_INDEX ? NULL : &state->path_pool[offset];
+    }
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        IRFlowchartSubgraphData* sg = state->subgraphs[s];
+        if (!sg) continue;
+        sg->x = snapshot->subgraph_boxes[s * 4];
+        sg->y = snapshot->subgraph_boxes[s * 4 + 1];
+        sg->width = snapshot->subgraph_boxes[s * 4 + 2];
+        sg->height = snapshot->subgraph_boxes[s * 4 + 3];
+        sg->layout_computed = false;
     }
 
-    #ifdef KRYON_TRACE_LAYOUT
-    if (has_directional_subgraphs) {
-        fprintf(stderr, "  🔀 Detected subgraphs with independent directions\n");
+    install->content_width = snapshot->content_width;
+    install->content_height = snapshot->content_height;
+    return true;
+}
+
+// Helper: Size node i from its measured label and shape
+static void size_flowchart_node(IRFlowchartState* state, uint32_t i, float label_width, float label_height,
+                                float font_size) {
+    const IRFlowchartNodeData* node = state->nodes[i];
+    if (!node->label || node->label[0] == '\0') {
+        label_width = 50.0f;
+        label_height = font_size * 1.2f;
+    }
+
+    // Add padding around text
+    float h_padding = 32.0f;  // 16px on each side
+    float v_padding = 20.0f;  // 10px on each side
+
+    // Extra padding for non-rectangular shapes (text area is smaller)
+    if (node->shape == IR_FLOWCHART_SHAPE_DIAMOND) {
+        h_padding *= 2.0f;  // Diamond needs ~2x because text area is diagonal
+        v_padding *= 2.0f;
+    } else if (node->shape == IR_FLOWCHART_SHAPE_CIRCLE ||
+               node->shape == IR_FLOWCHART_SHAPE_HEXAGON) {
+        h_padding *= 1.5f;
+        v_padding *= 1.5f;
     }
-    #endif
 
-    // Phase 2: Assign nodes to layers using longest-path algorithm
-    // This properly handles cycles by only considering forward edges
+    float width = fmaxf(FLOWCHART_NODE_MIN_WIDTH, label_width + h_padding);
+    float height = fmaxf(FLOWCHART_NODE_MIN_HEIGHT, label_height + v_padding);
 
-    // Create layer assignment (-1 = unassigned)
-    int* node_layer = calloc(state->node_count, sizeof(int));
-    bool* processed = calloc(state->node_count, sizeof(bool));
-    if (!node_layer || !processed) {
-        free(node_layer);
-        free(processed);
-        return;
+    // Make circles and diamonds square
+    if (node->shape == IR_FLOWCHART_SHAPE_CIRCLE ||
+        node->shape == IR_FLOWCHART_SHAPE_DIAMOND) {
+        width = height = fmaxf(width, height);
     }
 
-    // Initialize all layers to -1
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        node_layer[i] = -1;
+    state->node_width[i] = width;
+    state->node_height[i] = height;
+}
+
+// Helper: Size the given nodes (all nodes when nodes is NULL)
+// Labels are measured in one pass through the state's text cache, so
+// unchanged labels cost no font metric calls. A node whose size changed
+// invalidates the cached layout of its subgraphs when `invalidate` is set.
+static bool measure_flowchart_nodes(FlowchartLayoutContext* ctx, const uint32_t* nodes, uint32_t count,
+                                    float font_size, bool invalidate) {
+    IRFlowchartState* state = ctx->state;
+    if (!nodes) count = state->node_count;
+    if (count == 0) return true;
+
+    // The list is always a copy owned here (dirty lists are short)
+    uint32_t* list = (uint32_t*)malloc(count * sizeof(uint32_t));
+    float* widths = (float*)malloc(count * sizeof(float));
+    if (!list || !widths) {
+        free(list);
+        free(widths);
+        return false;
+    }
+    if (nodes) {
+        memcpy(list, nodes, count * sizeof(uint32_t));
+    } else {
+        for (uint32_t i = 0; i < count; i++) list[i] = i;
     }
 
-    // Find nodes with no incoming edges (start nodes)
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        IRFlowchartNodeData* node = state->nodes[i];
-        if (!node || !node->node_id) continue;
+    float label_height = 0;
+    ir_flowchart_measure_labels(state, list, count, font_size, NULL, widths, &label_height);
 
-        bool has_incoming = false;
-        for (uint32_t e = 0; e < state->edge_count; e++) {
-            IRFlowchartEdgeData* edge = state->edges[e];
-            if (edge && edge->to_id && strcmp(edge->to_id, node->node_id) == 0) {
-                has_incoming = true;
-                break;
-            }
-        }
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t i = list[k];
+        if (i >= state->node_count || !state->nodes[i]) continue;
+
+        float old_width = state->node_width[i];
+        float old_height = state->node_height[i];
+        size_flowchart_node(state, i, widths[k], label_height, font_size);
 
-        if (!has_incoming) {
-            node_layer[i] = 0;
-            processed[i] = true;
+        if (invalidate && (state->node_width[i] != old_width || state->node_height[i] != old_height)) {
+            invalidate_subgraph_layout(ctx, ctx->node_group[i]);
         }
     }
 
-    // If no start nodes found, pick the first node
-    bool any_assigned = false;
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        if (node_layer[i] >= 0) {
-            any_assigned = true;
-            break;
-        }
+    free(widths);
+    free(list);
+    return true;
+}
+
+// Helper: Item of the current level that holds node n (the node or an enclosing child block)
+static uint32_t level_item(const FlowchartLayoutContext* ctx, uint32_t group, uint32_t n) {
+    uint32_t g = ctx->node_group[n];
+    if (g == group) return ctx->item_of[n];
+    while (ctx->group_parent[g] != group) g = ctx->group_parent[g];
+    return ctx->item_of[ctx->state->node_count + g];
+}
+
+static uint32_t union_find_root(uint32_t* parent, uint32_t x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
     }
-    if (!any_assigned && state->node_count > 0) {
-        node_layer[0] = 0;
-        processed[0] = true;
-    }
-
-    // Iterate until all nodes are assigned
-    // Each node's layer = 1 + max(layer of predecessors that are already assigned)
-    int max_iterations = state->node_count * 2;  // Prevent infinite loops
-    for (int iter = 0; iter < max_iterations; iter++) {
-        bool made_progress = false;
-
-        for (uint32_t i = 0; i < state->node_count; i++) {
-            if (processed[i]) continue;
-
-            IRFlowchartNodeData* node = state->nodes[i];
-            if (!node || !node->node_id) continue;
-
-            // Find max layer of all predecessors that have been assigned
-            int max_pred_layer = -1;
-            bool has_assigned_pred = false;
-
-            for (uint32_t e = 0; e < state->edge_count; e++) {
-                IRFlowchartEdgeData* edge = state->edges[e];
-                if (!edge || !edge->to_id || strcmp(edge->to_id, node->node_id) != 0) continue;
-
-                // Find the source node
-                for (uint32_t j = 0; j < state->node_count; j++) {
-                    if (state->nodes[j] && state->nodes[j]->node_id &&
-                        edge->from_id && strcmp(state->nodes[j]->node_id, edge->from_id) == 0) {
-                        if (node_layer[j] >= 0) {
-                            has_assigned_pred = true;
-                            if (node_layer[j] > max_pred_layer) {
-                                max_pred_layer = node_layer[j];
-                            }
-                        }
-                        break;
-                    }
-                }
-            }
+    return x;
+}
 
-            // If we have at least one assigned predecessor, assign this node
-            if (has_assigned_pred) {
-                node_layer[i] = max_pred_layer + 1;
-                processed[i] = true;
-                made_progress = true;
-            }
-        }
+// Helper: Collect the items of one subgraph (or the top level) and split them into components
+// Items are the direct member nodes plus nested subgraphs as single blocks,
+// whose sizes come from their already finished layouts.
+static bool prepare_subgraph_level(FlowchartLayoutContext* ctx, uint32_t group,
+                                   IRFlowchartDirection direction, FlowchartLevel* level) {
+    IRFlowchartState* state = ctx->state;
+    memset(level, 0, sizeof(FlowchartLevel));
+    level->group = group;
+    level->horizontal = (direction == IR_FLOWCHART_DIR_LR || direction == IR_FLOWCHART_DIR_RL);
+    level->reversed = (direction == IR_FLOWCHART_DIR_BT || direction == IR_FLOWCHART_DIR_RL);
+    level->node_spacing = ctx->node_spacing;
+    level->rank_spacing = ctx->rank_spacing;
+    level->crossing_iterations = state->crossing_iterations;
+    level->crossing_time_budget_ms = state->crossing_time_budget_ms;
+
+    uint32_t member_begin = ctx->member_offsets[group];
+    uint32_t member_end = ctx->member_offsets[group + 1];
+    uint32_t child_begin = ctx->child_offsets[group];
+    uint32_t child_end = ctx->child_offsets[group + 1];
+    uint32_t edge_begin = ctx->edge_offsets[group];
+    uint32_t edge_end = ctx->edge_offsets[group + 1];
+    uint32_t capacity = (member_end - member_begin) + (child_end - child_begin) + 1;
+    uint32_t routed = edge_end - edge_begin;
+
+    level->item_ref = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    level->item_width = (float*)malloc(capacity * sizeof(float));
+    level->item_height = (float*)malloc(capacity * sizeof(float));
+    level->item_x = (float*)malloc(capacity * sizeof(float));
+    level->item_y = (float*)malloc(capacity * sizeof(float));
+    level->component_items = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    level->edge_state = (uint32_t*)malloc((routed + 1) * sizeof(uint32_t));
+    level->edge_from = (uint32_t*)malloc((routed + 1) * sizeof(uint32_t));
+    level->edge_to = (uint32_t*)malloc((routed + 1) * sizeof(uint32_t));
+    uint32_t* uf_parent = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    uint32_t* component_of = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    uint32_t* local_index = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    uint32_t* edge_items = (uint32_t*)malloc((routed * 2 + 1) * sizeof(uint32_t));
+    uint32_t* fill = (uint32_t*)calloc(capacity + 1, sizeof(uint32_t));
+    bool ok = level->item_ref && level->item_width && level->item_height && level->item_x &&
+              level->item_y && level->component_items && level->edge_state && level->edge_from &&
+              level->edge_to && uf_parent && component_of && local_index && edge_items && fill;
+
+    // Items of this level: direct member nodes, then non-empty nested subgraphs
+    uint32_t n = 0;
+    for (uint32_t k = member_begin; ok && k < member_end; k++) {
+        uint32_t node_index = ctx->member_items[k];
+        if (!state->nodes[node_index]) continue;
+        ctx->item_of[node_index] = n;
+        level->item_ref[n] = node_index;
+        level->item_width[n] = state->node_width[node_index];
+        level->item_height[n] = state->node_height[node_index];
+        n++;
+    }
+    for (uint32_t k = child_begin; ok && k < child_end; k++) {
+        uint32_t c = ctx->child_items[k];
+        IRFlowchartSubgraphData* sg = state->subgraphs[c];
+        if (!sg || ctx->group_node_total[c] == 0) continue;
+        ctx->item_of[state->node_count + c] = n;
+        level->item_ref[n] = state->node_count + c;
+        // Nested subgraph block: content plus padding and title bar
+        level->item_width[n] = sg->local_width + FLOWCHART_SUBGRAPH_PADDING * 2;
+        level->item_height[n] = sg->local_height + FLOWCHART_SUBGRAPH_PADDING * 2 + FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
+        n++;
+    }
+    level->item_count = n;
+
+    // Union the items joined by edges routed here
+    for (uint32_t i = 0; ok && i < n; i++) uf_parent[i] = i;
+    for (uint32_t k = 0; ok && k < routed; k++) {
+        IRFlowchartEdgeData* edge = state->edges[ctx->edge_items[edge_begin + k]];
+        uint32_t a = level_item(ctx, group, edge->from_index);
+        uint32_t b = level_item(ctx, group, edge->to_index);
+        edge_items[k * 2] = a;
+        edge_items[k * 2 + 1] = b;
+        uint32_t ra = union_find_root(uf_parent, a);
+        uint32_t rb = union_find_root(uf_parent, b);
+        if (ra != rb) uf_parent[ra > rb ? ra : rb] = ra < rb ? ra : rb;
+    }
 
-        // If no progress and still have unassigned nodes, pick one
-        if (!made_progress) {
-            for (uint32_t i = 0; i < state->node_count; i++) {
-                if (!processed[i]) {
-                    node_layer[i] = 0;  // Assign to layer 0
-                    processed[i] = true;
-                    made_progress = true;
-                    break;
-                }
-            }
+    // Components are numbered in order of their first item, which keeps packing deterministic
+    uint32_t components = 0;
+    for (uint32_t i = 0; ok && i < n; i++) {
+        uint32_t root = union_find_root(uf_parent, i);
+        component_of[i] = root == i ? components++ : component_of[root];
+    }
+
+    if (ok && components > 0) {
+        level->components = (FlowchartComponent*)calloc(components, sizeof(FlowchartComponent));
+        ok = level->components != NULL;
+    }
+
+    if (ok && components > 0) {
+        level->component_count = components;
+
+        // Group items by component (counting sort)
+        for (uint32_t i = 0; i < n; i++) level->components[component_of[i]].item_count++;
+        uint32_t cursor = 0;
+        for (uint32_t c = 0; c < components; c++) {
+            level->components[c].level = level;
+            level->components[c].item_begin = cursor;
+            fill[c] = cursor;
+            cursor += level->components[c].item_count;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            FlowchartComponent* comp = &level->components[component_of[i]];
+            local_index[i] = fill[component_of[i]] - comp->item_begin;
+            level->component_items[fill[component_of[i]]++] = i;
         }
 
-        // Check if all nodes are assigned
-        bool all_done = true;
-        for (uint32_t i = 0; i < state->node_count; i++) {
-            if (!processed[i]) {
-                all_done = false;
-                break;
-            }
+        // Group edges the same way, with component-local endpoints
+        for (uint32_t k = 0; k < routed; k++) level->components[component_of[edge_items[k * 2]]].edge_count++;
+        cursor = 0;
+        for (uint32_t c = 0; c < components; c++) {
+            level->components[c].edge_begin = cursor;
+            fill[c] = cursor;
+            cursor += level->components[c].edge_count;
+        }
+        for (uint32_t k = 0; k < routed; k++) {
+            uint32_t slot = fill[component_of[edge_items[k * 2]]]++;
+            level->edge_state[slot] = ctx->edge_items[edge_begin + k];
+            level->edge_from[slot] = local_index[edge_items[k * 2]];
+            level->edge_to[slot] = local_index[edge_items[k * 2 + 1]];
         }
-        if (all_done) break;
+        level->edge_count = routed;
     }
 
-    // Find max layer
-    int max_layer = 0;
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        if (node_layer[i] > max_layer) {
-            max_layer = node_layer[i];
+    free(uf_parent);
+    free(component_of);
+    free(local_index);
+    free(edge_items);
+    free(fill);
+    if (!ok) level_destroy(level);
+    return ok;
+}
+
+// Helper: Build the component's graph and assign layers (Phase 2)
+static bool build_component_graph(const FlowchartComponent* comp, IRFlowchartGraph* graph) {
+    const FlowchartLevel* level = comp->level;
+    uint32_t m = comp->edge_count;
+
+    // Edges are referenced by their component-local index so the chain table stays component-sized
+    uint32_t* edge_ref = (uint32_t*)malloc((m + 1) * sizeof(uint32_t));
+    if (!edge_ref) return false;
+    for (uint32_t k = 0; k < m; k++) edge_ref[k] = k;
+
+    // Adjacency lists are built once, then Kahn's algorithm ranks every item
+    // in O(N + E). Cycles are broken at the first item that stalls.
+    bool ok = ir_flowchart_graph_build_edges(graph, comp->item_count, m,
+                                             &level->edge_from[comp->edge_begin],
+                                             &level->edge_to[comp->edge_begin], edge_ref);
+    free(edge_ref);
+    if (!ok) return false;
+
+    if (!ir_flowchart_graph_assign_layers(graph)) {
+        ir_flowchart_graph_destroy(graph);
+        return false;
+    }
+    return true;
+}
+
+// Helper: Layer the component's items and order the layers (Phases 2-2b)
+static bool order_component(FlowchartComponent* comp) {
+    const FlowchartLevel* level = comp->level;
+    ir_flowchart_graph_destroy(&comp->graph);
+
+    // Phase 2: Assign items to layers using longest-path algorithm
+    if (!build_component_graph(comp, &comp->graph)) return false;
+
+    // Split edges spanning several layers with virtual nodes so they are
+    // ordered and positioned like regular nodes instead of cutting through them
+    // Phase 2b: Reduce edge crossings by reordering items within layers
+    return ir_flowchart_graph_insert_virtual_nodes(&comp->graph, comp->edge_count) &&
+           ir_flowchart_graph_order_layers(&comp->graph, level->crossing_iterations,
+                                           level->crossing_time_budget_ms);
+}
+
+// Helper: Position the items of an ordered component and route its edges (Phases 3-5)
+static bool place_component(FlowchartComponent* comp) {
+    FlowchartLevel* level = comp->level;
+    const IRFlowchartGraph* graph = &comp->graph;
+    bool horizontal = level->horizontal;
+    uint32_t m = comp->edge_count;
+    bool ok;
+
+    free(comp->bends);
+    free(comp->bend_offsets);
+    comp->bends = NULL;
+    comp->bend_offsets = NULL;
+
+    int* node_layer = graph->layer;
+    int max_layer = (int)graph->layer_count - 1;
+    const uint32_t* items = &level->component_items[comp->item_begin];
+
+    // Phase 3: Measure layers
+    // Every item keeps its own size; each layer is as deep as its deepest item
+    float* breadth = calloc(graph->node_count + 1, sizeof(float));    // Extent across the layer
+    float* center = malloc((graph->node_count + 1) * sizeof(float));  // Center across the layer
+    float* layer_depth = calloc(max_layer + 1, sizeof(float));
+    float* layer_start = malloc((max_layer + 1) * sizeof(float));
+    comp->bend_offsets = (uint32_t*)malloc((m + 1) * sizeof(uint32_t));
+    ok = breadth && center && layer_depth && layer_start && comp->bend_offsets;
+
+    if (ok) {
+        for (uint32_t i = 0; i < comp->item_count; i++) {
+            float w = level->item_width[items[i]];
+            float h = level->item_height[items[i]];
+            breadth[i] = horizontal ? h : w;
+            layer_depth[node_layer[i]] = fmaxf(layer_depth[node_layer[i]], horizontal ? w : h);
         }
+
+        // Stack layers along the primary axis (last layer first when reversed)
+        float layer_cursor = 0;
+        for (int step = 0; step <= max_layer; step++) {
+            int l = level->reversed ? (max_layer - step) : step;
+            layer_start[l] = layer_cursor;
+            layer_cursor += layer_depth[l] + level->rank_spacing;
+        }
+
+        // Phase 4: Position items
+        // Compact assignment across layers: items are pulled towards their
+        // neighbours with only node_spacing between actual extents
+        ok = ir_flowchart_graph_assign_coordinates(graph, breadth, level->node_spacing, center);
     }
 
-    // Phase 3: Count nodes per layer and find max
-    int* nodes_per_layer = calloc(max_layer + 1, sizeof(int));
-    if (!nodes_per_layer) {
-        free(node_layer);
-        free(processed);
-        return;
+    float total_primary_size = 0;
+    float total_secondary_size = 0;
+
+    for (uint32_t i = 0; ok && i < comp->item_count; i++) {
+        int layer = node_layer[i];
+        uint32_t item = items[i];
+        float w = level->item_width[item];
+        float h = level->item_height[item];
+
+        // Centered in its layer band, at the assigned cross-layer center
+        float depth = horizontal ? w : h;
+        float primary_coord = layer_start[layer] + (layer_depth[layer] - depth) / 2.0f;
+        if (horizontal) {
+            level->item_x[item] = primary_coord;
+            level->item_y[item] = center[i] - h / 2.0f;
+        } else {
+            level->item_x[item] = center[i] - w / 2.0f;
+            level->item_y[item] = primary_coord;
+        }
+
+        // Track total size
+        total_primary_size = fmaxf(total_primary_size,
+            horizontal ? (level->item_x[item] + w) : (level->item_y[item] + h));
+        total_secondary_size = fmaxf(total_secondary_size,
+            horizontal ? (level->item_y[item] + h) : (level->item_x[item] + w));
     }
 
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        nodes_per_layer[node_layer[i]]++;
+    // Virtual nodes sit mid-band in their layer
+    for (uint32_t v = graph->real_node_count; ok && v < graph->node_count; v++) {
+        total_secondary_size = fmaxf(total_secondary_size, center[v]);
     }
 
-    int max_nodes_in_layer = 0;
-    for (int l = 0; l <= max_layer; l++) {
-        if (nodes_per_layer[l] > max_nodes_in_layer) {
-            max_nodes_in_layer = nodes_per_layer[l];
+    // Phase 5: Route edges through their virtual nodes
+    // Endpoints are filled in once nodes have absolute coordinates
+    if (ok) {
+        memcpy(comp->bend_offsets, graph->chain_offsets, (m + 1) * sizeof(uint32_t));
+        uint32_t bend_count = graph->chain_offsets[m];
+        comp->bends = (float*)malloc((bend_count * 2 + 1) * sizeof(float));
+        ok = comp->bends != NULL;
+
+        for (uint32_t b = 0; ok && b < bend_count; b++) {
+            uint32_t v = graph->chain_nodes[b];
+            float primary = layer_start[node_layer[v]] + layer_depth[node_layer[v]] / 2.0f;
+            comp->bends[b * 2] = horizontal ? primary : center[v];
+            comp->bends[b * 2 + 1] = horizontal ? center[v] : primary;
         }
     }
 
-    // Phase 4: Position nodes
-    // Track position within each layer
-    int* layer_position = calloc(max_layer + 1, sizeof(int));
-    if (!layer_position) {
-        free(node_layer);
-        free(processed);
-        free(nodes_per_layer);
-        return;
+    comp->width = horizontal ? total_primary_size : total_secondary_size;
+    comp->height = horizontal ? total_secondary_size : total_primary_size;
+
+    // Cleanup
+    free(breadth);
+    free(center);
+    free(layer_depth);
+    free(layer_start);
+    return ok;
+}
+
+// Phases 2-5 for one component, as far as its work requires; runs on a worker thread
+static void layout_component(void* user_data, uint32_t index) {
+    FlowchartComponent* comp = ((FlowchartComponent**)user_data)[index];
+    bool ok = true;
+
+    if (comp->work == COMPONENT_LAYOUT_FULL) {
+        ok = order_component(comp);
+    } else if (comp->work == COMPONENT_LAYOUT_REORDER) {
+        ok = ir_flowchart_graph_reorder_layers(&comp->graph, comp->previous_position,
+                                               comp->sweep_layers, FLOWCHART_LOCAL_SWEEPS);
+        free(comp->sweep_layers);
+        comp->sweep_layers = NULL;
+        comp->previous_position = NULL;
     }
+    comp->ok = ok && place_component(comp);
+}
 
-    // Find max node dimensions for spacing
-    float max_node_width = FLOWCHART_NODE_MIN_WIDTH;
-    float max_node_height = FLOWCHART_NODE_MIN_HEIGHT;
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        if (state->nodes[i]) {
-            max_node_width = fmaxf(max_node_width, state->nodes[i]->width);
-            max_node_height = fmaxf(max_node_height, state->nodes[i]->height);
+static int compare_pack_keys(const void* a, const void* b) {
+    uint64_t ka = *(const uint64_t*)a;
+    uint64_t kb = *(const uint64_t*)b;
+    return (ka > kb) - (ka < kb);
+}
+
+// Helper: Pack the components of a level with a deterministic shelf packer
+// Components are placed side by side across the layer direction, deepest
+// first, and a new shelf starts once a shelf is wider than sqrt(total area)
+// (or the widest component), which keeps many small clusters near square.
+// Returns false on allocation failure.
+static bool pack_components(FlowchartLevel* level, float* out_width, float* out_height) {
+    uint32_t count = level->component_count;
+    *out_width = 0;
+    *out_height = 0;
+    if (count == 0) return true;
+    if (count == 1) {
+        level->components[0].offset_x = 0;
+        level->components[0].offset_y = 0;
+        *out_width = level->components[0].width;
+        *out_height = level->components[0].height;
+        return true;
+    }
+
+    bool horizontal = level->horizontal;
+    float across_gap = level->node_spacing;
+    float along_gap = level->rank_spacing;
+
+    // Sort by depth along the layers, deepest first; ties keep component order.
+    // Non-negative float bits order like integers, so the key packs into a u64.
+    uint64_t* keys = (uint64_t*)malloc(count * sizeof(uint64_t));
+    if (!keys) return false;
+
+    float total_area = 0;
+    float widest = 0;
+    for (uint32_t c = 0; c < count; c++) {
+        FlowchartComponent* comp = &level->components[c];
+        float along = horizontal ? comp->width : comp->height;
+        if (!(along > 0)) along = 0;
+        float across = horizontal ? comp->height : comp->width;
+        total_area += (along + along_gap) * (across + across_gap);
+        widest = fmaxf(widest, across);
+
+        uint32_t bits;
+        memcpy(&bits, &along, sizeof(bits));
+        keys[c] = ((uint64_t)(~bits) << 32) | c;
+    }
+    qsort(keys, count, sizeof(uint64_t), compare_pack_keys);
+
+    float shelf_limit = fmaxf(widest, sqrtf(total_area));
+    float shelf_start = 0;      // Along the layers
+    float shelf_depth = 0;
+    float cursor = 0;           // Across the layers
+    float extent_across = 0;
+    uint32_t shelf_first = 0;
+
+    for (uint32_t k = 0; k <= count; k++) {
+        FlowchartComponent* comp = k < count ? &level->components[keys[k] & 0xFFFFFFFFu] : NULL;
+        float along = comp ? (horizontal ? comp->width : comp->height) : 0;
+        float across = comp ? (horizontal ? comp->height : comp->width) : 0;
+
+        // Close the shelf; in reversed directions components hug the far edge
+        if (!comp || (k > shelf_first && cursor + across > shelf_limit)) {
+            for (uint32_t j = shelf_first; j < k; j++) {
+                FlowchartComponent* placed = &level->components[keys[j] & 0xFFFFFFFFu];
+                float placed_along = horizontal ? placed->width : placed->height;
+                float along_pos = shelf_start + (level->reversed ? shelf_depth - placed_along : 0);
+                if (horizontal) placed->offset_x = along_pos;
+                else placed->offset_y = along_pos;
+            }
+            if (!comp) break;
+            shelf_start += shelf_depth + along_gap;
+            shelf_depth = 0;
+            cursor = 0;
+            shelf_first = k;
         }
+
+        if (horizontal) comp->offset_y = cursor;
+        else comp->offset_x = cursor;
+        cursor += across + across_gap;
+        extent_across = fmaxf(extent_across, cursor - across_gap);
+        shelf_depth = fmaxf(shelf_depth, along);
     }
 
-    // Assign positions based on direction
-    bool horizontal = (state->direction == IR_FLOWCHART_DIR_LR ||
-                       state->direction == IR_FLOWCHART_DIR_RL);
-    bool reversed = (state->direction == IR_FLOWCHART_DIR_BT ||
-                     state->direction == IR_FLOWCHART_DIR_RL);
+    float extent_along = shelf_start + shelf_depth;
+    *out_width = horizontal ? extent_along : extent_across;
+    *out_height = horizontal ? extent_across : extent_along;
 
-    float total_primary_size = 0;
-    float total_secondary_size = 0;
+    free(keys);
+    return true;
+}
 
-    for (uint32_t i = 0; i < state->node_count; i++) {
-        IRFlowchartNodeData* node = state->nodes[i];
-        if (!node) continue;
+// Helper: Write a packed level back into nodes, subgraph boxes and the path pool
+// Positions and edge bends are left in the level's local coordinates.
+static bool finish_subgraph_level(FlowchartLayoutContext* ctx, FlowchartLevel* level,
+                                  float* out_width, float* out_height) {
+    IRFlowchartState* state = ctx->state;
+    if (!pack_components(level, out_width, out_height)) return false;
 
-        int layer = node_layer[i];
+    for (uint32_t c = 0; c < level->component_count; c++) {
+        FlowchartComponent* comp = &level->components[c];
+
+        for (uint32_t i = comp->item_begin; i < comp->item_begin + comp->item_count; i++) {
+            uint32_t item = level->component_items[i];
+            float x = level->item_x[item] + comp->offset_x;
+            float y = level->item_y[item] + comp->offset_y;
+            uint32_t ref = level->item_ref[item];
 
-        // For nodes in subgraphs with different directions, track position separately
-        bool node_in_directional_subgraph = false;
-        if (has_directional_subgraphs && node->subgraph_id) {
-            for (uint32_t sg_idx = 0; sg_idx < state->subgraph_count; sg_idx++) {
-                IRFlowchartSubgraphData* sg = state->subgraphs[sg_idx];
-                if (sg && sg->subgraph_id && strcmp(node->subgraph_id, sg->subgraph_id) == 0) {
-                    if (sg->direction != state->direction) {
-                        node_in_directional_subgraph = true;
-                        break;
-                    }
-                }
+            if (ref < state->node_count) {
+                state->node_x[ref] = x;
+                state->node_y[ref] = y;
+
+                #ifdef KRYON_TRACE_LAYOUT
+                fprintf(stderr, "  Node '%s' C%u: (%.1f, %.1f) %.1fx%.1f\n",
+                        state->nodes[ref]->node_id ? state->nodes[ref]->node_id : "?", c,
+                        x, y, state->node_width[ref], state->node_height[ref]);
+                #endif
+            } else {
+                // The block's box lives in this level; its content origin is
+                // applied to the nested nodes by transform_subgraph_coordinates
+                uint32_t s = ref - state->node_count;
+                IRFlowchartSubgraphData* sg = state->subgraphs[s];
+                sg->x = x;
+                sg->y = y;
+                sg->width = level->item_width[item];
+                sg->height = level->item_height[item];
+                ctx->origin_x[s] = x + FLOWCHART_SUBGRAPH_PADDING;
+                ctx->origin_y[s] = y + FLOWCHART_SUBGRAPH_PADDING + FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
             }
         }
 
-        int pos;
-        if (node_in_directional_subgraph) {
-            // For directional subgraphs, calculate position within subgraph context
-            pos = 0;  // Count nodes in same (layer, subgraph) before this one
-            for (uint32_t j = 0; j < i; j++) {
-                if (node_layer[j] == layer) {
-                    IRFlowchartNodeData* other = state->nodes[j];
-                    if (other && other->subgraph_id && node->subgraph_id &&
-                        strcmp(other->subgraph_id, node->subgraph_id) == 0) {
-                        pos++;
-                    }
-                }
-            }
-        } else {
-            // Global position for top-level nodes
-            pos = layer_position[layer]++;
-        }
-
-        // Calculate center position within layer
-        // Count only nodes in the same subgraph (or top-level) for proper centering
-        int nodes_in_this_layer = 0;
-        for (uint32_t j = 0; j < state->node_count; j++) {
-            if (node_layer[j] == layer) {
-                IRFlowchartNodeData* other = state->nodes[j];
-                if (!other) continue;
-
-                // Check if both nodes are in the same subgraph
-                bool same_subgraph = false;
-                if (node->subgraph_id == NULL && other->subgraph_id == NULL) {
-                    same_subgraph = true;  // Both top-level
-                } else if (node->subgraph_id && other->subgraph_id &&
-                           strcmp(node->subgraph_id, other->subgraph_id) == 0) {
-                    same_subgraph = true;  // Both in same subgraph
-                }
-
-                if (same_subgraph) {
-                    nodes_in_this_layer++;
-                }
+        for (uint32_t k = 0; k < comp->edge_count; k++) {
+            uint32_t e = level->edge_state[comp->edge_begin + k];
+            uint32_t bend_begin = comp->bend_offsets[k];
+            uint32_t bend_end = comp->bend_offsets[k + 1];
+            uint32_t count = 2 + (bend_end - bend_begin);
+
+            uint32_t offset = append_edge_path(state, count * 2);
+            if (offset == IR_FLOWCHART_INVALID_INDEX) return false;
+
+            float* points = &state->path_pool[offset];
+            points[0] = points[1] = 0;
+            for (uint32_t b = bend_begin; b < bend_end; b++) {
+                float* bend = &points[(1 + b - bend_begin) * 2];
+                bend[0] = comp->bends[b * 2] + comp->offset_x;
+                bend[1] = comp->bends[b * 2 + 1] + comp->offset_y;
             }
-        }
+            points[(count - 1) * 2] = points[(count - 1) * 2 + 1] = 0;
 
-        #ifdef KRYON_TRACE_LAYOUT
-        if (has_directional_subgraphs && node->subgraph_id) {
-            fprintf(stderr, "    [DEBUG] Node '%s' L%d P%d: nodes_in_this_layer=%d (subgraph: %s)\n",
-                    node->node_id ? node->node_id : "?", layer, pos,
-                    nodes_in_this_layer, node->subgraph_id);
+            ctx->path_offset[e] = offset;
+            state->edges[e]->path_point_count = count;
         }
-        #endif
+    }
+
+    #ifdef KRYON_TRACE_LAYOUT
+    fprintf(stderr, "  ✂️  Level %s: %u items in %u components, %.1fx%.1f\n",
+            level->group == ctx->root ? "<top>" :
+            (state->subgraphs[level->group]->subgraph_id ? state->subgraphs[level->group]->subgraph_id : "?"),
+            level->item_count, level->component_count, *out_width, *out_height);
+    #endif
+    return true;
+}
+
+// Helper: Take over a level laid out in an earlier pass
+static void adopt_level(FlowchartLevel* level, FlowchartLevel* previous) {
+    *level = *previous;
+    memset(previous, 0, sizeof(FlowchartLevel));
+    for (uint32_t c = 0; c < level->component_count; c++) level->components[c].level = level;
+}
+
+// Helper: Update the nested subgraph blocks of a level to their children's new sizes
+static void refresh_block_sizes(const FlowchartLayoutContext* ctx, FlowchartLevel* level) {
+    const IRFlowchartState* state = ctx->state;
+    for (uint32_t i = 0; i < level->item_count; i++) {
+        uint32_t ref = level->item_ref[i];
+        if (ref < state->node_count) continue;
+        const IRFlowchartSubgraphData* sg = state->subgraphs[ref - state->node_count];
+        level->item_width[i] = sg->local_width + FLOWCHART_SUBGRAPH_PADDING * 2;
+        level->item_height[i] = sg->local_height + FLOWCHART_SUBGRAPH_PADDING * 2 + FLOWCHART_SUBGRAPH_TITLE_HEIGHT;
+    }
+}
 
-        // Check if node belongs to a subgraph with different direction
-        IRFlowchartDirection node_direction = state->direction;
-        bool node_horizontal = horizontal;
-        bool node_reversed = reversed;
-
-        if (has_directional_subgraphs && node->subgraph_id) {
-            for (uint32_t sg_idx = 0; sg_idx < state->subgraph_count; sg_idx++) {
-                IRFlowchartSubgraphData* sg = state->subgraphs[sg_idx];
-                if (sg && sg->subgraph_id && strcmp(node->subgraph_id, sg->subgraph_id) == 0) {
-                    if (sg->direction != state->direction) {  // Use subgraph's direction if different from parent
-                        node_direction = sg->direction;
-                        node_horizontal = (node_direction == IR_FLOWCHART_DIR_LR ||
-                                          node_direction == IR_FLOWCHART_DIR_RL);
-                        node_reversed = (node_direction == IR_FLOWCHART_DIR_BT ||
-                                        node_direction == IR_FLOWCHART_DIR_RL);
-                        #ifdef KRYON_TRACE_LAYOUT
-                        fprintf(stderr, "    → Node '%s' in subgraph '%s' using direction: %s\n",
-                                node->node_id ? node->node_id : "?", sg->subgraph_id,
-                                ir_flowchart_direction_to_string(node_direction));
-                        #endif
-                    }
-                    break;
-                }
+// Helper: Carry the previous layout of unchanged components over to a matched level
+// Components whose items kept their sizes keep their geometry; resized
+// ones keep their ordering and are placed again.
+static void reuse_previous_layout(FlowchartLevel* level, FlowchartLevel* previous) {
+    for (uint32_t c = 0; c < level->component_count; c++) {
+        FlowchartComponent* comp = &level->components[c];
+        FlowchartComponent* old = &previous->components[c];
+        if (comp->work != COMPONENT_LAYOUT_KEEP) continue;
+
+        comp->graph = old->graph;
+        memset(&old->graph, 0, sizeof(IRFlowchartGraph));
+
+        const uint32_t* items = &level->component_items[comp->item_begin];
+        for (uint32_t i = 0; i < comp->item_count; i++) {
+            if (level->item_width[items[i]] != previous->item_width[items[i]] ||
+                level->item_height[items[i]] != previous->item_height[items[i]]) {
+                comp->work = COMPONENT_LAYOUT_PLACE;
+                break;
             }
         }
+        if (comp->work != COMPONENT_LAYOUT_KEEP) continue;
 
-        // Calculate centering offset for nodes within this layer
-        float layer_start;
-        if (node_horizontal) {
-            // LR/RL: nodes in layer arranged vertically (use height for spacing)
-            layer_start = (max_nodes_in_layer - nodes_in_this_layer) * (max_node_height + node_spacing) / 2.0f;
-        } else {
-            // TB/BT: nodes in layer arranged horizontally (use width for spacing)
-            layer_start = (max_nodes_in_layer - nodes_in_this_layer) * (max_node_width + node_spacing) / 2.0f;
+        for (uint32_t i = 0; i < comp->item_count; i++) {
+            level->item_x[items[i]] = previous->item_x[items[i]];
+            level->item_y[items[i]] = previous->item_y[items[i]];
         }
+        comp->bends = old->bends;
+        comp->bend_offsets = old->bend_offsets;
+        old->bends = NULL;
+        old->bend_offsets = NULL;
+        comp->width = old->width;
+        comp->height = old->height;
+    }
+}
 
-        float primary_coord, secondary_coord;
+// Helper: Layout nodes of every subgraph and of the top level
+// Subgraphs are processed in waves of equal depth, innermost first: all
+// components of all subgraphs in one wave are independent, so they are laid
+// out together on worker threads and then packed and written back in order.
+// With `previous`, every level has already been prepared and matched
+// against the previous pass (relayout_changes) and only components with
+// work left are laid out. Levels stay in ctx->levels.
+// Returns the computed size of the top level
+static bool layout_subgraph_nodes(FlowchartLayoutContext* ctx, FlowchartLevel* previous,
+                                  float* out_width, float* out_height) {
+    IRFlowchartState* state = ctx->state;
+    IRFlowchartLayoutCache* cache = state->layout_cache;
+    FlowchartLevel* levels = ctx->levels;
+    uint32_t groups = state->subgraph_count + 1;
+    *out_width = 0;
+    *out_height = 0;
+
+    // Subgraphs to lay out this pass; reused layouts and their contents are skipped
+    uint32_t max_depth = 0;
+    uint32_t* wave_keys = (uint32_t*)malloc(groups * sizeof(uint32_t));
+    FlowchartComponent** jobs = NULL;
+    bool ok = wave_keys != NULL;
+
+    for (uint32_t g = 0; ok && g < groups; g++) {
+        bool has_level = g == ctx->root || (state->subgraphs[g] && ctx->group_node_total[g] > 0);
+        bool needed = has_level && (previous || g == ctx->root ||
+                                    outermost_cached_group(ctx, g) == IR_FLOWCHART_INVALID_INDEX);
+
+        // Reused subgraphs keep their levels from the previous pass
+        if (has_level && !needed && cache && cache->ctx.levels) {
+            adopt_level(&levels[g], &cache->ctx.levels[g]);
+        }
 
-        if (node_horizontal) {
-            // LR/RL: layers are columns, positions are rows
-            primary_coord = layer * (max_node_width + rank_spacing);
-            secondary_coord = layer_start + pos * (max_node_height + node_spacing);
+        wave_keys[g] = needed ? ctx->group_depth[g] : IR_FLOWCHART_INVALID_INDEX;
+        if (needed && ctx->group_depth[g] > max_depth) max_depth = ctx->group_depth[g];
+    }
 
-            if (node_reversed) {
-                primary_coord = (max_layer - layer) * (max_node_width + rank_spacing);
+    uint32_t* offsets = NULL;
+    uint32_t* ordered = NULL;
+    if (ok) ok = build_group_lists(wave_keys, groups, max_depth + 1, &offsets, &ordered);
+
+    for (uint32_t depth = max_depth + 1; ok && depth-- > 0;) {
+        uint32_t begin = offsets[depth];
+        uint32_t end = offsets[depth + 1];
+
+        // Prepare every level of the wave; nested block sizes are final by now
+        uint32_t job_count = 0;
+        uint32_t item_total = 0;
+        for (uint32_t k = begin; ok && k < end; k++) {
+            uint32_t g = ordered[k];
+            if (previous) {
+                refresh_block_sizes(ctx, &levels[g]);
+                reuse_previous_layout(&levels[g], &previous[g]);
+            } else {
+                IRFlowchartDirection direction = g == ctx->root ? state->direction : state->subgraphs[g]->direction;
+                ok = prepare_subgraph_level(ctx, g, direction, &levels[g]);
             }
+            for (uint32_t c = 0; ok && c < levels[g].component_count; c++) {
+                if (levels[g].components[c].work == COMPONENT_LAYOUT_KEEP) continue;
+                job_count++;
+                item_total += levels[g].components[c].item_count;
+            }
+        }
+        if (!ok) break;
 
-            node->x = primary_coord + (max_node_width - node->width) / 2.0f;
-            node->y = secondary_coord + (max_node_height - node->height) / 2.0f;
-        } else {
-            // TB/BT: layers are rows, positions are columns
-            primary_coord = layer * (max_node_height + rank_spacing);
-            secondary_coord = layer_start + pos * (max_node_width + node_spacing);
-
-            if (node_reversed) {
-                primary_coord = (max_layer - layer) * (max_node_height + rank_spacing);
+        free(jobs);
+        jobs = (FlowchartComponent**)malloc((job_count + 1) * sizeof(FlowchartComponent*));
+        if (!jobs) {
+            ok = false;
+            break;
+        }
+        uint32_t j = 0;
+        for (uint32_t k = begin; k < end; k++) {
+            FlowchartLevel* level = &levels[ordered[k]];
+            for (uint32_t c = 0; c < level->component_count; c++) {
+                if (level->components[c].work != COMPONENT_LAYOUT_KEEP) jobs[j++] = &level->components[c];
             }
+        }
 
-            node->x = secondary_coord + (max_node_width - node->width) / 2.0f;
-            node->y = primary_coord + (max_node_height - node->height) / 2.0f;
+        // Only as many threads as the wave keeps busy past their startup cost
+        uint32_t threads = state->layout_threads == 0 ? ir_flowchart_parallel_default_threads()
+                                                      : state->layout_threads;
+        uint32_t worth = item_total / FLOWCHART_PARALLEL_MIN_ITEMS;
+        if (threads > worth) threads = worth > 0 ? worth : 1;
+        ir_flowchart_parallel_for(job_count, threads, layout_component, jobs);
+        for (uint32_t c = 0; c < job_count; c++) {
+            if (!jobs[c]->ok) ok = false;
         }
 
-        // Track total size
-        total_primary_size = fmaxf(total_primary_size,
-            horizontal ? (node->x + node->width) : (node->y + node->height));
-        total_secondary_size = fmaxf(total_secondary_size,
-            horizontal ? (node->y + node->height) : (node->x + node->width));
+        // Pack and write back in group order so the parallel layout is deterministic
+        for (uint32_t k = begin; ok && k < end; k++) {
+            uint32_t g = ordered[k];
+            if (g == ctx->root) {
+                ok = finish_subgraph_level(ctx, &levels[g], out_width, out_height);
+            } else {
+                IRFlowchartSubgraphData* sg = state->subgraphs[g];
+                ok = finish_subgraph_level(ctx, &levels[g], &sg->local_width, &sg->local_height);
+                sg->layout_computed = ok;
+            }
+        }
+    }
 
-        #ifdef KRYON_TRACE_LAYOUT
-        fprintf(stderr, "  Node '%s' L%d P%d: (%.1f, %.1f) %.1fx%.1f\n",
-                node->node_id ? node->node_id : "?", layer, pos,
-                node->x, node->y, node->width, node->height);
-        #endif
+    free(jobs);
+    free(offsets);
+    free(ordered);
+    free(wave_keys);
+    return ok;
+}
+
+// Helper: Rebuild the graph of a component whose edges changed
+// The previous ordering still applies when every item keeps its layer and
+// the edges spanning several layers (and so the virtual nodes) are the same;
+// the layers touched by added or removed edges are flagged for a re-sweep.
+// Returns false when the rank structure changed.
+static bool prepare_component_reorder(FlowchartComponent* comp, const FlowchartComponent* previous) {
+    const FlowchartLevel* level = comp->level;
+    const FlowchartLevel* previous_level = previous->level;
+    const IRFlowchartGraph* old_graph = &previous->graph;
+    IRFlowchartGraph* graph = &comp->graph;
+    const uint32_t* from = &level->edge_from[comp->edge_begin];
+    const uint32_t* to = &level->edge_to[comp->edge_begin];
+    const uint32_t* old_from = &previous_level->edge_from[previous->edge_begin];
+    const uint32_t* old_to = &previous_level->edge_to[previous->edge_begin];
+
+    if (!old_graph->layer || !old_graph->position) return false;
+    if (!build_component_graph(comp, graph)) return false;
+
+    int* layer = graph->layer;
+    for (uint32_t i = 0; i < comp->item_count; i++) {
+        if (layer[i] != old_graph->layer[i]) return false;
     }
 
-    // Phase 5: Route edges (simple straight-line for now)
-    for (uint32_t i = 0; i < state->edge_count; i++) {
-        IRFlowchartEdgeData* edge = state->edges[i];
-        if (!edge) continue;
+    // Long edges in the same order get the same virtual nodes
+    uint32_t k = 0;
+    uint32_t j = 0;
+    for (;;) {
+        while (k < comp->edge_count && abs(layer[to[k]] - layer[from[k]]) <= 1) k++;
+        while (j < previous->edge_count && abs(layer[old_to[j]] - layer[old_from[j]]) <= 1) j++;
+        if (k == comp->edge_count || j == previous->edge_count) {
+            if (k != comp->edge_count || j != previous->edge_count) return false;
+            break;
+        }
+        if (from[k] != old_from[j] || to[k] != old_to[j]) return false;
+        k++;
+        j++;
+    }
 
-        // Find source and target nodes
-        IRFlowchartNodeData* from_node = NULL;
-        IRFlowchartNodeData* to_node = NULL;
-
-        for (uint32_t j = 0; j < state->node_count; j++) {
-            if (state->nodes[j] && state->nodes[j]->node_id) {
-                if (edge->from_id && strcmp(state->nodes[j]->node_id, edge->from_id) == 0) {
-                    from_node = state->nodes[j];
-                }
-                if (edge->to_id && strcmp(state->nodes[j]->node_id, edge->to_id) == 0) {
-                    to_node = state->nodes[j];
-                }
-            }
+    if (!ir_flowchart_graph_insert_virtual_nodes(graph, comp->edge_count)) return false;
+    if (graph->node_count != old_graph->node_count) return false;
+    layer = graph->layer;              // Grown for the virtual nodes
+
+    // Layers touched by added or removed edges: merge the sorted edge lists
+    uint64_t* keys = (uint64_t*)malloc((comp->edge_count + 1) * sizeof(uint64_t));
+    uint64_t* old_keys = (uint64_t*)malloc((previous->edge_count + 1) * sizeof(uint64_t));
+    comp->sweep_layers = (bool*)calloc(graph->layer_count + 1, sizeof(bool));
+    if (!keys || !old_keys || !comp->sweep_layers) {
+        free(keys);
+        free(old_keys);
+        return false;
+    }
+    for (k = 0; k < comp->edge_count; k++) keys[k] = ((uint64_t)from[k] << 32) | to[k];
+    for (j = 0; j < previous->edge_count; j++) old_keys[j] = ((uint64_t)old_from[j] << 32) | old_to[j];
+    qsort(keys, comp->edge_count, sizeof(uint64_t), compare_pack_keys);
+    qsort(old_keys, previous->edge_count, sizeof(uint64_t), compare_pack_keys);
+
+    k = 0;
+    j = 0;
+    while (k < comp->edge_count || j < previous->edge_count) {
+        uint64_t changed;
+        if (j == previous->edge_count || (k < comp->edge_count && keys[k] < old_keys[j])) {
+            changed = keys[k++];
+        } else if (k == comp->edge_count || old_keys[j] < keys[k]) {
+            changed = old_keys[j++];
+        } else {
+            k++;
+            j++;
+            continue;
         }
+        comp->sweep_layers[layer[changed >> 32]] = true;
+        comp->sweep_layers[layer[changed & 0xFFFFFFFFu]] = true;
+    }
 
-        if (from_node && to_node) {
-            // Free existing path points
-            free(edge->path_points);
+    free(keys);
+    free(old_keys);
+    comp->previous_position = old_graph->position;
+    comp->work = COMPONENT_LAYOUT_REORDER;
+    return true;
+}
 
-            // Create simple 2-point path (straight line from center to center)
-            edge->path_point_count = 2;
-            edge->path_points = malloc(4 * sizeof(float));  // 2 points x 2 coords
-            if (edge->path_points) {
-                // From center
-                edge->path_points[0] = from_node->x + from_node->width / 2;
-                edge->path_points[1] = from_node->y + from_node->height / 2;
-                // To center
-                edge->path_points[2] = to_node->x + to_node->width / 2;
-                edge->path_points[3] = to_node->y + to_node->height / 2;
+// Helper: Match a freshly prepared level against its previous layout
+// Items, components and level parameters must be unchanged. Edge lists are
+// compared only in levels that route a recorded edge change.
+// Returns false when the rank structure changed.
+static bool match_level(FlowchartLevel* level, const FlowchartLevel* previous, bool edges_changed) {
+    if (!previous->item_ref || previous->item_count != level->item_count ||
+        previous->component_count != level->component_count ||
+        previous->horizontal != level->horizontal || previous->reversed != level->reversed ||
+        previous->node_spacing != level->node_spacing || previous->rank_spacing != level->rank_spacing) {
+        return false;
+    }
+    if (memcmp(previous->item_ref, level->item_ref, level->item_count * sizeof(uint32_t)) != 0 ||
+        memcmp(previous->component_items, level->component_items, level->item_count * sizeof(uint32_t)) != 0) {
+        return false;
+    }
 
-                #ifdef KRYON_TRACE_LAYOUT
-                fprintf(stderr, "  Edge '%s'->'%s': (%.1f,%.1f) -> (%.1f,%.1f)\n",
-                        edge->from_id ? edge->from_id : "?",
-                        edge->to_id ? edge->to_id : "?",
-                        edge->path_points[0], edge->path_points[1],
-                        edge->path_points[2], edge->path_points[3]);
-                #endif
-            }
+    for (uint32_t c = 0; c < level->component_count; c++) {
+        FlowchartComponent* comp = &level->components[c];
+        const FlowchartComponent* old = &previous->components[c];
+        if (comp->item_begin != old->item_begin || comp->item_count != old->item_count) return false;
+
+        comp->work = COMPONENT_LAYOUT_KEEP;
+        bool same_edges = comp->edge_count == old->edge_count;
+        if (same_edges && edges_changed) {
+            size_t bytes = comp->edge_count * sizeof(uint32_t);
+            same_edges = memcmp(&level->edge_from[comp->edge_begin], &previous->edge_from[old->edge_begin], bytes) == 0 &&
+                         memcmp(&level->edge_to[comp->edge_begin], &previous->edge_to[old->edge_begin], bytes) == 0;
         }
+        if (same_edges) continue;
+        if (!edges_changed || !prepare_component_reorder(comp, old)) return false;
     }
+    return true;
+}
 
-    // Cleanup
-    free(node_layer);
-    free(processed);
-    free(nodes_per_layer);
-    free(layer_position);
+// Helper: Apply the recorded label and edge changes to the previous layout
+// Only relabelled nodes are measured again. Every level is matched against
+// the previous pass: components whose edges changed are re-swept on the
+// touched layers, resized ones are placed again with their previous
+// ordering, and the rest keep their geometry. Every level is re-packed.
+// Returns false when the rank structure changed and a full layout is needed.
+static bool relayout_changes(FlowchartLayoutContext* ctx, float font_size, float* out_width, float* out_height) {
+    IRFlowchartState* state = ctx->state;
+    FlowchartLevel* previous = state->layout_cache->ctx.levels;
+    uint32_t groups = state->subgraph_count + 1;
+
+    // A full dirty list may have dropped entries, so then every node is measured
+    bool listed = state->dirty_node_count < state->node_count;
+    if (!measure_flowchart_nodes(ctx, listed ? state->dirty_nodes : NULL, state->dirty_node_count,
+                                 font_size, false)) {
+        return false;
+    }
+
+    // Levels that route an added or removed edge
+    bool* edges_changed = (bool*)calloc(groups, sizeof(bool));
+    if (!edges_changed) return false;
+    for (uint32_t k = 0; k + 1 < state->dirty_edge_end_count; k += 2) {
+        uint32_t from = state->dirty_edge_ends[k];
+        uint32_t to = state->dirty_edge_ends[k + 1];
+        if (from >= state->node_count || to >= state->node_count) continue;
+        if (!state->nodes[from] || !state->nodes[to]) continue;
+        edges_changed[lowest_common_group(ctx, from, to)] = true;
+    }
+
+    bool ok = true;
+    for (uint32_t g = 0; ok && g < groups; g++) {
+        if (g != ctx->root && (!state->subgraphs[g] || ctx->group_node_total[g] == 0)) continue;
+        IRFlowchartDirection direction = g == ctx->root ? state->direction : state->subgraphs[g]->direction;
+        ok = prepare_subgraph_level(ctx, g, direction, &ctx->levels[g]) &&
+             match_level(&ctx->levels[g], &previous[g], edges_changed[g]);
+    }
+    free(edges_changed);
+    if (!ok) return false;
+
+    // From here on the previous levels are taken apart
+    state->path_pool_count = 0;
+    return layout_subgraph_nodes(ctx, previous, out_width, out_height);
+}
+
+// Helper: Forget the recorded changes once a layout has absorbed them
+static void clear_dirty_sets(IRFlowchartState* state) {
+    state->dirty_flags = 0;
+    state->dirty_node_count = 0;
+    state->dirty_edge_end_count = 0;
+}
+
+// Helper: Fit the cached natural layout into the available space
+// Runs in O(N + path points); called after every full layout and on resize
+static void fit_flowchart_layout(IRFlowchartState* state, float available_width, float available_height) {
+    IRFlowchartLayoutCache* cache = state->layout_cache;
+    if (!cache) return;
 
     // Calculate natural size
-    float natural_width = horizontal ? total_primary_size : total_secondary_size;
-    float natural_height = horizontal ? total_secondary_size : total_primary_size;
+    float natural_width = cache->content_width;
+    float natural_height = cache->content_height;
 
     // Add padding
     float padding = 20.0f;
@@ -689,55 +1678,30 @@ void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width,
     // Apply scaling to node POSITIONS only (not dimensions!)
     // Node dimensions must stay the same size as the text they contain
     // Only positions scale to fit within available space
-    if (scale < 1.0f) {
-        for (uint32_t i = 0; i < state->node_count; i++) {
-            IRFlowchartNodeData* node = state->nodes[i];
-            if (!node) continue;
-
-            // Scale position only, NOT width/height
-            // Text rendering uses node dimensions directly
-            node->x = padding + (node->x) * scale;
-            node->y = padding + (node->y) * scale;
-            // DO NOT scale: node->width *= scale;
-            // DO NOT scale: node->height *= scale;
-        }
+    ir_flowchart_geometry_fit(state->node_x, cache->node_x, state->node_count, scale, padding);
+    ir_flowchart_geometry_fit(state->node_y, cache->node_y, state->node_count, scale, padding);
 
-        // Also scale edge path points
-        for (uint32_t i = 0; i < state->edge_count; i++) {
-            IRFlowchartEdgeData* edge = state->edges[i];
-            if (!edge || !edge->path_points) continue;
+    // Also scale edge path points (one pass over the shared pool)
+    ir_flowchart_geometry_fit(state->path_pool, cache->path_coords, cache->path_count, scale, padding);
 
-            for (uint32_t p = 0; p < edge->path_point_count; p++) {
-                edge->path_points[p * 2] = padding + edge->path_points[p * 2] * scale;
-                edge->path_points[p * 2 + 1] = padding + edge->path_points[p * 2 + 1] * scale;
-            }
-        }
-
-        // Update computed size
-        natural_width = (natural_width - padding * 2) * scale + padding * 2;
-        natural_height = (natural_height - padding * 2) * scale + padding * 2;
+    if (scale < 1.0f) {
+        // Boxes follow the scaled nodes
+        compute_subgraph_bounds(&cache->ctx);
     } else {
         // Just add padding offset
-        for (uint32_t i = 0; i < state->node_count; i++) {
-            IRFlowchartNodeData* node = state->nodes[i];
-            if (!node) continue;
-            node->x += padding;
-            node->y += padding;
-        }
-
-        for (uint32_t i = 0; i < state->edge_count; i++) {
-            IRFlowchartEdgeData* edge = state->edges[i];
-            if (!edge || !edge->path_points) continue;
-
-            for (uint32_t p = 0; p < edge->path_point_count; p++) {
-                edge->path_points[p * 2] += padding;
-                edge->path_points[p * 2 + 1] += padding;
-            }
+        for (uint32_t s = 0; s < state->subgraph_count; s++) {
+            IRFlowchartSubgraphData* sg = state->subgraphs[s];
+            if (!sg || cache->ctx.group_node_total[s] == 0) continue;
+            sg->x = padding + cache->subgraph_boxes[s * 4];
+            sg->y = padding + cache->subgraph_boxes[s * 4 + 1];
+            sg->width = cache->subgraph_boxes[s * 4 + 2];
+            sg->height = cache->subgraph_boxes[s * 4 + 3];
         }
     }
 
-    // Compute subgraph bounding boxes after node positions are finalized
-    compute_subgraph_bounds(state);
+    state->fit_scale = scale;
+    state->fit_offset_x = padding;
+    state->fit_offset_y = padding;
 
     // NOTE: Do NOT overwrite flowchart->rendered_bounds here!
     // The parent container (Column/Row) sets the flowchart's bounds based on
@@ -746,6 +1710,7 @@ void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width,
 
     // Mark layout as computed
     state->layout_computed = true;
+    state->layout_generation++;
     state->computed_width = available_width;
     state->computed_height = available_height;
 
@@ -768,9 +1733,169 @@ void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width,
     }
 
     #ifdef KRYON_TRACE_LAYOUT
-    fprintf(stderr, "🔀 FLOWCHART_LAYOUT done: size=%.1fx%.1f\n",
-            flowchart->rendered_bounds.width, flowchart->rendered_bounds.height);
+    fprintf(stderr, "🔀 FLOWCHART_LAYOUT fit: scale=%.2f natural=%.1fx%.1f\n",
+            scale, state->natural_width, state->natural_height);
+    #endif
+}
+
+// Simple layered layout for flowcharts
+// Uses topological sort to assign layers, then positions nodes within layers.
+// Subgraphs are laid out bottom-up in their own direction and placed as blocks.
+void ir_layout_compute_flowchart(IRComponent* flowchart, float available_width, float available_height) {
+    if (!flowchart || flowchart->type != IR_COMPONENT_FLOWCHART) return;
+
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return;
+
+    // Check if layout is already computed and dimensions match
+    // A size change alone only refits the cached natural layout
+    if (state->layout_computed) {
+        if (state->computed_width == available_width &&
+            state->computed_height == available_height) {
+            return;
+        }
+        if (state->layout_cache) {
+            fit_flowchart_layout(state, available_width, available_height);
+            return;
+        }
+    }
+
+    #ifdef KRYON_TRACE_LAYOUT
+    fprintf(stderr, "🔀 FLOWCHART_LAYOUT: %u nodes, %u edges, dir=%s\n",
+            state->node_count, state->edge_count,
+            ir_flowchart_direction_to_string(state->direction));
     #endif
+
+    if (state->node_count == 0) {
+        state->layout_computed = true;
+        state->layout_generation++;
+        state->computed_width = available_width;
+        state->computed_height = available_height;
+        clear_dirty_sets(state);
+        return;
+    }
+
+    // Use layout parameters from state or defaults
+    float node_spacing = state->node_spacing > 0 ? state->node_spacing : FLOWCHART_NODE_SPACING;
+    float rank_spacing = state->rank_spacing > 0 ? state->rank_spacing : FLOWCHART_RANK_SPACING;
+
+    // Resolve edges and the subgraph hierarchy to indices once
+    ir_flowchart_resolve_edges(state);
+    ir_flowchart_resolve_subgraphs(state);
+
+    FlowchartLayoutContext ctx;
+    if (!layout_context_init(&ctx, state, node_spacing, rank_spacing)) return;
+
+    // Use flowchart's font size if specified, otherwise default to 14
+    float font_size = (flowchart->style && flowchart->style->font.size > 0)
+                      ? flowchart->style->font.size : 14.0f;
+    float content_width = 0;
+    float content_height = 0;
+
+    // Label and edge edits update the previous layout while the ranks allow it
+    IRFlowchartLayoutCache* cache = state->layout_cache;
+    bool updated = false;
+    if (cache && state->dirty_flags != 0 && !(state->dirty_flags & IR_FLOWCHART_DIRTY_STRUCTURE) &&
+        cache->node_count == state->node_count && cache->subgraph_count == state->subgraph_count &&
+        cache->font_size == font_size) {
+        updated = relayout_changes(&ctx, font_size, &content_width, &content_height);
+        if (!updated) {
+            // Start over; the previous layout may already be taken apart
+            #ifdef KRYON_TRACE_LAYOUT
+            fprintf(stderr, "🔀 FLOWCHART_LAYOUT: rank structure changed, full layout\n");
+            #endif
+            layout_context_destroy(&ctx);
+            ir_flowchart_layout_cache_destroy(state->layout_cache);
+            state->layout_cache = NULL;
+            if (!layout_context_init(&ctx, state, node_spacing, rank_spacing)) return;
+        }
+    }
+
+    // Charts parsed from the same source share their natural layout
+    uint64_t shared_key = 0;
+    bool shared = false;
+    if (!updated && state->content_key != 0 && ir_flowchart_cache_enabled()) {
+        shared_key = layout_snapshot_key(state, font_size, node_spacing, rank_spacing);
+        SnapshotInstall install = { &ctx, 0, 0 };
+        shared = shared_key != 0 &&
+                 ir_flowchart_cache_apply_layout(state->content_key, shared_key, install_layout_snapshot, &install);
+        if (shared) {
+            content_width = install.content_width;
+            content_height = install.content_height;
+            #ifdef KRYON_TRACE_LAYOUT
+            fprintf(stderr, "🔀 FLOWCHART_LAYOUT: natural layout taken from the cache\n");
+            #endif
+        }
+    }
+
+    if (!updated && !shared) {
+        // Phase 1: Compute node sizes based on labels
+        if (!measure_flowchart_nodes(&ctx, NULL, 0, font_size, true)) {
+            layout_context_destroy(&ctx);
+            return;
+        }
+
+        // Reused subgraph layouts go back to their local coordinates
+        if (!restore_cached_subgraphs(&ctx)) {
+            layout_context_destroy(&ctx);
+            return;
+        }
+
+        // Phases 2-5 run per level, innermost subgraphs first
+        if (!layout_subgraph_nodes(&ctx, NULL, &content_width, &content_height)) {
+            layout_context_destroy(&ctx);
+            return;
+        }
+    }
+
+    // A shared layout is already in absolute coordinates, endpoints included
+    if (!shared) {
+        // Place every subgraph block and its content in absolute coordinates
+        transform_subgraph_coordinates(&ctx);
+
+        // Edge endpoints are node centers; all paths live in the state's pool
+        for (uint32_t i = 0; i < state->edge_count; i++) {
+            IRFlowchartEdgeData* edge = state->edges[i];
+            if (!edge) continue;
+
+            if (ctx.path_offset[i] == IR_FLOWCHART_INVALID_INDEX) {
+                edge->path_points = NULL;
+                edge->path_point_count = 0;
+                continue;
+            }
+
+            uint32_t from = edge->from_index;
+            uint32_t to = edge->to_index;
+            float* points = &state->path_pool[ctx.path_offset[i]];
+            uint32_t last = edge->path_point_count - 1;
+
+            points[0] = state->node_x[from] + state->node_width[from] / 2;
+            points[1] = state->node_y[from] + state->node_height[from] / 2;
+            points[last * 2] = state->node_x[to] + state->node_width[to] / 2;
+            points[last * 2 + 1] = state->node_y[to] + state->node_height[to] / 2;
+            edge->path_points = points;
+
+            #ifdef KRYON_TRACE_LAYOUT
+            fprintf(stderr, "  Edge '%s'->'%s': (%.1f,%.1f) -> (%.1f,%.1f) via %u bends\n",
+                    edge->from_id ? edge->from_id : "?",
+                    edge->to_id ? edge->to_id : "?",
+                    points[0], points[1], points[last * 2], points[last * 2 + 1], last - 1);
+            #endif
+        }
+    }
+
+    if (shared_key != 0 && !shared) {
+        ir_flowchart_cache_store_layout(state->content_key, shared_key,
+                                        create_layout_snapshot(&ctx, content_width, content_height));
+    }
+
+    // Keep the natural layout, then fit it to the available space
+    if (!save_natural_layout(&ctx, content_width, content_height, font_size)) {
+        layout_context_destroy(&ctx);
+        return;
+    }
+    fit_flowchart_layout(state, available_width, available_height);
+    clear_dirty_sets(state);
 }
 
 // ============================================================================
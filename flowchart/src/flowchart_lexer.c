@@ -0,0 +1,385 @@
+// ============================================================================
+// MERMAID FLOWCHART LEXER
+// ============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+#include "flowchart_lexer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// ============================================================================
+// Character classes
+// ============================================================================
+
+#define CC_SPACE       0x01            // Blank inside a line
+#define CC_IDENT_START 0x02            // First character of an identifier
+#define CC_IDENT       0x04            // Identifier character
+#define CC_ARROW       0x08            // Part of an edge operator
+#define CC_ARROW_START 0x10            // Starts an edge operator
+#define CC_OPEN        0x20            // Starts a node shape
+
+#define S CC_SPACE
+#define I (CC_IDENT_START | CC_IDENT)
+#define D CC_IDENT
+#define A (CC_ARROW | CC_ARROW_START)
+#define R CC_ARROW
+#define O CC_OPEN
+#define G (CC_ARROW | CC_OPEN)
+
+// Bytes 0x80-0xFF have no class
+static const uint8_t char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, 0, S, S, S, 0, 0,  // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x10
+    S, 0, 0, 0, 0, 0, 0, 0, O, 0, 0, 0, 0, A, R, 0,  // 0x20  ( - .
+    D, D, D, D, D, D, D, D, D, D, 0, 0, A, A, G, 0,  // 0x30  0-9 < = >
+    0, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,  // 0x40  A-O
+    I, I, I, I, I, I, I, I, I, I, I, O, 0, 0, 0, I,  // 0x50  P-Z [ _
+    0, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,  // 0x60  a-o
+    I, I, I, I, I, I, I, I, I, I, I, O, 0, 0, 0, 0,  // 0x70  p-z {
+};
+
+#undef S
+#undef I
+#undef D
+#undef A
+#undef R
+#undef O
+#undef G
+
+#define CHAR_CLASS(c) char_class[(uint8_t)(c)]
+
+// ============================================================================
+// Keyword and arrow tables
+// ============================================================================
+
+typedef struct {
+    const char* text;                  // NULL = empty slot
+    uint8_t length;
+    uint8_t value;
+} LexEntry;
+
+// Perfect hash over the statement keywords (lower case):
+// (2 * length + first + last) & 15
+static const LexEntry keyword_table[16] = {
+    [0]  = { "class",     5, IR_FLOWCHART_KEYWORD_CLASS },
+    [2]  = { "style",     5, IR_FLOWCHART_KEYWORD_STYLE },
+    [3]  = { "linkstyle", 9, IR_FLOWCHART_KEYWORD_LINKSTYLE },
+    [4]  = { "direction", 9, IR_FLOWCHART_KEYWORD_DIRECTION },
+    [8]  = { "click",     5, IR_FLOWCHART_KEYWORD_CLICK },
+    [9]  = { "classdef",  8, IR_FLOWCHART_KEYWORD_CLASSDEF },
+    [11] = { "subgraph",  8, IR_FLOWCHART_KEYWORD_SUBGRAPH },
+    [15] = { "end",       3, IR_FLOWCHART_KEYWORD_END },
+};
+
+// "--" on its own opens "-- text -->" (or is an open line)
+#define LEX_ARROW_LABEL 0xFF
+
+// Perfect hash over the edge operators: (length + (last >> 1) + (first >> 2)) & 7
+static const LexEntry arrow_table[8] = {
+    [1] = { "==>",   3, IR_FLOWCHART_EDGE_THICK },
+    [2] = { "<-->",  4, IR_FLOWCHART_EDGE_BIDIRECTIONAL },
+    [3] = { "--",    2, LEX_ARROW_LABEL },
+    [4] = { "---",   3, IR_FLOWCHART_EDGE_OPEN },
+    [5] = { "-->",   3, IR_FLOWCHART_EDGE_ARROW },
+    [6] = { "-.->",  4, IR_FLOWCHART_EDGE_DOTTED },
+    [7] = { "-..->", 5, IR_FLOWCHART_EDGE_DOTTED },
+};
+
+static int lookup_keyword(const char* text, size_t length) {
+    if (length < 3 || length > 9) return -1;
+    uint32_t first = (uint8_t)text[0] | 0x20;
+    uint32_t last = (uint8_t)text[length - 1] | 0x20;
+    const LexEntry* entry = &keyword_table[(2 * length + first + last) & 15];
+    if (!entry->text || entry->length != length || strncasecmp(text, entry->text, length) != 0) return -1;
+    return entry->value;
+}
+
+static int lookup_arrow(const char* text, size_t length) {
+    if (length < 2 || length > 5) return -1;
+    uint32_t first = (uint8_t)text[0];
+    uint32_t last = (uint8_t)text[length - 1];
+    const LexEntry* entry = &arrow_table[(length + (last >> 1) + (first >> 2)) & 7];
+    if (!entry->text || entry->length != length || memcmp(text, entry->text, length) != 0) return -1;
+    return entry->value;
+}
+
+// ============================================================================
+// Token stream
+// ============================================================================
+
+static bool push_token(IRFlowchartTokenStream* stream, IRFlowchartTokenType type, uint8_t kind, uint8_t flags,
+                       size_t start, size_t length) {
+    if (stream->count >= stream->capacity) {
+        uint32_t new_capacity = stream->capacity == 0 ? 32 : stream->capacity * 2;
+        IRFlowchartToken* new_tokens = (IRFlowchartToken*)realloc(stream->tokens,
+                                                                  new_capacity * sizeof(IRFlowchartToken));
+        if (!new_tokens) return false;
+        stream->tokens = new_tokens;
+        stream->capacity = new_capacity;
+    }
+
+    IRFlowchartToken* token = &stream->tokens[stream->count++];
+    token->type = (uint8_t)type;
+    token->kind = kind;
+    token->flags = flags;
+    token->start = (uint32_t)start;
+    token->length = (uint32_t)length;
+    return true;
+}
+
+void ir_flowchart_token_stream_destroy(IRFlowchartTokenStream* stream) {
+    if (!stream) return;
+    free(stream->tokens);
+    stream->tokens = NULL;
+    stream->count = 0;
+    stream->capacity = 0;
+}
+
+const char* ir_flowchart_next_line(const char* cursor, const char* end, size_t* length) {
+    const char* newline = (const char*)memchr(cursor, '\n', (size_t)(end - cursor));
+    const char* line_end = newline ? newline : end;
+    if (line_end > cursor && line_end[-1] == '\r') line_end--;
+    *length = (size_t)(line_end - cursor);
+    return newline ? newline + 1 : end;
+}
+
+// ============================================================================
+// Lexer
+// ============================================================================
+
+// Helper: Scan text between nested open/close characters
+// `pos` is at the opening character. Returns the offset after the closing
+// character (or the line length if it is missing).
+static size_t scan_nested(const char* line, size_t length, size_t pos, char open, char close,
+                          size_t* text_start, size_t* text_length) {
+    size_t i = pos + 1;
+    int depth = 1;
+    *text_start = i;
+    for (; i < length; i++) {
+        if (line[i] == open) {
+            depth++;
+        } else if (line[i] == close && --depth == 0) {
+            break;
+        }
+    }
+    *text_length = i - *text_start;
+    return i < length ? i + 1 : length;
+}
+
+// Helper: Scan raw text up to a delimiter
+// Returns the offset after the delimiter (or the line length if it is missing).
+static size_t scan_until(const char* line, size_t length, size_t pos, char delimiter,
+                         size_t* text_start, size_t* text_length) {
+    const char* found = (const char*)memchr(line + pos, delimiter, length - pos);
+    size_t end = found ? (size_t)(found - line) : length;
+    *text_start = pos;
+    *text_length = end - pos;
+    return found ? end + 1 : length;
+}
+
+// Helper: Consume an optional closing character after a shape
+static size_t skip_close(const char* line, size_t length, size_t pos, char close) {
+    return pos < length && line[pos] == close ? pos + 1 : pos;
+}
+
+// Helper: Node shape: [text], (text), {text}, >text] and their doubled forms
+static size_t lex_shape(IRFlowchartTokenStream* stream, const char* line, size_t length, size_t pos, bool* ok) {
+    char c = line[pos];
+    char c2 = pos + 1 < length ? line[pos + 1] : '\0';
+    IRFlowchartShape shape = IR_FLOWCHART_SHAPE_RECTANGLE;
+    uint8_t flags = 0;
+    size_t start = 0;
+    size_t text_length = 0;
+    size_t end;
+
+    if (c == '[' && c2 == '[') {           // [[subroutine]]
+        end = skip_close(line, length, scan_nested(line, length, pos + 1, '[', ']', &start, &text_length), ']');
+        shape = IR_FLOWCHART_SHAPE_SUBROUTINE;
+    } else if (c == '[' && c2 == '(') {    // [(database)]
+        end = skip_close(line, length, scan_nested(line, length, pos + 1, '(', ')', &start, &text_length), ']');
+        shape = IR_FLOWCHART_SHAPE_CYLINDER;
+    } else if (c == '[' && c2 == '/') {    // [/parallelogram/] or [/trapezoid\]
+        start = pos + 2;
+        end = start;
+        while (end < length && line[end] != '/' && line[end] != '\\') end++;
+        text_length = end - start;
+        if (end < length) {
+            shape = line[end] == '/' ? IR_FLOWCHART_SHAPE_PARALLELOGRAM : IR_FLOWCHART_SHAPE_TRAPEZOID;
+            end++;
+        }
+        end = skip_close(line, length, end, ']');
+        flags = IR_FLOWCHART_TOKEN_RAW;
+    } else if (c == '[') {                 // [rectangle] or ["quoted text"]
+        size_t q = pos + 1;
+        while (q < length && (CHAR_CLASS(line[q]) & CC_SPACE)) q++;
+        if (q < length && line[q] == '"') {
+            // Closing quote, skipping escaped ones
+            size_t close = q + 1;
+            for (;;) {
+                const char* found = (const char*)memchr(line + close, '"', length - close);
+                close = found ? (size_t)(found - line) : length;
+                if (!found || line[close - 1] != '\\') break;
+                close++;
+            }
+            start = q + 1;
+            text_length = close - start;
+            size_t bracket_start, bracket_length;
+            end = scan_until(line, length, close < length ? close + 1 : length, ']', &bracket_start, &bracket_length);
+            flags = IR_FLOWCHART_TOKEN_RAW | IR_FLOWCHART_TOKEN_QUOTED;
+        } else {
+            end = scan_nested(line, length, pos, '[', ']', &start, &text_length);
+        }
+        shape = IR_FLOWCHART_SHAPE_RECTANGLE;
+    } else if (c == '(' && c2 == '(') {    // ((circle))
+        end = skip_close(line, length, scan_nested(line, length, pos + 1, '(', ')', &start, &text_length), ')');
+        shape = IR_FLOWCHART_SHAPE_CIRCLE;
+    } else if (c == '(' && c2 == '[') {    // ([stadium])
+        end = skip_close(line, length, scan_nested(line, length, pos + 1, '[', ']', &start, &text_length), ')');
+        shape = IR_FLOWCHART_SHAPE_STADIUM;
+    } else if (c == '(') {                 // (rounded)
+        end = scan_nested(line, length, pos, '(', ')', &start, &text_length);
+        shape = IR_FLOWCHART_SHAPE_ROUNDED;
+    } else if (c == '{' && c2 == '{') {    // {{hexagon}}
+        end = skip_close(line, length, scan_nested(line, length, pos + 1, '{', '}', &start, &text_length), '}');
+        shape = IR_FLOWCHART_SHAPE_HEXAGON;
+    } else if (c == '{') {                 // {diamond}
+        end = scan_nested(line, length, pos, '{', '}', &start, &text_length);
+        shape = IR_FLOWCHART_SHAPE_DIAMOND;
+    } else {                               // >asymmetric]
+        end = scan_until(line, length, pos + 1, ']', &start, &text_length);
+        shape = IR_FLOWCHART_SHAPE_ASYMMETRIC;
+        flags = IR_FLOWCHART_TOKEN_RAW;
+    }
+
+    *ok = push_token(stream, IR_FLOWCHART_TOKEN_SHAPE, (uint8_t)shape, flags, start, text_length);
+    return end;
+}
+
+// Helper: Edge operator, including the label of "-- text -->"
+static size_t lex_arrow(IRFlowchartTokenStream* stream, const char* line, size_t length, size_t pos, bool* ok) {
+    size_t end = pos;
+    while (end < length && (CHAR_CLASS(line[end]) & CC_ARROW)) end++;
+
+    int type = lookup_arrow(line + pos, end - pos);
+    if (type < 0) {
+        *ok = push_token(stream, IR_FLOWCHART_TOKEN_OTHER, 0, 0, pos, end - pos);
+        return end;
+    }
+    if (type != LEX_ARROW_LABEL) {
+        *ok = push_token(stream, IR_FLOWCHART_TOKEN_ARROW, (uint8_t)type, 0, pos, end - pos);
+        return end;
+    }
+
+    // "--" followed by another operator character is an open line
+    size_t text = end;
+    while (text < length && (CHAR_CLASS(line[text]) & CC_SPACE)) text++;
+    if (text < length && (line[text] == '-' || line[text] == '=' || line[text] == '.')) {
+        *ok = push_token(stream, IR_FLOWCHART_TOKEN_ARROW, IR_FLOWCHART_EDGE_OPEN, 0, pos, end - pos);
+        return end;
+    }
+
+    // "-- text -->": the label runs up to the closing arrow
+    size_t arrow = length;
+    for (size_t i = text; i + 2 < length; ) {
+        const char* dash = (const char*)memchr(line + i, '-', length - 2 - i);
+        if (!dash) break;
+        i = (size_t)(dash - line);
+        if (line[i + 1] == '-' && line[i + 2] == '>') {
+            arrow = i;
+            break;
+        }
+        i++;
+    }
+    size_t arrow_start = arrow;
+    while (arrow_start > text && line[arrow_start - 1] == '-') arrow_start--;
+
+    size_t label_end = arrow_start;
+    while (label_end > text && (CHAR_CLASS(line[label_end - 1]) & CC_SPACE)) label_end--;
+    *ok = true;
+    if (label_end > text) {
+        *ok = push_token(stream, IR_FLOWCHART_TOKEN_EDGE_LABEL, 0, IR_FLOWCHART_TOKEN_RAW, text, label_end - text);
+    }
+    if (*ok && arrow < length) {
+        *ok = push_token(stream, IR_FLOWCHART_TOKEN_ARROW, IR_FLOWCHART_EDGE_ARROW, 0,
+                         arrow_start, arrow + 3 - arrow_start);
+        return arrow + 3;
+    }
+    return length;
+}
+
+bool ir_flowchart_lex_line(IRFlowchartTokenStream* stream, const char* line, size_t length) {
+    stream->count = 0;
+
+    size_t pos = 0;
+    bool statement_start = true;
+    bool ok = true;
+
+    while (ok) {
+        while (pos < length && (CHAR_CLASS(line[pos]) & CC_SPACE)) pos++;
+        if (pos >= length) break;
+
+        char c = line[pos];
+        uint8_t cls = CHAR_CLASS(c);
+
+        // Comments: a line starting with % or anything after %%
+        if (c == '%' && (statement_start || (pos + 1 < length && line[pos + 1] == '%'))) break;
+
+        if (c == ';') {
+            if (!statement_start) ok = push_token(stream, IR_FLOWCHART_TOKEN_END, 0, 0, pos, 0);
+            statement_start = true;
+            pos++;
+            continue;
+        }
+
+        if (cls & CC_IDENT_START) {
+            size_t start = pos;
+            while (pos < length && (CHAR_CLASS(line[pos]) & CC_IDENT)) pos++;
+
+            int keyword = statement_start ? lookup_keyword(line + start, pos - start) : -1;
+            statement_start = false;
+            if (keyword < 0) {
+                ok = push_token(stream, IR_FLOWCHART_TOKEN_IDENT, 0, 0, start, pos - start);
+                continue;
+            }
+
+            ok = push_token(stream, IR_FLOWCHART_TOKEN_KEYWORD, (uint8_t)keyword, 0, start, pos - start);
+            if (ok && keyword != IR_FLOWCHART_KEYWORD_SUBGRAPH && keyword != IR_FLOWCHART_KEYWORD_END &&
+                keyword != IR_FLOWCHART_KEYWORD_DIRECTION) {
+                // Styling and click statements take the rest of the statement as one token
+                size_t rest_start, rest_length;
+                scan_until(line, length, pos, ';', &rest_start, &rest_length);
+                pos = rest_start + rest_length;
+                while (rest_length > 0 && (CHAR_CLASS(line[rest_start]) & CC_SPACE)) {
+                    rest_start++;
+                    rest_length--;
+                }
+                while (rest_length > 0 && (CHAR_CLASS(line[rest_start + rest_length - 1]) & CC_SPACE)) {
+                    rest_length--;
+                }
+                ok = push_token(stream, IR_FLOWCHART_TOKEN_REST, 0, IR_FLOWCHART_TOKEN_RAW, rest_start, rest_length);
+            }
+            continue;
+        }
+
+        statement_start = false;
+        if (cls & CC_ARROW_START) {
+            pos = lex_arrow(stream, line, length, pos, &ok);
+        } else if (cls & CC_OPEN) {
+            pos = lex_shape(stream, line, length, pos, &ok);
+        } else if (c == '|') {
+            size_t start, text_length;
+            pos = scan_until(line, length, pos + 1, '|', &start, &text_length);
+            ok = push_token(stream, IR_FLOWCHART_TOKEN_EDGE_LABEL, 0, IR_FLOWCHART_TOKEN_RAW, start, text_length);
+        } else if (c == '&') {
+            ok = push_token(stream, IR_FLOWCHART_TOKEN_AMPERSAND, 0, 0, pos, 1);
+            pos++;
+        } else {
+            ok = push_token(stream, IR_FLOWCHART_TOKEN_OTHER, 0, 0, pos, 1);
+            pos++;
+        }
+    }
+
+    if (ok && !statement_start) ok = push_token(stream, IR_FLOWCHART_TOKEN_END, 0, 0, length, 0);
+    return ok;
+}
@@ -0,0 +1,371 @@
+// ============================================================================
+// FLOWCHART TEXT MEASUREMENT
+// ============================================================================
+
+#include "flowchart_measure.h"
+#include "ir_core.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Entries kept beyond the chart's own labels before the cache starts over
+#define TEXT_CACHE_SLACK 256
+
+typedef struct {
+    uint64_t hash;                     // Hash of label, font size and font id
+    uint32_t text_offset;              // Label copy in IRFlowchartTextCache.text
+    uint32_t length;
+    float font_size;
+    uint32_t font_id;
+    float width;
+} TextCacheEntry;
+
+typedef struct {
+    float font_size;
+    uint32_t font_id;
+    float height;
+} FontHeightEntry;
+
+struct IRFlowchartTextCache {
+    // Backend the entries were measured with; a different one drops them
+    const IRTextMeasurementCallbacks* metrics;
+    IRFlowchartMeasureBatchFn batch;
+    void* batch_user_data;
+
+    TextCacheEntry* entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+
+    // Open addressing, slot holds entry index + 1 (0 = empty)
+    uint32_t* slots;
+    uint32_t slot_capacity;            // Power of two
+
+    char* text;                        // NUL-terminated label copies
+    uint32_t text_count;
+    uint32_t text_capacity;
+
+    FontHeightEntry* heights;
+    uint32_t height_count;
+    uint32_t height_capacity;
+};
+
+static IRFlowchartMeasureBatchFn g_measure_batch = NULL;
+static void* g_measure_batch_user_data = NULL;
+
+// Font backends are not assumed thread-safe; charts laid out on several
+// threads take turns measuring
+static pthread_mutex_t g_measure_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void ir_flowchart_set_measure_batch(IRFlowchartMeasureBatchFn fn, void* user_data) {
+    g_measure_batch = fn;
+    g_measure_batch_user_data = user_data;
+}
+
+void ir_flowchart_text_cache_destroy(IRFlowchartTextCache* cache) {
+    if (!cache) return;
+    free(cache->entries);
+    free(cache->slots);
+    free(cache->text);
+    free(cache->heights);
+    free(cache);
+}
+
+// ============================================================================
+// Hashing
+// ============================================================================
+
+static uint64_t text_hash_bytes(uint64_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint32_t text_font_id(const char* font_family) {
+    if (!font_family) return 0;
+    uint32_t id = (uint32_t)text_hash_bytes(14695981039346656037ull, font_family, strlen(font_family));
+    return id == 0 ? 1 : id;
+}
+
+uint64_t ir_flowchart_measure_backend_id(void) {
+    const IRTextMeasurementCallbacks* metrics = g_ir_font_metrics;
+    IRFlowchartMeasureBatchFn batch = g_measure_batch;
+    uint64_t hash = text_hash_bytes(14695981039346656037ull, &metrics, sizeof(metrics));
+    hash = text_hash_bytes(hash, &batch, sizeof(batch));
+    return text_hash_bytes(hash, &g_measure_batch_user_data, sizeof(g_measure_batch_user_data));
+}
+
+static uint64_t text_key_hash(const char* text, uint32_t length, float font_size, uint32_t font_id) {
+    uint64_t hash = text_hash_bytes(14695981039346656037ull, text, length);
+    hash = text_hash_bytes(hash, &font_size, sizeof(font_size));
+    return text_hash_bytes(hash, &font_id, sizeof(font_id));
+}
+
+// ============================================================================
+// Cache table
+// ============================================================================
+
+static void text_cache_clear_entries(IRFlowchartTextCache* cache) {
+    cache->entry_count = 0;
+    cache->text_count = 0;
+    if (cache->slots) memset(cache->slots, 0, cache->slot_capacity * sizeof(uint32_t));
+}
+
+// Helper: Cache for this layout, reset when the backend changed or stale labels piled up
+static IRFlowchartTextCache* text_cache_prepare(IRFlowchartState* state, const IRTextMeasurementCallbacks* metrics) {
+    IRFlowchartTextCache* cache = state->text_cache;
+    if (!cache) {
+        cache = (IRFlowchartTextCache*)calloc(1, sizeof(IRFlowchartTextCache));
+        if (!cache) return NULL;
+        state->text_cache = cache;
+    } else if (cache->metrics != metrics || cache->batch != g_measure_batch ||
+               cache->batch_user_data != g_measure_batch_user_data) {
+        text_cache_clear_entries(cache);
+        cache->height_count = 0;
+    } else if (cache->entry_count > state->node_count * 2 + TEXT_CACHE_SLACK) {
+        text_cache_clear_entries(cache);
+    }
+
+    cache->metrics = metrics;
+    cache->batch = g_measure_batch;
+    cache->batch_user_data = g_measure_batch_user_data;
+    return cache;
+}
+
+static uint32_t text_cache_find(const IRFlowchartTextCache* cache, uint64_t hash, const char* text,
+                                uint32_t length, float font_size, uint32_t font_id, uint32_t* out_slot) {
+    uint32_t mask = cache->slot_capacity - 1;
+    uint32_t slot = (uint32_t)(hash ^ (hash >> 32)) & mask;
+    while (cache->slots[slot] != 0) {
+        const TextCacheEntry* entry = &cache->entries[cache->slots[slot] - 1];
+        if (entry->hash == hash && entry->length == length && entry->font_size == font_size &&
+            entry->font_id == font_id && memcmp(&cache->text[entry->text_offset], text, length) == 0) {
+            return cache->slots[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    *out_slot = slot;
+    return IR_FLOWCHART_INVALID_INDEX;
+}
+
+// Helper: Keep the table at most half full
+static bool text_cache_reserve(IRFlowchartTextCache* cache, uint32_t extra_entries) {
+    uint32_t needed = cache->entry_count + extra_entries;
+    if (needed > cache->entry_capacity) {
+        uint32_t capacity = cache->entry_capacity ? cache->entry_capacity : 64;
+        while (capacity < needed) capacity *= 2;
+        TextCacheEntry* entries = (TextCacheEntry*)realloc(cache->entries, capacity * sizeof(TextCacheEntry));
+        if (!entries) return false;
+        cache->entries = entries;
+        cache->entry_capacity = capacity;
+    }
+
+    if (needed * 2 <= cache->slot_capacity) return true;
+
+    uint32_t slot_capacity = cache->slot_capacity ? cache->slot_capacity : 128;
+    while (slot_capacity < needed * 2) slot_capacity *= 2;
+    uint32_t* slots = (uint32_t*)calloc(slot_capacity, sizeof(uint32_t));
+    if (!slots) return false;
+
+    uint32_t mask = slot_capacity - 1;
+    for (uint32_t i = 0; i < cache->entry_count; i++) {
+        uint64_t hash = cache->entries[i].hash;
+        uint32_t slot = (uint32_t)(hash ^ (hash >> 32)) & mask;
+        while (slots[slot] != 0) slot = (slot + 1) & mask;
+        slots[slot] = i + 1;
+    }
+    free(cache->slots);
+    cache->slots = slots;
+    cache->slot_capacity = slot_capacity;
+    return true;
+}
+
+static bool text_cache_append_text(IRFlowchartTextCache* cache, const char* text, uint32_t length,
+                                   uint32_t* out_offset) {
+    uint32_t needed = cache->text_count + length + 1;
+    if (needed > cache->text_capacity) {
+        uint32_t capacity = cache->text_capacity ? cache->text_capacity : 1024;
+        while (capacity < needed) capacity *= 2;
+        char* buffer = (char*)realloc(cache->text, capacity);
+        if (!buffer) return false;
+        cache->text = buffer;
+        cache->text_capacity = capacity;
+    }
+    *out_offset = cache->text_count;
+    memcpy(&cache->text[cache->text_count], text, length);
+    cache->text[cache->text_count + length] = '\0';
+    cache->text_count = needed;
+    return true;
+}
+
+// Helper: Line height for one font, asked from the backend once
+static float text_cache_font_height(IRFlowchartTextCache* cache, const IRTextMeasurementCallbacks* metrics,
+                                    float font_size, const char* font_family, uint32_t font_id) {
+    for (uint32_t i = 0; i < cache->height_count; i++) {
+        if (cache->heights[i].font_size == font_size && cache->heights[i].font_id == font_id) {
+            return cache->heights[i].height;
+        }
+    }
+
+    float height = (metrics && metrics->get_font_height)
+        ? metrics->get_font_height(font_size, font_family)
+        : font_size * 1.2f;
+
+    if (cache->height_count >= cache->height_capacity) {
+        uint32_t capacity = cache->height_capacity ? cache->height_capacity * 2 : 4;
+        FontHeightEntry* heights = (FontHeightEntry*)realloc(cache->heights, capacity * sizeof(FontHeightEntry));
+        if (!heights) return height;
+        cache->heights = heights;
+        cache->height_capacity = capacity;
+    }
+    cache->heights[cache->height_count].font_size = font_size;
+    cache->heights[cache->height_count].font_id = font_id;
+    cache->heights[cache->height_count].height = height;
+    cache->height_count++;
+    return height;
+}
+
+// ============================================================================
+// Measurement
+// ============================================================================
+
+// Helper: Measure without the cache (no metrics, or the cache could not grow)
+static void measure_labels_uncached(const IRFlowchartState* state, const IRTextMeasurementCallbacks* metrics,
+                                    const uint32_t* nodes, uint32_t count, float font_size,
+                                    const char* font_family, float* widths) {
+    for (uint32_t i = 0; i < count; i++) {
+        const char* label = nodes[i] < state->node_count && state->nodes[nodes[i]]
+            ? state->nodes[nodes[i]]->label : NULL;
+        uint32_t length = label ? (uint32_t)strlen(label) : 0;
+        if (length == 0) {
+            widths[i] = 0;
+        } else if (g_measure_batch) {
+            g_measure_batch(&label, &length, 1, font_size, font_family, &widths[i], g_measure_batch_user_data);
+        } else if (metrics && metrics->get_text_width) {
+            widths[i] = metrics->get_text_width(label, length, font_size, font_family);
+        } else {
+            // No font metrics - use estimate
+            widths[i] = length * font_size * 0.6f;
+        }
+    }
+}
+
+// Helper: Measure through the state's cache (backend present, g_measure_lock held)
+static bool measure_labels_cached(IRFlowchartState* state, const IRTextMeasurementCallbacks* metrics,
+                                  const uint32_t* nodes, uint32_t count, float font_size,
+                                  const char* font_family, float* widths, float* height) {
+    IRFlowchartTextCache* cache = text_cache_prepare(state, metrics);
+    uint32_t* entry_of = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+    uint32_t* misses = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+    if (!cache || !entry_of || !misses || !text_cache_reserve(cache, count)) {
+        free(entry_of);
+        free(misses);
+        measure_labels_uncached(state, metrics, nodes, count, font_size, font_family, widths);
+        *height = (metrics && metrics->get_font_height) ? metrics->get_font_height(font_size, font_family)
+                                                        : font_size * 1.2f;
+        return false;
+    }
+
+    uint32_t font_id = text_font_id(font_family);
+    *height = text_cache_font_height(cache, metrics, font_size, font_family, font_id);
+
+    // Look every label up; each distinct miss gets an entry and is measured once below
+    bool ok = true;
+    uint32_t miss_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        entry_of[i] = IR_FLOWCHART_INVALID_INDEX;
+        const char* label = nodes[i] < state->node_count && state->nodes[nodes[i]]
+            ? state->nodes[nodes[i]]->label : NULL;
+        uint32_t length = label ? (uint32_t)strlen(label) : 0;
+        if (length == 0) continue;
+
+        uint64_t hash = text_key_hash(label, length, font_size, font_id);
+        uint32_t slot = 0;
+        uint32_t index = text_cache_find(cache, hash, label, length, font_size, font_id, &slot);
+        if (index == IR_FLOWCHART_INVALID_INDEX) {
+            uint32_t text_offset = 0;
+            if (!text_cache_append_text(cache, label, length, &text_offset)) {
+                ok = false;
+                break;
+            }
+            index = cache->entry_count++;
+            TextCacheEntry* entry = &cache->entries[index];
+            entry->hash = hash;
+            entry->text_offset = text_offset;
+            entry->length = length;
+            entry->font_size = font_size;
+            entry->font_id = font_id;
+            entry->width = 0;
+            cache->slots[slot] = index + 1;
+            misses[miss_count++] = index;
+        }
+        entry_of[i] = index;
+    }
+
+    if (!ok) {
+        // Entries without a width must not survive
+        text_cache_clear_entries(cache);
+        free(entry_of);
+        free(misses);
+        measure_labels_uncached(state, metrics, nodes, count, font_size, font_family, widths);
+        return false;
+    }
+
+    if (miss_count > 0 && g_measure_batch) {
+        const char** texts = (const char**)malloc(miss_count * sizeof(const char*));
+        uint32_t* lengths = (uint32_t*)malloc(miss_count * sizeof(uint32_t));
+        float* measured = (float*)malloc(miss_count * sizeof(float));
+        if (texts && lengths && measured) {
+            for (uint32_t m = 0; m < miss_count; m++) {
+                const TextCacheEntry* entry = &cache->entries[misses[m]];
+                texts[m] = &cache->text[entry->text_offset];
+                lengths[m] = entry->length;
+            }
+            g_measure_batch(texts, lengths, miss_count, font_size, font_family, measured, g_measure_batch_user_data);
+            for (uint32_t m = 0; m < miss_count; m++) cache->entries[misses[m]].width = measured[m];
+        } else {
+            for (uint32_t m = 0; m < miss_count; m++) {
+                TextCacheEntry* entry = &cache->entries[misses[m]];
+                const char* text = &cache->text[entry->text_offset];
+                g_measure_batch(&text, &entry->length, 1, font_size, font_family, &entry->width,
+                                g_measure_batch_user_data);
+            }
+        }
+        free(texts);
+        free(lengths);
+        free(measured);
+    } else {
+        for (uint32_t m = 0; m < miss_count; m++) {
+            TextCacheEntry* entry = &cache->entries[misses[m]];
+            entry->width = metrics->get_text_width(&cache->text[entry->text_offset], entry->length,
+                                                   font_size, font_family);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        widths[i] = entry_of[i] == IR_FLOWCHART_INVALID_INDEX ? 0 : cache->entries[entry_of[i]].width;
+    }
+
+    free(entry_of);
+    free(misses);
+    return true;
+}
+
+bool ir_flowchart_measure_labels(IRFlowchartState* state, const uint32_t* nodes, uint32_t count,
+                                 float font_size, const char* font_family, float* widths, float* height) {
+    const IRTextMeasurementCallbacks* metrics = g_ir_font_metrics;
+    bool has_backend = g_measure_batch || (metrics && metrics->get_text_width);
+
+    if (!has_backend) {
+        measure_labels_uncached(state, NULL, nodes, count, font_size, font_family, widths);
+        *height = font_size * 1.2f;
+        return true;
+    }
+
+    pthread_mutex_lock(&g_measure_lock);
+    bool ok = measure_labels_cached(state, metrics, nodes, count, font_size, font_family, widths, height);
+    pthread_mutex_unlock(&g_measure_lock);
+    return ok;
+}
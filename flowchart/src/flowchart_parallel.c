@@ -0,0 +1,66 @@
+// ============================================================================
+// FLOWCHART PARALLEL-FOR
+// ============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+#include "flowchart_parallel.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Upper bound on threads started for one parallel-for
+#define PARALLEL_MAX_THREADS 64
+
+typedef struct {
+    IRFlowchartTaskFn fn;
+    void* user_data;
+    uint32_t count;
+    atomic_uint next;
+} ParallelRange;
+
+static void* parallel_worker(void* arg) {
+    ParallelRange* range = (ParallelRange*)arg;
+    for (;;) {
+        uint32_t index = atomic_fetch_add(&range->next, 1);
+        if (index >= range->count) break;
+        range->fn(range->user_data, index);
+    }
+    return NULL;
+}
+
+uint32_t ir_flowchart_parallel_default_threads(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) return 1;
+    if (cpus > PARALLEL_MAX_THREADS) return PARALLEL_MAX_THREADS;
+    return (uint32_t)cpus;
+}
+
+void ir_flowchart_parallel_for(uint32_t count, uint32_t max_threads, IRFlowchartTaskFn fn, void* user_data) {
+    if (!fn || count == 0) return;
+
+    uint32_t threads = max_threads == 0 ? ir_flowchart_parallel_default_threads() : max_threads;
+    if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+    if (threads > count) threads = count;
+
+    ParallelRange range;
+    range.fn = fn;
+    range.user_data = user_data;
+    range.count = count;
+    atomic_init(&range.next, 0);
+
+    // Workers beyond the calling thread, started for this call only;
+    // failures just leave more work for the caller
+    pthread_t workers[PARALLEL_MAX_THREADS];
+    uint32_t started = 0;
+    for (uint32_t t = 1; t < threads; t++) {
+        if (pthread_create(&workers[started], NULL, parallel_worker, &range) != 0) break;
+        started++;
+    }
+
+    parallel_worker(&range);
+
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+}
@@ -1,6 +1,10 @@
 #define _POSIX_C_SOURCE 200809L
 #include "flowchart_parser.h"
 #include "flowchart_builder.h"
+#include "flowchart_cache.h"
+#include "flowchart_lexer.h"
+#include "flowchart_kir.h"
+#include "flowchart_strings.h"
 #include "ir_serialization.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,226 +12,180 @@
 #include <strings.h>
 #include <ctype.h>
 
+// Node or subgraph ID created so far (interned in the flowchart's string arena)
+typedef struct {
+    const char* id;                    // NULL = empty slot
+    IRFlowchartNodeData* node;         // NULL for subgraph IDs
+} ParserSymbol;
+
+// Open subgraph (component is NULL when writing KIR directly)
+typedef struct {
+    IRComponent* component;
+    IRFlowchartSubgraphData* data;
+} ParserSubgraph;
+
+// Node IDs on one side of an edge: A & B & C
+typedef struct {
+    const char** ids;                  // Interned
+    uint32_t count;
+    uint32_t capacity;
+} ParserGroup;
+
 // Parser state
 typedef struct {
-    const char* source;
-    size_t length;
-    size_t pos;
-    int line;
-    int col;
+    const char* line;                  // Line being parsed (tokens point into it)
+    int line_number;
+    IRFlowchartTokenStream tokens;     // Tokens of the current line
+    uint32_t next;                     // Next token of the current statement
+
+    // NUL-terminated copies of token text, valid until the next line
+    char* text;
+    size_t text_count;
+    size_t text_capacity;
+
     IRFlowchartDirection direction;
-    IRComponent* flowchart;
-    IRFlowchartState* state;
+    IRComponent* flowchart;            // Output tree (NULL when writing KIR directly)
+    IRFlowchartState* state;           // The flowchart's state (owned by the parser in KIR mode)
+    IRFlowchartKirWriter* kir;         // Direct KIR output instead of a component tree
+    bool kir_settled;                  // Node data handed to kir may already be freed
 
     // Subgraph stack (for nested subgraphs)
-    IRComponent** subgraph_stack;
+    ParserSubgraph* subgraph_stack;
     uint32_t stack_depth;
     uint32_t stack_capacity;
+
+    // Symbol table of node and subgraph IDs (open addressing, at most half full)
+    ParserSymbol* symbols;
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;          // Power of two
+
+    uint32_t edge_count;               // Edges created so far (linkStyle refers to them by index)
+
+    // Sources and targets of the edges being expanded (reused across statements)
+    ParserGroup groups[2];
 } FlowchartParser;
 
 // Forward declarations
-static void skip_whitespace(FlowchartParser* p);
-static void skip_whitespace_and_newlines(FlowchartParser* p);
-static bool is_at_end(FlowchartParser* p);
-static char peek(FlowchartParser* p);
-static char peek_next(FlowchartParser* p);
-static char advance(FlowchartParser* p);
-static bool match(FlowchartParser* p, const char* str);
-static bool match_case_insensitive(FlowchartParser* p, const char* str);
-static char* parse_identifier(FlowchartParser* p);
-static char* parse_text_in_brackets(FlowchartParser* p, char open, char close);
-static char* parse_quoted_string(FlowchartParser* p);
-static char* process_html_in_text(const char* text);
-static IRFlowchartDirection parse_direction(FlowchartParser* p);
-static void parse_node_definition(FlowchartParser* p, const char* node_id);
-static void parse_edge(FlowchartParser* p, const char* from_id);
+static const IRFlowchartToken* peek_token(FlowchartParser* p);
+static const IRFlowchartToken* next_token(FlowchartParser* p);
+static bool check_token(FlowchartParser* p, IRFlowchartTokenType type);
+static char* parser_copy_text(FlowchartParser* p, const char* text, size_t length);
+static char* token_text(FlowchartParser* p, const IRFlowchartToken* token);
+static char* token_label(FlowchartParser* p, const IRFlowchartToken* token);
+static const char* token_id(FlowchartParser* p, const IRFlowchartToken* token);
+static void process_html_in_text(char* text);
+static const char* parse_node_ref(FlowchartParser* p);
+static bool parse_node_group(FlowchartParser* p, ParserGroup* group);
+static void parse_edges(FlowchartParser* p, ParserGroup* from, ParserGroup* to);
+static void parse_node_statement(FlowchartParser* p);
 static void parse_subgraph(FlowchartParser* p);
+static void parse_direction(FlowchartParser* p);
 static void parse_style(FlowchartParser* p);
-static void parse_line(FlowchartParser* p);
+static void parse_class_def(FlowchartParser* p);
+static void parse_class(FlowchartParser* p);
+static void parse_link_style(FlowchartParser* p);
+static void parse_style_properties(IRFlowchartStyle* style, const char* text, size_t length);
+static void parse_style_property(IRFlowchartStyle* style, const char* text, size_t length);
+static void parse_statement(FlowchartParser* p);
+static bool parse_line(FlowchartParser* p, const char* line, size_t length);
 static uint32_t parse_hex_color(const char* str);
-static bool node_exists_in_children(IRComponent* parent, const char* node_id);
+
+// Symbol table helpers
+static ParserSymbol* parser_find_symbol(FlowchartParser* p, const char* id);
+static bool parser_add_symbol(FlowchartParser* p, const char* id, IRFlowchartNodeData* node);
+static bool parser_create_node(FlowchartParser* p, const char* node_id,
+                               IRFlowchartShape shape, const char* label);
+static IRFlowchartNodeData* parser_find_node(FlowchartParser* p, const char* node_id);
+static void parser_ensure_node(FlowchartParser* p, const char* node_id);
+static void parser_create_edge(FlowchartParser* p, const char* from_id, const char* to_id,
+                               IRFlowchartEdgeType type, const char* label);
+static bool parser_reserve_groups(FlowchartParser* p, uint32_t ids);
 
 // Subgraph stack helpers
-static void parser_push_subgraph(FlowchartParser* p, IRComponent* subgraph);
+static bool parser_push_subgraph(FlowchartParser* p, IRComponent* component, IRFlowchartSubgraphData* data);
 static void parser_pop_subgraph(FlowchartParser* p);
-static IRComponent* parser_current_subgraph(FlowchartParser* p);
-
-// Utility functions
-static void skip_whitespace(FlowchartParser* p) {
-    while (!is_at_end(p) && (peek(p) == ' ' || peek(p) == '\t')) {
-        advance(p);
-    }
-}
-
-static void skip_whitespace_and_newlines(FlowchartParser* p) {
-    while (!is_at_end(p)) {
-        char c = peek(p);
-        if (c == ' ' || c == '\t') {
-            advance(p);
-        } else if (c == '\n') {
-            advance(p);
-            p->line++;
-            p->col = 0;
-        } else if (c == '\r') {
-            advance(p);
-            if (!is_at_end(p) && peek(p) == '\n') advance(p);
-            p->line++;
-            p->col = 0;
-        } else if (c == '%' && peek_next(p) == '%') {
-            // Skip comment (%%...)
-            while (!is_at_end(p) && peek(p) != '\n') advance(p);
-        } else {
-            break;
-        }
-    }
-}
+static ParserSubgraph* parser_current_subgraph(FlowchartParser* p);
 
-static bool is_at_end(FlowchartParser* p) {
-    return p->pos >= p->length;
+// Token helpers
+// Every statement ends with an END token, so peeking never runs past the stream
+static const IRFlowchartToken* peek_token(FlowchartParser* p) {
+    return &p->tokens.tokens[p->next];
 }
 
-static char peek(FlowchartParser* p) {
-    if (is_at_end(p)) return '\0';
-    return p->source[p->pos];
+static const IRFlowchartToken* next_token(FlowchartParser* p) {
+    const IRFlowchartToken* token = &p->tokens.tokens[p->next];
+    if (token->type != IR_FLOWCHART_TOKEN_END) p->next++;
+    return token;
 }
 
-static char peek_next(FlowchartParser* p) {
-    if (p->pos + 1 >= p->length) return '\0';
-    return p->source[p->pos + 1];
+static bool check_token(FlowchartParser* p, IRFlowchartTokenType type) {
+    return peek_token(p)->type == type;
 }
 
-static char advance(FlowchartParser* p) {
-    if (is_at_end(p)) return '\0';
-    p->col++;
-    return p->source[p->pos++];
+// Copy text into the line's text buffer (reserved by parse_line, never reallocated mid-line)
+static char* parser_copy_text(FlowchartParser* p, const char* text, size_t length) {
+    if (p->text_count + length + 1 > p->text_capacity) return NULL;
+    char* copy = p->text + p->text_count;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    p->text_count += length + 1;
+    return copy;
 }
 
-static bool match(FlowchartParser* p, const char* str) {
-    size_t len = strlen(str);
-    if (p->pos + len > p->length) return false;
-    if (strncmp(p->source + p->pos, str, len) == 0) {
-        for (size_t i = 0; i < len; i++) {
-            advance(p);
-        }
-        return true;
-    }
-    return false;
+static char* token_text(FlowchartParser* p, const IRFlowchartToken* token) {
+    return parser_copy_text(p, p->line + token->start, token->length);
 }
 
-static bool match_case_insensitive(FlowchartParser* p, const char* str) {
-    size_t len = strlen(str);
-    if (p->pos + len > p->length) return false;
-    if (strncasecmp(p->source + p->pos, str, len) == 0) {
-        for (size_t i = 0; i < len; i++) {
-            advance(p);
-        }
-        return true;
-    }
-    return false;
-}
-
-static char* parse_identifier(FlowchartParser* p) {
-    skip_whitespace(p);
-    size_t start = p->pos;
-
-    // First char must be letter or underscore
-    if (!is_at_end(p) && (isalpha(peek(p)) || peek(p) == '_')) {
-        advance(p);
-        // Rest can be alphanumeric or underscore
-        while (!is_at_end(p) && (isalnum(peek(p)) || peek(p) == '_')) {
-            advance(p);
-        }
-    }
-
-    if (p->pos == start) return NULL;
-
-    size_t len = p->pos - start;
-    char* id = (char*)malloc(len + 1);
-    memcpy(id, p->source + start, len);
-    id[len] = '\0';
-    return id;
+// ID of a token, interned so that IDs compare by pointer
+static const char* token_id(FlowchartParser* p, const IRFlowchartToken* token) {
+    return ir_flowchart_intern_n(p->state->strings, p->line + token->start, token->length);
 }
 
-static char* parse_text_in_brackets(FlowchartParser* p, char open, char close) {
-    if (peek(p) != open) return NULL;
-    advance(p);  // Skip opening bracket
-
-    size_t start = p->pos;
-    int depth = 1;
-
-    while (!is_at_end(p) && depth > 0) {
-        char c = peek(p);
-        if (c == open) depth++;
-        else if (c == close) depth--;
-        if (depth > 0) advance(p);
+// Label of a shape token: trimmed and HTML processed unless taken verbatim
+// A label quoted as a whole is taken verbatim without its quotes, whatever
+// the shape; the lexer already drops those of ["..."].
+static char* token_label(FlowchartParser* p, const IRFlowchartToken* token) {
+    char* text = token_text(p, token);
+    if (!text || (token->flags & IR_FLOWCHART_TOKEN_QUOTED)) return text;
+
+    size_t start = 0;
+    size_t end = token->length;
+    while (start < end && isspace((unsigned char)text[start])) start++;
+    while (end > start && isspace((unsigned char)text[end - 1])) end--;
+    if (end - start >= 2 && text[start] == '"' && text[end - 1] == '"') {
+        text[end - 1] = '\0';
+        return text + start + 1;
     }
-
-    size_t len = p->pos - start;
-    char* text = (char*)malloc(len + 1);
-    memcpy(text, p->source + start, len);
-    text[len] = '\0';
-
-    if (peek(p) == close) advance(p);  // Skip closing bracket
+    if (token->flags & IR_FLOWCHART_TOKEN_RAW) return text;
 
     // Trim whitespace
-    while (len > 0 && isspace(text[len - 1])) text[--len] = '\0';
-    char* trimmed = text;
-    while (*trimmed && isspace(*trimmed)) trimmed++;
-    if (trimmed != text) {
-        memmove(text, trimmed, strlen(trimmed) + 1);
-    }
+    text[end] = '\0';
+    char* trimmed = text + start;
 
     // Process HTML tags (convert <br/> to newlines, strip formatting tags)
-    char* processed = process_html_in_text(text);
-    free(text);
-
-    return processed;
-}
-
-static char* parse_quoted_string(FlowchartParser* p) {
-    if (peek(p) != '"') return NULL;
-    advance(p);  // Skip opening quote
-
-    size_t start = p->pos;
-    while (!is_at_end(p) && peek(p) != '"') {
-        if (peek(p) == '\\' && peek_next(p) == '"') {
-            advance(p);  // Skip backslash
-        }
-        advance(p);
-    }
-
-    size_t len = p->pos - start;
-    char* str = (char*)malloc(len + 1);
-    memcpy(str, p->source + start, len);
-    str[len] = '\0';
-
-    if (peek(p) == '"') advance(p);  // Skip closing quote
-
-    return str;
+    process_html_in_text(trimmed);
+    return trimmed;
 }
 
 // Process HTML tags in text, converting to appropriate Kryon representations
-static char* process_html_in_text(const char* text) {
-    if (!text) return NULL;
+// Works in place: the output is never longer than the input.
+static void process_html_in_text(char* text) {
+    if (!text) return;
 
     size_t len = strlen(text);
-    size_t output_size = len * 2;  // Generous buffer for potential newlines
-    char* output = (char*)malloc(output_size);
-    if (!output) return NULL;
-
     size_t out_pos = 0;
 
     for (size_t i = 0; i < len; ) {
         if (text[i] == '<') {
             // Check for specific HTML tags
             if (strncasecmp(&text[i], "<br/>", 5) == 0) {
-                output[out_pos++] = '\n';
+                text[out_pos++] = '\n';
                 i += 5;
             } else if (strncasecmp(&text[i], "<br>", 4) == 0) {
-                output[out_pos++] = '\n';
+                text[out_pos++] = '\n';
                 i += 4;
             } else if (strncasecmp(&text[i], "<br />", 6) == 0) {
-                output[out_pos++] = '\n';
+                text[out_pos++] = '\n';
                 i += 6;
             } else if (i + 1 < len && text[i + 1] == '/') {
                 // Closing tag (e.g., </b>, </i>) - skip it
@@ -240,86 +198,162 @@ static char* process_html_in_text(const char* text) {
             }
         } else {
             // Regular character - copy it
-            output[out_pos++] = text[i++];
+            text[out_pos++] = text[i++];
         }
     }
 
-    output[out_pos] = '\0';
-
-    // Reallocate to exact size to save memory
-    char* final = (char*)realloc(output, out_pos + 1);
-    return final ? final : output;
-}
-
-// Parse flowchart direction (TB, LR, BT, RL)
-static IRFlowchartDirection parse_direction(FlowchartParser* p) {
-    skip_whitespace(p);
-
-    if (match_case_insensitive(p, "TB") || match_case_insensitive(p, "TD")) {
-        return IR_FLOWCHART_DIR_TB;
-    } else if (match_case_insensitive(p, "LR")) {
-        return IR_FLOWCHART_DIR_LR;
-    } else if (match_case_insensitive(p, "BT")) {
-        return IR_FLOWCHART_DIR_BT;
-    } else if (match_case_insensitive(p, "RL")) {
-        return IR_FLOWCHART_DIR_RL;
-    }
-
-    return IR_FLOWCHART_DIR_TB;  // Default
+    text[out_pos] = '\0';
 }
 
 // Subgraph stack helpers
-static void parser_push_subgraph(FlowchartParser* p, IRComponent* subgraph) {
-    if (!p || !subgraph) return;
+static bool parser_push_subgraph(FlowchartParser* p, IRComponent* component, IRFlowchartSubgraphData* data) {
+    if (!p || !data) return false;
 
     // Grow stack if needed
     if (p->stack_depth >= p->stack_capacity) {
         uint32_t new_capacity = p->stack_capacity == 0 ? 4 : p->stack_capacity * 2;
-        IRComponent** new_stack = (IRComponent**)realloc(p->subgraph_stack,
-                                                          new_capacity * sizeof(IRComponent*));
-        if (!new_stack) return;  // Out of memory
+        ParserSubgraph* new_stack = (ParserSubgraph*)realloc(p->subgraph_stack,
+                                                             new_capacity * sizeof(ParserSubgraph));
+        if (!new_stack) return false;  // Out of memory
         p->subgraph_stack = new_stack;
         p->stack_capacity = new_capacity;
     }
 
-    p->subgraph_stack[p->stack_depth++] = subgraph;
+    p->subgraph_stack[p->stack_depth].component = component;
+    p->subgraph_stack[p->stack_depth].data = data;
+    p->stack_depth++;
+    return true;
 }
 
 static void parser_pop_subgraph(FlowchartParser* p) {
     if (!p || p->stack_depth == 0) return;
     p->stack_depth--;
+    if (p->kir) ir_flowchart_kir_end_subgraph(p->kir);
 }
 
-static IRComponent* parser_current_subgraph(FlowchartParser* p) {
+static ParserSubgraph* parser_current_subgraph(FlowchartParser* p) {
     if (!p || p->stack_depth == 0) return NULL;
-    return p->subgraph_stack[p->stack_depth - 1];
+    return &p->subgraph_stack[p->stack_depth - 1];
 }
 
-// Check if a node with given ID already exists as a child of the parent component
-static bool node_exists_in_children(IRComponent* parent, const char* node_id) {
-    if (!parent || !node_id) return false;
+// Symbol table helpers
+// IDs are interned, so they carry their hash and compare by pointer
+static ParserSymbol* parser_find_symbol(FlowchartParser* p, const char* id) {
+    if (!p || !id || p->symbol_capacity == 0) return NULL;
 
-    for (uint32_t i = 0; i < parent->child_count; i++) {
-        IRComponent* child = parent->children[i];
-        if (child && child->type == IR_COMPONENT_FLOWCHART_NODE) {
-            IRFlowchartNodeData* data = ir_get_flowchart_node_data(child);
-            if (data && data->node_id && strcmp(data->node_id, node_id) == 0) {
-                return true;
-            }
+    uint32_t mask = p->symbol_capacity - 1;
+    for (uint32_t slot = ir_flowchart_interned_hash(id) & mask; p->symbols[slot].id; slot = (slot + 1) & mask) {
+        if (p->symbols[slot].id == id) return &p->symbols[slot];
+    }
+    return NULL;
+}
+
+// Register an ID; the first node or subgraph created with it keeps the entry
+static bool parser_add_symbol(FlowchartParser* p, const char* id, IRFlowchartNodeData* node) {
+    if (!p || !id) return false;
+    if (parser_find_symbol(p, id)) return true;
+
+    // Grow table if needed
+    if ((p->symbol_count + 1) * 2 > p->symbol_capacity) {
+        uint32_t new_capacity = p->symbol_capacity == 0 ? 64 : p->symbol_capacity * 2;
+        ParserSymbol* new_symbols = (ParserSymbol*)calloc(new_capacity, sizeof(ParserSymbol));
+        if (!new_symbols) return false;  // Out of memory
+
+        uint32_t mask = new_capacity - 1;
+        for (uint32_t i = 0; i < p->symbol_capacity; i++) {
+            if (!p->symbols[i].id) continue;
+            uint32_t slot = ir_flowchart_interned_hash(p->symbols[i].id) & mask;
+            while (new_symbols[slot].id) slot = (slot + 1) & mask;
+            new_symbols[slot] = p->symbols[i];
         }
-        // Also check if the ID matches a subgraph (subgraphs can be edge targets)
-        if (child && child->type == IR_COMPONENT_FLOWCHART_SUBGRAPH) {
-            IRFlowchartSubgraphData* sg_data = ir_get_flowchart_subgraph_data(child);
-            if (sg_data && sg_data->subgraph_id && strcmp(sg_data->subgraph_id, node_id) == 0) {
-                return true;  // This ID is a subgraph, not a node
-            }
-            // Also check children within the subgraph
-            if (node_exists_in_children(child, node_id)) {
-                return true;
-            }
+        free(p->symbols);
+        p->symbols = new_symbols;
+        p->symbol_capacity = new_capacity;
+    }
+
+    uint32_t mask = p->symbol_capacity - 1;
+    uint32_t slot = ir_flowchart_interned_hash(id) & mask;
+    while (p->symbols[slot].id) slot = (slot + 1) & mask;
+    p->symbols[slot].id = id;
+    p->symbols[slot].node = node;
+    p->symbol_count++;
+    return true;
+}
+
+// Create a node in the current subgraph (or the flowchart) and register its ID
+static bool parser_create_node(FlowchartParser* p, const char* node_id,
+                               IRFlowchartShape shape, const char* label) {
+    if (p->kir) {
+        // A settled writer frees the data once written, so the ID is registered first
+        IRFlowchartNodeData* data = ir_flowchart_node_data_create_in(p->state, node_id, shape, label);
+        const char* id = data ? data->node_id : NULL;
+        if (!id || !parser_add_symbol(p, id, data)) {
+            ir_flowchart_node_data_destroy(data);
+            return false;
         }
+        if (ir_flowchart_kir_add_node(p->kir, data)) return true;
+
+        // The writer freed the data
+        parser_find_symbol(p, id)->node = NULL;
+        return false;
+    }
+
+    IRComponent* node = ir_flowchart_create_node(p->flowchart, node_id, shape, label);
+    if (!node) return false;
+
+    ParserSubgraph* current = parser_current_subgraph(p);
+    ir_add_child(current ? current->component : p->flowchart, node);
+    IRFlowchartNodeData* data = ir_get_flowchart_node_data(node);
+    return data && parser_add_symbol(p, data->node_id, data);
+}
+
+// Node data for an ID (NULL if unknown or a subgraph)
+// Nodes are not registered with the state until finalization, so lookups during parsing go through here
+static IRFlowchartNodeData* parser_find_node(FlowchartParser* p, const char* node_id) {
+    if (p->kir_settled) return NULL;
+    ParserSymbol* symbol = parser_find_symbol(p, node_id);
+    return symbol ? symbol->node : NULL;
+}
+
+// Create an implicit rectangle node unless the ID is already a node or subgraph
+static void parser_ensure_node(FlowchartParser* p, const char* node_id) {
+    if (!parser_find_symbol(p, node_id)) {
+        parser_create_node(p, node_id, IR_FLOWCHART_SHAPE_RECTANGLE, node_id);
     }
-    return false;
+}
+
+// Edges always belong to the flowchart itself
+static void parser_create_edge(FlowchartParser* p, const char* from_id, const char* to_id,
+                               IRFlowchartEdgeType type, const char* label) {
+    if (p->kir) {
+        IRFlowchartEdgeData* data = ir_flowchart_edge_data_create_in(p->state, from_id, to_id);
+        if (data) {
+            data->type = type;
+            if (label) ir_flowchart_edge_set_label(data, label);
+        }
+        if (ir_flowchart_kir_add_edge(p->kir, data)) p->edge_count++;
+    } else {
+        IRComponent* edge = ir_flowchart_create_edge(p->flowchart, from_id, to_id, type);
+        if (!edge) return;
+        if (label) ir_flowchart_edge_set_label(ir_get_flowchart_edge_data(edge), label);
+        ir_add_child(p->flowchart, edge);
+        p->edge_count++;
+    }
+}
+
+// Make room for `ids` node IDs in both edge groups
+static bool parser_reserve_groups(FlowchartParser* p, uint32_t ids) {
+    for (int i = 0; i < 2; i++) {
+        ParserGroup* group = &p->groups[i];
+        if (group->capacity >= ids) continue;
+        uint32_t new_capacity = group->capacity == 0 ? 16 : group->capacity;
+        while (new_capacity < ids) new_capacity *= 2;
+        const char** new_ids = (const char**)realloc(group->ids, new_capacity * sizeof(const char*));
+        if (!new_ids) return false;
+        group->ids = new_ids;
+        group->capacity = new_capacity;
+    }
+    return true;
 }
 
 static uint32_t parse_hex_color(const char* str) {
@@ -340,482 +374,408 @@ static uint32_t parse_hex_color(const char* str) {
     return (r << 24) | (g << 16) | (b << 8) | a;
 }
 
-// Parse node shape from syntax like A[text], A{text}, A((text)), etc.
-static void parse_node_definition(FlowchartParser* p, const char* node_id) {
-    skip_whitespace(p);
-
-    IRFlowchartShape shape = IR_FLOWCHART_SHAPE_RECTANGLE;
-    char* label = NULL;
-
-    char c = peek(p);
-    char c2 = peek_next(p);
-
-    if (c == '[') {
-        if (c2 == '[') {  // [[subroutine]]
-            advance(p);
-            label = parse_text_in_brackets(p, '[', ']');
-            if (peek(p) == ']') advance(p);  // Extra ]
-            shape = IR_FLOWCHART_SHAPE_SUBROUTINE;
-        } else if (c2 == '(') {  // [(database)]
-            advance(p);
-            label = parse_text_in_brackets(p, '(', ')');
-            if (peek(p) == ']') advance(p);
-            shape = IR_FLOWCHART_SHAPE_CYLINDER;
-        } else if (c2 == '/') {  // [/parallelogram/] or [/trapezoid\]
-            advance(p); advance(p);  // Skip [/
-            size_t start = p->pos;
-            while (!is_at_end(p) && peek(p) != '/' && peek(p) != '\\') {
-                advance(p);
-            }
-            size_t len = p->pos - start;
-            label = (char*)malloc(len + 1);
-            memcpy(label, p->source + start, len);
-            label[len] = '\0';
-
-            if (peek(p) == '/') {
-                shape = IR_FLOWCHART_SHAPE_PARALLELOGRAM;
-                advance(p);
-            } else if (peek(p) == '\\') {
-                shape = IR_FLOWCHART_SHAPE_TRAPEZOID;
-                advance(p);
-            }
-            if (peek(p) == ']') advance(p);
-        } else {  // [rectangle]
-            label = parse_text_in_brackets(p, '[', ']');
-            shape = IR_FLOWCHART_SHAPE_RECTANGLE;
+// ============================================================================
+// Grammar
+// ============================================================================
+
+// node_ref := IDENT [SHAPE]
+// The node is created on first use; a shape only applies where it is created.
+static const char* parse_node_ref(FlowchartParser* p) {
+    const char* node_id = token_id(p, next_token(p));
+    if (!node_id) return NULL;
+
+    if (check_token(p, IR_FLOWCHART_TOKEN_SHAPE)) {
+        const IRFlowchartToken* shape = next_token(p);
+        // Check if node already exists - skip creating duplicate
+        if (!parser_find_symbol(p, node_id)) {
+            char* label = token_label(p, shape);
+            parser_create_node(p, node_id, (IRFlowchartShape)shape->kind, label ? label : node_id);
         }
-    } else if (c == '(') {
-        if (c2 == '(') {  // ((circle))
-            advance(p);
-            label = parse_text_in_brackets(p, '(', ')');
-            if (peek(p) == ')') advance(p);
-            shape = IR_FLOWCHART_SHAPE_CIRCLE;
-        } else if (c2 == '[') {  // ([stadium])
-            advance(p);
-            label = parse_text_in_brackets(p, '[', ']');
-            if (peek(p) == ')') advance(p);
-            shape = IR_FLOWCHART_SHAPE_STADIUM;
-        } else {  // (rounded)
-            label = parse_text_in_brackets(p, '(', ')');
-            shape = IR_FLOWCHART_SHAPE_ROUNDED;
-        }
-    } else if (c == '{') {
-        if (c2 == '{') {  // {{hexagon}}
-            advance(p);
-            label = parse_text_in_brackets(p, '{', '}');
-            if (peek(p) == '}') advance(p);
-            shape = IR_FLOWCHART_SHAPE_HEXAGON;
-        } else {  // {diamond}
-            label = parse_text_in_brackets(p, '{', '}');
-            shape = IR_FLOWCHART_SHAPE_DIAMOND;
-        }
-    } else if (c == '>') {  // >asymmetric]
-        advance(p);  // Skip >
-        size_t start = p->pos;
-        while (!is_at_end(p) && peek(p) != ']') {
-            advance(p);
-        }
-        size_t len = p->pos - start;
-        label = (char*)malloc(len + 1);
-        memcpy(label, p->source + start, len);
-        label[len] = '\0';
-        if (peek(p) == ']') advance(p);
-        shape = IR_FLOWCHART_SHAPE_ASYMMETRIC;
-    }
-
-    // If no label parsed, use node_id as label
-    if (!label) {
-        label = strdup(node_id);
+    } else {
+        parser_ensure_node(p, node_id);
     }
+    return node_id;
+}
 
-    // Check if node already exists - skip creating duplicate
-    bool already_exists = node_exists_in_children(p->flowchart, node_id);
-    IRComponent* current = parser_current_subgraph(p);
-    if (current && !already_exists) {
-        already_exists = node_exists_in_children(current, node_id);
+// node_group := node_ref ("&" node_ref)*
+static bool parse_node_group(FlowchartParser* p, ParserGroup* group) {
+    group->count = 0;
+    for (;;) {
+        const char* node_id = parse_node_ref(p);
+        if (!node_id) return false;
+        group->ids[group->count++] = node_id;
+
+        if (!check_token(p, IR_FLOWCHART_TOKEN_AMPERSAND)) return true;
+        next_token(p);
+        if (!check_token(p, IR_FLOWCHART_TOKEN_IDENT)) return true;
     }
+}
 
-    if (!already_exists) {
-        // Create the node component
-        IRComponent* node = ir_flowchart_node(node_id, shape, label);
-
-        if (node) {
-            // Add to current subgraph or flowchart
-            if (current) {
-                ir_add_child(current, node);
-            } else {
-                ir_add_child(p->flowchart, node);
-            }
+// edge := [EDGE_LABEL] ARROW [EDGE_LABEL] node_group
+// Edges chain from the previous targets: A --> B --> C
+// Each hop connects every source to every target: A & B --> C & D
+static void parse_edges(FlowchartParser* p, ParserGroup* from, ParserGroup* to) {
+    for (;;) {
+        char* label = NULL;
+        if (check_token(p, IR_FLOWCHART_TOKEN_EDGE_LABEL)) {
+            label = token_text(p, next_token(p));
         }
-    }
+        if (!check_token(p, IR_FLOWCHART_TOKEN_ARROW)) return;
+        IRFlowchartEdgeType type = (IRFlowchartEdgeType)next_token(p)->kind;
 
-    free(label);
-}
-
-// Parse edge: A --> B, A -->|label| B, A -- label --> B
-static void parse_edge(FlowchartParser* p, const char* from_id) {
-    skip_whitespace(p);
-
-    IRFlowchartEdgeType type = IR_FLOWCHART_EDGE_ARROW;
-    char* label = NULL;
-
-    // Determine edge type
-    if (match(p, "<-->")) {
-        type = IR_FLOWCHART_EDGE_BIDIRECTIONAL;
-    } else if (match(p, "-.->") || match(p, "-..->")) {
-        type = IR_FLOWCHART_EDGE_DOTTED;
-    } else if (match(p, "==>")) {
-        type = IR_FLOWCHART_EDGE_THICK;
-    } else if (match(p, "-->")) {
-        type = IR_FLOWCHART_EDGE_ARROW;
-    } else if (match(p, "---")) {
-        type = IR_FLOWCHART_EDGE_OPEN;
-    } else if (match(p, "--")) {
-        // Could be "-- label -->" or just "--"
-        skip_whitespace(p);
-
-        // Check if there's a label before arrow
-        if (peek(p) != '-' && peek(p) != '=' && peek(p) != '.') {
-            // Parse label text
-            size_t start = p->pos;
-            while (!is_at_end(p) && !match(p, "-->") && !match(p, "--->")
-                   && peek(p) != '\n') {
-                if (strncmp(p->source + p->pos, "-->", 3) == 0) break;
-                advance(p);
-            }
-            size_t len = p->pos - start;
-            if (len > 0) {
-                label = (char*)malloc(len + 1);
-                memcpy(label, p->source + start, len);
-                label[len] = '\0';
-                // Trim whitespace
-                while (len > 0 && isspace(label[len - 1])) label[--len] = '\0';
-            }
-            // Now consume the arrow
-            skip_whitespace(p);
-            match(p, "-->");
-            type = IR_FLOWCHART_EDGE_ARROW;
-        } else {
-            type = IR_FLOWCHART_EDGE_OPEN;
+        // |label| after the arrow replaces any -- label --> text
+        if (check_token(p, IR_FLOWCHART_TOKEN_EDGE_LABEL)) {
+            label = token_text(p, next_token(p));
         }
-    } else {
-        return;  // Not an edge
-    }
 
-    // Check for |label| syntax after arrow
-    skip_whitespace(p);
-    if (peek(p) == '|') {
-        advance(p);  // Skip |
-        size_t start = p->pos;
-        while (!is_at_end(p) && peek(p) != '|') {
-            advance(p);
-        }
-        size_t len = p->pos - start;
-        if (label) free(label);  // Replace any existing label
-        label = (char*)malloc(len + 1);
-        memcpy(label, p->source + start, len);
-        label[len] = '\0';
-        if (peek(p) == '|') advance(p);
-    }
-
-    // Parse target node ID
-    skip_whitespace(p);
-    char* to_id = parse_identifier(p);
-    if (!to_id) {
-        if (label) free(label);
-        return;
-    }
+        if (!check_token(p, IR_FLOWCHART_TOKEN_IDENT)) return;
+        if (!parse_node_group(p, to)) return;
 
-    // Create implicit target node if it doesn't exist
-    IRComponent* current = parser_current_subgraph(p);
-    bool to_node_exists = node_exists_in_children(p->flowchart, to_id);
-    if (current && !to_node_exists) {
-        to_node_exists = node_exists_in_children(current, to_id);
-    }
-    if (!to_node_exists) {
-        IRComponent* to_node = ir_flowchart_node(to_id, IR_FLOWCHART_SHAPE_RECTANGLE, to_id);
-        if (to_node) {
-            if (current) {
-                ir_add_child(current, to_node);
-            } else {
-                ir_add_child(p->flowchart, to_node);
+        for (uint32_t i = 0; i < from->count; i++) {
+            for (uint32_t j = 0; j < to->count; j++) {
+                parser_create_edge(p, from->ids[i], to->ids[j], type, label);
             }
         }
-    }
 
-    // Create edge component
-    IRComponent* edge = ir_flowchart_edge(from_id, to_id, type);
-    if (edge && label) {
-        IRFlowchartEdgeData* data = ir_get_flowchart_edge_data(edge);
-        if (data) {
-            ir_flowchart_edge_set_label(data, label);
-        }
-    }
-
-    if (edge) {
-        ir_add_child(p->flowchart, edge);
-    }
-
-    // Check if the target node needs definition
-    skip_whitespace(p);
-    if (peek(p) == '[' || peek(p) == '(' || peek(p) == '{' || peek(p) == '>') {
-        parse_node_definition(p, to_id);
-    }
-
-    // Check for chained arrows: A --> B --> C
-    skip_whitespace(p);
-    char next = peek(p);
-    if (next == '-' || next == '=' || next == '<') {
-        // There's another edge following, parse it recursively with to_id as the new from_id
-        parse_edge(p, to_id);
+        ParserGroup* next = from;
+        from = to;
+        to = next;
     }
+}
 
-    if (label) free(label);
-    free(to_id);
+// node_statement := node_group (edge)*
+static void parse_node_statement(FlowchartParser* p) {
+    // A statement never names more nodes than it has tokens, so the groups never grow mid-statement
+    if (!parser_reserve_groups(p, p->tokens.count - p->next)) return;
+    if (!parse_node_group(p, &p->groups[0])) return;
+    parse_edges(p, &p->groups[0], &p->groups[1]);
 }
 
+// subgraph := "subgraph" [IDENT] ["[" title "]"]
 static void parse_subgraph(FlowchartParser* p) {
-    skip_whitespace(p);
-
-    // Parse subgraph ID
-    char* subgraph_id = parse_identifier(p);
+    const char* subgraph_id = NULL;
+    if (check_token(p, IR_FLOWCHART_TOKEN_IDENT)) {
+        subgraph_id = token_id(p, next_token(p));
+        if (!subgraph_id) return;
+    }
 
-    // Parse optional title in brackets (supports both [text] and ["quoted text"])
-    skip_whitespace(p);
+    // Optional title in brackets (supports both [text] and ["quoted text"])
     char* title = NULL;
-    if (peek(p) == '[') {
-        size_t save_pos = p->pos;  // Save position in case we need to backtrack
-        advance(p);  // Skip '['
-        skip_whitespace(p);
-
-        if (peek(p) == '"') {
-            // Handle ["quoted text"] format
-            title = parse_quoted_string(p);
-            skip_whitespace(p);
-            if (peek(p) == ']') advance(p);  // Skip ']'
-        } else {
-            // Handle [plain text] format - restore position and use existing parser
-            p->pos = save_pos;
-            title = parse_text_in_brackets(p, '[', ']');
-        }
+    if (check_token(p, IR_FLOWCHART_TOKEN_SHAPE) && peek_token(p)->kind == IR_FLOWCHART_SHAPE_RECTANGLE) {
+        title = token_label(p, next_token(p));
     }
 
     // Create subgraph component
-    IRComponent* subgraph = ir_flowchart_subgraph(subgraph_id, title ? title : subgraph_id);
+    ParserSubgraph* parent = parser_current_subgraph(p);
+    IRComponent* subgraph = NULL;
+    IRFlowchartSubgraphData* data = NULL;
+    if (p->kir) {
+        data = ir_flowchart_subgraph_data_create_in(p->state, subgraph_id, title ? title : subgraph_id);
+        if (!ir_flowchart_kir_begin_subgraph(p->kir, data)) return;
+    } else {
+        subgraph = ir_flowchart_create_subgraph(p->flowchart, subgraph_id, title ? title : subgraph_id);
+        if (!subgraph) return;
 
-    if (subgraph) {
         // Add subgraph to parent (current subgraph or flowchart root)
-        IRComponent* parent = parser_current_subgraph(p);
-        if (parent) {
-            ir_add_child(parent, subgraph);
-
-            // Set parent_subgraph_id for nested subgraphs
-            IRFlowchartSubgraphData* subgraph_data = ir_get_flowchart_subgraph_data(subgraph);
-            IRFlowchartSubgraphData* parent_data = ir_get_flowchart_subgraph_data(parent);
-            if (subgraph_data && parent_data && parent_data->subgraph_id) {
-                subgraph_data->parent_subgraph_id = strdup(parent_data->subgraph_id);
-            }
-        } else {
-            ir_add_child(p->flowchart, subgraph);
-        }
+        ir_add_child(parent ? parent->component : p->flowchart, subgraph);
+        data = ir_get_flowchart_subgraph_data(subgraph);
+    }
+    if (!data) return;
 
-        // Push new subgraph onto stack
-        parser_push_subgraph(p, subgraph);
+    // Set parent_subgraph_id for nested subgraphs (both IDs live in the same arena)
+    if (parent) data->parent_subgraph_id = parent->data->subgraph_id;
 
-        // Check for direction directive inside subgraph
-        skip_whitespace_and_newlines(p);
-        if (match_case_insensitive(p, "direction")) {
-            IRFlowchartDirection dir = parse_direction(p);
+    // Subgraph IDs can be edge targets
+    if (data->subgraph_id) parser_add_symbol(p, data->subgraph_id, NULL);
 
-            // Set the direction in the subgraph data
-            IRFlowchartSubgraphData* data = ir_get_flowchart_subgraph_data(subgraph);
-            if (data) {
-                data->direction = dir;
-            }
-        }
+    // Push new subgraph onto stack
+    if (!parser_push_subgraph(p, subgraph, data) && p->kir) {
+        // Keep the KIR events balanced with the stack
+        ir_flowchart_kir_end_subgraph(p->kir);
     }
-
-    if (subgraph_id) free(subgraph_id);
-    if (title) free(title);
 }
 
-static void parse_style(FlowchartParser* p) {
-    skip_whitespace(p);
+// direction := "direction" IDENT (local direction of the current subgraph)
+static void parse_direction(FlowchartParser* p) {
+    if (!check_token(p, IR_FLOWCHART_TOKEN_IDENT)) return;
+    char* direction = token_text(p, next_token(p));
 
-    char* node_id = parse_identifier(p);
-    if (!node_id) return;
+    ParserSubgraph* current = parser_current_subgraph(p);
+    if (current && direction) {
+        current->data->direction = ir_flowchart_parse_direction(direction);
+    }
+}
 
-    skip_whitespace(p);
+// style := "style" IDENT property ("," property)*
+static void parse_style(FlowchartParser* p) {
+    if (!check_token(p, IR_FLOWCHART_TOKEN_REST)) return;
+    const IRFlowchartToken* rest = next_token(p);
+    const char* text = p->line + rest->start;
+    size_t length = rest->length;
 
-    // Parse style properties (basic support for fill: and stroke:)
-    while (!is_at_end(p) && peek(p) != '\n') {
-        skip_whitespace(p);
+    size_t i = 0;
+    while (i < length && (isalnum((unsigned char)text[i]) || text[i] == '_')) i++;
+    if (i == 0) return;
+
+    const char* node_id = ir_flowchart_intern_n(p->state->strings, text, i);
+    IRFlowchartNodeData* node = node_id ? parser_find_node(p, node_id) : NULL;
+    if (!node) return;
+
+    IRFlowchartStyle style = {0};
+    parse_style_properties(&style, text + i, length - i);
+    if (style.flags & IR_FLOWCHART_STYLE_FILL) ir_flowchart_node_set_fill_color(node, style.fill_color);
+    if (style.flags & IR_FLOWCHART_STYLE_STROKE) ir_flowchart_node_set_stroke_color(node, style.stroke_color);
+    if (style.flags & IR_FLOWCHART_STYLE_STROKE_WIDTH) ir_flowchart_node_set_stroke_width(node, style.stroke_width);
+}
 
-        if (match_case_insensitive(p, "fill:")) {
-            skip_whitespace(p);
-            // Parse color value
-            size_t start = p->pos;
-            while (!is_at_end(p) && peek(p) != ',' && peek(p) != '\n' && !isspace(peek(p))) {
-                advance(p);
-            }
-            size_t len = p->pos - start;
-            char* color_str = (char*)malloc(len + 1);
-            memcpy(color_str, p->source + start, len);
-            color_str[len] = '\0';
-
-            // Find the node and set fill color
-            IRFlowchartNodeData* node = ir_flowchart_find_node(p->state, node_id);
-            if (node) {
-                node->fill_color = parse_hex_color(color_str);
-            }
-            free(color_str);
-        } else if (match_case_insensitive(p, "stroke:")) {
-            skip_whitespace(p);
-            size_t start = p->pos;
-            while (!is_at_end(p) && peek(p) != ',' && peek(p) != '\n' && !isspace(peek(p))) {
-                advance(p);
-            }
-            size_t len = p->pos - start;
-            char* color_str = (char*)malloc(len + 1);
-            memcpy(color_str, p->source + start, len);
-            color_str[len] = '\0';
-
-            IRFlowchartNodeData* node = ir_flowchart_find_node(p->state, node_id);
-            if (node) {
-                node->stroke_color = parse_hex_color(color_str);
-            }
-            free(color_str);
-        } else if (match_case_insensitive(p, "stroke-width:")) {
-            skip_whitespace(p);
-            float width = 2.0f;
-            sscanf(p->source + p->pos, "%f", &width);
-            while (!is_at_end(p) && (isdigit(peek(p)) || peek(p) == '.')) {
-                advance(p);
-            }
+// Length of the comma-separated list leading a class or link statement
+static size_t style_list_length(const char* text, size_t length) {
+    size_t i = 0;
+    while (i < length && !isspace((unsigned char)text[i])) i++;
+    return i;
+}
 
-            IRFlowchartNodeData* node = ir_flowchart_find_node(p->state, node_id);
-            if (node) {
-                node->stroke_width = width;
-            }
-        } else {
-            // Skip unknown property
-            while (!is_at_end(p) && peek(p) != ',' && peek(p) != '\n') {
-                advance(p);
-            }
+// Next item of a comma-separated list (NULL at the end)
+static const char* next_list_item(const char* text, size_t length, size_t* pos, size_t* item_length) {
+    while (*pos < length) {
+        size_t start = *pos;
+        while (*pos < length && text[*pos] != ',') (*pos)++;
+        size_t end = (*pos)++;
+        if (end > start) {
+            *item_length = end - start;
+            return text + start;
         }
+    }
+    return NULL;
+}
 
-        // Skip comma separator
-        if (peek(p) == ',') advance(p);
+// class_def := "classDef" NAME ("," NAME)* property ("," property)*
+// The properties are parsed once into the class's style table entry
+static void parse_class_def(FlowchartParser* p) {
+    if (!check_token(p, IR_FLOWCHART_TOKEN_REST)) return;
+    const IRFlowchartToken* rest = next_token(p);
+    const char* text = p->line + rest->start;
+    size_t list = style_list_length(text, rest->length);
+
+    IRFlowchartStyle style = {0};
+    parse_style_properties(&style, text + list, rest->length - list);
+
+    size_t pos = 0, name_length = 0;
+    const char* name;
+    while ((name = next_list_item(text, list, &pos, &name_length))) {
+        const char* interned = ir_flowchart_intern_n(p->state->strings, name, name_length);
+        if (interned) ir_flowchart_define_class(p->state, interned, &style);
     }
+}
 
-    free(node_id);
+// class := "class" IDENT ("," IDENT)* NAME ("," NAME)*
+// Only the class index is stored on the node; finalization applies the properties
+static void parse_class(FlowchartParser* p) {
+    if (!check_token(p, IR_FLOWCHART_TOKEN_REST)) return;
+    const IRFlowchartToken* rest = next_token(p);
+    const char* text = p->line + rest->start;
+    size_t ids = style_list_length(text, rest->length);
+
+    size_t start = ids;
+    while (start < rest->length && isspace((unsigned char)text[start])) start++;
+    const char* names = text + start;
+    size_t names_length = style_list_length(names, rest->length - start);
+
+    size_t name_pos = 0, name_length = 0;
+    const char* name;
+    while ((name = next_list_item(names, names_length, &name_pos, &name_length))) {
+        const char* class_name = ir_flowchart_intern_n(p->state->strings, name, name_length);
+        if (!class_name) return;
+
+        size_t id_pos = 0, id_length = 0;
+        const char* id;
+        while ((id = next_list_item(text, ids, &id_pos, &id_length))) {
+            const char* node_id = ir_flowchart_intern_n(p->state->strings, id, id_length);
+            IRFlowchartNodeData* node = node_id ? parser_find_node(p, node_id) : NULL;
+            if (node) ir_flowchart_node_add_class(p->state, node, class_name);
+        }
+    }
 }
 
-static void parse_line(FlowchartParser* p) {
-    skip_whitespace(p);
+// link_style := "linkStyle" ("default" | INDEX ("," INDEX)*) property ("," property)*
+// Indices count edges in declaration order; edges not declared yet are ignored
+static void parse_link_style(FlowchartParser* p) {
+    if (!check_token(p, IR_FLOWCHART_TOKEN_REST)) return;
+    const IRFlowchartToken* rest = next_token(p);
+    const char* text = p->line + rest->start;
+    size_t list = style_list_length(text, rest->length);
 
-    // Skip empty lines and comments
-    if (is_at_end(p) || peek(p) == '\n') return;
-    if (peek(p) == '%') {
-        while (!is_at_end(p) && peek(p) != '\n') advance(p);
+    IRFlowchartStyle style = {0};
+    parse_style_properties(&style, text + list, rest->length - list);
+
+    if (list == 7 && strncasecmp(text, "default", 7) == 0) {
+        ir_flowchart_set_link_style(p->state, IR_FLOWCHART_INVALID_INDEX, &style);
         return;
     }
 
-    // Check for keywords
-    if (match_case_insensitive(p, "subgraph")) {
-        parse_subgraph(p);
-        return;
+    size_t pos = 0, item_length = 0;
+    const char* item;
+    while ((item = next_list_item(text, list, &pos, &item_length))) {
+        uint32_t index = 0;
+        size_t i = 0;
+        while (i < item_length && isdigit((unsigned char)item[i]) && index < p->edge_count) {
+            index = index * 10 + (uint32_t)(item[i] - '0');
+            i++;
+        }
+        if (i == item_length && index < p->edge_count) {
+            ir_flowchart_set_link_style(p->state, index, &style);
+        }
     }
+}
 
-    if (match_case_insensitive(p, "end")) {
-        // End of subgraph - pop from stack
-        parser_pop_subgraph(p);
-        return;
+// properties := property ("," property)*
+static void parse_style_properties(IRFlowchartStyle* style, const char* text, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        // Skip whitespace and comma separators
+        while (i < length && (isspace((unsigned char)text[i]) || text[i] == ',')) i++;
+        size_t start = i;
+        while (i < length && text[i] != ',') i++;
+        if (i > start) parse_style_property(style, text + start, i - start);
     }
+}
 
-    if (match_case_insensitive(p, "style")) {
-        parse_style(p);
-        return;
+// Compile one "key:value" style property (basic support for fill, stroke and stroke-width)
+static void parse_style_property(IRFlowchartStyle* style, const char* text, size_t length) {
+    const char* colon = (const char*)memchr(text, ':', length);
+    if (!colon) return;
+
+    size_t key_length = (size_t)(colon - text);
+    const char* value = colon + 1;
+    size_t value_length = length - key_length - 1;
+    while (value_length > 0 && isspace((unsigned char)*value)) {
+        value++;
+        value_length--;
     }
 
-    if (match_case_insensitive(p, "classDef") || match_case_insensitive(p, "class")) {
-        // Skip class definitions for now
-        while (!is_at_end(p) && peek(p) != '\n') advance(p);
-        return;
+    // The value ends at the first blank
+    char buffer[32];
+    size_t n = 0;
+    while (n < value_length && n + 1 < sizeof(buffer) && !isspace((unsigned char)value[n])) {
+        buffer[n] = value[n];
+        n++;
+    }
+    buffer[n] = '\0';
+
+    if (key_length == 4 && strncasecmp(text, "fill", 4) == 0) {
+        style->fill_color = parse_hex_color(buffer);
+        style->flags |= IR_FLOWCHART_STYLE_FILL;
+    } else if (key_length == 6 && strncasecmp(text, "stroke", 6) == 0) {
+        style->stroke_color = parse_hex_color(buffer);
+        style->flags |= IR_FLOWCHART_STYLE_STROKE;
+    } else if (key_length == 12 && strncasecmp(text, "stroke-width", 12) == 0) {
+        float width = 2.0f;
+        sscanf(buffer, "%f", &width);
+        style->stroke_width = width;
+        style->flags |= IR_FLOWCHART_STYLE_STROKE_WIDTH;
     }
+    // Unknown properties are ignored
+}
 
-    if (match_case_insensitive(p, "linkStyle")) {
-        // Skip link styles for now
-        while (!is_at_end(p) && peek(p) != '\n') advance(p);
-        return;
+static void parse_statement(FlowchartParser* p) {
+    const IRFlowchartToken* token = peek_token(p);
+
+    if (token->type == IR_FLOWCHART_TOKEN_KEYWORD) {
+        next_token(p);
+        switch ((IRFlowchartKeyword)token->kind) {
+            case IR_FLOWCHART_KEYWORD_SUBGRAPH:
+                parse_subgraph(p);
+                break;
+            case IR_FLOWCHART_KEYWORD_END:
+                // End of subgraph - pop from stack
+                parser_pop_subgraph(p);
+                break;
+            case IR_FLOWCHART_KEYWORD_STYLE:
+                parse_style(p);
+                break;
+            case IR_FLOWCHART_KEYWORD_DIRECTION:
+                parse_direction(p);
+                break;
+            case IR_FLOWCHART_KEYWORD_CLASSDEF:
+                parse_class_def(p);
+                break;
+            case IR_FLOWCHART_KEYWORD_CLASS:
+                parse_class(p);
+                break;
+            case IR_FLOWCHART_KEYWORD_LINKSTYLE:
+                parse_link_style(p);
+                break;
+            case IR_FLOWCHART_KEYWORD_CLICK:
+                // Interactions have no meaning here; the node named is not created
+                break;
+        }
+    } else if (token->type == IR_FLOWCHART_TOKEN_IDENT) {
+        parse_node_statement(p);
     }
+}
 
-    // Parse node ID
-    char* node_id = parse_identifier(p);
-    if (!node_id) {
-        // Skip to end of line
-        while (!is_at_end(p) && peek(p) != '\n') advance(p);
-        return;
+// Parse one line of the body
+// Each statement runs up to its END token; whatever a statement leaves unparsed is skipped.
+static bool parse_line(FlowchartParser* p, const char* line, size_t length) {
+    p->line_number++;
+    if (!ir_flowchart_lex_line(&p->tokens, line, length)) return false;
+    if (p->tokens.count == 0) return true;
+
+    // Token copies never take more than the line plus a terminator each
+    size_t needed = 2 * (length + p->tokens.count) + 1;
+    if (needed > p->text_capacity) {
+        size_t new_capacity = p->text_capacity == 0 ? 256 : p->text_capacity;
+        while (new_capacity < needed) new_capacity *= 2;
+        char* new_text = (char*)realloc(p->text, new_capacity);
+        if (!new_text) return false;
+        p->text = new_text;
+        p->text_capacity = new_capacity;
     }
 
-    skip_whitespace(p);
+    p->line = line;
+    p->text_count = 0;
+    p->next = 0;
+    while (p->next < p->tokens.count) {
+        parse_statement(p);
+        while (p->tokens.tokens[p->next].type != IR_FLOWCHART_TOKEN_END) p->next++;
+        p->next++;
+    }
+    return true;
+}
 
-    // Check what follows the identifier
-    char c = peek(p);
+// Parse header: "flowchart TB" or "graph LR" etc.
+static bool parse_header(FlowchartParser* p, const char* line) {
+    const IRFlowchartToken* tokens = p->tokens.tokens;
+    if (tokens[0].type != IR_FLOWCHART_TOKEN_IDENT) return false;
 
-    if (c == '[' || c == '(' || c == '{' || c == '>') {
-        // Node definition
-        parse_node_definition(p, node_id);
-        skip_whitespace(p);
+    const char* keyword = line + tokens[0].start;
+    if (!(tokens[0].length == 9 && strncasecmp(keyword, "flowchart", 9) == 0) &&
+        !(tokens[0].length == 5 && strncasecmp(keyword, "graph", 5) == 0)) {
+        return false;
+    }
 
-        // Check for chained edge after node definition
-        c = peek(p);
-        if (c == '-' || c == '=' || c == '<') {
-            parse_edge(p, node_id);
-        }
-    } else if (c == '-' || c == '=' || c == '<') {
-        // Edge (node might be defined elsewhere or implicitly)
-        // First ensure node exists (check children, not state which isn't finalized yet)
-        IRComponent* current = parser_current_subgraph(p);
-        bool node_exists = node_exists_in_children(p->flowchart, node_id);
-        if (current && !node_exists) {
-            node_exists = node_exists_in_children(current, node_id);
-        }
-        if (!node_exists) {
-            // Create implicit node with default shape
-            IRComponent* node = ir_flowchart_node(node_id, IR_FLOWCHART_SHAPE_RECTANGLE, node_id);
-            if (node) {
-                if (current) {
-                    ir_add_child(current, node);
-                } else {
-                    ir_add_child(p->flowchart, node);
-                }
-            }
-        }
-        parse_edge(p, node_id);
-    } else if (c == '&') {
-        // Node chain: A & B & C (multiple nodes, often styled together)
-        // For now, just create the first node
-        IRComponent* current = parser_current_subgraph(p);
-        bool node_exists = node_exists_in_children(p->flowchart, node_id);
-        if (current && !node_exists) {
-            node_exists = node_exists_in_children(current, node_id);
-        }
-        if (!node_exists) {
-            IRComponent* node = ir_flowchart_node(node_id, IR_FLOWCHART_SHAPE_RECTANGLE, node_id);
-            if (node) {
-                if (current) {
-                    ir_add_child(current, node);
-                } else {
-                    ir_add_child(p->flowchart, node);
-                }
-            }
-        }
-        // Skip the rest of the chain for now
-        while (!is_at_end(p) && peek(p) != '\n') advance(p);
+    // Parse direction
+    p->direction = IR_FLOWCHART_DIR_TB;
+    if (tokens[1].type == IR_FLOWCHART_TOKEN_IDENT && tokens[1].length == 2) {
+        char direction[3] = { line[tokens[1].start], line[tokens[1].start + 1], '\0' };
+        p->direction = ir_flowchart_parse_direction(direction);
     }
+    return true;
+}
 
-    free(node_id);
+static void parser_destroy(FlowchartParser* p) {
+    if (p->kir) {
+        ir_flowchart_kir_writer_destroy(p->kir);
+        ir_flowchart_destroy_state(p->state);
+        p->kir = NULL;
+        p->state = NULL;
+    }
+    ir_flowchart_token_stream_destroy(&p->tokens);
+    free(p->text);
+    free(p->subgraph_stack);
+    free(p->symbols);
+    free(p->groups[0].ids);
+    free(p->groups[1].ids);
 }
 
 bool ir_flowchart_is_mermaid(const char* source, size_t length) {
@@ -836,68 +796,198 @@ bool ir_flowchart_is_mermaid(const char* source, size_t length) {
     return false;
 }
 
+// Feed one line: the header until it has been seen, the body after that
+static bool parser_feed_line(FlowchartParser* p, const char* line, size_t length) {
+    if (p->state) return parse_line(p, line, length);
+
+    // Header is the first line with tokens (blank and comment lines are skipped)
+    p->line_number++;
+    if (!ir_flowchart_lex_line(&p->tokens, line, length)) return false;
+    if (p->tokens.count == 0) return true;
+    if (!parse_header(p, line)) return false;  // Not a valid flowchart header
+
+    // KIR output needs only the state (for its string arena)
+    if (p->kir) {
+        p->state = ir_flowchart_create_state();
+        if (!p->state) return false;
+        p->state->direction = p->direction;
+        return ir_flowchart_kir_begin(p->kir, p->state);
+    }
+
+    // Create flowchart component
+    p->flowchart = ir_flowchart(p->direction);
+    if (!p->flowchart) return false;
+    p->state = ir_get_flowchart_state(p->flowchart);
+    return true;
+}
+
+// Feed every line of a complete source
+static bool parser_feed_source(FlowchartParser* p, const char* source, size_t length) {
+    const char* cursor = source;
+    const char* end = source + length;
+    while (cursor < end) {
+        size_t line_length;
+        const char* line = cursor;
+        cursor = ir_flowchart_next_line(cursor, end, &line_length);
+        if (!parser_feed_line(p, line, line_length)) return false;
+    }
+    return true;
+}
+
+// Drop everything built so far
+static void parser_fail(FlowchartParser* p) {
+    if (p->flowchart) {
+        // The state goes with the component
+        ir_flowchart_free_component(p->flowchart);
+        p->flowchart = NULL;
+        p->state = NULL;
+    }
+    parser_destroy(p);
+}
+
+// Finalize the flowchart (NULL if no header was seen) and free the parser
+static IRComponent* parser_finish(FlowchartParser* p) {
+    IRComponent* flowchart = p->flowchart;
+
+    // Finalize flowchart (register all nodes/edges)
+    if (flowchart) ir_flowchart_finalize(flowchart);
+
+    // Cleanup tokens, stack and symbol table
+    parser_destroy(p);
+    return flowchart;
+}
+
 IRComponent* ir_flowchart_parse(const char* source, size_t length) {
     if (!source || length == 0) return NULL;
 
+    // A source parsed before is cloned from the cache
+    uint64_t key = 0;
+    if (ir_flowchart_cache_enabled()) {
+        key = ir_flowchart_cache_hash(source, length);
+        IRComponent* cached = ir_flowchart_cache_find_parse(source, length, key);
+        if (cached) return cached;
+    }
+
     FlowchartParser parser = {0};
-    parser.source = source;
-    parser.length = length;
-    parser.pos = 0;
-    parser.line = 1;
-    parser.col = 0;
     parser.direction = IR_FLOWCHART_DIR_TB;
-    parser.subgraph_stack = NULL;
-    parser.stack_depth = 0;
-    parser.stack_capacity = 0;
-
-    skip_whitespace_and_newlines(&parser);
-
-    // Parse header: "flowchart TB" or "graph LR" etc.
-    if (match_case_insensitive(&parser, "flowchart") || match_case_insensitive(&parser, "graph")) {
-        skip_whitespace(&parser);
-
-        // Parse direction
-        if (match_case_insensitive(&parser, "TB") || match_case_insensitive(&parser, "TD")) {
-            parser.direction = IR_FLOWCHART_DIR_TB;
-        } else if (match_case_insensitive(&parser, "LR")) {
-            parser.direction = IR_FLOWCHART_DIR_LR;
-        } else if (match_case_insensitive(&parser, "BT")) {
-            parser.direction = IR_FLOWCHART_DIR_BT;
-        } else if (match_case_insensitive(&parser, "RL")) {
-            parser.direction = IR_FLOWCHART_DIR_RL;
-        }
-    } else {
-        // Not a valid flowchart header
+    if (!parser_feed_source(&parser, source, length)) {
+        parser_fail(&parser);
         return NULL;
     }
 
-    // Create flowchart component
-    parser.flowchart = ir_flowchart(parser.direction);
-    if (!parser.flowchart) return NULL;
-
-    parser.state = ir_get_flowchart_state(parser.flowchart);
-
-    // Parse body lines
-    while (!is_at_end(&parser)) {
-        skip_whitespace_and_newlines(&parser);
-        if (!is_at_end(&parser)) {
-            parse_line(&parser);
-            // Skip to next line
-            while (!is_at_end(&parser) && peek(&parser) != '\n') {
-                advance(&parser);
-            }
-        }
+    IRComponent* flowchart = parser_finish(&parser);
+    if (flowchart && key != 0) {
+        ir_get_flowchart_state(flowchart)->content_key = key;
+        ir_flowchart_cache_store_parse(source, length, key, flowchart);
     }
+    return flowchart;
+}
 
-    // Finalize flowchart (register all nodes/edges)
-    ir_flowchart_finalize(parser.flowchart);
+// ============================================================================
+// Streaming Parse
+// ============================================================================
+// Complete lines are parsed straight from the caller's chunk; only a line
+// split across chunks is copied, into a carry-over buffer that never grows
+// past IR_FLOWCHART_PARSE_MAX_LINE.
+
+struct IRFlowchartParseStream {
+    FlowchartParser parser;
+    bool failed;                       // Set on the first error; later feeds are ignored
+
+    // Start of a line whose end has not arrived yet
+    char* carry;
+    size_t carry_length;
+    size_t carry_capacity;
+};
+
+IRFlowchartParseStream* ir_flowchart_parse_begin(void) {
+    IRFlowchartParseStream* stream = (IRFlowchartParseStream*)calloc(1, sizeof(IRFlowchartParseStream));
+    if (!stream) return NULL;
+    stream->parser.direction = IR_FLOWCHART_DIR_TB;
+    return stream;
+}
+
+// Helper: Append a partial line to the carry-over buffer
+static bool stream_carry(IRFlowchartParseStream* stream, const char* data, size_t length) {
+    size_t needed = stream->carry_length + length;
+    if (needed > IR_FLOWCHART_PARSE_MAX_LINE) return false;
+    if (needed > stream->carry_capacity) {
+        size_t new_capacity = stream->carry_capacity == 0 ? 256 : stream->carry_capacity;
+        while (new_capacity < needed) new_capacity *= 2;
+        char* new_carry = (char*)realloc(stream->carry, new_capacity);
+        if (!new_carry) return false;
+        stream->carry = new_carry;
+        stream->carry_capacity = new_capacity;
+    }
+    memcpy(stream->carry + stream->carry_length, data, length);
+    stream->carry_length = needed;
+    return true;
+}
+
+// Helper: Parse a complete line, dropping a "\r" left by "\r\n"
+static bool stream_line(IRFlowchartParseStream* stream, const char* line, size_t length) {
+    if (length > 0 && line[length - 1] == '\r') length--;
+    return parser_feed_line(&stream->parser, line, length);
+}
+
+// Helper: Parse the lines completed by a chunk and carry over its tail
+static bool stream_feed(IRFlowchartParseStream* stream, const char* data, size_t length) {
+    const char* cursor = data;
+    const char* end = data + length;
+
+    // Complete the line carried over from the previous chunk
+    if (stream->carry_length > 0) {
+        const char* newline = (const char*)memchr(cursor, '\n', length);
+        size_t part = newline ? (size_t)(newline - cursor) : length;
+        if (!stream_carry(stream, cursor, part)) return false;
+        if (!newline) return true;
+
+        size_t carry_length = stream->carry_length;
+        stream->carry_length = 0;
+        if (!stream_line(stream, stream->carry, carry_length)) return false;
+        cursor = newline + 1;
+    }
+
+    // Complete lines are parsed in place
+    while (cursor < end) {
+        const char* newline = (const char*)memchr(cursor, '\n', (size_t)(end - cursor));
+        if (!newline) break;
+        if (!stream_line(stream, cursor, (size_t)(newline - cursor))) return false;
+        cursor = newline + 1;
+    }
+
+    // Keep the unterminated tail for the next chunk
+    return cursor == end || stream_carry(stream, cursor, (size_t)(end - cursor));
+}
 
-    // Cleanup stack
-    if (parser.subgraph_stack) {
-        free(parser.subgraph_stack);
+bool ir_flowchart_parse_feed(IRFlowchartParseStream* stream, const char* data, size_t length) {
+    if (!stream || stream->failed) return false;
+    if (!data || length == 0) return true;
+
+    if (!stream_feed(stream, data, length)) {
+        stream->failed = true;
+        parser_fail(&stream->parser);
+        return false;
+    }
+    return true;
+}
+
+IRComponent* ir_flowchart_parse_end(IRFlowchartParseStream* stream) {
+    if (!stream) return NULL;
+
+    IRComponent* flowchart = NULL;
+    if (!stream->failed) {
+        // The last line needs no terminator
+        if (stream->carry_length > 0 && !stream_line(stream, stream->carry, stream->carry_length)) {
+            parser_fail(&stream->parser);
+        } else {
+            flowchart = parser_finish(&stream->parser);
+        }
     }
 
-    return parser.flowchart;
+    free(stream->carry);
+    free(stream);
+    return flowchart;
 }
 
 char* ir_flowchart_to_kir(const char* source, size_t length) {
@@ -908,7 +998,103 @@ char* ir_flowchart_to_kir(const char* source, size_t length) {
     char* json = ir_serialize_json_v2(flowchart);
 
     // Clean up
-    ir_destroy_component(flowchart);
+    ir_flowchart_free_component(flowchart);
 
     return json;
 }
+
+// ============================================================================
+// Direct KIR Output
+// ============================================================================
+// The parser reports elements to a KIR writer instead of building
+// components; see flowchart_kir.h.
+
+// Does a line hold a statement that styles elements declared before it?
+static bool parser_styles_line(FlowchartParser* p, const char* line, size_t length) {
+    // Every such statement starts with "style", "class", "classDef" or "linkStyle"
+    bool candidate = false;
+    for (size_t i = 0; i + 5 <= length && !candidate; i++) {
+        char c = (char)(line[i] | 0x20);
+        candidate = (c == 's' && strncasecmp(line + i, "style", 5) == 0) ||
+                    (c == 'c' && strncasecmp(line + i, "class", 5) == 0);
+    }
+    if (!candidate || !ir_flowchart_lex_line(&p->tokens, line, length)) return candidate;
+
+    for (uint32_t i = 0; i < p->tokens.count; i++) {
+        const IRFlowchartToken* token = &p->tokens.tokens[i];
+        if (token->type == IR_FLOWCHART_TOKEN_KEYWORD &&
+            (token->kind == IR_FLOWCHART_KEYWORD_STYLE || token->kind == IR_FLOWCHART_KEYWORD_CLASSDEF ||
+             token->kind == IR_FLOWCHART_KEYWORD_CLASS || token->kind == IR_FLOWCHART_KEYWORD_LINKSTYLE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Length of the source up to the end of its last styling line
+static size_t parser_style_horizon(FlowchartParser* p, const char* source, size_t length) {
+    const char* cursor = source;
+    const char* end = source + length;
+    size_t horizon = 0;
+    while (cursor < end) {
+        size_t line_length;
+        const char* line = cursor;
+        cursor = ir_flowchart_next_line(cursor, end, &line_length);
+        if (parser_styles_line(p, line, line_length)) horizon = (size_t)(cursor - source);
+    }
+    return horizon;
+}
+
+bool ir_flowchart_write_kir(const char* source, size_t length, IRFlowchartWriteFn write, void* user_data) {
+    if (!source || length == 0 || !write) return false;
+
+    FlowchartParser parser = {0};
+    parser.direction = IR_FLOWCHART_DIR_TB;
+    parser.kir = ir_flowchart_kir_writer_create(write, user_data);
+    if (!parser.kir) return false;
+
+    // Elements are written as they are parsed once no style statement can change them
+    size_t horizon = parser_style_horizon(&parser, source, length);
+    bool ok = parser_feed_source(&parser, source, horizon);
+    if (ok) {
+        ir_flowchart_kir_settle(parser.kir);
+        parser.kir_settled = true;
+        ok = parser_feed_source(&parser, source + horizon, length - horizon) && parser.state &&
+             ir_flowchart_kir_finish(parser.kir);
+    }
+    parser_destroy(&parser);
+    return ok;
+}
+
+// Growable output for ir_flowchart_to_kir_direct()
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} KirBuffer;
+
+static bool kir_buffer_write(const char* data, size_t length, void* user_data) {
+    KirBuffer* buffer = (KirBuffer*)user_data;
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t new_capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+        while (new_capacity < buffer->length + length + 1) new_capacity *= 2;
+        char* new_data = (char*)realloc(buffer->data, new_capacity);
+        if (!new_data) return false;
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+    return true;
+}
+
+char* ir_flowchart_to_kir_direct(const char* source, size_t length, size_t* out_length) {
+    KirBuffer buffer = {0};
+    if (!ir_flowchart_write_kir(source, length, kir_buffer_write, &buffer)) {
+        free(buffer.data);
+        return NULL;
+    }
+    if (out_length) *out_length = buffer.length;
+    return buffer.data;
+}
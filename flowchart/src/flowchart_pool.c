@@ -0,0 +1,138 @@
+// ============================================================================
+// FLOWCHART ELEMENT POOL
+// ============================================================================
+
+#include "flowchart_pool.h"
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Elements in the first slab; later slabs double
+#define POOL_FIRST_SLAB 64
+
+#define POOL_ALIGN alignof(max_align_t)
+#define POOL_ROUND(size) (((size) + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1))
+
+typedef struct PoolSlab {
+    struct PoolSlab* next;
+    uint32_t used;                     // Elements handed out from the slab so far
+    uint32_t capacity;
+    // Elements follow the slab header
+} PoolSlab;
+
+// Freed element (the link overlays its first bytes)
+typedef struct PoolFree {
+    struct PoolFree* next;
+} PoolFree;
+
+struct IRFlowchartPool {
+    size_t element_size;               // Rounded up to POOL_ALIGN
+    PoolSlab* slabs;                   // Most recent slab first; new elements come from it
+    PoolFree* free_list;
+    uint32_t free_count;
+    uint32_t live;                     // Elements currently out
+    bool released;                     // Owner gone; freed with the last element
+};
+
+#define POOL_HEADER_SIZE POOL_ROUND(sizeof(PoolSlab))
+
+static char* pool_slab_element(const IRFlowchartPool* pool, PoolSlab* slab, uint32_t index) {
+    return (char*)slab + POOL_HEADER_SIZE + (size_t)index * pool->element_size;
+}
+
+IRFlowchartPool* ir_flowchart_pool_create(size_t element_size) {
+    IRFlowchartPool* pool = (IRFlowchartPool*)calloc(1, sizeof(IRFlowchartPool));
+    if (!pool) return NULL;
+    if (element_size < sizeof(PoolFree)) element_size = sizeof(PoolFree);
+    pool->element_size = POOL_ROUND(element_size);
+    return pool;
+}
+
+static void pool_destroy(IRFlowchartPool* pool) {
+    PoolSlab* slab = pool->slabs;
+    while (slab) {
+        PoolSlab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(pool);
+}
+
+void ir_flowchart_pool_release(IRFlowchartPool* pool) {
+    if (!pool) return;
+    if (pool->live == 0) {
+        pool_destroy(pool);
+    } else {
+        pool->released = true;
+    }
+}
+
+// Start a new slab; what is left of the current one goes to the free list
+static bool pool_add_slab(IRFlowchartPool* pool, uint32_t capacity) {
+    PoolSlab* slab = (PoolSlab*)malloc(POOL_HEADER_SIZE + (size_t)capacity * pool->element_size);
+    if (!slab) return false;
+
+    PoolSlab* current = pool->slabs;
+    if (current) {
+        while (current->used < current->capacity) {
+            PoolFree* element = (PoolFree*)(void*)pool_slab_element(pool, current, current->used++);
+            element->next = pool->free_list;
+            pool->free_list = element;
+            pool->free_count++;
+        }
+    }
+
+    slab->next = pool->slabs;
+    slab->used = 0;
+    slab->capacity = capacity;
+    pool->slabs = slab;
+    return true;
+}
+
+// New elements come from the current slab first, so elements created in a row stay adjacent
+void* ir_flowchart_pool_alloc(IRFlowchartPool* pool) {
+    if (!pool) return NULL;
+
+    void* element = NULL;
+    PoolSlab* slab = pool->slabs;
+    if (slab && slab->used < slab->capacity) {
+        element = pool_slab_element(pool, slab, slab->used++);
+    } else if (pool->free_list) {
+        element = pool->free_list;
+        pool->free_list = pool->free_list->next;
+        pool->free_count--;
+    } else {
+        uint32_t capacity = slab ? slab->capacity * 2 : POOL_FIRST_SLAB;
+        if (!pool_add_slab(pool, capacity)) return NULL;
+        slab = pool->slabs;
+        element = pool_slab_element(pool, slab, slab->used++);
+    }
+
+    memset(element, 0, pool->element_size);
+    pool->live++;
+    return element;
+}
+
+void ir_flowchart_pool_free(IRFlowchartPool* pool, void* element) {
+    if (!pool || !element) return;
+
+    PoolFree* link = (PoolFree*)element;
+    link->next = pool->free_list;
+    pool->free_list = link;
+    pool->free_count++;
+
+    if (--pool->live == 0 && pool->released) pool_destroy(pool);
+}
+
+bool ir_flowchart_pool_reserve(IRFlowchartPool* pool, uint32_t count) {
+    if (!pool) return false;
+    if (count <= pool->live) return true;
+
+    uint32_t needed = count - pool->live;
+    uint32_t available = pool->free_count;
+    if (pool->slabs) available += pool->slabs->capacity - pool->slabs->used;
+    if (needed <= available) return true;
+
+    // One slab for the rest, so the reserved elements are contiguous
+    return pool_add_slab(pool, needed - pool->free_count);
+}
@@ -0,0 +1,614 @@
+// ============================================================================
+// FLOWCHART RENDER SNAPSHOTS
+// ============================================================================
+
+#include "flowchart_snapshot.h"
+#include "flowchart_builder.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK IR_FLOWCHART_SNAPSHOT_CHUNK
+#define KINDS 3                        // IRFlowchartSnapshotKind values
+
+// Immutable block of snapshot data, shared by every snapshot it appears in
+typedef struct SnapshotChunk {
+    atomic_uint refs;
+    uint32_t count;                    // Elements
+    size_t size;                       // Bytes of data
+    float data[];                      // Records, then edge path points, then the records' strings
+} SnapshotChunk;
+
+// Records hold only 4-byte fields, so chunks compare bytewise with no padding.
+// Strings are stored with their terminator; text_offset counts bytes from the
+// start of the chunk's data, text_length is IR_FLOWCHART_INVALID_INDEX for NULL.
+
+typedef struct {
+    float box[4];
+    uint32_t shape;
+    uint32_t fill_color;
+    uint32_t stroke_color;
+    float stroke_width;
+    uint32_t style_flags;
+    uint32_t text_offset;              // Label
+    uint32_t text_length;
+} SnapshotNodeEntry;
+
+typedef struct {
+    uint32_t from_index;
+    uint32_t to_index;
+    uint32_t point_offset;             // Floats past the chunk's last record
+    uint32_t point_count;
+    float label_x, label_y;
+    uint32_t type;
+    uint32_t start_marker;
+    uint32_t end_marker;
+    uint32_t stroke_color;
+    float stroke_width;
+    uint32_t style_flags;
+    uint32_t text_offset;              // Label
+    uint32_t text_length;
+} SnapshotEdgeEntry;
+
+typedef struct {
+    float box[4];
+    uint32_t background_color;
+    uint32_t border_color;
+    uint32_t text_offset;              // Title
+    uint32_t text_length;
+} SnapshotSubgraphEntry;
+
+struct IRFlowchartSnapshot {
+    atomic_uint refs;                  // Readers, plus one while published or retired
+    uint64_t version;
+    uint32_t node_count;
+    uint32_t edge_count;
+    uint32_t subgraph_count;
+    float content_width;
+    float content_height;
+    struct IRFlowchartSnapshot* next_retired;
+    SnapshotChunk* chunks[];           // Node chunks, then edge chunks, then subgraph chunks
+};
+
+struct IRFlowchartPublisher {
+    _Atomic(IRFlowchartSnapshot*) current;
+    atomic_uint acquiring;             // Readers between loading `current` and referencing it
+    IRFlowchartSnapshot* retired;      // Replaced while readers were acquiring; released later
+    uint64_t version;
+    float* scratch;                    // Chunk being built, compared with the previous one
+    size_t scratch_capacity;           // Bytes
+
+    // Chunks changed since the last publish, by kind (see ir_flowchart_publisher_mark)
+    uint8_t* dirty[KINDS];             // Per chunk, 1 = changed
+    uint32_t dirty_capacity[KINDS];    // Chunks
+    bool dirty_all[KINDS];             // Every chunk of the kind changed
+    uint64_t layout_generation;        // The state's when last published
+};
+
+static uint32_t chunk_count(uint32_t elements) {
+    return (elements + CHUNK - 1) / CHUNK;
+}
+
+static void chunk_release(SnapshotChunk* chunk) {
+    if (chunk && atomic_fetch_sub(&chunk->refs, 1) == 1) free(chunk);
+}
+
+static void snapshot_release(IRFlowchartSnapshot* snapshot) {
+    if (!snapshot || atomic_fetch_sub(&snapshot->refs, 1) != 1) return;
+
+    uint32_t chunks = chunk_count(snapshot->node_count) + chunk_count(snapshot->edge_count) +
+                      chunk_count(snapshot->subgraph_count);
+    for (uint32_t c = 0; c < chunks; c++) chunk_release(snapshot->chunks[c]);
+    free(snapshot);
+}
+
+// ============================================================================
+// Building
+// ============================================================================
+
+static bool scratch_reserve(IRFlowchartPublisher* publisher, size_t size) {
+    if (size <= publisher->scratch_capacity) return true;
+
+    size_t capacity = publisher->scratch_capacity ? publisher->scratch_capacity : 4096;
+    while (capacity < size) capacity *= 2;
+    float* scratch = (float*)realloc(publisher->scratch, capacity);
+    if (!scratch) return false;
+    publisher->scratch = scratch;
+    publisher->scratch_capacity = capacity;
+    return true;
+}
+
+// The chunk built in the scratch buffer: `previous` when it holds the same
+// bytes, a new copy otherwise
+static SnapshotChunk* chunk_commit(IRFlowchartPublisher* publisher, SnapshotChunk* previous,
+                                   uint32_t count, size_t size) {
+    if (previous && previous->count == count && previous->size == size &&
+        memcmp(previous->data, publisher->scratch, size) == 0) {
+        atomic_fetch_add(&previous->refs, 1);
+        return previous;
+    }
+
+    SnapshotChunk* chunk = (SnapshotChunk*)malloc(sizeof(SnapshotChunk) + size);
+    if (!chunk) return NULL;
+    atomic_init(&chunk->refs, 1);
+    chunk->count = count;
+    chunk->size = size;
+    memcpy(chunk->data, publisher->scratch, size);
+    return chunk;
+}
+
+// Bytes a string takes in a chunk
+static size_t text_size(const char* text) {
+    return text ? strlen(text) + 1 : 0;
+}
+
+// Copy a string to `*end` bytes into the scratch buffer and advance `*end`
+static void scratch_text(IRFlowchartPublisher* publisher, const char* text, size_t* end,
+                         uint32_t* offset, uint32_t* length) {
+    *offset = (uint32_t)*end;
+    *length = IR_FLOWCHART_INVALID_INDEX;
+    if (!text) return;
+
+    size_t size = strlen(text) + 1;
+    memcpy((char*)publisher->scratch + *end, text, size);
+    *end += size;
+    *length = (uint32_t)(size - 1);
+}
+
+static SnapshotChunk* build_node_chunk(IRFlowchartPublisher* publisher, const IRFlowchartState* state,
+                                       uint32_t first, uint32_t count, SnapshotChunk* previous) {
+    size_t size = (size_t)count * sizeof(SnapshotNodeEntry);
+    for (uint32_t i = 0; i < count; i++) {
+        const IRFlowchartNodeData* node = state->nodes[first + i];
+        if (node) size += text_size(node->label);
+    }
+    if (!scratch_reserve(publisher, size)) return NULL;
+
+    SnapshotNodeEntry* entries = (SnapshotNodeEntry*)publisher->scratch;
+    size_t end = (size_t)count * sizeof(SnapshotNodeEntry);
+    for (uint32_t i = 0; i < count; i++) {
+        const IRFlowchartNodeData* node = state->nodes[first + i];
+        SnapshotNodeEntry entry = {
+            { state->node_x[first + i], state->node_y[first + i],
+              state->node_width[first + i], state->node_height[first + i] },
+            IR_FLOWCHART_SHAPE_RECTANGLE, 0, 0, 0.0f, 0, 0, 0
+        };
+        if (node) {
+            entry.shape = (uint32_t)node->shape;
+            entry.fill_color = node->fill_color;
+            entry.stroke_color = node->stroke_color;
+            entry.stroke_width = node->stroke_width;
+            entry.style_flags = node->style_flags;
+        }
+        scratch_text(publisher, node ? node->label : NULL, &end, &entry.text_offset, &entry.text_length);
+        entries[i] = entry;
+    }
+    return chunk_commit(publisher, previous, count, size);
+}
+
+static SnapshotChunk* build_subgraph_chunk(IRFlowchartPublisher* publisher, const IRFlowchartState* state,
+                                           uint32_t first, uint32_t count, SnapshotChunk* previous) {
+    size_t size = (size_t)count * sizeof(SnapshotSubgraphEntry);
+    for (uint32_t i = 0; i < count; i++) {
+        const IRFlowchartSubgraphData* sg = state->subgraphs[first + i];
+        if (sg) size += text_size(sg->title);
+    }
+    if (!scratch_reserve(publisher, size)) return NULL;
+
+    SnapshotSubgraphEntry* entries = (SnapshotSubgraphEntry*)publisher->scratch;
+    size_t end = (size_t)count * sizeof(SnapshotSubgraphEntry);
+    for (uint32_t i = 0; i < count; i++) {
+        const IRFlowchartSubgraphData* sg = state->subgraphs[first + i];
+        SnapshotSubgraphEntry entry = { { 0.0f, 0.0f, 0.0f, 0.0f }, 0, 0, 0, 0 };
+        if (sg) {
+            entry.box[0] = sg->x;
+            entry.box[1] = sg->y;
+            entry.box[2] = sg->width;
+            entry.box[3] = sg->height;
+            entry.background_color = sg->background_color;
+            entry.border_color = sg->border_color;
+        }
+        scratch_text(publisher, sg ? sg->title : NULL, &end, &entry.text_offset, &entry.text_length);
+        entries[i] = entry;
+    }
+    return chunk_commit(publisher, previous, count, size);
+}
+
+static SnapshotChunk* build_edge_chunk(IRFlowchartPublisher* publisher, const IRFlowchartState* state,
+                                       uint32_t first, uint32_t count, SnapshotChunk* previous) {
+    size_t floats = 0, text = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const IRFlowchartEdgeData* edge = state->edges[first + i];
+        if (!edge) continue;
+        if (edge->path_points) floats += (size_t)edge->path_point_count * 2;
+        text += text_size(edge->label);
+    }
+    size_t records = (size_t)count * sizeof(SnapshotEdgeEntry);
+    size_t size = records + floats * sizeof(float) + text;
+    if (!scratch_reserve(publisher, size)) return NULL;
+
+    SnapshotEdgeEntry* entries = (SnapshotEdgeEntry*)publisher->scratch;
+    float* points = publisher->scratch + records / sizeof(float);
+    size_t end = records + floats * sizeof(float);
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const IRFlowchartEdgeData* edge = state->edges[first + i];
+        uint32_t point_count = edge && edge->path_points ? edge->path_point_count : 0;
+        SnapshotEdgeEntry entry = {
+            IR_FLOWCHART_INVALID_INDEX, IR_FLOWCHART_INVALID_INDEX, offset, point_count, 0.0f, 0.0f,
+            IR_FLOWCHART_EDGE_ARROW, IR_FLOWCHART_MARKER_NONE, IR_FLOWCHART_MARKER_ARROW, 0, 0.0f, 0, 0, 0
+        };
+        if (edge) {
+            entry.from_index = edge->from_index;
+            entry.to_index = edge->to_index;
+            entry.label_x = edge->label_x;
+            entry.label_y = edge->label_y;
+            entry.type = (uint32_t)edge->type;
+            entry.start_marker = (uint32_t)edge->start_marker;
+            entry.end_marker = (uint32_t)edge->end_marker;
+            entry.stroke_color = edge->stroke_color;
+            entry.stroke_width = edge->stroke_width;
+            entry.style_flags = edge->style_flags;
+        }
+        scratch_text(publisher, edge ? edge->label : NULL, &end, &entry.text_offset, &entry.text_length);
+        entries[i] = entry;
+        if (point_count) memcpy(points + offset, edge->path_points, (size_t)point_count * 2 * sizeof(float));
+        offset += point_count * 2;
+    }
+    return chunk_commit(publisher, previous, count, size);
+}
+
+typedef SnapshotChunk* (*ChunkBuilder)(IRFlowchartPublisher* publisher, const IRFlowchartState* state,
+                                       uint32_t first, uint32_t count, SnapshotChunk* previous);
+
+// ============================================================================
+// Reuse
+// ============================================================================
+// A chunk no mutation marked holds the current content of its elements;
+// only its geometry may be out of date, and only after a layout.
+
+static bool node_geometry_matches(const IRFlowchartState* state, uint32_t first, const SnapshotChunk* chunk) {
+    const SnapshotNodeEntry* entries = (const SnapshotNodeEntry*)chunk->data;
+    for (uint32_t i = 0; i < chunk->count; i++) {
+        const float* box = entries[i].box;
+        if (box[0] != state->node_x[first + i] || box[1] != state->node_y[first + i] ||
+            box[2] != state->node_width[first + i] || box[3] != state->node_height[first + i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool edge_geometry_matches(const IRFlowchartState* state, uint32_t first, const SnapshotChunk* chunk) {
+    const SnapshotEdgeEntry* entries = (const SnapshotEdgeEntry*)chunk->data;
+    const float* points = chunk->data + chunk->count * sizeof(SnapshotEdgeEntry) / sizeof(float);
+    for (uint32_t i = 0; i < chunk->count; i++) {
+        const IRFlowchartEdgeData* edge = state->edges[first + i];
+        if (!edge) continue;
+        uint32_t point_count = edge->path_points ? edge->path_point_count : 0;
+        if (entries[i].point_count != point_count || entries[i].label_x != edge->label_x ||
+            entries[i].label_y != edge->label_y) {
+            return false;
+        }
+        if (point_count && memcmp(points + entries[i].point_offset, edge->path_points,
+                                  (size_t)point_count * 2 * sizeof(float)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool subgraph_geometry_matches(const IRFlowchartState* state, uint32_t first, const SnapshotChunk* chunk) {
+    const SnapshotSubgraphEntry* entries = (const SnapshotSubgraphEntry*)chunk->data;
+    for (uint32_t i = 0; i < chunk->count; i++) {
+        const IRFlowchartSubgraphData* sg = state->subgraphs[first + i];
+        if (!sg) continue;
+        const float* box = entries[i].box;
+        if (box[0] != sg->x || box[1] != sg->y || box[2] != sg->width || box[3] != sg->height) return false;
+    }
+    return true;
+}
+
+typedef bool (*GeometryCheck)(const IRFlowchartState* state, uint32_t first, const SnapshotChunk* chunk);
+
+static const ChunkBuilder g_chunk_builders[KINDS] = {
+    build_node_chunk, build_edge_chunk, build_subgraph_chunk
+};
+static const GeometryCheck g_geometry_checks[KINDS] = {
+    node_geometry_matches, edge_geometry_matches, subgraph_geometry_matches
+};
+
+static bool chunk_dirty(const IRFlowchartPublisher* publisher, IRFlowchartSnapshotKind kind, uint32_t c) {
+    return publisher->dirty_all[kind] || (c < publisher->dirty_capacity[kind] && publisher->dirty[kind][c]);
+}
+
+// Fill `chunks` with the chunks of `elements` elements of `kind`: those of
+// `previous` (previous_elements elements) that no mutation marked and whose
+// geometry still holds are shared as they are, the others are rebuilt
+static bool build_chunks(IRFlowchartPublisher* publisher, const IRFlowchartState* state, IRFlowchartSnapshotKind kind,
+                         uint32_t elements, SnapshotChunk** chunks,
+                         uint32_t previous_elements, SnapshotChunk* const* previous) {
+    uint32_t previous_chunks = chunk_count(previous_elements);
+    bool laid_out = state->layout_generation != publisher->layout_generation;
+    for (uint32_t c = 0; c < chunk_count(elements); c++) {
+        uint32_t first = c * CHUNK;
+        uint32_t count = elements - first < CHUNK ? elements - first : CHUNK;
+        SnapshotChunk* old = c < previous_chunks ? previous[c] : NULL;
+        if (old && old->count == count && !chunk_dirty(publisher, kind, c) &&
+            (!laid_out || g_geometry_checks[kind](state, first, old))) {
+            atomic_fetch_add(&old->refs, 1);
+            chunks[c] = old;
+            continue;
+        }
+        chunks[c] = g_chunk_builders[kind](publisher, state, first, count, old);
+        if (!chunks[c]) return false;
+    }
+    return true;
+}
+
+static IRFlowchartSnapshot* snapshot_create(IRFlowchartPublisher* publisher, const IRFlowchartState* state,
+                                            const IRFlowchartSnapshot* previous) {
+    uint32_t node_chunks = chunk_count(state->node_count);
+    uint32_t edge_chunks = chunk_count(state->edge_count);
+    uint32_t chunks = node_chunks + edge_chunks + chunk_count(state->subgraph_count);
+
+    IRFlowchartSnapshot* snapshot = (IRFlowchartSnapshot*)calloc(1, sizeof(IRFlowchartSnapshot) +
+                                                                    chunks * sizeof(SnapshotChunk*));
+    if (!snapshot) return NULL;
+    atomic_init(&snapshot->refs, 1);
+    snapshot->node_count = state->node_count;
+    snapshot->edge_count = state->edge_count;
+    snapshot->subgraph_count = state->subgraph_count;
+    snapshot->content_width = state->content_width;
+    snapshot->content_height = state->content_height;
+
+    SnapshotChunk* const* previous_nodes = previous ? previous->chunks : NULL;
+    SnapshotChunk* const* previous_edges = previous ? previous_nodes + chunk_count(previous->node_count) : NULL;
+    SnapshotChunk* const* previous_subgraphs = previous ? previous_edges + chunk_count(previous->edge_count) : NULL;
+
+    // Unfilled entries are NULL, so a partial snapshot releases cleanly
+    if (!build_chunks(publisher, state, IR_FLOWCHART_SNAPSHOT_NODES, state->node_count, snapshot->chunks,
+                      previous ? previous->node_count : 0, previous_nodes) ||
+        !build_chunks(publisher, state, IR_FLOWCHART_SNAPSHOT_EDGES, state->edge_count,
+                      snapshot->chunks + node_chunks, previous ? previous->edge_count : 0, previous_edges) ||
+        !build_chunks(publisher, state, IR_FLOWCHART_SNAPSHOT_SUBGRAPHS, state->subgraph_count,
+                      snapshot->chunks + node_chunks + edge_chunks,
+                      previous ? previous->subgraph_count : 0, previous_subgraphs)) {
+        snapshot_release(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+// ============================================================================
+// Publishing
+// ============================================================================
+
+IRFlowchartPublisher* ir_flowchart_publisher_create(void) {
+    IRFlowchartPublisher* publisher = (IRFlowchartPublisher*)calloc(1, sizeof(IRFlowchartPublisher));
+    if (!publisher) return NULL;
+    atomic_init(&publisher->current, NULL);
+    atomic_init(&publisher->acquiring, 0);
+    return publisher;
+}
+
+static void publisher_release_retired(IRFlowchartPublisher* publisher) {
+    IRFlowchartSnapshot* snapshot = publisher->retired;
+    publisher->retired = NULL;
+    while (snapshot) {
+        IRFlowchartSnapshot* next = snapshot->next_retired;
+        snapshot_release(snapshot);
+        snapshot = next;
+    }
+}
+
+// Release the retired snapshots once no reader can still be taking a reference to one
+static void publisher_drain(IRFlowchartPublisher* publisher) {
+    if (publisher->retired && atomic_load(&publisher->acquiring) == 0) publisher_release_retired(publisher);
+}
+
+void ir_flowchart_publisher_destroy(IRFlowchartPublisher* publisher) {
+    if (!publisher) return;
+    snapshot_release(atomic_exchange(&publisher->current, NULL));
+    publisher_release_retired(publisher);
+    free(publisher->scratch);
+    for (int kind = 0; kind < KINDS; kind++) free(publisher->dirty[kind]);
+    free(publisher);
+}
+
+void ir_flowchart_publisher_mark(IRFlowchartPublisher* publisher, IRFlowchartSnapshotKind kind, uint32_t index) {
+    if (!publisher || publisher->dirty_all[kind]) return;
+    if (index == IR_FLOWCHART_INVALID_INDEX) {
+        publisher->dirty_all[kind] = true;
+        return;
+    }
+
+    uint32_t c = index / CHUNK;
+    if (c >= publisher->dirty_capacity[kind]) {
+        uint32_t capacity = publisher->dirty_capacity[kind] ? publisher->dirty_capacity[kind] : 8;
+        while (capacity <= c) capacity *= 2;
+        uint8_t* dirty = (uint8_t*)realloc(publisher->dirty[kind], capacity);
+        if (!dirty) {
+            // Without the bitmap every chunk counts as changed
+            publisher->dirty_all[kind] = true;
+            return;
+        }
+        memset(dirty + publisher->dirty_capacity[kind], 0, capacity - publisher->dirty_capacity[kind]);
+        publisher->dirty[kind] = dirty;
+        publisher->dirty_capacity[kind] = capacity;
+    }
+    publisher->dirty[kind][c] = 1;
+}
+
+// Forget the marks once a snapshot has absorbed them
+static void publisher_clear_marks(IRFlowchartPublisher* publisher, const IRFlowchartState* state) {
+    for (int kind = 0; kind < KINDS; kind++) {
+        publisher->dirty_all[kind] = false;
+        if (publisher->dirty[kind]) memset(publisher->dirty[kind], 0, publisher->dirty_capacity[kind]);
+    }
+    publisher->layout_generation = state->layout_generation;
+}
+
+void ir_flowchart_snapshot_invalidate(IRComponent* flowchart) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state) return;
+    for (int kind = 0; kind < KINDS; kind++) {
+        ir_flowchart_publisher_mark(state->publisher, (IRFlowchartSnapshotKind)kind, IR_FLOWCHART_INVALID_INDEX);
+    }
+}
+
+bool ir_flowchart_snapshot_publish(IRComponent* flowchart) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state || !state->publisher || !state->layout_computed) return false;
+    IRFlowchartPublisher* publisher = state->publisher;
+
+    // The published snapshot is only released by this thread, so it can be read here
+    IRFlowchartSnapshot* previous = atomic_load(&publisher->current);
+    IRFlowchartSnapshot* snapshot = snapshot_create(publisher, state, previous);
+    if (!snapshot) return false;
+    snapshot->version = ++publisher->version;
+    publisher_clear_marks(publisher, state);
+
+    // A reader that loaded the old pointer before the swap may not have
+    // referenced it yet: with readers mid-acquire it is retired, not released
+    previous = atomic_exchange(&publisher->current, snapshot);
+    if (previous) {
+        previous->next_retired = publisher->retired;
+        publisher->retired = previous;
+    }
+    publisher_drain(publisher);
+    return true;
+}
+
+const IRFlowchartSnapshot* ir_flowchart_snapshot_acquire(IRComponent* flowchart) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    if (!state || !state->publisher) return NULL;
+    IRFlowchartPublisher* publisher = state->publisher;
+
+    atomic_fetch_add(&publisher->acquiring, 1);
+    IRFlowchartSnapshot* snapshot = atomic_load(&publisher->current);
+    if (snapshot) atomic_fetch_add(&snapshot->refs, 1);
+    atomic_fetch_sub(&publisher->acquiring, 1);
+    return snapshot;
+}
+
+void ir_flowchart_snapshot_release(const IRFlowchartSnapshot* snapshot) {
+    snapshot_release((IRFlowchartSnapshot*)snapshot);
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+uint64_t ir_flowchart_snapshot_version(const IRFlowchartSnapshot* snapshot) {
+    return snapshot ? snapshot->version : 0;
+}
+
+uint32_t ir_flowchart_snapshot_node_count(const IRFlowchartSnapshot* snapshot) {
+    return snapshot ? snapshot->node_count : 0;
+}
+
+uint32_t ir_flowchart_snapshot_edge_count(const IRFlowchartSnapshot* snapshot) {
+    return snapshot ? snapshot->edge_count : 0;
+}
+
+uint32_t ir_flowchart_snapshot_subgraph_count(const IRFlowchartSnapshot* snapshot) {
+    return snapshot ? snapshot->subgraph_count : 0;
+}
+
+void ir_flowchart_snapshot_size(const IRFlowchartSnapshot* snapshot, float* width, float* height) {
+    if (width) *width = snapshot ? snapshot->content_width : 0.0f;
+    if (height) *height = snapshot ? snapshot->content_height : 0.0f;
+}
+
+// Record `index` of a group of chunks
+static const void* snapshot_entry(SnapshotChunk* const* chunks, uint32_t index, size_t entry_size,
+                                  const SnapshotChunk** chunk) {
+    *chunk = chunks[index / CHUNK];
+    return (const char*)(*chunk)->data + (size_t)(index % CHUNK) * entry_size;
+}
+
+static const char* snapshot_text(const SnapshotChunk* chunk, uint32_t offset, uint32_t length, uint32_t* out_length) {
+    *out_length = length == IR_FLOWCHART_INVALID_INDEX ? 0 : length;
+    return length == IR_FLOWCHART_INVALID_INDEX ? NULL : (const char*)chunk->data + offset;
+}
+
+static SnapshotChunk* const* snapshot_subgraph_chunks(const IRFlowchartSnapshot* snapshot) {
+    return snapshot->chunks + chunk_count(snapshot->node_count) + chunk_count(snapshot->edge_count);
+}
+
+bool ir_flowchart_snapshot_node_box(const IRFlowchartSnapshot* snapshot, uint32_t index, float box[4]) {
+    if (!snapshot || index >= snapshot->node_count) return false;
+    const SnapshotChunk* chunk;
+    const SnapshotNodeEntry* entry = snapshot_entry(snapshot->chunks, index, sizeof(SnapshotNodeEntry), &chunk);
+    memcpy(box, entry->box, sizeof(entry->box));
+    return true;
+}
+
+bool ir_flowchart_snapshot_subgraph_box(const IRFlowchartSnapshot* snapshot, uint32_t index, float box[4]) {
+    if (!snapshot || index >= snapshot->subgraph_count) return false;
+    const SnapshotChunk* chunk;
+    const SnapshotSubgraphEntry* entry = snapshot_entry(snapshot_subgraph_chunks(snapshot), index,
+                                                        sizeof(SnapshotSubgraphEntry), &chunk);
+    memcpy(box, entry->box, sizeof(entry->box));
+    return true;
+}
+
+bool ir_flowchart_snapshot_node(const IRFlowchartSnapshot* snapshot, uint32_t index, IRFlowchartSnapshotNode* node) {
+    if (!snapshot || !node || index >= snapshot->node_count) return false;
+
+    const SnapshotChunk* chunk;
+    const SnapshotNodeEntry* entry = snapshot_entry(snapshot->chunks, index, sizeof(SnapshotNodeEntry), &chunk);
+    node->x = entry->box[0];
+    node->y = entry->box[1];
+    node->width = entry->box[2];
+    node->height = entry->box[3];
+    node->shape = (IRFlowchartShape)entry->shape;
+    node->label = snapshot_text(chunk, entry->text_offset, entry->text_length, &node->label_length);
+    node->fill_color = entry->fill_color;
+    node->stroke_color = entry->stroke_color;
+    node->stroke_width = entry->stroke_width;
+    node->style_flags = entry->style_flags;
+    return true;
+}
+
+bool ir_flowchart_snapshot_edge(const IRFlowchartSnapshot* snapshot, uint32_t index, IRFlowchartSnapshotEdge* edge) {
+    if (!snapshot || !edge || index >= snapshot->edge_count) return false;
+
+    const SnapshotChunk* chunk;
+    const SnapshotEdgeEntry* entry = snapshot_entry(snapshot->chunks + chunk_count(snapshot->node_count), index,
+                                                    sizeof(SnapshotEdgeEntry), &chunk);
+    const float* points = chunk->data + chunk->count * sizeof(SnapshotEdgeEntry) / sizeof(float);
+
+    edge->from_index = entry->from_index;
+    edge->to_index = entry->to_index;
+    edge->path_points = entry->point_count ? points + entry->point_offset : NULL;
+    edge->path_point_count = entry->point_count;
+    edge->label_x = entry->label_x;
+    edge->label_y = entry->label_y;
+    edge->type = (IRFlowchartEdgeType)entry->type;
+    edge->start_marker = (IRFlowchartMarker)entry->start_marker;
+    edge->end_marker = (IRFlowchartMarker)entry->end_marker;
+    edge->label = snapshot_text(chunk, entry->text_offset, entry->text_length, &edge->label_length);
+    edge->stroke_color = entry->stroke_color;
+    edge->stroke_width = entry->stroke_width;
+    edge->style_flags = entry->style_flags;
+    return true;
+}
+
+bool ir_flowchart_snapshot_subgraph(const IRFlowchartSnapshot* snapshot, uint32_t index,
+                                    IRFlowchartSnapshotSubgraph* subgraph) {
+    if (!snapshot || !subgraph || index >= snapshot->subgraph_count) return false;
+
+    const SnapshotChunk* chunk;
+    const SnapshotSubgraphEntry* entry = snapshot_entry(snapshot_subgraph_chunks(snapshot), index,
+                                                        sizeof(SnapshotSubgraphEntry), &chunk);
+    subgraph->x = entry->box[0];
+    subgraph->y = entry->box[1];
+    subgraph->width = entry->box[2];
+    subgraph->height = entry->box[3];
+    subgraph->title = snapshot_text(chunk, entry->text_offset, entry->text_length, &subgraph->title_length);
+    subgraph->background_color = entry->background_color;
+    subgraph->border_color = entry->border_color;
+    return true;
+}
@@ -0,0 +1,144 @@
+// ============================================================================
+// FLOWCHART STRING ARENA
+// ============================================================================
+
+#include "flowchart_strings.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Default chunk size; longer strings get a chunk of their own
+#define STRING_CHUNK_SIZE (64 * 1024)
+
+// Every string is stored as [hash][length][bytes]['\0'], 4-byte aligned
+typedef struct {
+    uint32_t hash;
+    uint32_t length;
+} StringHeader;
+
+typedef struct StringChunk {
+    struct StringChunk* next;
+    size_t used;
+    size_t capacity;
+    // Data follows the chunk header
+} StringChunk;
+
+struct IRFlowchartStringArena {
+    StringChunk* chunks;               // Most recent chunk first
+
+    // Intern table (open addressing, at most half full)
+    const char** slots;
+    uint32_t slot_count;
+    uint32_t slot_capacity;            // Power of two
+};
+
+IRFlowchartStringArena* ir_flowchart_string_arena_create(void) {
+    return (IRFlowchartStringArena*)calloc(1, sizeof(IRFlowchartStringArena));
+}
+
+void ir_flowchart_string_arena_destroy(IRFlowchartStringArena* arena) {
+    if (!arena) return;
+    StringChunk* chunk = arena->chunks;
+    while (chunk) {
+        StringChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena->slots);
+    free(arena);
+}
+
+static uint32_t string_hash_n(const char* str, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t ir_flowchart_string_hash(const char* str) {
+    return str ? string_hash_n(str, strlen(str)) : 0;
+}
+
+static const StringHeader* string_header(const char* interned) {
+    return (const StringHeader*)(const void*)(interned - sizeof(StringHeader));
+}
+
+uint32_t ir_flowchart_interned_hash(const char* interned) {
+    return string_header(interned)->hash;
+}
+
+// Helper: Keep the intern table at most half full
+static bool string_table_reserve(IRFlowchartStringArena* arena) {
+    if ((arena->slot_count + 1) * 2 <= arena->slot_capacity) return true;
+
+    uint32_t new_capacity = arena->slot_capacity == 0 ? 256 : arena->slot_capacity * 2;
+    const char** new_slots = (const char**)calloc(new_capacity, sizeof(const char*));
+    if (!new_slots) return false;
+
+    uint32_t mask = new_capacity - 1;
+    for (uint32_t i = 0; i < arena->slot_capacity; i++) {
+        const char* str = arena->slots[i];
+        if (!str) continue;
+        uint32_t slot = string_header(str)->hash & mask;
+        while (new_slots[slot]) slot = (slot + 1) & mask;
+        new_slots[slot] = str;
+    }
+    free(arena->slots);
+    arena->slots = new_slots;
+    arena->slot_capacity = new_capacity;
+    return true;
+}
+
+// Helper: Copy a string into the current chunk (or a new one)
+static const char* string_store(IRFlowchartStringArena* arena, const char* str, size_t length, uint32_t hash) {
+    size_t size = (sizeof(StringHeader) + length + 1 + 3) & ~(size_t)3;
+    StringChunk* chunk = arena->chunks;
+    if (!chunk || chunk->used + size > chunk->capacity) {
+        size_t capacity = size > STRING_CHUNK_SIZE ? size : STRING_CHUNK_SIZE;
+        chunk = (StringChunk*)malloc(sizeof(StringChunk) + capacity);
+        if (!chunk) return NULL;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    char* base = (char*)(chunk + 1) + chunk->used;
+    StringHeader header = { hash, (uint32_t)length };
+    memcpy(base, &header, sizeof(header));
+    char* copy = base + sizeof(StringHeader);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    chunk->used += size;
+    return copy;
+}
+
+const char* ir_flowchart_intern_n(IRFlowchartStringArena* arena, const char* str, size_t length) {
+    if (!arena || !str || length > UINT32_MAX) return NULL;
+    if (!string_table_reserve(arena)) return NULL;
+
+    uint32_t hash = string_hash_n(str, length);
+    uint32_t mask = arena->slot_capacity - 1;
+    uint32_t slot = hash & mask;
+    while (arena->slots[slot]) {
+        const char* existing = arena->slots[slot];
+        const StringHeader* header = string_header(existing);
+        if (header->hash == hash && header->length == length && memcmp(existing, str, length) == 0) {
+            return existing;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    const char* copy = string_store(arena, str, length, hash);
+    if (!copy) return NULL;
+    arena->slots[slot] = copy;
+    arena->slot_count++;
+    return copy;
+}
+
+const char* ir_flowchart_intern(IRFlowchartStringArena* arena, const char* str) {
+    if (!str) return NULL;
+    return ir_flowchart_intern_n(arena, str, strlen(str));
+}
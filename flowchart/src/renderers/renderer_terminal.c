@@ -1,6 +1,7 @@
 #include "flowchart_renderer_terminal.h"
 #include "flowchart_types.h"
 #include "flowchart_builder.h"
+#include "flowchart_geometry.h"
 #include "ir_builder.h"
 #include "ir_core.h"
 #include <stdio.h>
@@ -9,7 +10,13 @@
 #include <math.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
-#include <float.h>
+
+static void render_node_box_terminal(TerminalBuffer* buffer, const float box[4], IRFlowchartShape shape,
+                                     const char* label, const TerminalScaling* scale,
+                                     const TerminalCapabilities* caps);
+static void render_edge_path_terminal(TerminalBuffer* buffer, const float* path_points, uint32_t path_point_count,
+                                      IRFlowchartEdgeType type, const char* label,
+                                      const TerminalScaling* scale, const TerminalCapabilities* caps);
 
 // =============================================================================
 // Terminal Capability Detection
@@ -72,24 +79,10 @@ void print_terminal_capabilities(const TerminalCapabilities* caps) {
 // Coordinate Scaling
 // =============================================================================
 
-TerminalScaling calculate_scaling(const IRFlowchartState* fc_state, int available_cols, int available_rows) {
-    if (!fc_state || fc_state->node_count == 0) {
-        return (TerminalScaling){1.0f, 1.0f, available_cols, available_rows, 0, 0};
-    }
-
-    // Find bounding box of all nodes
-    float min_x = FLT_MAX, max_x = 0;
-    float min_y = FLT_MAX, max_y = 0;
-
-    for (uint32_t i = 0; i < fc_state->node_count; i++) {
-        IRFlowchartNodeData* node = fc_state->nodes[i];
-        if (!node) continue;
-
-        min_x = fminf(min_x, node->x);
-        max_x = fmaxf(max_x, node->x + node->width);
-        min_y = fminf(min_y, node->y);
-        max_y = fmaxf(max_y, node->y + node->height);
-    }
+// Scaling that fits a bounding box (min x, min y, max x, max y) of the nodes
+static TerminalScaling scaling_for_bounds(const float bounds[4], int available_cols, int available_rows) {
+    float min_x = bounds[0], max_x = fmaxf(bounds[2], 0.0f);
+    float min_y = bounds[1], max_y = fmaxf(bounds[3], 0.0f);
 
     float width = max_x - min_x;
     float height = max_y - min_y;
@@ -108,6 +101,37 @@ TerminalScaling calculate_scaling(const IRFlowchartState* fc_state, int availabl
     };
 }
 
+TerminalScaling calculate_scaling(const IRFlowchartState* fc_state, int available_cols, int available_rows) {
+    if (!fc_state || fc_state->node_count == 0) {
+        return (TerminalScaling){1.0f, 1.0f, available_cols, available_rows, 0, 0};
+    }
+
+    // Find bounding box of all nodes (one pass over the geometry arrays)
+    float bounds[4];
+    ir_flowchart_geometry_bounds(fc_state->node_x, fc_state->node_y, fc_state->node_width,
+                                 fc_state->node_height, fc_state->node_count, bounds);
+    return scaling_for_bounds(bounds, available_cols, available_rows);
+}
+
+static TerminalScaling calculate_snapshot_scaling(const IRFlowchartSnapshot* snapshot,
+                                                  int available_cols, int available_rows) {
+    uint32_t count = ir_flowchart_snapshot_node_count(snapshot);
+    if (count == 0) {
+        return (TerminalScaling){1.0f, 1.0f, available_cols, available_rows, 0, 0};
+    }
+
+    float bounds[4] = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t i = 0; i < count; i++) {
+        float box[4];
+        ir_flowchart_snapshot_node_box(snapshot, i, box);
+        bounds[0] = fminf(bounds[0], box[0]);
+        bounds[1] = fminf(bounds[1], box[1]);
+        bounds[2] = fmaxf(bounds[2], box[0] + box[2]);
+        bounds[3] = fmaxf(bounds[3], box[1] + box[3]);
+    }
+    return scaling_for_bounds(bounds, available_cols, available_rows);
+}
+
 TerminalCell pixels_to_cell(float px_x, float px_y, const TerminalScaling* scale) {
     return (TerminalCell){
         .col = (int)((px_x - scale->offset_x) / scale->pixels_per_col) + 1,
@@ -173,8 +197,12 @@ void terminal_buffer_set_char_colored(TerminalBuffer* buffer, int col, int row,
 }
 
 void terminal_buffer_render(const TerminalBuffer* buffer, const TerminalCapabilities* caps) {
+    terminal_buffer_render_to(stdout, buffer, caps);
+}
+
+void terminal_buffer_render_to(FILE* out, const TerminalBuffer* buffer, const TerminalCapabilities* caps) {
     // Clear screen
-    printf("\033[2J\033[H");
+    fputs("\033[2J\033[H", out);
 
     for (int row = 0; row < buffer->height; row++) {
         for (int col = 0; col < buffer->width; col++) {
@@ -183,19 +211,19 @@ void terminal_buffer_render(const TerminalBuffer* buffer, const TerminalCapabili
                 uint8_t r = (color >> 24) & 0xFF;
                 uint8_t g = (color >> 16) & 0xFF;
                 uint8_t b = (color >> 8) & 0xFF;
-                set_terminal_color_rgb(r, g, b, true, caps);
+                set_terminal_color_rgb_to(out, r, g, b, true, caps);
             }
 
-            putchar(buffer->chars[row][col]);
+            putc(buffer->chars[row][col], out);
 
             if (color != 0 && caps->supports_ansi) {
-                reset_terminal_color();
+                reset_terminal_color_to(out);
             }
         }
-        putchar('\n');
+        putc('\n', out);
     }
 
-    fflush(stdout);
+    fflush(out);
 }
 
 // =============================================================================
@@ -386,10 +414,34 @@ void render_cylinder_terminal(TerminalBuffer* buffer, TerminalCell pos, int w, i
 
 void render_node_terminal(TerminalBuffer* buffer, const IRFlowchartNodeData* node,
                          const TerminalScaling* scale, const TerminalCapabilities* caps) {
-    if (!node || !buffer || !scale) return;
+    if (!node) return;
+
+    // The flowchart holding the node's component (through any subgraphs)
+    IRComponent* flowchart = node->component;
+    while (flowchart && flowchart->type != IR_COMPONENT_FLOWCHART) flowchart = flowchart->parent;
+    if (!flowchart) return;
+
+    render_node_terminal_in(buffer, ir_get_flowchart_state(flowchart), node, scale, caps);
+}
+
+void render_node_terminal_in(TerminalBuffer* buffer, const IRFlowchartState* fc_state, const IRFlowchartNodeData* node,
+                            const TerminalScaling* scale, const TerminalCapabilities* caps) {
+    if (!node || !buffer || !scale || !fc_state || node->index >= fc_state->node_count ||
+        fc_state->nodes[node->index] != node) {
+        return;
+    }
+
+    uint32_t i = node->index;
+    const float box[4] = { fc_state->node_x[i], fc_state->node_y[i], fc_state->node_width[i], fc_state->node_height[i] };
+    render_node_box_terminal(buffer, box, node->shape, node->label, scale, caps);
+}
 
-    TerminalCell top_left = pixels_to_cell(node->x, node->y, scale);
-    TerminalCell bottom_right = pixels_to_cell(node->x + node->width, node->y + node->height, scale);
+// Draw a node from its box (x, y, width, height), shape and label
+static void render_node_box_terminal(TerminalBuffer* buffer, const float box[4], IRFlowchartShape shape,
+                                     const char* label, const TerminalScaling* scale,
+                                     const TerminalCapabilities* caps) {
+    TerminalCell top_left = pixels_to_cell(box[0], box[1], scale);
+    TerminalCell bottom_right = pixels_to_cell(box[0] + box[2], box[1] + box[3], scale);
 
     int width = bottom_right.col - top_left.col;
     int height = bottom_right.row - top_left.row;
@@ -399,7 +451,7 @@ void render_node_terminal(TerminalBuffer* buffer, const IRFlowchartNodeData* nod
     if (height < 3) height = 3;
 
     // Render shape
-    switch (node->shape) {
+    switch (shape) {
         case IR_FLOWCHART_SHAPE_RECTANGLE:
             render_rectangle_terminal(buffer, top_left, width, height, caps);
             break;
@@ -444,8 +496,8 @@ void render_node_terminal(TerminalBuffer* buffer, const IRFlowchartNodeData* nod
     }
 
     // Render label
-    if (node->label) {
-        render_label_centered(buffer, top_left, width, height, node->label);
+    if (label) {
+        render_label_centered(buffer, top_left, width, height, label);
     }
 }
 
@@ -489,48 +541,57 @@ void draw_line_terminal(TerminalBuffer* buffer, TerminalCell c1, TerminalCell c2
 
 void render_edge_terminal(TerminalBuffer* buffer, const IRFlowchartEdgeData* edge,
                          const TerminalScaling* scale, const TerminalCapabilities* caps) {
-    if (!edge || !edge->path_points || edge->path_point_count < 2) return;
+    if (!edge) return;
+    render_edge_path_terminal(buffer, edge->path_points, edge->path_point_count, edge->type, edge->label,
+                              scale, caps);
+}
+
+// Draw an edge from its path (x,y pairs), line type and label
+static void render_edge_path_terminal(TerminalBuffer* buffer, const float* path_points, uint32_t path_point_count,
+                                      IRFlowchartEdgeType type, const char* label,
+                                      const TerminalScaling* scale, const TerminalCapabilities* caps) {
+    if (!path_points || path_point_count < 2) return;
 
     const char* arrow = caps->unicode_arrows ? "→" : ">";
     const char* bi_arrow_l = caps->unicode_arrows ? "←" : "<";
 
     // Draw each segment
-    for (uint32_t p = 0; p < edge->path_point_count - 1; p++) {
-        TerminalCell c1 = pixels_to_cell(edge->path_points[p * 2], edge->path_points[p * 2 + 1], scale);
-        TerminalCell c2 = pixels_to_cell(edge->path_points[(p + 1) * 2], edge->path_points[(p + 1) * 2 + 1], scale);
+    for (uint32_t p = 0; p < path_point_count - 1; p++) {
+        TerminalCell c1 = pixels_to_cell(path_points[p * 2], path_points[p * 2 + 1], scale);
+        TerminalCell c2 = pixels_to_cell(path_points[(p + 1) * 2], path_points[(p + 1) * 2 + 1], scale);
 
-        draw_line_terminal(buffer, c1, c2, edge->type, caps);
+        draw_line_terminal(buffer, c1, c2, type, caps);
     }
 
     // Draw arrow heads
-    if (edge->type != IR_FLOWCHART_EDGE_OPEN) {
+    if (type != IR_FLOWCHART_EDGE_OPEN) {
         TerminalCell end = pixels_to_cell(
-            edge->path_points[(edge->path_point_count - 1) * 2],
-            edge->path_points[(edge->path_point_count - 1) * 2 + 1],
+            path_points[(path_point_count - 1) * 2],
+            path_points[(path_point_count - 1) * 2 + 1],
             scale);
         terminal_buffer_set_char(buffer, end.col, end.row, arrow[0]);
 
-        if (edge->type == IR_FLOWCHART_EDGE_BIDIRECTIONAL) {
+        if (type == IR_FLOWCHART_EDGE_BIDIRECTIONAL) {
             TerminalCell start = pixels_to_cell(
-                edge->path_points[0],
-                edge->path_points[1],
+                path_points[0],
+                path_points[1],
                 scale);
             terminal_buffer_set_char(buffer, start.col, start.row, bi_arrow_l[0]);
         }
     }
 
     // Draw edge label if present
-    if (edge->label) {
+    if (label) {
         // Find midpoint of path
-        uint32_t mid_idx = edge->path_point_count / 2;
+        uint32_t mid_idx = path_point_count / 2;
         TerminalCell mid = pixels_to_cell(
-            edge->path_points[mid_idx * 2],
-            edge->path_points[mid_idx * 2 + 1],
+            path_points[mid_idx * 2],
+            path_points[mid_idx * 2 + 1],
             scale);
 
-        int label_len = strlen(edge->label);
+        int label_len = strlen(label);
         for (int i = 0; i < label_len && i < 10; i++) {
-            terminal_buffer_set_char(buffer, mid.col + i, mid.row, edge->label[i]);
+            terminal_buffer_set_char(buffer, mid.col + i, mid.row, label[i]);
         }
     }
 }
@@ -540,24 +601,33 @@ void render_edge_terminal(TerminalBuffer* buffer, const IRFlowchartEdgeData* edg
 // =============================================================================
 
 void set_terminal_color_rgb(uint8_t r, uint8_t g, uint8_t b, bool foreground, const TerminalCapabilities* caps) {
+    set_terminal_color_rgb_to(stdout, r, g, b, foreground, caps);
+}
+
+void set_terminal_color_rgb_to(FILE* out, uint8_t r, uint8_t g, uint8_t b, bool foreground,
+                               const TerminalCapabilities* caps) {
     if (!caps->supports_ansi) return;
 
     if (caps->color_depth == 16777216) {
         // Truecolor (24-bit)
-        printf("\033[%d;2;%d;%d;%dm", foreground ? 38 : 48, r, g, b);
+        fprintf(out, "\033[%d;2;%d;%d;%dm", foreground ? 38 : 48, r, g, b);
     } else if (caps->color_depth == 256) {
         // 256-color palette
         int color_idx = rgb_to_256color(r, g, b);
-        printf("\033[%d;5;%dm", foreground ? 38 : 48, color_idx);
+        fprintf(out, "\033[%d;5;%dm", foreground ? 38 : 48, color_idx);
     } else if (caps->color_depth == 16) {
         // 16-color ANSI
         int color_idx = rgb_to_16color(r, g, b);
-        printf("\033[%dm", foreground ? (30 + color_idx) : (40 + color_idx));
+        fprintf(out, "\033[%dm", foreground ? (30 + color_idx) : (40 + color_idx));
     }
 }
 
 void reset_terminal_color(void) {
-    printf("\033[0m");
+    reset_terminal_color_to(stdout);
+}
+
+void reset_terminal_color_to(FILE* out) {
+    fputs("\033[0m", out);
 }
 
 int rgb_to_256color(uint8_t r, uint8_t g, uint8_t b) {
@@ -587,6 +657,11 @@ int rgb_to_16color(uint8_t r, uint8_t g, uint8_t b) {
 // =============================================================================
 
 bool render_flowchart_terminal(IRComponent* flowchart, const TerminalCapabilities* caps) {
+    return render_flowchart_terminal_to(stdout, flowchart, caps);
+}
+
+bool render_flowchart_terminal_to(FILE* out, IRComponent* flowchart, const TerminalCapabilities* caps) {
+    if (!out) return false;
     if (!flowchart || flowchart->type != IR_COMPONENT_FLOWCHART) {
         fprintf(stderr, "Error: Not a flowchart component\n");
         return false;
@@ -622,14 +697,58 @@ bool render_flowchart_terminal(IRComponent* flowchart, const TerminalCapabilitie
 
     // Render nodes
     for (uint32_t i = 0; i < fc_state->node_count; i++) {
-        render_node_terminal(buffer, fc_state->nodes[i], &scale, caps);
+        render_node_terminal_in(buffer, fc_state, fc_state->nodes[i], &scale, caps);
     }
 
     // Render to terminal
-    terminal_buffer_render(buffer, caps);
+    terminal_buffer_render_to(out, buffer, caps);
 
     // Cleanup
     terminal_buffer_destroy(buffer);
 
     return true;
 }
+
+bool render_flowchart_terminal_snapshot(const IRFlowchartSnapshot* snapshot, const TerminalCapabilities* caps) {
+    return render_flowchart_terminal_snapshot_to(stdout, snapshot, caps);
+}
+
+bool render_flowchart_terminal_snapshot_to(FILE* out, const IRFlowchartSnapshot* snapshot,
+                                           const TerminalCapabilities* caps) {
+    if (!out || !caps) return false;
+    if (!snapshot) {
+        fprintf(stderr, "Error: No flowchart snapshot\n");
+        return false;
+    }
+
+    TerminalScaling scale = calculate_snapshot_scaling(snapshot, caps->max_cols, caps->max_rows);
+
+    TerminalBuffer* buffer = terminal_buffer_create(caps->max_cols, caps->max_rows);
+    if (!buffer) {
+        fprintf(stderr, "Error: Failed to create terminal buffer\n");
+        return false;
+    }
+
+    terminal_buffer_clear(buffer);
+
+    // Edges behind nodes, as render_flowchart_terminal_to draws them
+    uint32_t edge_count = ir_flowchart_snapshot_edge_count(snapshot);
+    for (uint32_t i = 0; i < edge_count; i++) {
+        IRFlowchartSnapshotEdge edge;
+        ir_flowchart_snapshot_edge(snapshot, i, &edge);
+        render_edge_path_terminal(buffer, edge.path_points, edge.path_point_count, edge.type, edge.label,
+                                  &scale, caps);
+    }
+
+    uint32_t node_count = ir_flowchart_snapshot_node_count(snapshot);
+    for (uint32_t i = 0; i < node_count; i++) {
+        IRFlowchartSnapshotNode node;
+        ir_flowchart_snapshot_node(snapshot, i, &node);
+        const float box[4] = { node.x, node.y, node.width, node.height };
+        render_node_box_terminal(buffer, box, node.shape, node.label, &scale, caps);
+    }
+
+    terminal_buffer_render_to(out, buffer, caps);
+    terminal_buffer_destroy(buffer);
+    return true;
+}
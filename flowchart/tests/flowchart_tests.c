@@ -0,0 +1,918 @@
+// ============================================================================
+// FLOWCHART REGRESSION TESTS
+// ============================================================================
+// Usage:
+//   flowchart_tests            Run every test
+//   flowchart_tests NAME...    Run the named tests
+//
+// Prints one line per failed check and exits non-zero if any failed.
+
+#include "flowchart_builder.h"
+#include "flowchart_cache.h"
+#include "flowchart_parser.h"
+#include "flowchart_renderer_terminal.h"
+#include "flowchart_snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        g_failures++; \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+static IRComponent* test_parse(const char* source) {
+    IRComponent* flowchart = ir_flowchart_parse(source, strlen(source));
+    CHECK(flowchart != NULL);
+    return flowchart;
+}
+
+// Edge data by endpoint IDs (NULL if not registered)
+static IRFlowchartEdgeData* test_find_edge(IRFlowchartState* state, const char* from_id, const char* to_id) {
+    for (uint32_t i = 0; i < state->edge_count; i++) {
+        IRFlowchartEdgeData* edge = state->edges[i];
+        if (strcmp(edge->from_id, from_id) == 0 && strcmp(edge->to_id, to_id) == 0) return edge;
+    }
+    return NULL;
+}
+
+// Node data by ID (NULL if not registered)
+static IRFlowchartNodeData* test_find_node(IRFlowchartState* state, const char* node_id) {
+    uint32_t index = ir_flowchart_find_node_index(state, node_id);
+    return index == IR_FLOWCHART_INVALID_INDEX ? NULL : state->nodes[index];
+}
+
+// ============================================================================
+// Parsing
+// ============================================================================
+
+// Keywords only match whole words opening a statement; ';' separates
+// statements; a bare identifier declares a node; & groups connect every
+// source to every target; click statements create nothing
+static void test_parse_statements(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart TB\n"
+        "    endpoint --> styled; classy --> B\n"
+        "    Lonely\n"
+        "    P & Q --> R & S\n"
+        "    click P callback \"Tooltip\"\n"
+        "    click Q href \"https://example.com\"; T --> U\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    CHECK(test_find_edge(state, "endpoint", "styled") != NULL);
+    CHECK(test_find_edge(state, "classy", "B") != NULL);
+    CHECK(test_find_node(state, "Lonely") != NULL);
+    CHECK(test_find_edge(state, "P", "R") && test_find_edge(state, "P", "S"));
+    CHECK(test_find_edge(state, "Q", "R") && test_find_edge(state, "Q", "S"));
+    CHECK(test_find_node(state, "click") == NULL && test_find_node(state, "callback") == NULL);
+    CHECK(test_find_edge(state, "T", "U") != NULL);
+    CHECK(state->node_count == 11 && state->edge_count == 7);
+    ir_flowchart_free_component(flowchart);
+}
+
+// A shape on an edge target applies, and "-- text -->" keeps only the text
+static void test_parse_edge_targets(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart LR\n"
+        "    A --> B{Decision}\n"
+        "    B -- on fire --> C((Done))\n"
+        "    B -->|no| D\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    IRFlowchartNodeData* b = test_find_node(state, "B");
+    CHECK(b && b->shape == IR_FLOWCHART_SHAPE_DIAMOND && b->label && strcmp(b->label, "Decision") == 0);
+    IRFlowchartNodeData* c = test_find_node(state, "C");
+    CHECK(c && c->shape == IR_FLOWCHART_SHAPE_CIRCLE && c->label && strcmp(c->label, "Done") == 0);
+    IRFlowchartEdgeData* labelled = test_find_edge(state, "B", "C");
+    CHECK(labelled && labelled->label && strcmp(labelled->label, "on fire") == 0);
+    CHECK(labelled && labelled->type == IR_FLOWCHART_EDGE_ARROW);
+    IRFlowchartEdgeData* piped = test_find_edge(state, "B", "D");
+    CHECK(piped && piped->label && strcmp(piped->label, "no") == 0);
+    ir_flowchart_free_component(flowchart);
+}
+
+// The line after "subgraph" is a statement of its own, as is "direction"
+static void test_parse_subgraph_body(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart TB\n"
+        "    subgraph group [Group]\n"
+        "        A --> B\n"
+        "        direction LR\n"
+        "    end\n"
+        "    B --> C\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    CHECK(state->subgraph_count == 1);
+    IRFlowchartSubgraphData* group = state->subgraph_count == 1 ? state->subgraphs[0] : NULL;
+    CHECK(group && group->title && strcmp(group->title, "Group") == 0);
+    CHECK(group && group->direction == IR_FLOWCHART_DIR_LR);
+    IRFlowchartNodeData* a = test_find_node(state, "A");
+    IRFlowchartNodeData* c = test_find_node(state, "C");
+    CHECK(a && a->subgraph_index == 0);
+    CHECK(c && c->subgraph_index == IR_FLOWCHART_INVALID_INDEX);
+    CHECK(test_find_edge(state, "A", "B") != NULL);
+    ir_flowchart_free_component(flowchart);
+}
+
+// Labels quoted as a whole lose their quotes in every shape; CRLF line
+// ends leave nothing behind in IDs or labels
+static void test_parse_labels(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart TB\r\n"
+        "    A[\"x [y]\"] --> B(\"x [y]\")\r\n"
+        "    C{\"a {b}\"} --> D((\"round\"))\r\n"
+        "    E[\"<b>kept</b>\"] --> F[<b>bold</b>]\r\n"
+        "    G --> H[Tail]\r\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    static const struct { const char* id; const char* label; } expected[] = {
+        { "A", "x [y]" }, { "B", "x [y]" }, { "C", "a {b}" }, { "D", "round" },
+        { "E", "<b>kept</b>" }, { "F", "bold" }, { "H", "Tail" },
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        IRFlowchartNodeData* node = test_find_node(state, expected[i].id);
+        CHECK(node && node->label && strcmp(node->label, expected[i].label) == 0);
+    }
+    CHECK(test_find_edge(state, "G", "H") != NULL);
+    CHECK(state->node_count == 8);
+    ir_flowchart_free_component(flowchart);
+}
+
+// ============================================================================
+// Finalization
+// ============================================================================
+
+// Registries, handles, containers, styles and the layout a finalized chart
+// ends up with, flattened for comparison
+static size_t test_capture(IRComponent* flowchart, char* out, size_t capacity) {
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    size_t length = 0;
+#define TEST_EMIT(...) do { \
+        if (length < capacity) length += (size_t)snprintf(out + length, capacity - length, __VA_ARGS__); \
+    } while (0)
+    TEST_EMIT("%u %u %u\n", state->node_count, state->edge_count, state->subgraph_count);
+    for (uint32_t i = 0; i < state->node_count; i++) {
+        const IRFlowchartNodeData* node = state->nodes[i];
+        TEST_EMIT("n %s %llx %u %x %x %.2f %.2f\n", node->node_id, (unsigned long long)node->handle,
+                  node->subgraph_index, node->fill_color, node->style_flags, state->node_x[i], state->node_y[i]);
+    }
+    for (uint32_t i = 0; i < state->edge_count; i++) {
+        const IRFlowchartEdgeData* edge = state->edges[i];
+        TEST_EMIT("e %u %u %llx %x %x %u\n", edge->from_index, edge->to_index, (unsigned long long)edge->handle,
+                  edge->stroke_color, edge->style_flags, edge->path_point_count);
+    }
+    for (uint32_t s = 0; s < state->subgraph_count; s++) {
+        const IRFlowchartSubgraphData* subgraph = state->subgraphs[s];
+        TEST_EMIT("s %s %llx %u:", subgraph->subgraph_id, (unsigned long long)subgraph->handle, subgraph->parent_index);
+        for (uint32_t m = state->subgraph_member_offsets[s]; m < state->subgraph_member_offsets[s + 1]; m++) {
+            TEST_EMIT(" %u", state->subgraph_members[m]);
+        }
+        TEST_EMIT("\n");
+    }
+#undef TEST_EMIT
+    return length;
+}
+
+static void test_refinalize_idempotent(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart LR\n"
+        "    classDef hot fill:#ff0000\n"
+        "    A[Start] --> B{Check}\n"
+        "    subgraph outer [Outer]\n"
+        "        C --> D\n"
+        "        subgraph inner\n"
+        "            E --> F\n"
+        "        end\n"
+        "    end\n"
+        "    B -->|yes| C\n"
+        "    B -.-> E\n"
+        "    F ==> A\n"
+        "    class B,E hot\n"
+        "    linkStyle 1 stroke:#00ff00\n"
+        "    linkStyle default stroke-width:2px\n");
+    if (!flowchart) return;
+
+    static char first[8192], again[8192];
+    ir_layout_compute_flowchart(flowchart, 800.0f, 600.0f);
+    size_t first_length = test_capture(flowchart, first, sizeof(first));
+    CHECK(first_length < sizeof(first));
+
+    for (int pass = 0; pass < 3; pass++) {
+        ir_flowchart_finalize(flowchart);
+        CHECK(!ir_get_flowchart_state(flowchart)->layout_computed);
+        ir_layout_compute_flowchart(flowchart, 800.0f, 600.0f);
+        size_t length = test_capture(flowchart, again, sizeof(again));
+        CHECK(length == first_length && memcmp(first, again, length) == 0);
+    }
+    ir_flowchart_free_component(flowchart);
+}
+
+// ============================================================================
+// Styles
+// ============================================================================
+
+static const char* g_link_style_source =
+    "flowchart TB\n"
+    "    A --> B\n"
+    "    X --> Y\n"
+    "    P --> Q\n"
+    "    linkStyle 0 stroke:#123456\n"
+    "    linkStyle 2 stroke:#abcdef,stroke-width:3px\n";
+
+static void test_link_style_swap_remove(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart TB\n"
+        "    A --> B\n"
+        "    X --> Y\n"
+        "    linkStyle 0 stroke:#123456\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    // X --> Y moves into index 0, which linkStyle 0 gave to A --> B
+    IRFlowchartNodeData* a = ir_flowchart_find_node(state, "A");
+    CHECK(a && ir_flowchart_swap_remove_node(flowchart, a->handle));
+    ir_flowchart_finalize(flowchart);
+
+    IRFlowchartEdgeData* xy = test_find_edge(state, "X", "Y");
+    CHECK(state->edge_count == 1);
+    CHECK(xy && xy->style_flags == 0 && xy->style_class == 0);
+    ir_flowchart_free_component(flowchart);
+}
+
+static void test_link_style_refinalize(void) {
+    IRComponent* flowchart = test_parse(g_link_style_source);
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    CHECK(ir_flowchart_remove_edge(flowchart, "A", "B"));
+    for (int pass = 0; pass < 2; pass++) {
+        ir_flowchart_finalize(flowchart);
+        IRFlowchartEdgeData* xy = test_find_edge(state, "X", "Y");
+        IRFlowchartEdgeData* pq = test_find_edge(state, "P", "Q");
+        CHECK(state->edge_count == 2);
+        CHECK(xy && xy->style_flags == 0 && xy->style_class == 0);
+        CHECK(pq && pq->stroke_color == 0xabcdefff && pq->stroke_width == 3.0f);
+    }
+
+    // linkStyle for an index now names the edge registered there
+    IRFlowchartStyle style = {0};
+    style.stroke_color = 0x00ff00ff;
+    style.flags = IR_FLOWCHART_STYLE_STROKE;
+    CHECK(ir_flowchart_set_link_style(state, 0, &style));
+    ir_flowchart_finalize(flowchart);
+    CHECK(strcmp(state->edges[0]->from_id, "X") == 0 && state->edges[0]->stroke_color == 0x00ff00ff);
+    CHECK(strcmp(state->edges[1]->from_id, "P") == 0 && state->edges[1]->stroke_color == 0xabcdefff);
+    ir_flowchart_free_component(flowchart);
+}
+
+// Class lookups go through the style index: one entry per class name and one
+// per distinct class list, whatever the number of classes
+static void test_class_entries_shared(void) {
+    IRComponent* flowchart = test_parse("flowchart TB\n    n0 --> n1\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    enum { CLASSES = 300, NODES = 64 };
+    char name[32];
+    for (uint32_t i = 0; i < CLASSES; i++) {
+        IRFlowchartStyle style = {0};
+        style.fill_color = (i << 8) | 0xff;
+        style.flags = IR_FLOWCHART_STYLE_FILL;
+        snprintf(name, sizeof(name), "c%u", i);
+        CHECK(ir_flowchart_define_class(state, name, &style));
+    }
+    CHECK(state->style_count == CLASSES);
+
+    // Node k gets classes (k % 8) then (100 + k / 8 % 4): 8 x 4 distinct lists
+    IRFlowchartNodeData* nodes[NODES];
+    for (uint32_t k = 0; k < NODES; k++) {
+        snprintf(name, sizeof(name), "m%u", k);
+        nodes[k] = ir_flowchart_node_data_create_in(state, name, IR_FLOWCHART_SHAPE_RECTANGLE, name);
+        CHECK(nodes[k] != NULL);
+        if (!nodes[k]) continue;
+        snprintf(name, sizeof(name), "c%u", k % 8);
+        CHECK(ir_flowchart_node_add_class(state, nodes[k], name));
+        snprintf(name, sizeof(name), "c%u", 100 + k / 8 % 4);
+        CHECK(ir_flowchart_node_add_class(state, nodes[k], name));
+    }
+    CHECK(state->style_count == CLASSES + 8 * 4);
+
+    ir_flowchart_compile_styles(state);
+    for (uint32_t k = 0; k < NODES; k++) {
+        if (!nodes[k]) continue;
+        CHECK(nodes[k]->style_class == nodes[k % 32]->style_class);
+        ir_flowchart_apply_node_style(state, nodes[k]);
+        CHECK(nodes[k]->fill_color == (((100 + k / 8 % 4) << 8) | 0xff));
+        ir_flowchart_node_data_destroy(nodes[k]);
+    }
+    ir_flowchart_free_component(flowchart);
+}
+
+// Every edge but the removed ones keeps the stroke it had, however often the
+// flowchart is finalized again
+static void test_link_style_removals_keep_styles(void) {
+    char source[4096];
+    int length = snprintf(source, sizeof(source), "flowchart LR\n");
+    for (int i = 0; i < 24; i++) {
+        length += snprintf(source + length, sizeof(source) - length, "    n%d --> n%d\n", i, i + 1);
+    }
+    for (int i = 0; i < 24; i += 3) {
+        length += snprintf(source + length, sizeof(source) - length,
+                           "    linkStyle %d stroke:#%06x\n", i, 0x101010 * (i / 3 + 1));
+    }
+    IRComponent* flowchart = test_parse(source);
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    // Stroke by source node number, 0 when unstyled
+    uint32_t expected[24];
+    for (uint32_t i = 0; i < state->edge_count; i++) {
+        IRFlowchartEdgeData* edge = state->edges[i];
+        expected[atoi(edge->from_id + 1)] = edge->style_flags ? edge->stroke_color : 0;
+    }
+
+    const char* removed[][2] = { { "n0", "n1" }, { "n4", "n5" }, { "n13", "n14" } };
+    for (size_t r = 0; r < sizeof(removed) / sizeof(removed[0]); r++) {
+        CHECK(ir_flowchart_remove_edge(flowchart, removed[r][0], removed[r][1]));
+        for (int pass = 0; pass < 2; pass++) {
+            ir_flowchart_finalize(flowchart);
+            CHECK(state->edge_count == 24 - (r + 1));
+            for (uint32_t i = 0; i < state->edge_count; i++) {
+                IRFlowchartEdgeData* edge = state->edges[i];
+                uint32_t stroke = edge->style_flags ? edge->stroke_color : 0;
+                CHECK(stroke == expected[atoi(edge->from_id + 1)]);
+            }
+        }
+    }
+    ir_flowchart_free_component(flowchart);
+}
+
+// ============================================================================
+// Cache
+// ============================================================================
+
+// Lookups find entries by key among many; eviction still follows recency
+static void test_cache_lookup_and_eviction(void) {
+    enum { CAPACITY = 64, CHARTS = 100 };
+    ir_flowchart_cache_clear();
+    ir_flowchart_cache_set_capacity(CAPACITY);
+    ir_flowchart_cache_reset_stats();
+
+    char source[64];
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < CHARTS; i++) {
+            // Second pass: only the last CAPACITY charts are still cached
+            if (pass == 1 && i < CHARTS - CAPACITY) continue;
+            snprintf(source, sizeof(source), "flowchart TB\n    a%d --> b%d\n", i, i);
+            IRComponent* flowchart = test_parse(source);
+            if (!flowchart) continue;
+            CHECK(ir_get_flowchart_state(flowchart)->node_count == 2);
+            ir_flowchart_free_component(flowchart);
+        }
+    }
+
+    IRFlowchartCacheStats stats;
+    ir_flowchart_cache_get_stats(&stats);
+    CHECK(stats.entries == CAPACITY);
+    CHECK(stats.parse_misses == CHARTS);
+    CHECK(stats.parse_hits == CAPACITY);
+    CHECK(stats.evictions == CHARTS - CAPACITY);
+
+    // The oldest chart was evicted
+    snprintf(source, sizeof(source), "flowchart TB\n    a%d --> b%d\n", 0, 0);
+    IRComponent* flowchart = test_parse(source);
+    if (flowchart) ir_flowchart_free_component(flowchart);
+    ir_flowchart_cache_get_stats(&stats);
+    CHECK(stats.parse_misses == CHARTS + 1);
+
+    ir_flowchart_cache_set_capacity(0);
+}
+
+// Component tree and style tables, flattened for comparison (with test_capture)
+static size_t test_capture_styles(IRComponent* component, char* out, size_t capacity, size_t length) {
+#define TEST_EMIT(...) do { \
+        if (length < capacity) length += (size_t)snprintf(out + length, capacity - length, __VA_ARGS__); \
+    } while (0)
+    if (component->type == IR_COMPONENT_FLOWCHART) {
+        IRFlowchartState* state = ir_get_flowchart_state(component);
+        TEST_EMIT("styles %u default %u link default %u:", state->style_count, state->default_class,
+                  state->link_style_default);
+        for (uint32_t i = 0; i < state->style_count; i++) {
+            const IRFlowchartStyle* style = &state->styles[i];
+            TEST_EMIT(" [%s %u %u %x %x %x %.1f]", style->name ? style->name : "-", style->base, style->top,
+                      style->flags, style->fill_color, style->stroke_color, style->stroke_width);
+        }
+        TEST_EMIT("\nlink styles:");
+        for (uint32_t i = 0; i < state->link_style_count; i++) TEST_EMIT(" %u", state->link_styles[i]);
+        TEST_EMIT("\n");
+    } else if (component->type == IR_COMPONENT_FLOWCHART_NODE) {
+        const IRFlowchartNodeData* node = ir_get_flowchart_node_data(component);
+        TEST_EMIT("node %s %s cls %u\n", node->node_id, node->label, node->style_class);
+    } else if (component->type == IR_COMPONENT_FLOWCHART_EDGE) {
+        const IRFlowchartEdgeData* edge = ir_get_flowchart_edge_data(component);
+        TEST_EMIT("edge %s %s %s cls %u %d\n", edge->from_id, edge->to_id, edge->label ? edge->label : "-",
+                  edge->style_class, edge->link_style_resolved);
+    } else if (component->type == IR_COMPONENT_FLOWCHART_SUBGRAPH) {
+        TEST_EMIT("subgraph %s {\n", ir_get_flowchart_subgraph_data(component)->subgraph_id);
+    }
+    for (uint32_t i = 0; i < component->child_count; i++) {
+        length = test_capture_styles(component->children[i], out, capacity, length);
+    }
+    if (component->type == IR_COMPONENT_FLOWCHART_SUBGRAPH) TEST_EMIT("}\n");
+#undef TEST_EMIT
+    return length;
+}
+
+// A cache hit hands back the chart a miss builds, style tables included,
+// and later style edits act on both alike
+static void test_cache_hit_matches_miss(void) {
+    const char* source =
+        "flowchart LR\n"
+        "    classDef default stroke-width:2px\n"
+        "    classDef hot fill:#f96\n"
+        "    classDef cold stroke:#00f\n"
+        "    A[Alpha] --> B --> C\n"
+        "    subgraph group [Group]\n"
+        "        C -->|yes| D\n"
+        "    end\n"
+        "    class A hot\n"
+        "    class B,C hot\n"
+        "    class C cold\n"
+        "    linkStyle 1 stroke:#0f0\n"
+        "    linkStyle default stroke:#999\n";
+    ir_flowchart_cache_clear();
+    ir_flowchart_cache_set_capacity(8);
+    ir_flowchart_cache_reset_stats();
+
+    IRComponent* charts[2] = { test_parse(source), test_parse(source) };
+    IRFlowchartCacheStats stats;
+    ir_flowchart_cache_get_stats(&stats);
+    CHECK(stats.parse_misses == 1 && stats.parse_hits == 1);
+
+    static char captures[2][8192];
+    for (int round = 0; round < 2 && charts[0] && charts[1]; round++) {
+        for (int c = 0; c < 2; c++) {
+            size_t length = test_capture(charts[c], captures[c], sizeof(captures[c]));
+            test_capture_styles(charts[c], captures[c], sizeof(captures[c]), length);
+        }
+        CHECK(strstr(captures[0], "node A Alpha cls 0") == NULL);
+        CHECK(strcmp(captures[0], captures[1]) == 0);
+
+        // The same edits on both, then compared again
+        for (int c = 0; c < 2 && round == 0; c++) {
+            IRFlowchartState* state = ir_get_flowchart_state(charts[c]);
+            IRFlowchartStyle warm = { .flags = IR_FLOWCHART_STYLE_FILL, .fill_color = 0x112233FF };
+            CHECK(ir_flowchart_define_class(state, "hot", &warm));
+            CHECK(ir_flowchart_node_add_class(state, state->nodes[3], "cold"));
+            CHECK(ir_flowchart_set_link_style(state, 0, &warm));
+            ir_flowchart_finalize(charts[c]);
+        }
+    }
+
+    for (int c = 0; c < 2; c++) {
+        if (charts[c]) ir_flowchart_free_component(charts[c]);
+    }
+    ir_flowchart_cache_set_capacity(0);
+}
+
+// ============================================================================
+// Terminal Renderer
+// ============================================================================
+
+// render_node_terminal finds the geometry through the node's flowchart,
+// nested subgraphs included, and draws what render_node_terminal_in does
+static void test_render_node_wrapper(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart TB\n"
+        "    subgraph outer\n"
+        "        subgraph inner\n"
+        "            A[Alpha] --> B((Beta))\n"
+        "        end\n"
+        "    end\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    ir_layout_compute_flowchart(flowchart, 400.0f, 300.0f);
+
+    TerminalCapabilities caps = {0};
+    caps.max_cols = 80;
+    caps.max_rows = 30;
+    TerminalScaling scale = calculate_scaling(state, caps.max_cols, caps.max_rows);
+    TerminalBuffer* wrapped = terminal_buffer_create(caps.max_cols, caps.max_rows);
+    TerminalBuffer* direct = terminal_buffer_create(caps.max_cols, caps.max_rows);
+    CHECK(wrapped && direct);
+    if (wrapped && direct) {
+        terminal_buffer_clear(wrapped);
+        terminal_buffer_clear(direct);
+        for (uint32_t i = 0; i < state->node_count; i++) {
+            render_node_terminal(wrapped, state->nodes[i], &scale, &caps);
+            render_node_terminal_in(direct, state, state->nodes[i], &scale, &caps);
+        }
+        bool drawn = false, same = true;
+        for (int row = 0; row < caps.max_rows; row++) {
+            same = same && memcmp(wrapped->chars[row], direct->chars[row], (size_t)caps.max_cols) == 0;
+            drawn = drawn || memchr(direct->chars[row], 'A', (size_t)caps.max_cols) != NULL;
+        }
+        CHECK(drawn);
+        CHECK(same);
+    }
+    terminal_buffer_destroy(wrapped);
+    terminal_buffer_destroy(direct);
+    ir_flowchart_free_component(flowchart);
+}
+
+// Render to a string (caller frees)
+static char* test_render(const IRFlowchartSnapshot* snapshot, IRComponent* flowchart,
+                         const TerminalCapabilities* caps) {
+    FILE* out = tmpfile();
+    CHECK(out != NULL);
+    if (!out) return NULL;
+    bool ok = snapshot ? render_flowchart_terminal_snapshot_to(out, snapshot, caps)
+                       : render_flowchart_terminal_to(out, flowchart, caps);
+    CHECK(ok);
+
+    long length = ftell(out);
+    char* text = (char*)calloc((size_t)(length > 0 ? length : 0) + 1, 1);
+    rewind(out);
+    if (text && length > 0) CHECK(fread(text, 1, (size_t)length, out) == (size_t)length);
+    fclose(out);
+    return text;
+}
+
+// A snapshot draws what the live state drew when it was published, and
+// keeps doing so while the flowchart is edited and after it is destroyed
+static void test_render_from_snapshot(void) {
+    IRComponent* flowchart = test_parse(
+        "flowchart LR\n"
+        "    A[Alpha] --> B((Beta))\n"
+        "    B -.->|maybe| C{Gamma}\n"
+        "    subgraph group [Group]\n"
+        "        C <--> D[(Delta)]\n"
+        "    end\n"
+        "    style A fill:#f9f\n");
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+    TerminalCapabilities caps = {0};
+    caps.max_cols = 100;
+    caps.max_rows = 30;
+    ir_layout_compute_flowchart(flowchart, 800.0f, 300.0f);
+    CHECK(ir_flowchart_snapshot_publish(flowchart));
+
+    const IRFlowchartSnapshot* snapshot = ir_flowchart_snapshot_acquire(flowchart);
+    CHECK(snapshot != NULL);
+    if (!snapshot) {
+        ir_flowchart_free_component(flowchart);
+        return;
+    }
+
+    IRFlowchartSnapshotNode node;
+    CHECK(ir_flowchart_snapshot_node(snapshot, 0, &node));
+    CHECK(node.label && strcmp(node.label, state->nodes[0]->label) == 0);
+    CHECK(node.label_length == strlen(state->nodes[0]->label));
+    CHECK(node.fill_color == state->nodes[0]->fill_color && node.shape == state->nodes[0]->shape);
+    IRFlowchartSnapshotEdge edge;
+    CHECK(ir_flowchart_snapshot_edge(snapshot, 1, &edge));
+    CHECK(edge.type == state->edges[1]->type && edge.label && strcmp(edge.label, "maybe") == 0);
+    IRFlowchartSnapshotSubgraph subgraph;
+    CHECK(ir_flowchart_snapshot_subgraph(snapshot, 0, &subgraph));
+    CHECK(subgraph.title && strcmp(subgraph.title, "Group") == 0);
+
+    char* live = test_render(NULL, flowchart, &caps);
+    char* published = test_render(snapshot, NULL, &caps);
+    CHECK(live && published && strcmp(live, published) == 0);
+    CHECK(live && strstr(live, "Alpha") != NULL);
+
+    // Edits after the publish do not reach the snapshot
+    CHECK(ir_flowchart_set_label(flowchart, "A", "Changed"));
+    CHECK(ir_flowchart_remove_edge(flowchart, "A", "B"));
+    ir_flowchart_free_component(flowchart);
+
+    char* later = test_render(snapshot, NULL, &caps);
+    CHECK(published && later && strcmp(published, later) == 0);
+
+    ir_flowchart_snapshot_release(snapshot);
+    free(live);
+    free(published);
+    free(later);
+}
+
+// Label storage of node `index`, which moves only when its chunk is rebuilt
+static const char* test_snapshot_label(const IRFlowchartSnapshot* snapshot, uint32_t index) {
+    IRFlowchartSnapshotNode node;
+    CHECK(ir_flowchart_snapshot_node(snapshot, index, &node));
+    return node.label;
+}
+
+// A publish rebuilds the chunks the mutations marked and shares the rest,
+// including after a layout that left their geometry alone
+static void test_snapshot_reuses_clean_chunks(void) {
+    IRComponent* flowchart = ir_flowchart(IR_FLOWCHART_DIR_LR);
+    CHECK(flowchart != NULL);
+    if (!flowchart) return;
+    IRFlowchartState* state = ir_get_flowchart_state(flowchart);
+
+    // Unconnected nodes: relabelling one leaves the others in place
+    char id[16], label[16];
+    for (uint32_t i = 0; i < 3 * IR_FLOWCHART_SNAPSHOT_CHUNK; i++) {
+        snprintf(id, sizeof(id), "n%u", i);
+        snprintf(label, sizeof(label), "Node %u", i);
+        CHECK(ir_flowchart_add_node(flowchart, id, IR_FLOWCHART_SHAPE_RECTANGLE, label) != NULL);
+    }
+    uint32_t last = state->node_count - 1;
+    ir_layout_compute_flowchart(flowchart, 4000.0f, 4000.0f);
+    CHECK(ir_flowchart_snapshot_publish(flowchart));
+    const IRFlowchartSnapshot* first = ir_flowchart_snapshot_acquire(flowchart);
+
+    // A style setter marks its node's chunk only
+    ir_flowchart_node_set_fill_color(state->nodes[last], 0x112233FF);
+    CHECK(ir_flowchart_snapshot_publish(flowchart));
+    const IRFlowchartSnapshot* second = ir_flowchart_snapshot_acquire(flowchart);
+    IRFlowchartSnapshotNode node;
+    CHECK(ir_flowchart_snapshot_node(second, last, &node) && node.fill_color == 0x112233FF);
+    CHECK(test_snapshot_label(first, 0) == test_snapshot_label(second, 0));
+    CHECK(test_snapshot_label(first, last) != test_snapshot_label(second, last));
+
+    // A relabel rebuilds the chunk holding the node; a relayout that moves
+    // nothing (the label keeps its length) leaves the others shared
+    CHECK(ir_flowchart_set_label(flowchart, "n1", "Edit 1"));
+    ir_layout_compute_flowchart(flowchart, 4000.0f, 4000.0f);
+    CHECK(ir_flowchart_snapshot_publish(flowchart));
+    const IRFlowchartSnapshot* third = ir_flowchart_snapshot_acquire(flowchart);
+    CHECK(ir_flowchart_snapshot_node(third, 1, &node) && node.label && strcmp(node.label, "Edit 1") == 0);
+    CHECK(ir_flowchart_snapshot_node(third, 1, &node) && node.width == state->node_width[1]);
+    CHECK(test_snapshot_label(second, last) == test_snapshot_label(third, last));
+
+    // Direct writes take an invalidation
+    state->nodes[last]->shape = IR_FLOWCHART_SHAPE_DIAMOND;
+    ir_flowchart_snapshot_invalidate(flowchart);
+    CHECK(ir_flowchart_snapshot_publish(flowchart));
+    const IRFlowchartSnapshot* fourth = ir_flowchart_snapshot_acquire(flowchart);
+    CHECK(ir_flowchart_snapshot_node(fourth, last, &node) && node.shape == IR_FLOWCHART_SHAPE_DIAMOND);
+
+    ir_flowchart_snapshot_release(first);
+    ir_flowchart_snapshot_release(second);
+    ir_flowchart_snapshot_release(third);
+    ir_flowchart_snapshot_release(fourth);
+    ir_flowchart_free_component(flowchart);
+}
+
+// ============================================================================
+// Direct KIR Output
+// ============================================================================
+
+// Growable text for the KIR projection
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TestText;
+
+static void test_text_add(TestText* text, const char* data, size_t length) {
+    if (text->length + length + 1 > text->capacity) {
+        size_t new_capacity = text->capacity == 0 ? 256 : text->capacity;
+        while (new_capacity < text->length + length + 1) new_capacity *= 2;
+        char* new_data = (char*)realloc(text->data, new_capacity);
+        if (!new_data) return;
+        text->data = new_data;
+        text->capacity = new_capacity;
+    }
+    memcpy(text->data + text->length, data, length);
+    text->length += length;
+    text->data[text->length] = '\0';
+}
+
+static void test_json_space(const char** json) {
+    while (**json == ' ' || **json == '\n' || **json == '\r' || **json == '\t') (*json)++;
+}
+
+// Skip one JSON value, appending it without whitespace to out (if not NULL)
+static bool test_json_value(const char** json, TestText* out) {
+    test_json_space(json);
+    const char* start = *json;
+    char c = **json;
+    if (c == '"') {
+        for ((*json)++; **json != '"'; (*json)++) {
+            if (**json == '\0') return false;
+            if (**json == '\\') (*json)++;
+        }
+        (*json)++;
+    } else if (c == '{' || c == '[') {
+        char close = c == '{' ? '}' : ']';
+        (*json)++;
+        if (out) test_text_add(out, &c, 1);
+        test_json_space(json);
+        while (**json != close) {
+            if (c == '{') {
+                if (!test_json_value(json, out)) return false;
+                test_json_space(json);
+                if (*(*json)++ != ':') return false;
+                if (out) test_text_add(out, ":", 1);
+            }
+            if (!test_json_value(json, out)) return false;
+            test_json_space(json);
+            if (**json == ',') {
+                (*json)++;
+                if (out) test_text_add(out, ",", 1);
+            } else if (**json != close) {
+                return false;
+            }
+        }
+        (*json)++;
+        if (out) test_text_add(out, &close, 1);
+        return true;
+    } else {
+        while (**json && strchr(",]} \n\r\t", **json) == NULL) (*json)++;
+        if (*json == start) return false;
+    }
+    if (out) test_text_add(out, start, (size_t)(*json - start));
+    return true;
+}
+
+// What of a KIR component both writers must agree on: its type, its
+// flowchart payload (keys, order and values) and its children, in order.
+// Other component fields (IDs, ...) belong to the core and are skipped.
+static bool test_kir_project(const char** json, TestText* out) {
+    test_json_space(json);
+    if (*(*json)++ != '{') return false;
+
+    TestText type = {0}, payload = {0}, children = {0};
+    bool ok = true;
+    test_json_space(json);
+    while (ok && **json != '}') {
+        const char* key = *json + 1;
+        ok = test_json_value(json, NULL);
+        size_t key_length = (size_t)(*json - key) - 1;
+        test_json_space(json);
+        ok = ok && *(*json)++ == ':';
+        if (!ok) break;
+
+        if (key_length == 4 && strncmp(key, "type", 4) == 0) {
+            ok = test_json_value(json, &type);
+        } else if (key_length > 9 && strncmp(key, "flowchart", 9) == 0) {
+            test_text_add(&payload, key, key_length);
+            test_text_add(&payload, "=", 1);
+            ok = test_json_value(json, &payload);
+        } else if (key_length == 8 && strncmp(key, "children", 8) == 0) {
+            test_json_space(json);
+            ok = *(*json)++ == '[';
+            test_json_space(json);
+            while (ok && **json != ']') {
+                ok = test_kir_project(json, &children);
+                test_json_space(json);
+                if (**json == ',') (*json)++;
+                test_json_space(json);
+            }
+            if (ok) (*json)++;
+        } else {
+            ok = test_json_value(json, NULL);
+        }
+        test_json_space(json);
+        if (**json == ',') (*json)++;
+        test_json_space(json);
+    }
+    if (ok) {
+        (*json)++;
+        if (type.data) test_text_add(out, type.data, type.length);
+        if (payload.data) test_text_add(out, payload.data, payload.length);
+        test_text_add(out, "[\n", 2);
+        if (children.data) test_text_add(out, children.data, children.length);
+        test_text_add(out, "]\n", 2);
+    }
+    free(type.data);
+    free(payload.data);
+    free(children.data);
+    return ok;
+}
+
+// ir_flowchart_to_kir_direct must describe the same document as
+// serializing the parsed tree with the core's ir_serialize_json_v2
+static void test_kir_check_direct(const char* source) {
+    size_t length = strlen(source);
+    char* tree = ir_flowchart_to_kir(source, length);
+    size_t direct_length = 0;
+    char* direct = ir_flowchart_to_kir_direct(source, length, &direct_length);
+    CHECK(tree != NULL);
+    CHECK(direct != NULL);
+    if (tree && direct) {
+        CHECK(direct_length == strlen(direct));
+
+        TestText want = {0}, got = {0};
+        const char* cursor = tree;
+        CHECK(test_kir_project(&cursor, &want));
+        cursor = direct;
+        CHECK(test_kir_project(&cursor, &got));
+        test_json_space(&cursor);
+        CHECK(*cursor == '\0');
+        CHECK(want.data && got.data && strcmp(want.data, got.data) == 0);
+        if (want.data && got.data && strcmp(want.data, got.data) != 0) {
+            size_t at = 0;
+            while (want.data[at] == got.data[at]) at++;
+            size_t from = at > 80 ? at - 80 : 0;
+            fprintf(stderr, "  tree:   ...%.160s\n  direct: ...%.160s\n", want.data + from, got.data + from);
+        }
+        free(want.data);
+        free(got.data);
+    }
+    free(tree);
+    free(direct);
+}
+
+static void test_kir_direct_matches_tree(void) {
+    // Styles after the elements they change, a subgraph direction, edges
+    // declared inside subgraphs, nodes after the last style line and a
+    // subgraph the source leaves open
+    test_kir_check_direct(
+        "flowchart LR\n"
+        "  A[Start \"q\"] --> B{Ok?}\n"
+        "  B -->|yes\\no| C((Done))\n"
+        "  subgraph s1 [Group]\n"
+        "    direction RL\n"
+        "    D --> E\n"
+        "    subgraph s2\n"
+        "      F-.->G\n"
+        "    end\n"
+        "    H\n"
+        "  end\n"
+        "  B -- no --> A\n"
+        "  classDef hot fill:#f96,stroke-width:3px\n"
+        "  class A,E hot\n"
+        "  style A fill:#f9f,stroke:#333\n"
+        "  linkStyle 1 stroke:#0f0,stroke-width:2px\n"
+        "  C --> D; linkStyle default stroke:#00f\n"
+        "  I[Tail] ==> A\n"
+        "  subgraph open\n"
+        "    X-->Y\n");
+
+    // Nothing to hold back
+    test_kir_check_direct("graph TB\nX-->Y\nY==>Z\nend\nend\n");
+
+    // One style line at the very end reaches back to the first node
+    TestText source = {0};
+    const char* header = "flowchart TB\n";
+    test_text_add(&source, header, strlen(header));
+    for (int i = 1; i < 6000; i++) {
+        char line[96];
+        int n = (i % 500 == 0) ? snprintf(line, sizeof(line), "subgraph g%d [Group %d]\n", i, i) : 0;
+        n += snprintf(line + n, sizeof(line) - (size_t)n, "  n%d[Node %d] --> n%d\n", (i * 7919) % i, i, i);
+        if (i % 500 == 250) n += snprintf(line + n, sizeof(line) - (size_t)n, "end\n");
+        test_text_add(&source, line, (size_t)n);
+    }
+    const char* tail = "style n0 fill:#123456\nlinkStyle 0 stroke:#abcdef\n";
+    test_text_add(&source, tail, strlen(tail));
+    if (source.data) test_kir_check_direct(source.data);
+    free(source.data);
+}
+
+// ============================================================================
+// Driver
+// ============================================================================
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} FlowchartTest;
+
+static const FlowchartTest g_tests[] = {
+    { "parse_statements", test_parse_statements },
+    { "parse_edge_targets", test_parse_edge_targets },
+    { "parse_subgraph_body", test_parse_subgraph_body },
+    { "parse_labels", test_parse_labels },
+    { "refinalize_idempotent", test_refinalize_idempotent },
+    { "class_entries_shared", test_class_entries_shared },
+    { "link_style_swap_remove", test_link_style_swap_remove },
+    { "link_style_refinalize", test_link_style_refinalize },
+    { "link_style_removals_keep_styles", test_link_style_removals_keep_styles },
+    { "cache_lookup_and_eviction", test_cache_lookup_and_eviction },
+    { "cache_hit_matches_miss", test_cache_hit_matches_miss },
+    { "render_node_wrapper", test_render_node_wrapper },
+    { "render_from_snapshot", test_render_from_snapshot },
+    { "snapshot_reuses_clean_chunks", test_snapshot_reuses_clean_chunks },
+    { "kir_direct_matches_tree", test_kir_direct_matches_tree },
+};
+
+int main(int argc, char** argv) {
+    size_t test_count = sizeof(g_tests) / sizeof(g_tests[0]);
+    int run = 0;
+    for (size_t i = 0; i < test_count; i++) {
+        bool selected = argc < 2;
+        for (int a = 1; a < argc && !selected; a++) {
+            selected = strcmp(argv[a], g_tests[i].name) == 0;
+        }
+        if (!selected) continue;
+
+        int before = g_failures;
+        g_tests[i].run();
+        printf("%-32s %s\n", g_tests[i].name, g_failures == before ? "ok" : "FAILED");
+        run++;
+    }
+
+    printf("%d tests, %d failed checks\n", run, g_failures);
+    return g_failures == 0 && run > 0 ? 0 : 1;
+}